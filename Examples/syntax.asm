@@ -58,6 +58,19 @@ instr1  LOAD    R00, @op2  // chargement adresse op2 (2)
         LOAD    R03, #op2 // chargement d'une valeur immédiate
         LOAD    R03, #-2 // ici, équivalent au précédent
 
+        // Préfixe EXT : opérandes plus grands que leur champ
+        //---------------------------------------------------
+        // Une adresse absolue ou une valeur immédiate tient sur
+        // 20 bits, un offset sur 16 bits. Une valeur déjà connue
+        // plus grande est précédée automatiquement d'un mot EXT
+        // qui porte ses bits de poids fort (l'opérande fait alors
+        // 32 bits). Pour un symbole défini plus loin (étiquette de
+        // la section de données, par exemple), EXT doit être écrit
+        // sur la ligne qui précède l'instruction.
+        LOAD    R04, #0x12345678 // EXT ajouté automatiquement
+        EXT
+        LOAD    R04, @op2 // adresse sur 32 bits
+
         // Fin de la section de texte
         END
 
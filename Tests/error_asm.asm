@@ -0,0 +1,22 @@
+//-----------------
+// Programme refusé par simul-asm, qui signale toutes les erreurs (ligne:
+// colonne) puis sort avec le code 1 sans écrire de fichier : registre
+// inconnu, opérande registre, condition inconnue, POP immédiat, symbole
+// défini deux fois, puis, en fin d'assemblage, symbole jamais défini
+//-----------------
+        TEXT
+
+main    EQU *
+        LOAD R16, #1
+        ADD R01, R02
+        BRANCH ZZ, @main
+        STORE R01, @nowhere
+        POP #3
+main    EQU *
+        HALT
+
+        END
+
+        DATA 10
+
+        END
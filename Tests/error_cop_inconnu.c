@@ -9,7 +9,7 @@
 Instruction text[] = {
 //   type		 cop	imm	ind	regcond	operand
 //-------------------------------------------------------------
-    {.instr_absolute =  {TEST, 	 false, false, 	0, 	0	}},  // 0
+    {.instr_absolute =  {63, 	 false, false, 	0, 	0	}},  // 0 : code opération inconnu
     {.instr_absolute =  {LOAD, 	 false, false, 	1, 	1	}},  // 1
     {.instr_immediate = {SUB, 	 true, 	false, 	1, 	1	}},  // 2
     {.instr_absolute =  {BRANCH, false, false, 	LE, 	7	}},  // 3
@@ -0,0 +1,29 @@
+//-----------------
+// Récursion sans fin : la pile (28 mots) déborde au 29e appel
+// (SEGSTACK à l'adresse 0x3, count = R01 = 29)
+// Exécution enregistrée, à remonter dans le débogueur :
+//     test_simul -R -d -b Tests/error_record.bin
+// c       s'arrête sur l'erreur, que le dialogue affiche
+// rs 4    revient à l'étape 84, devant un CALL : R01 = 28
+// who 1   désigne le STORE de l'étape 84, qui a écrit 28 dans count
+// g 3     revient à l'état après le premier STORE : count = 1
+// Repartir en avant de l'erreur termine le simulateur
+//-----------------
+        TEXT 10
+
+main    EQU *
+        LOAD R01, #0
+rec     EQU *
+        ADD R01, #1
+        STORE R01, @count
+        CALL NC, @rec
+        HALT
+
+        END
+
+        DATA 30
+
+        WORD 0
+count   WORD 0
+
+        END
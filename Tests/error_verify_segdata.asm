@@ -0,0 +1,19 @@
+//-----------------
+// Vérificateur : ADD à une adresse absolue hors du segment de données,
+// réécrite en erreur au chargement
+// Résultat attendu : Erreur SEGDATA à l'adresse 0x1 (tous les moteurs)
+//-----------------
+        TEXT
+
+main    EQU *
+        LOAD R01, #1
+        ADD R01, @100
+        HALT
+
+        END
+
+        DATA 30
+
+        WORD 0
+
+        END
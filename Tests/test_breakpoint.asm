@@ -0,0 +1,40 @@
+//-----------------
+// Points d'arrêt et d'observation du mode de mise au point :
+//     test_simul -d -b Tests/test_breakpoint.bin
+// b 3 if R02 == 2      arrêt sur SUB quand R02 vaut 2 (3e tour)
+// w 4 r after 2        arrêt à la 2e lecture de tab[4] : jamais atteinte
+// w 5                  arrêt à l'écriture de sum, après la boucle
+// l                    liste les trois points
+// c                    s'arrête devant SUB (0x3), R01 = 6, R02 = 2
+// x 1                  supprime le point d'arrêt
+// c                    s'arrête après STORE R01, @sum : sum = 15
+// c                    fin du programme, R01 = 15, R02 = 5
+//-----------------
+        TEXT 20
+
+main    EQU *
+        LOAD R01, #0
+        LOAD R02, #0
+loop    EQU *
+        ADD R01, tab[R02]
+        SUB R02, #4
+        BRANCH EQ, @done
+        ADD R02, #5
+        BRANCH NC, @loop
+done    EQU *
+        ADD R02, #5
+        STORE R01, @sum
+        HALT
+
+        END
+
+        DATA 40
+
+tab     WORD 1
+        WORD 2
+        WORD 3
+        WORD 4
+        WORD 5
+sum     WORD 0
+
+        END
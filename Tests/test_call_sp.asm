@@ -0,0 +1,23 @@
+//-----------------
+// CALL indexé par SP : l'adresse utilise SP après l'empilement
+// Tous les moteurs (-e switch, threaded, jit) doivent finir avec R01 = 1
+//-----------------
+        TEXT 20
+
+main    EQU *
+        CALL NC, -25[R15]       // SP = 29 → 28 ; cible 28 - 25 = 3
+        HALT
+        HALT
+        BRANCH NC, @ok          // cible attendue
+        LOAD R01, #-1           // cible calculée avec l'ancien SP
+        HALT
+ok      LOAD R01, #1
+        HALT
+
+        END
+
+        DATA 30
+
+        WORD 0
+
+        END
@@ -0,0 +1,57 @@
+//-----------------
+// Appels imbriqués : main appelle 3 fois sum, qui appelle 8 fois elem ;
+// total = R01 = 108 sur tous les moteurs
+// Graphe de flot (-G cfg.dot) : 3 sous-programmes (0x0000, 0x0007, 0x000f),
+// 10 blocs de base, 2 arcs de retour de boucle (b2 -> b1 et b7 -> b5)
+// et aucun bloc inaccessible
+// Compteurs (-J) : 205 instructions, dont ADD 69, BRANCH 48, CALL 27,
+// RET 27, SUB 27 ; la boucle de sum (0x0008-0x000b) passe 24 fois
+// Profil des sous-programmes (-P) : piles repliées main 13,
+// main;0x0007 144 et main;0x0007;0x000f 48
+// Cache (-m 64:2:4) : 79 accès, 4 défauts, dont 2 sur ADD R01, tab[R02]
+// Prédicteurs (-p static,bimodal:4,gshare:4:2,ras:4) : 27 prédictions,
+// erreurs static 4, bimodal 5, gshare 5, ras 0
+//-----------------
+        TEXT
+
+main    EQU *
+        LOAD R01, #0
+        LOAD R04, #3
+again   EQU *
+        CALL NC, @sum
+        SUB R04, #1
+        BRANCH NE, @again
+        STORE R01, @total
+        HALT
+
+sum     EQU *
+        LOAD R02, #0
+loop    EQU *
+        CALL NC, @elem
+        ADD R02, #1
+        SUB R02, #8
+        BRANCH EQ, @fin
+        ADD R02, #8
+        BRANCH NC, @loop
+fin     EQU *
+        RET
+
+elem    EQU *
+        ADD R01, tab[R02]
+        RET
+
+        END
+
+        DATA 60
+
+tab     WORD 1
+        WORD 2
+        WORD 3
+        WORD 4
+        WORD 5
+        WORD 6
+        WORD 7
+        WORD 8
+total   WORD 0
+
+        END
@@ -0,0 +1,35 @@
+//-----------------
+// Programme au format conteneur (simul-asm -F container) et sa variante
+// compressée test_container_lz.bin (simul-asm -F lz) : le segment de texte,
+// complété par des ILLOP, dépasse CONTAINER_LZ_MIN octets
+// Somme des éléments de tab : R01 = 15, R02 = 5
+// error_container_crc.bin est test_container.bin dont un mot du segment de
+// texte a été altéré : le chargement doit échouer sur le CRC (EBADMSG)
+//-----------------
+        TEXT 400
+
+main    EQU *
+        LOAD R01, #0
+        LOAD R02, #0
+loop    EQU *
+        ADD R01, tab[R02]
+        ADD R02, #1
+        SUB R02, #5
+        BRANCH EQ, @done
+        ADD R02, #5
+        BRANCH NC, @loop
+done    EQU *
+        ADD R02, #5
+        HALT
+
+        END
+
+        DATA 40
+
+tab     WORD 1
+        WORD 2
+        WORD 3
+        WORD 4
+        WORD 5
+
+        END
@@ -0,0 +1,27 @@
+#include "machine.h"
+
+/*
+ * Fin des données statiques au-delà du segment de données : le chargeur
+ * l'accepte. Un instantané (-S 1:snap.bin) ou un dump au format conteneur
+ * (-F container) doit s'écrire sans erreur et garder dataend = 1500.
+ */
+
+Instruction text[] = {
+    {.instr_immediate = {LOAD, true, false,	1, 	1	}},  
+    {.instr_absolute =  {HALT, 						}},  
+};
+
+//! Taille utile du programme
+const unsigned textsize = sizeof(text) / sizeof(Instruction);
+
+//! Segment de données initial
+Word data[2] = {
+    0,  
+    0,  
+};
+
+//! Fin de la zone de données utile
+const unsigned dataend = 1500;
+
+//! Taille utile du segment de données
+const unsigned datasize = sizeof(data) / sizeof(Word);
@@ -0,0 +1,24 @@
+//-----------------
+// Rechargement du fichier écrit par test_simul lui-même :
+//     cp Tests/test_dump.bin dump.bin
+//     test_simul -b dump.bin
+// load_binary() projette dump.bin, que dump_memory() récrit aussitôt ;
+// l'exécution doit finir normalement (R01 = 42, value = 42) et dump.bin
+// rester identique à Tests/test_dump.bin (état initial : value = 0).
+// Une seconde exécution de test_simul -b dump.bin donne le même résultat
+//-----------------
+        TEXT
+
+main    EQU *
+        LOAD R01, #42
+        STORE R01, @value
+        LOAD R01, @value
+        HALT
+
+        END
+
+        DATA 100
+
+value   WORD 0
+
+        END
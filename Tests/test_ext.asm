@@ -0,0 +1,32 @@
+//-----------------
+// Préfixe EXT : opérandes de 32 bits
+// Résultat attendu (tous les moteurs) : R01 = R03 = R05 = 0x12345678,
+// R02 = -2000000, R04 = 7, R06 = 0x100000, et le mot 0x150000 vaut
+// 0x12345678 ; les autres pages du segment de données restent nulles
+// Le listing (-l) affiche chaque EXT sur sa ligne et l'opérande complet
+// sur l'instruction suivante : LOAD R01 #305419896, STORE R01 @0x150000,
+// LOAD R05 327680[R6]
+// test_ext.bin est au format conteneur (simul-asm -F container) : les
+// pages nulles du segment de données ne sont pas stockées
+//-----------------
+        TEXT 30
+
+main    EQU *
+        LOAD R01, #0x12345678   // EXT ajouté automatiquement
+        LOAD R02, #-2000000     // valeur négative hors du champ de 20 bits
+        STORE R01, @0x150000    // adresse absolue au-delà de 2^20
+        LOAD R03, @0x150000
+        EXT                     // référence en avant : EXT écrit à la main
+        LOAD R04, @val
+        LOAD R06, #0x100000
+        LOAD R05, 0x50000[R06]  // déplacement hors du champ de 16 bits
+        HALT
+
+        END
+
+        DATA 0x200000
+
+        WORD 0
+val     WORD 7
+
+        END
@@ -0,0 +1,26 @@
+//-----------------
+// Grand segment de données (DATA 1048576, soit 1024 pages de
+// DATA_PAGE_WORDS mots) dont seules la première et la dernière page sont
+// écrites : R01 = 5, R02 = 0 (page jamais touchée), R03 = 7
+// L'affichage des données regroupe les pages nulles 0x0400 - 0xffbff en
+// une seule ligne ; le fichier est au format conteneur (-F container), qui
+// ne stocke pas les pages nulles de la fin : il fait moins de 200 octets
+//-----------------
+        TEXT
+
+main    EQU *
+        LOAD R01, #5
+        STORE R01, @first
+        LOAD R03, #7
+        STORE R03, @0xFFC00
+        LOAD R02, @0x80000
+        LOAD R03, @0xFFC00
+        HALT
+
+        END
+
+        DATA 1048576
+
+first   WORD 0
+
+        END
@@ -0,0 +1,35 @@
+//-----------------
+// Instantané d'une exécution en cours (voir snapshot.h) : test_snapshot.bin
+// n'est pas produit par simul-asm mais par
+//     test_simul -S 12:Tests/test_snapshot.bin -b Tests/test_container.bin
+// Il a été pris au milieu de la boucle (PC = 6, R01 = 3, R02 = -3) ;
+// avec -b, l'exécution reprend là et finit avec R01 = 15, R02 = 5 sur tous
+// les moteurs (-e switch, threaded, jit)
+//-----------------
+        TEXT 400
+
+main    EQU *
+        LOAD R01, #0
+        LOAD R02, #0
+loop    EQU *
+        ADD R01, tab[R02]
+        ADD R02, #1
+        SUB R02, #5
+        BRANCH EQ, @done
+        ADD R02, #5
+        BRANCH NC, @loop
+done    EQU *
+        ADD R02, #5
+        HALT
+
+        END
+
+        DATA 40
+
+tab     WORD 1
+        WORD 2
+        WORD 3
+        WORD 4
+        WORD 5
+
+        END
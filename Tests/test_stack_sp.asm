@@ -0,0 +1,26 @@
+//-----------------
+// PUSH et POP indexés par SP : PUSH lit avec SP avant l'empilement,
+// POP écrit avec SP après le dépilement
+// Tous les moteurs (-e switch, threaded, jit) doivent finir avec
+// first = 1, second = 1 et R15 = 29
+//-----------------
+        TEXT 20
+
+main    EQU *
+        PUSH #1                 // Data[29] = 1, SP = 28
+        PUSH #2                 // Data[28] = 2, SP = 27
+        PUSH 2[R15]             // Data[27] = Data[29] = 1, SP = 26
+        POP 1[R15]              // SP = 27, Data[28] = Data[27] = 1
+        POP @first              // SP = 28, Data[28]
+        POP @second             // SP = 29, Data[29]
+        HALT
+
+        END
+
+        DATA 30
+
+        WORD 0
+first   WORD 0
+second  WORD 0
+
+        END
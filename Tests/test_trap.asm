@@ -0,0 +1,42 @@
+//-----------------
+// Trappes : à exécuter avec l'option -T 0
+// (table des trappes au début du segment de données)
+//-----------------
+        TEXT 20
+
+main    EQU *
+        LOAD R01, #5
+        ILLOP                   // trappe ERR_ILLEGAL
+        LOAD R02, @100          // trappe ERR_SEGDATA
+        RTT                     // hors d'un traitant : trappe ERR_ILLEGAL
+        PUSH #7
+        POP @100                // trappe ERR_SEGDATA, SP inchangé
+        POP @result
+        HALT
+
+        // Traitant : compte les trappes et saute l'instruction fautive
+handler LOAD R13, @epc
+        ADD R13, #1
+        STORE R13, @epc
+        LOAD R12, @count
+        ADD R12, #1
+        STORE R12, @count
+        RTT
+
+        END
+
+        DATA 30
+
+cause   WORD 0                  // TRAP_CAUSE
+epc     WORD 0                  // TRAP_EPC
+        WORD 0                  // ERR_UNKNOWN
+        WORD 8                  // ERR_ILLEGAL : handler
+        WORD 0                  // ERR_CONDITION
+        WORD 0                  // ERR_IMMEDIATE
+        WORD 0                  // ERR_SEGTEXT
+        WORD 8                  // ERR_SEGDATA : handler
+        WORD 0                  // ERR_SEGSTACK
+count   WORD 0
+result  WORD 0
+
+        END
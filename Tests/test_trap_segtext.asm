@@ -0,0 +1,43 @@
+//-----------------
+// Trappe ERR_SEGTEXT : à exécuter avec l'option -T 0
+// Le branchement indexé sort du segment de texte ; le traitant relève la
+// cause (R02 = 5) et l'adresse fautive (R03 = 6, la taille du texte)
+// La délivrance n'est pas une instruction : avec des sondes (-m 256:2:8,
+// -B trace.bin), aucune n'est notifiée pour l'adresse 6 et la trace binaire
+// ne contient que les 6 instructions exécutées
+// Retour en arrière à travers la trappe :
+//     test_simul -T 0 -R -d -b Tests/test_trap_segtext.bin
+// b 5, c     arrêt devant HALT, étape 5
+// rs 1       étape 4, PC = 4
+// rs 1       étape 3, PC = 3 : cause = 5, epc = 6 (trappe délivrée)
+// rs 1       étape 2, PC = 2 : cause = epc = 0
+// rs 1, rs 1 étape 0, PC = 0 ; un rs de plus signale le début de
+//            l'enregistrement
+//-----------------
+        TEXT
+
+main    EQU *
+        LOAD R01, #1
+        LOAD R05, #6
+        BRANCH NC, 0[R05]       // trappe ERR_SEGTEXT à l'adresse 6
+
+        // Traitant : la sortie du texte n'a pas de suite, on s'arrête
+handler LOAD R02, @cause
+        LOAD R03, @epc
+        HALT
+
+        END
+
+        DATA 30
+
+cause   WORD 0                  // TRAP_CAUSE
+epc     WORD 0                  // TRAP_EPC
+        WORD 0                  // ERR_UNKNOWN
+        WORD 0                  // ERR_ILLEGAL
+        WORD 0                  // ERR_CONDITION
+        WORD 0                  // ERR_IMMEDIATE
+        WORD 3                  // ERR_SEGTEXT : handler
+        WORD 0                  // ERR_SEGDATA
+        WORD 0                  // ERR_SEGSTACK
+
+        END
@@ -0,0 +1,26 @@
+//-----------------
+// Vérificateur : instructions rejetées mais jamais exécutées
+// Avec -V : 2 instructions en erreur à coup sûr (LOAD et STORE @100),
+// 3 adresses vérifiées à l'exécution (PUSH, POP et CALL @100).
+// Le programme s'arrête normalement sur HALT avec R01 = 1, R02 = 5.
+//-----------------
+        TEXT
+
+main    EQU *
+        LOAD R01, #1
+        BRANCH NC, @suite
+        LOAD R02, @100          // ERR_SEGDATA à coup sûr, jamais exécuté
+        STORE R02, @100         // idem
+        PUSH @100               // adresse vérifiée à l'exécution
+        POP @100                // idem
+suite   CALL EQ, @100           // condition fausse : rien n'est vérifié
+        LOAD R02, #5
+        HALT
+
+        END
+
+        DATA 30
+
+        WORD 0
+
+        END
@@ -0,0 +1,909 @@
+/*!
+ * \file asm.c
+ * \brief Assembleur du langage décrit dans Examples/syntax.asm.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include "asm.h"
+
+//! Plus grande adresse absolue sans préfixe \c EXT (champ de 20 bits)
+#define MAX_ADDRESS 0xfffff
+
+//! Bornes d'une valeur immédiate (champ signé de 20 bits)
+#define MIN_IMMEDIATE (-(1 << 19))
+#define MAX_IMMEDIATE ((1 << 19) - 1)
+
+//! Bornes d'un déplacement (champ signé de 16 bits)
+#define MIN_OFFSET (-(1 << 15))
+#define MAX_OFFSET ((1 << 15) - 1)
+
+//! Longueur maximale d'un nom de symbole (voir container.h)
+#define MAX_NAME 255
+
+//! État d'un symbole
+typedef enum {
+	SYM_UNDEFINED = 0,	//!< Seulement référencé
+	SYM_DEFINED,		//!< Valeur connue
+	SYM_ALIAS,		//!< Synonyme d'un symbole pas encore défini
+} Sym_State;
+
+//! Nature de la valeur d'un symbole
+typedef enum {
+	KIND_CONST = 0,		//!< Constante
+	KIND_TEXT,		//!< Adresse dans le segment de texte
+	KIND_DATA,		//!< Adresse dans le segment de données
+} Sym_Kind;
+
+//! Symbole en cours d'assemblage
+typedef struct {
+	const char *_name;	//!< Nom (dans le texte source)
+	unsigned _length;	//!< Longueur du nom
+	Sym_State _state;	//!< État
+	Sym_Kind _kind;		//!< Nature de la valeur
+	int64_t _value;		//!< Valeur
+	unsigned _alias;	//!< Symbole désigné (SYM_ALIAS)
+	bool _resolving;	//!< En cours de résolution (définition circulaire ?)
+	unsigned _line;		//!< Ligne de la définition ou de la première référence
+	unsigned _col;		//!< Colonne correspondante
+} Asm_Symbol;
+
+//! Champ à compléter par la valeur d'un symbole
+typedef enum {
+	FIX_ADDRESS,		//!< Adresse absolue d'une instruction
+	FIX_IMMEDIATE,		//!< Valeur immédiate d'une instruction
+	FIX_OFFSET,		//!< Déplacement d'une instruction indexée
+	FIX_WORD,		//!< Mot de données
+} Fix_Kind;
+
+//! Référence en avant
+typedef struct {
+	Fix_Kind _kind;		//!< Champ à compléter
+	unsigned _index;	//!< Adresse de l'instruction ou du mot
+	unsigned _symbol;	//!< Symbole référencé
+	unsigned _line;		//!< Ligne de la référence
+	unsigned _col;		//!< Colonne de la référence
+} Asm_Fixup;
+
+//! Section en cours
+typedef enum {
+	PHASE_START = 0,	//!< Avant TEXT
+	PHASE_TEXT,		//!< Dans la section de texte
+	PHASE_BETWEEN,		//!< Entre les deux sections
+	PHASE_DATA,		//!< Dans la section de données
+	PHASE_DONE,		//!< Après la section de données
+} Phase;
+
+//! Valeur d'un opérande : nombre ou symbole
+typedef struct {
+	bool _symbolic;		//!< Symbole pas encore défini ?
+	int64_t _value;		//!< Valeur (si connue)
+	unsigned _symbol;	//!< Symbole (sinon)
+} Operand_Value;
+
+//! État de l'assembleur
+typedef struct {
+	const char *_name;	//!< Nom du source
+	FILE *_diag;		//!< Fichier des diagnostics
+	unsigned _errors;	//!< Nombre d'erreurs
+
+	const char *_p;		//!< Caractère courant
+	const char *_eol;	//!< Fin de la ligne courante (sans le commentaire)
+	const char *_bol;	//!< Début de la ligne courante
+	unsigned _line;		//!< Numéro de la ligne courante
+	Phase _phase;		//!< Section en cours
+
+	Asm_Symbol *_symbols;	//!< Symboles
+	unsigned _nsymbols;	//!< Nombre de symboles
+	unsigned _symalloc;	//!< Taille allouée
+	unsigned *_table;	//!< Table de hachage (indice + 1, 0 si vide)
+	unsigned _tablesize;	//!< Taille de la table (puissance de 2)
+
+	Asm_Fixup *_fixups;	//!< Références en avant
+	unsigned _nfixups;	//!< Nombre de références
+	unsigned _fixalloc;	//!< Taille allouée
+
+	Instruction *_text;	//!< Instructions
+	unsigned _ntext;	//!< Nombre d'instructions
+	unsigned _textalloc;	//!< Taille allouée
+	unsigned _textdecl;	//!< Taille annoncée par TEXT (0 : aucune)
+	unsigned _textline;	//!< Ligne de la directive TEXT
+	unsigned _textcol;	//!< Colonne de la directive TEXT
+	Word *_data;		//!< Mots de données
+	unsigned _ndata;	//!< Nombre de mots
+	unsigned _dataalloc;	//!< Taille allouée
+	unsigned _datadecl;	//!< Taille annoncée par DATA
+	unsigned _dataline;	//!< Ligne de la directive DATA
+	unsigned _datacol;	//!< Colonne de la directive DATA
+} Assembler;
+
+//! Agrandissement d'un tableau
+static void *grow(void *p, unsigned *palloc, size_t size){
+	*palloc = *palloc ? 2 * *palloc : 1024;
+	if(!(p = realloc(p, *palloc * size))){
+		perror("Erreur d'allocation mémoire dans <asm.c:assemble>");
+		exit(1);
+	}
+	return p;
+}
+
+//! Diagnostic à une ligne et une colonne données
+static void error_at(Assembler *pa, unsigned line, unsigned col, const char *fmt, ...){
+	va_list ap;
+
+	if(++pa->_errors > ASM_MAX_ERRORS) return;
+	fprintf(pa->_diag, "%s:%u:%u: error: ", pa->_name, line, col);
+	va_start(ap, fmt);
+	vfprintf(pa->_diag, fmt, ap);
+	va_end(ap);
+	fputc('\n', pa->_diag);
+	if(pa->_errors == ASM_MAX_ERRORS) fprintf(pa->_diag, "%s: too many errors\n", pa->_name);
+}
+
+//! Colonne d'un caractère de la ligne courante
+static inline unsigned column(const Assembler *pa, const char *at){
+	return at - pa->_bol + 1;
+}
+
+//! Diagnostic à un caractère de la ligne courante
+#define error(pa, at, ...) error_at(pa, (pa)->_line, column(pa, at), __VA_ARGS__)
+
+static inline bool is_space(char c){
+	return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool is_ident_start(char c){
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool is_ident(char c){
+	return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static inline void skip_spaces(Assembler *pa){
+	while(pa->_p < pa->_eol && is_space(*pa->_p)) pa->_p++;
+}
+
+//! Lecture d'un identificateur ; renvoie sa longueur (0 s'il n'y en a pas)
+static unsigned read_ident(Assembler *pa, const char **pname){
+	const char *start = pa->_p;
+	if(pa->_p == pa->_eol || !is_ident_start(*pa->_p)) return 0;
+	while(pa->_p < pa->_eol && is_ident(*pa->_p)) pa->_p++;
+	*pname = start;
+	return pa->_p - start;
+}
+
+//! Comparaison sans casse avec un mot-clé
+static bool keyword(const char *name, unsigned length, const char *kw){
+	unsigned i;
+	for(i = 0 ; i < length && kw[i] ; i++){
+		char c = name[i];
+		if(c >= 'a' && c <= 'z') c -= 'a' - 'A';
+		if(c != kw[i]) return false;
+	}
+	return i == length && !kw[i];
+}
+
+//! Hachage FNV-1a d'un nom
+static inline uint32_t hash_name(const char *name, unsigned length){
+	uint32_t h = 2166136261u;
+	for(unsigned i = 0 ; i < length ; i++){
+		h ^= (unsigned char) name[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+//! Symbole d'un nom, créé s'il n'existe pas
+static unsigned lookup(Assembler *pa, const char *name, unsigned length){
+	//la table reste remplie au plus à moitié
+	if(2 * (pa->_nsymbols + 1) > pa->_tablesize){
+		unsigned size = pa->_tablesize ? 2 * pa->_tablesize : 1024;
+		unsigned *table = calloc(size, sizeof(unsigned));
+		if(!table){
+			perror("Erreur d'allocation mémoire dans <asm.c:assemble>");
+			exit(1);
+		}
+		for(unsigned i = 0 ; i < pa->_nsymbols ; i++){
+			uint32_t h = hash_name(pa->_symbols[i]._name, pa->_symbols[i]._length) & (size - 1);
+			while(table[h]) h = (h + 1) & (size - 1);
+			table[h] = i + 1;
+		}
+		free(pa->_table);
+		pa->_table = table;
+		pa->_tablesize = size;
+	}
+
+	uint32_t h = hash_name(name, length) & (pa->_tablesize - 1);
+	for(; pa->_table[h] ; h = (h + 1) & (pa->_tablesize - 1)){
+		Asm_Symbol *ps = &pa->_symbols[pa->_table[h] - 1];
+		if(ps->_length == length && memcmp(ps->_name, name, length) == 0) return pa->_table[h] - 1;
+	}
+	if(pa->_nsymbols == pa->_symalloc) pa->_symbols = grow(pa->_symbols, &pa->_symalloc, sizeof(Asm_Symbol));
+	pa->_symbols[pa->_nsymbols] = (Asm_Symbol) { name, length, SYM_UNDEFINED, KIND_CONST, 0, 0, false,
+	                                             pa->_line, column(pa, name) };
+	pa->_table[h] = ++pa->_nsymbols;
+	return pa->_nsymbols - 1;
+}
+
+//! Définition d'un symbole
+static void define(Assembler *pa, const char *name, unsigned length, Sym_State state, Sym_Kind kind,
+                   int64_t value, unsigned alias){
+	unsigned s = lookup(pa, name, length);
+	Asm_Symbol *ps = &pa->_symbols[s];
+	if(ps->_state != SYM_UNDEFINED){
+		error(pa, name, "symbol '%.*s' already defined at line %u", (int) length, name, ps->_line);
+		return;
+	}
+	ps->_state = state;
+	ps->_kind = kind;
+	ps->_value = value;
+	ps->_alias = alias;
+	ps->_line = pa->_line;
+	ps->_col = column(pa, name);
+}
+
+//! Lecture d'une valeur : nombre (décimal ou hexadécimal, signé) ou symbole
+/*!
+ * Un symbole déjà défini donne directement sa valeur.
+ *
+ * \return faux si la valeur est absente ou invalide (l'erreur est signalée)
+ */
+static bool read_value(Assembler *pa, Operand_Value *pv, Sym_Kind *pkind){
+	const char *start = pa->_p, *name;
+	unsigned length = read_ident(pa, &name);
+
+	if(pkind) *pkind = KIND_CONST;
+	if(length){
+		if(length > MAX_NAME){
+			error(pa, start, "symbol name too long");
+			return false;
+		}
+		unsigned s = lookup(pa, name, length);
+		Asm_Symbol *ps = &pa->_symbols[s];
+		pv->_symbolic = ps->_state != SYM_DEFINED;
+		pv->_symbol = s;
+		pv->_value = ps->_value;
+		if(pkind) *pkind = ps->_kind;
+		return true;
+	}
+
+	bool negative = false;
+	if(pa->_p < pa->_eol && (*pa->_p == '-' || *pa->_p == '+')) negative = *pa->_p++ == '-';
+	uint64_t v = 0;
+	unsigned digits = 0;
+	if(pa->_eol - pa->_p > 2 && pa->_p[0] == '0' && (pa->_p[1] == 'x' || pa->_p[1] == 'X')){
+		for(pa->_p += 2 ; pa->_p < pa->_eol ; pa->_p++, digits++){
+			char c = *pa->_p;
+			unsigned d;
+			if(c >= '0' && c <= '9') d = c - '0';
+			else if(c >= 'a' && c <= 'f') d = c - 'a' + 10;
+			else if(c >= 'A' && c <= 'F') d = c - 'A' + 10;
+			else break;
+			if(v <= UINT32_MAX) v = 16 * v + d;
+		}
+	}
+	else {
+		for(; pa->_p < pa->_eol && *pa->_p >= '0' && *pa->_p <= '9' ; pa->_p++, digits++){
+			if(v <= UINT32_MAX) v = 10 * v + (*pa->_p - '0');
+		}
+	}
+	if(!digits || (pa->_p < pa->_eol && is_ident(*pa->_p))){
+		error(pa, start, "expected a number or a symbol");
+		return false;
+	}
+	if(v > UINT32_MAX || (negative && v > (uint64_t) 1 << 31)){
+		error(pa, start, "value out of range");
+		return false;
+	}
+	pv->_symbolic = false;
+	pv->_value = negative ? -(int64_t) v : (int64_t) v;
+	return true;
+}
+
+//! Lecture d'un registre \c Rn
+static bool read_register(Assembler *pa, unsigned *preg){
+	const char *start = pa->_p, *name;
+	unsigned length = read_ident(pa, &name);
+	unsigned reg = 0;
+
+	if(length < 2 || length > 3 || (name[0] != 'R' && name[0] != 'r')) goto bad;
+	for(unsigned i = 1 ; i < length ; i++){
+		if(name[i] < '0' || name[i] > '9') goto bad;
+		reg = 10 * reg + (name[i] - '0');
+	}
+	if(reg >= NREGISTERS) goto bad;
+	*preg = reg;
+	return true;
+bad:
+	error(pa, start, "expected a register (R00 to R%02u)", NREGISTERS - 1);
+	return false;
+}
+
+//! Lecture d'une condition
+static bool read_condition(Assembler *pa, unsigned *pcond){
+	const char *start = pa->_p, *name;
+	unsigned length = read_ident(pa, &name);
+
+	for(unsigned cond = 0 ; length && cond <= LAST_CONDITION ; cond++){
+		if(keyword(name, length, condition_names[cond])){
+			*pcond = cond;
+			return true;
+		}
+	}
+	error(pa, start, "expected a condition (NC, EQ, NE, GT, GE, LT or LE)");
+	return false;
+}
+
+//! Lecture de la virgule entre deux opérandes
+static bool read_comma(Assembler *pa){
+	skip_spaces(pa);
+	if(pa->_p < pa->_eol && *pa->_p == ','){
+		pa->_p++;
+		skip_spaces(pa);
+		return true;
+	}
+	error(pa, pa->_p, "expected ','");
+	return false;
+}
+
+//! Un préfixe EXT précède-t-il l'instruction d'adresse index ?
+static inline bool prefixed(const Assembler *pa, unsigned index){
+	return index && pa->_text[index - 1].instr_generic._cop == EXT;
+}
+
+//! Une valeur tient-elle dans le champ d'une instruction sans préfixe EXT ?
+static bool fits(Fix_Kind kind, int64_t v){
+	switch(kind){
+		case FIX_ADDRESS : return v >= 0 && v <= MAX_ADDRESS;
+		case FIX_IMMEDIATE : return v >= MIN_IMMEDIATE && v <= MAX_IMMEDIATE;
+		case FIX_OFFSET : return v >= MIN_OFFSET && v <= MAX_OFFSET;
+		default: return v >= INT32_MIN && v <= UINT32_MAX;
+	}
+}
+
+//! Une valeur tient-elle dans le champ étendu sur 32 bits par un préfixe EXT ?
+static bool fits_ext(Fix_Kind kind, int64_t v){
+	return kind == FIX_ADDRESS ? v >= 0 && v <= UINT32_MAX : fits(FIX_WORD, v);
+}
+
+//! Report d'une valeur dans un champ (vérification de son domaine)
+/*!
+ * Derrière un préfixe \c EXT, le champ s'étend sur 32 bits : ses bits de
+ * poids fort sont rangés dans le préfixe (voir extend_operand()).
+ */
+static void store_field(Assembler *pa, Fix_Kind kind, unsigned index, int64_t v, unsigned line, unsigned col){
+	static const char *field_names[] = { "address", "immediate value", "offset", "word" };
+	Instruction *pi = &pa->_text[index];
+	bool ext = kind != FIX_WORD && prefixed(pa, index);
+
+	if(ext ? !fits_ext(kind, v) : !fits(kind, v)){
+		//référence en avant : le préfixe n'a pas pu être ajouté
+		bool hint = !ext && kind != FIX_WORD && fits_ext(kind, v);
+		error_at(pa, line, col, "%s %" PRId64 " out of range%s", field_names[kind], v,
+		         hint ? " (write EXT before the instruction)" : "");
+		return;
+	}
+	switch(kind){
+		case FIX_ADDRESS :
+			pi->instr_absolute._address = v;
+			if(ext) pi[-1].instr_ext._high = (uint32_t) v >> 20;
+			break;
+		case FIX_IMMEDIATE :
+			pi->instr_immediate._value = v;
+			if(ext) pi[-1].instr_ext._high = (uint32_t) v >> 20;
+			break;
+		case FIX_OFFSET :
+			pi->instr_indexed._offset = v;
+			if(ext) pi[-1].instr_ext._high = (uint32_t) v >> 16;
+			break;
+		default:
+			pa->_data[index] = (Word) v;
+			break;
+	}
+}
+
+//! Valeur d'un opérande : reportée tout de suite ou notée pour la fin
+static void use_value(Assembler *pa, Fix_Kind kind, unsigned index, const Operand_Value *pv, const char *at){
+	if(!pv->_symbolic){
+		store_field(pa, kind, index, pv->_value, pa->_line, column(pa, at));
+		return;
+	}
+	if(pa->_nfixups == pa->_fixalloc) pa->_fixups = grow(pa->_fixups, &pa->_fixalloc, sizeof(Asm_Fixup));
+	pa->_fixups[pa->_nfixups++] = (Asm_Fixup) { kind, index, pv->_symbol, pa->_line, column(pa, at) };
+}
+
+//! Opérande lu, pas encore reporté dans l'instruction
+typedef struct {
+	Fix_Kind _kind;		//!< Champ à compléter
+	Operand_Value _value;	//!< Valeur
+	const char *_at;	//!< Position dans la ligne
+} Pending_Operand;
+
+//! Opérande de données : \c \#v (si permis), \c \@a ou \c d[Rn]
+/*!
+ * Les modes d'adressage sont notés dans l'instruction ; la valeur n'est
+ * reportée qu'une fois l'instruction placée (voir instruction()).
+ */
+static bool read_data_operand(Assembler *pa, Instruction *pi, bool imm_allowed, Pending_Operand *pop){
+	const char *start = pa->_p;
+
+	pop->_value = (Operand_Value) { false, 0, 0 };
+	if(pa->_p < pa->_eol && *pa->_p == '#'){
+		if(!imm_allowed){
+			error(pa, start, "immediate operand not allowed with %s", cop_names[pi->instr_generic._cop]);
+			return false;
+		}
+		pa->_p++;
+		if(!read_value(pa, &pop->_value, NULL)) return false;
+		pi->instr_generic._immediate = true;
+		pop->_kind = FIX_IMMEDIATE;
+		pop->_at = start + 1;
+		return true;
+	}
+	if(pa->_p < pa->_eol && *pa->_p == '@'){
+		pa->_p++;
+		if(!read_value(pa, &pop->_value, NULL)) return false;
+		pop->_kind = FIX_ADDRESS;
+		pop->_at = start + 1;
+		return true;
+	}
+
+	//adressage indexé, déplacement facultatif
+	if(pa->_p < pa->_eol && *pa->_p != '[' && !read_value(pa, &pop->_value, NULL)) return false;
+	skip_spaces(pa);
+	if(pa->_p == pa->_eol || *pa->_p != '['){
+		error(pa, pa->_p, "expected '#', '@' or an indexed operand d[Rn]");
+		return false;
+	}
+	pa->_p++;
+	skip_spaces(pa);
+	unsigned rindex;
+	if(!read_register(pa, &rindex)) return false;
+	skip_spaces(pa);
+	if(pa->_p == pa->_eol || *pa->_p != ']'){
+		error(pa, pa->_p, "expected ']'");
+		return false;
+	}
+	pa->_p++;
+	pi->instr_generic._indexed = true;
+	pi->instr_indexed._rindex = rindex;
+	pop->_kind = FIX_OFFSET;
+	pop->_at = start;
+	return true;
+}
+
+//! Ajout d'un mot au segment de texte
+static void emit(Assembler *pa, Instruction instr){
+	if(pa->_ntext == pa->_textalloc) pa->_text = grow(pa->_text, &pa->_textalloc, sizeof(Instruction));
+	pa->_text[pa->_ntext++] = instr;
+}
+
+//! Instruction : lecture de ses opérandes et ajout au segment de texte
+/*!
+ * Une valeur déjà connue qui ne tient pas dans son champ est précédée d'un
+ * préfixe \c EXT ajouté automatiquement. Une référence en avant ne peut pas
+ * l'être (les adresses qui suivent sont déjà attribuées) : le préfixe doit
+ * alors être écrit explicitement, sur la ligne qui précède l'instruction.
+ */
+static void instruction(Assembler *pa, Code_Op cop){
+	Instruction instr = { ._raw = 0 };
+	Pending_Operand op = { FIX_ADDRESS, { false, 0, 0 }, NULL };
+	unsigned regcond = 0;
+	bool ok = true;
+
+	instr.instr_generic._cop = cop;
+	skip_spaces(pa);
+	switch(cop){
+		case LOAD : case ADD : case SUB : case STORE :
+			ok = read_register(pa, &regcond) && read_comma(pa)
+			     && read_data_operand(pa, &instr, cop != STORE, &op);
+			break;
+		case BRANCH : case CALL :
+			ok = read_condition(pa, &regcond) && read_comma(pa)
+			     && read_data_operand(pa, &instr, false, &op);
+			break;
+		case PUSH : case POP :
+			ok = read_data_operand(pa, &instr, cop == PUSH, &op);
+			break;
+		default:
+			break;
+	}
+	instr.instr_generic._regcond = regcond;
+	if(ok && op._at && !op._value._symbolic && !fits(op._kind, op._value._value)
+	   && fits_ext(op._kind, op._value._value) && !prefixed(pa, pa->_ntext)){
+		Instruction ext = { ._raw = 0 };
+		ext.instr_generic._cop = EXT;
+		emit(pa, ext);
+	}
+	emit(pa, instr);
+	if(ok && op._at) use_value(pa, op._kind, pa->_ntext - 1, &op._value, op._at);
+	skip_spaces(pa);
+	if(ok && pa->_p < pa->_eol) error(pa, pa->_p, "unexpected '%c' after the operands", *pa->_p);
+}
+
+//! Taille d'une section (facultative pour TEXT, obligatoire pour DATA)
+static bool section_size(Assembler *pa, unsigned *psize, const char *required){
+	const char *start;
+	Operand_Value v;
+
+	skip_spaces(pa);
+	start = pa->_p;
+	if(pa->_p == pa->_eol){
+		if(required) error(pa, start, "missing size of the %s section", required);
+		return false;
+	}
+	if(!read_value(pa, &v, NULL)) return false;
+	if(v._symbolic || v._value < 0 || v._value > UINT32_MAX){
+		error(pa, start, v._symbolic ? "section size must be known" : "section size out of range");
+		return false;
+	}
+	*psize = v._value;
+	return true;
+}
+
+//! Directive \c TEXT, \c DATA ou \c END
+static void section(Assembler *pa, const char *at, int which){
+	switch(which){
+		case 'T' :
+			if(pa->_phase != PHASE_START){
+				error(pa, at, "TEXT must be the first section");
+				return;
+			}
+			pa->_phase = PHASE_TEXT;
+			pa->_textline = pa->_line;
+			pa->_textcol = column(pa, at);
+			section_size(pa, &pa->_textdecl, NULL);
+			break;
+		case 'D' :
+			if(pa->_phase != PHASE_BETWEEN){
+				error(pa, at, pa->_phase == PHASE_TEXT ? "missing END before DATA"
+				          : "DATA must follow the TEXT section");
+				return;
+			}
+			pa->_phase = PHASE_DATA;
+			pa->_dataline = pa->_line;
+			pa->_datacol = column(pa, at);
+			//taille erronée : pas d'erreur en cascade sur le nombre de mots
+			if(!section_size(pa, &pa->_datadecl, "DATA")) pa->_datadecl = UINT32_MAX;
+			break;
+		default:
+			if(pa->_phase != PHASE_TEXT && pa->_phase != PHASE_DATA){
+				error(pa, at, "END outside a section");
+				return;
+			}
+			pa->_phase++;
+			break;
+	}
+	skip_spaces(pa);
+	if(pa->_p < pa->_eol) error(pa, pa->_p, "unexpected '%c'", *pa->_p);
+}
+
+//! Assemblage d'une ligne (sans son commentaire)
+static void assemble_line(Assembler *pa){
+	const char *label = NULL, *mnemonic;
+	unsigned labellen = 0, length;
+
+	//étiquette en première colonne
+	if(pa->_p < pa->_eol && !is_space(*pa->_p)){
+		labellen = read_ident(pa, &label);
+		if(!labellen || labellen > MAX_NAME || (pa->_p < pa->_eol && !is_space(*pa->_p))){
+			error(pa, pa->_bol, labellen > MAX_NAME ? "symbol name too long" : "invalid label");
+			return;
+		}
+	}
+	skip_spaces(pa);
+	const char *at = pa->_p;
+	length = read_ident(pa, &mnemonic);
+	if(!length && pa->_p < pa->_eol){
+		error(pa, at, "expected an instruction or a directive");
+		return;
+	}
+
+	if(length && keyword(mnemonic, length, "EQU")){
+		Operand_Value v;
+		Sym_Kind kind;
+		skip_spaces(pa);
+		const char *start = pa->_p;
+		if(pa->_p < pa->_eol && *pa->_p == '*'){
+			pa->_p++;
+			if(pa->_phase != PHASE_TEXT && pa->_phase != PHASE_DATA){
+				error(pa, start, "'*' outside a section");
+				return;
+			}
+			v = (Operand_Value) { false, pa->_phase == PHASE_TEXT ? pa->_ntext : pa->_ndata, 0 };
+			kind = pa->_phase == PHASE_TEXT ? KIND_TEXT : KIND_DATA;
+		}
+		else if(!read_value(pa, &v, &kind)) return;
+		skip_spaces(pa);
+		if(pa->_p < pa->_eol){
+			error(pa, pa->_p, "unexpected '%c'", *pa->_p);
+			return;
+		}
+		//sans étiquette, la directive est sans effet
+		if(labellen) define(pa, label, labellen, v._symbolic ? SYM_ALIAS : SYM_DEFINED, kind, v._value, v._symbol);
+		return;
+	}
+
+	//une étiquette désigne le compteur d'assemblage de la section
+	if(labellen){
+		if(pa->_phase == PHASE_TEXT) define(pa, label, labellen, SYM_DEFINED, KIND_TEXT, pa->_ntext, 0);
+		else if(pa->_phase == PHASE_DATA) define(pa, label, labellen, SYM_DEFINED, KIND_DATA, pa->_ndata, 0);
+		else error(pa, label, "label outside a section");
+	}
+	if(!length) return;
+
+	if(keyword(mnemonic, length, "TEXT")) section(pa, at, 'T');
+	else if(keyword(mnemonic, length, "DATA")) section(pa, at, 'D');
+	else if(keyword(mnemonic, length, "END")) section(pa, at, 'E');
+	else if(keyword(mnemonic, length, "WORD")){
+		Operand_Value v;
+		if(pa->_phase != PHASE_DATA){
+			error(pa, at, "WORD outside the DATA section");
+			return;
+		}
+		skip_spaces(pa);
+		const char *start = pa->_p;
+		if(!read_value(pa, &v, NULL)) return;
+		if(pa->_ndata == pa->_dataalloc) pa->_data = grow(pa->_data, &pa->_dataalloc, sizeof(Word));
+		pa->_data[pa->_ndata] = 0;
+		use_value(pa, FIX_WORD, pa->_ndata++, &v, start);
+		skip_spaces(pa);
+		if(pa->_p < pa->_eol) error(pa, pa->_p, "unexpected '%c'", *pa->_p);
+	}
+	else {
+		for(unsigned cop = 0 ; cop <= LAST_COP ; cop++){
+			if(keyword(mnemonic, length, cop_names[cop])){
+				if(pa->_phase != PHASE_TEXT) error(pa, at, "instruction outside the TEXT section");
+				else instruction(pa, cop);
+				return;
+			}
+		}
+		error(pa, at, "unknown instruction '%.*s'", (int) length, mnemonic);
+	}
+}
+
+//! Résolution d'un symbole (suit les synonymes)
+/*!
+ * \return faux si le symbole n'est pas défini ou si sa définition est
+ * circulaire (l'erreur est signalée une seule fois)
+ */
+static bool resolve(Assembler *pa, unsigned s){
+	Asm_Symbol *ps = &pa->_symbols[s];
+
+	if(ps->_state == SYM_DEFINED) return true;
+	if(ps->_state == SYM_UNDEFINED){
+		error_at(pa, ps->_line, ps->_col, "undefined symbol '%.*s'", (int) ps->_length, ps->_name);
+		ps->_state = SYM_DEFINED;	//une seule erreur par symbole
+		return false;
+	}
+	if(ps->_resolving){
+		error_at(pa, ps->_line, ps->_col, "circular definition of '%.*s'", (int) ps->_length, ps->_name);
+		return false;
+	}
+	ps->_resolving = true;
+	bool ok = resolve(pa, ps->_alias);
+	ps->_resolving = false;
+	ps->_state = SYM_DEFINED;
+	ps->_kind = ok ? pa->_symbols[ps->_alias]._kind : KIND_CONST;
+	ps->_value = pa->_symbols[ps->_alias]._value;
+	return ok;
+}
+
+//! Construction de la table des symboles d'adresse du programme
+static void collect_symbols(Assembler *pa, Symbol_Table *psyms){
+	unsigned n = 0;
+
+	psyms->_count = 0;
+	psyms->_symbols = calloc(pa->_nsymbols ? pa->_nsymbols : 1, sizeof(Symbol));
+	if(!psyms->_symbols){
+		perror("Erreur d'allocation mémoire dans <asm.c:assemble>");
+		exit(1);
+	}
+	for(unsigned s = 0 ; s < pa->_nsymbols ; s++){
+		const Asm_Symbol *ps = &pa->_symbols[s];
+		if(ps->_kind == KIND_CONST) continue;
+		Symbol *psym = &psyms->_symbols[n++];
+		if(!(psym->_name = malloc(ps->_length + 1))){
+			perror("Erreur d'allocation mémoire dans <asm.c:assemble>");
+			exit(1);
+		}
+		memcpy(psym->_name, ps->_name, ps->_length);
+		psym->_name[ps->_length] = '\0';
+		psym->_value = ps->_value;
+		psym->_data = ps->_kind == KIND_DATA;
+	}
+	psyms->_count = n;
+}
+
+/*!
+ * \param pprog le programme produit
+ * \param source le texte source
+ * \param length sa longueur
+ * \param name le nom du source dans les diagnostics
+ * \param diag le fichier des diagnostics
+ * \return faux si le source contient des erreurs
+ */
+bool assemble(Asm_Program *pprog, const char *source, size_t length, const char *name, FILE *diag){
+	Assembler a = { ._name = name, ._diag = diag };
+	const char *end = source + length;
+
+	memset(pprog, 0, sizeof(Asm_Program));
+	for(const char *p = source ; p < end ; ){
+		const char *nl = memchr(p, '\n', end - p);
+		const char *eol = nl ? nl : end;
+
+		a._line++;
+		a._bol = a._p = p;
+		//commentaire jusqu'à la fin de la ligne
+		for(a._eol = p ; a._eol + 1 < eol && (a._eol[0] != '/' || a._eol[1] != '/') ; a._eol++);
+		if(a._eol + 1 >= eol) a._eol = eol;
+		assemble_line(&a);
+		p = nl ? nl + 1 : end;
+		if(a._errors >= ASM_MAX_ERRORS) break;
+	}
+
+	a._p = a._bol = end;
+	if(a._errors < ASM_MAX_ERRORS){
+		if(a._phase == PHASE_START) error_at(&a, a._line, 1, "missing TEXT section");
+		else if(a._phase == PHASE_TEXT || a._phase == PHASE_DATA) error_at(&a, a._line, 1, "missing END at end of file");
+		else if(a._phase == PHASE_BETWEEN) error_at(&a, a._line, 1, "missing DATA section");
+	}
+
+	//résolution des symboles et report des références en avant
+	for(unsigned s = 0 ; s < a._nsymbols ; s++){
+		if(a._symbols[s]._state == SYM_ALIAS) resolve(&a, s);
+	}
+	for(unsigned i = 0 ; i < a._nfixups ; i++){
+		const Asm_Fixup *pf = &a._fixups[i];
+		Asm_Symbol *ps = &a._symbols[pf->_symbol];
+		if(ps->_state == SYM_UNDEFINED){
+			//l'erreur est signalée à la première référence
+			ps->_line = pf->_line;
+			ps->_col = pf->_col;
+		}
+		if(resolve(&a, pf->_symbol)) store_field(&a, pf->_kind, pf->_index, ps->_value, pf->_line, pf->_col);
+	}
+
+	//tailles des segments
+	if(a._textdecl && a._ntext > a._textdecl)
+		error_at(&a, a._textline, a._textcol, "%u instructions exceed the size of the TEXT section (%u)", a._ntext, a._textdecl);
+	if(a._ndata > a._datadecl)
+		error_at(&a, a._dataline, a._datacol, "%u words exceed the size of the DATA section (%u)", a._ndata, a._datadecl);
+
+	if(!a._errors){
+		pprog->_textsize = a._ntext > a._textdecl ? a._ntext : a._textdecl;
+		pprog->_datasize = a._datadecl;
+		pprog->_dataend = a._ndata;
+		pprog->_text = calloc(pprog->_textsize ? pprog->_textsize : 1, sizeof(Instruction));
+		//la pile et la fin nulle du segment ne sont pas matérialisées
+		pprog->_data = map_data(pprog->_datasize, &pprog->_datalen);
+		if(!pprog->_text || !pprog->_data){
+			perror("Erreur d'allocation mémoire dans <asm.c:assemble>");
+			exit(1);
+		}
+		if(a._ntext) memcpy(pprog->_text, a._text, a._ntext * sizeof(Instruction));
+		if(a._ndata) memcpy(pprog->_data, a._data, a._ndata * sizeof(Word));
+		collect_symbols(&a, &pprog->_symbols);
+	}
+
+	free(a._symbols);
+	free(a._table);
+	free(a._fixups);
+	free(a._text);
+	free(a._data);
+	return !a._errors;
+}
+
+/*!
+ * \param pprog le programme produit
+ * \param file le nom du fichier
+ * \param diag le fichier des diagnostics
+ * \return faux en cas d'erreur
+ */
+bool assemble_file(Asm_Program *pprog, const char *file, FILE *diag){
+	FILE *f = fopen(file, "rb");
+	char *source = NULL;
+	size_t length = 0, alloc = 0, n;
+
+	memset(pprog, 0, sizeof(Asm_Program));
+	if(!f){
+		fprintf(diag, "%s: error: %s\n", file, strerror(errno));
+		return false;
+	}
+	//lecture par blocs : le fichier peut être un tube
+	do {
+		if(length == alloc){
+			alloc = alloc ? 2 * alloc : 1 << 16;
+			char *p = realloc(source, alloc);
+			if(!p){
+				free(source);
+				fclose(f);
+				errno = ENOMEM;
+				return false;
+			}
+			source = p;
+		}
+		n = fread(source + length, 1, alloc - length, f);
+		length += n;
+	} while(n > 0);
+	if(ferror(f)){
+		int saved_errno = errno;
+		fprintf(diag, "%s: error: %s\n", file, strerror(errno));
+		free(source);
+		fclose(f);
+		errno = saved_errno;
+		return false;
+	}
+	fclose(f);
+
+	bool ok = assemble(pprog, source, length, file, diag);
+	free(source);
+	return ok;
+}
+
+/*!
+ * \param pprog le programme
+ * \param f le fichier
+ * \param format le format
+ * \return faux en cas d'erreur d'écriture
+ */
+bool write_asm_program(const Asm_Program *pprog, FILE *f, Dump_Format format){
+	if(format != DUMP_RAW){
+		Machine mach;
+		memset(&mach, 0, sizeof(Machine));
+		mach._text = pprog->_text;
+		mach._textsize = pprog->_textsize;
+		mach._data = pprog->_data;
+		mach._datasize = pprog->_datasize;
+		mach._dataend = pprog->_dataend;
+		return write_container(&mach, f, &pprog->_symbols, format == DUMP_CONTAINER_LZ ? CONTAINER_LZ : 0);
+	}
+	unsigned header[3] = { pprog->_textsize, pprog->_datasize, pprog->_dataend };
+	return fwrite(header, sizeof(unsigned), 3, f) == 3
+	       && fwrite(pprog->_text, sizeof(Instruction), pprog->_textsize, f) == pprog->_textsize
+	       && write_data_pages(f, pprog->_data, pprog->_datasize);
+}
+
+//! Symboles par segment, adresse puis nom (qsort)
+static int by_address(const void *a, const void *b){
+	const Symbol *x = a, *y = b;
+	if(x->_data != y->_data) return x->_data ? 1 : -1;
+	if(x->_value != y->_value) return x->_value < y->_value ? -1 : 1;
+	return strcmp(x->_name, y->_name);
+}
+
+/*!
+ * \param pprog le programme
+ * \param f le fichier
+ * \return faux en cas d'erreur d'écriture
+ */
+bool write_asm_symbols(const Asm_Program *pprog, FILE *f){
+	unsigned n = pprog->_symbols._count;
+	Symbol *sorted = malloc((n ? n : 1) * sizeof(Symbol));
+
+	if(!sorted) return false;
+	memcpy(sorted, pprog->_symbols._symbols, n * sizeof(Symbol));
+	qsort(sorted, n, sizeof(Symbol), by_address);
+	for(unsigned i = 0 ; i < n ; i++) fprintf(f, "%05x %c %s\n", sorted[i]._value, sorted[i]._data ? 'D' : 'T', sorted[i]._name);
+	free(sorted);
+	return !ferror(f);
+}
+
+/*!
+ * \param pprog le programme
+ */
+void free_asm_program(Asm_Program *pprog){
+	free(pprog->_text);
+	if(pprog->_data) munmap(pprog->_data, pprog->_datalen);
+	free_symbols(&pprog->_symbols);
+	memset(pprog, 0, sizeof(Asm_Program));
+}
@@ -0,0 +1,105 @@
+#ifndef _ASM_H_
+#define _ASM_H_
+
+/*!
+ * \file asm.h
+ * \brief Assembleur du langage décrit dans Examples/syntax.asm.
+ *
+ * Un programme source comporte une section de texte (\c TEXT [taille] ...
+ * \c END) suivie d'une section de données (\c DATA taille ... \c END). Une
+ * ligne est formée d'une étiquette facultative (en première colonne), d'une
+ * instruction ou d'une directive et de ses opérandes ; \c // commence un
+ * commentaire. Les directives sont \c EQU (définition d'un symbole par une
+ * valeur, \c * ou un autre symbole) et \c WORD (un mot de données). Les
+ * opérandes sont un registre (\c R00 à \c R15), une condition (\c NC, \c EQ,
+ * ...), une valeur immédiate (\c \#v), une adresse absolue (\c \@a) ou un
+ * adressage indexé (\c d[Rn]) ; les valeurs sont décimales, hexadécimales
+ * (\c 0x...) ou des symboles.
+ *
+ * L'assemblage se fait en une seule passe : une référence à un symbole pas
+ * encore défini est notée puis reportée à la fin, quand tous les symboles
+ * sont connus. Le segment de texte est complété par des mots nuls jusqu'à la
+ * taille annoncée par \c TEXT ; la taille annoncée par \c DATA est celle du
+ * segment de données, pile comprise.
+ *
+ * Un opérande qui ne tient pas dans son champ (20 bits pour une adresse ou une
+ * valeur immédiate, 16 pour un déplacement) est complété par un préfixe \c
+ * EXT (voir extend_operand()) : ajouté automatiquement si sa valeur est déjà
+ * connue, écrit explicitement dans le source sinon.
+ *
+ * Les erreurs sont signalées avec leur ligne et leur colonne, sous la forme
+ * <tt>fichier:ligne:colonne: error: message</tt>.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "machine.h"
+#include "container.h"
+
+//! Nombre maximal d'erreurs signalées avant l'abandon
+#define ASM_MAX_ERRORS 50
+
+//! Programme assemblé
+typedef struct
+{
+    Instruction *_text;     //!< Segment de texte (alloué)
+    unsigned _textsize;     //!< Taille du segment de texte
+    Word *_data;            //!< Segment de données (projeté par map_data(), pile comprise)
+    size_t _datalen;        //!< Longueur de la projection (en octets)
+    unsigned _datasize;     //!< Taille du segment de données
+    unsigned _dataend;      //!< Première adresse libre après les données statiques
+    Symbol_Table _symbols;  //!< Étiquettes et symboles définis par \c EQU \c *
+} Asm_Program;
+
+//! Assemblage d'un texte source
+/*!
+ * \param pprog le programme produit
+ * \param source le texte source (pas nécessairement terminé par un nul)
+ * \param length sa longueur
+ * \param name le nom du source dans les diagnostics
+ * \param diag le fichier des diagnostics
+ * \return faux si le source contient des erreurs (le programme est alors vide)
+ */
+bool assemble(Asm_Program *pprog, const char *source, size_t length, const char *name, FILE *diag);
+
+//! Assemblage d'un fichier source
+/*!
+ * \param pprog le programme produit
+ * \param file le nom du fichier
+ * \param diag le fichier des diagnostics
+ * \return faux si le fichier ne peut être lu (erreur signalée sur \c diag,
+ * voir aussi \c errno) ou contient des erreurs
+ */
+bool assemble_file(Asm_Program *pprog, const char *file, FILE *diag);
+
+//! Écriture d'un programme assemblé
+/*!
+ * \param pprog le programme
+ * \param f le fichier, ouvert en écriture
+ * \param format \c DUMP_RAW (ancien format de read_program()), \c
+ * DUMP_CONTAINER ou \c DUMP_CONTAINER_LZ (format conteneur, avec les
+ * symboles)
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_asm_program(const Asm_Program *pprog, FILE *f, Dump_Format format);
+
+//! Écriture de la table des symboles
+/*!
+ * Une ligne par symbole, triée par segment puis par adresse :
+ * <tt>adresse T|D nom</tt> (adresse en hexadécimal, \c T pour le segment de
+ * texte, \c D pour celui de données).
+ *
+ * \param pprog le programme
+ * \param f le fichier, ouvert en écriture
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_asm_symbols(const Asm_Program *pprog, FILE *f);
+
+//! Libération d'un programme assemblé
+/*!
+ * \param pprog le programme
+ */
+void free_asm_program(Asm_Program *pprog);
+
+#endif
@@ -0,0 +1,362 @@
+/*!
+ * \file btrace.c
+ * \brief Trace binaire de l'exécution.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ *
+ * Format d'un enregistrement compressé :
+ *
+ *    - un octet d'en-tête : les effets (BT_REG, BT_CC, BT_MEM) dans les bits
+ *    0 à 2, BT_JUMP et BT_RAW dans les bits 3 et 4, le nouveau code condition
+ *    dans les bits 5 et 6 ;
+ *
+ *    - si BT_JUMP (l'instruction ne suit pas la précédente) : son adresse ;
+ *
+ *    - si BT_RAW (première exécution de cette adresse) : le mot d'instruction
+ *    sur 4 octets, poids faible en tête ;
+ *
+ *    - si BT_REG : le numéro du registre sur un octet, puis le « ou exclusif »
+ *    de sa nouvelle valeur et de la dernière valeur enregistrée pour lui ;
+ *
+ *    - si BT_MEM : la différence entre l'adresse écrite et la précédente
+ *    (codée en zigzag), puis la valeur écrite.
+ *
+ * Sauf le mot d'instruction, tous les entiers sont codés sur un nombre
+ * variable d'octets : 7 bits par octet, le bit de poids fort indiquant qu'un
+ * octet suit.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "btrace.h"
+
+//! L'instruction ne suit pas la précédente : son adresse est enregistrée
+#define BT_JUMP 8
+
+//! Le mot d'instruction est enregistré
+#define BT_RAW 16
+
+//! Décalage du code condition dans l'octet d'en-tête
+#define BT_CCSHIFT 5
+
+//! Taille maximale d'un enregistrement, compressé ou non
+#define BT_MAXRECORD 32
+
+//! Traces actives, vidées si le simulateur s'arrête sur une erreur
+static Binary_Trace *active_traces = NULL;
+
+//! Codage d'un entier sur un nombre variable d'octets
+/*!
+ * \param p la position d'écriture
+ * \param v l'entier à coder
+ * \return la position qui suit l'entier codé
+ */
+static inline uint8_t *put_varint(uint8_t *p, uint32_t v){
+	while(v >= 0x80){
+		*p++ = (uint8_t) (v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (uint8_t) v;
+	return p;
+}
+
+//! Écriture du tampon dans le fichier
+/*!
+ * \param pbt l'écrivain de trace
+ */
+static void flush_buffer(Binary_Trace *pbt){
+	if(pbt->_len && fwrite(pbt->_buf, 1, pbt->_len, pbt->_file) != pbt->_len){
+		perror("Erreur lors de l'écriture de la trace binaire dans <btrace.c:flush_buffer>");
+		exit(1);
+	}
+	pbt->_len = 0;
+}
+
+//! Ajout d'un enregistrement au tampon
+/*!
+ * \param pbt l'écrivain de trace
+ * \param prec l'enregistrement
+ */
+static void emit_record(Binary_Trace *pbt, const Trace_Record *prec){
+	if(pbt->_len + BT_MAXRECORD > BTRACE_BUFSIZE) flush_buffer(pbt);
+	uint8_t *p = pbt->_buf + pbt->_len;
+
+	if(!pbt->_delta){
+		memcpy(p, prec, sizeof(Trace_Record));
+		pbt->_len += sizeof(Trace_Record);
+		return;
+	}
+
+	uint8_t *head = p++;
+	uint8_t flags = prec->_flags;
+	if(prec->_pc != pbt->_lastpc + 1){
+		flags |= BT_JUMP;
+		p = put_varint(p, prec->_pc);
+	}
+	pbt->_lastpc = prec->_pc;
+	if(!pbt->_seen[prec->_pc]){
+		pbt->_seen[prec->_pc] = 1;
+		flags |= BT_RAW;
+		for(int i = 0 ; i < 4 ; i++) *p++ = (uint8_t) (prec->_raw >> (8 * i));
+	}
+	if(prec->_flags & BT_REG){
+		*p++ = prec->_reg;
+		p = put_varint(p, prec->_regval ^ pbt->_regs[prec->_reg]);
+		pbt->_regs[prec->_reg] = prec->_regval;
+	}
+	if(prec->_flags & BT_CC){
+		flags |= prec->_cc << BT_CCSHIFT;
+	}
+	if(prec->_flags & BT_MEM){
+		int32_t diff = (int32_t) (prec->_memaddr - pbt->_lastmem);
+		p = put_varint(p, ((uint32_t) diff << 1) ^ (uint32_t) (diff >> 31));
+		p = put_varint(p, prec->_memval);
+		pbt->_lastmem = prec->_memaddr;
+	}
+	*head = flags;
+	pbt->_len = p - pbt->_buf;
+}
+
+//! Sonde : début d'une instruction
+static void on_before(Probe *pp, Machine *pmach, unsigned addr){
+	Binary_Trace *pbt = (Binary_Trace *) pp;
+	memcpy(pbt->_before, pmach->_registers, sizeof(pbt->_before));
+	pbt->_cc = pmach->_cc;
+	pbt->_rec._pc = addr;
+	pbt->_rec._raw = pmach->_text[addr]._raw;
+	pbt->_rec._flags = 0;
+}
+
+//! Sonde : écriture d'un mot de données
+static void on_write(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr, Word value){
+	Binary_Trace *pbt = (Binary_Trace *) pp;
+	pbt->_rec._flags |= BT_MEM;
+	pbt->_rec._memaddr = daddr;
+	pbt->_rec._memval = value;
+}
+
+//! Sonde : fin d'une instruction
+static void on_after(Probe *pp, Machine *pmach, unsigned addr){
+	Binary_Trace *pbt = (Binary_Trace *) pp;
+	Trace_Record *prec = &pbt->_rec;
+
+	if(!(prec->_flags & BT_MEM)) prec->_memaddr = prec->_memval = 0;
+	prec->_reg = 0;
+	prec->_regval = 0;
+	//au plus un registre est modifié par une instruction
+	for(unsigned r = 0 ; r < NREGISTERS ; r++){
+		if(pmach->_registers[r] != pbt->_before[r]){
+			prec->_flags |= BT_REG;
+			prec->_reg = r;
+			prec->_regval = pmach->_registers[r];
+			break;
+		}
+	}
+	prec->_cc = 0;
+	if(pmach->_cc != pbt->_cc){
+		prec->_flags |= BT_CC;
+		prec->_cc = pmach->_cc;
+	}
+	emit_record(pbt, prec);
+}
+
+//! Vidage des traces actives à la terminaison du simulateur
+/*!
+ * error() termine le simulateur sans revenir : l'instruction fautive a été
+ * commencée mais pas terminée. Les erreurs sont précises (elle n'a rien
+ * modifié) : elle n'est pas enregistrée, son adresse est dans le message
+ * d'erreur.
+ */
+static void flush_active_traces(void){
+	for(Binary_Trace *pbt = active_traces ; pbt ; pbt = pbt->_next){
+		flush_buffer(pbt);
+		fflush(pbt->_file);
+	}
+}
+
+/*!
+ * \param pbt l'écrivain de trace
+ * \param pmach la machine à tracer (déjà chargée)
+ * \param file le nom du fichier de trace
+ * \param delta compresser les enregistrements ?
+ */
+void btrace_start(Binary_Trace *pbt, Machine *pmach, const char *file, bool delta){
+	static bool registered = false;
+
+	memset(pbt, 0, sizeof(Binary_Trace));
+	pbt->_pmach = pmach;
+	pbt->_delta = delta;
+	pbt->_lastpc = (uint32_t) -1;
+
+	if(!(pbt->_file = fopen(file, "wb"))){
+		perror("Erreur lors de l'ouverture du fichier de trace dans <btrace.c:btrace_start>");
+		exit(1);
+	}
+	//le tampon de la trace suffit : pas de second tampon dans stdio
+	setvbuf(pbt->_file, NULL, _IONBF, 0);
+
+	if(!(pbt->_buf = malloc(BTRACE_BUFSIZE))
+	   || !(pbt->_seen = calloc(pmach->_textsize ? pmach->_textsize : 1, 1))){
+		perror("Erreur d'allocation mémoire pour la trace binaire dans <btrace.c:btrace_start>");
+		exit(1);
+	}
+
+	Trace_Header header = { BTRACE_MAGIC, BTRACE_VERSION, delta ? BTRACE_DELTA : 0 };
+	if(fwrite(&header, sizeof(header), 1, pbt->_file) != 1){
+		perror("Erreur lors de l'écriture de l'en-tête de trace dans <btrace.c:btrace_start>");
+		exit(1);
+	}
+
+	pbt->_probe._before = on_before;
+	pbt->_probe._write = on_write;
+	pbt->_probe._after = on_after;
+	attach_probe(pmach, &pbt->_probe);
+
+	pbt->_next = active_traces;
+	active_traces = pbt;
+	if(!registered){
+		atexit(flush_active_traces);
+		registered = true;
+	}
+}
+
+/*!
+ * \param pbt l'écrivain de trace
+ */
+void btrace_stop(Binary_Trace *pbt){
+	detach_probe(pbt->_pmach, &pbt->_probe);
+	for(Binary_Trace **link = &active_traces ; *link ; link = &(*link)->_next){
+		if(*link == pbt){
+			*link = pbt->_next;
+			break;
+		}
+	}
+	flush_buffer(pbt);
+	fclose(pbt->_file);
+	free(pbt->_buf);
+	free(pbt->_seen);
+	pbt->_file = NULL;
+	pbt->_buf = pbt->_seen = NULL;
+}
+
+//! Lecture d'un octet
+/*!
+ * \param ptr le lecteur
+ * \return l'octet lu
+ */
+static uint8_t get_byte(Trace_Reader *ptr){
+	int c = getc(ptr->_file);
+	if(c == EOF){
+		fprintf(stderr, "Trace binaire tronquée\n");
+		exit(1);
+	}
+	return (uint8_t) c;
+}
+
+//! Décodage d'un entier codé sur un nombre variable d'octets
+/*!
+ * \param ptr le lecteur
+ * \return l'entier décodé
+ */
+static uint32_t get_varint(Trace_Reader *ptr){
+	uint32_t v = 0;
+	for(unsigned shift = 0 ; shift < 35 ; shift += 7){
+		uint8_t b = get_byte(ptr);
+		v |= (uint32_t) (b & 0x7f) << shift;
+		if(!(b & 0x80)) break;
+	}
+	return v;
+}
+
+/*!
+ * \param ptr le lecteur
+ * \param file le nom du fichier de trace
+ */
+void btrace_open(Trace_Reader *ptr, const char *file){
+	Trace_Header header;
+
+	memset(ptr, 0, sizeof(Trace_Reader));
+	ptr->_lastpc = (uint32_t) -1;
+
+	if(!(ptr->_file = fopen(file, "rb"))){
+		perror("Erreur lors de l'ouverture du fichier de trace dans <btrace.c:btrace_open>");
+		exit(1);
+	}
+	if(fread(&header, sizeof(header), 1, ptr->_file) != 1
+	   || memcmp(header._magic, BTRACE_MAGIC, 4) != 0){
+		fprintf(stderr, "%s n'est pas une trace binaire\n", file);
+		exit(1);
+	}
+	if(header._version != BTRACE_VERSION){
+		fprintf(stderr, "%s : version de trace %u non supportée\n", file, header._version);
+		exit(1);
+	}
+	ptr->_delta = header._flags & BTRACE_DELTA;
+}
+
+/*!
+ * \param ptr le lecteur
+ * \param prec l'enregistrement lu (décompressé)
+ * \return faux à la fin du fichier
+ */
+bool btrace_read(Trace_Reader *ptr, Trace_Record *prec){
+	if(!ptr->_delta){
+		size_t n = fread(prec, 1, sizeof(Trace_Record), ptr->_file);
+		if(n != 0 && n != sizeof(Trace_Record)){
+			fprintf(stderr, "Trace binaire tronquée\n");
+			exit(1);
+		}
+		return n != 0;
+	}
+
+	int c = getc(ptr->_file);
+	if(c == EOF) return false;
+	uint8_t flags = (uint8_t) c;
+
+	memset(prec, 0, sizeof(Trace_Record));
+	prec->_flags = flags & (BT_REG | BT_CC | BT_MEM);
+	prec->_pc = (flags & BT_JUMP) ? get_varint(ptr) : ptr->_lastpc + 1;
+	ptr->_lastpc = prec->_pc;
+
+	//table des mots d'instruction, agrandie au besoin
+	if(prec->_pc >= ptr->_rawsize){
+		size_t size = ptr->_rawsize ? ptr->_rawsize : 1024;
+		while(size <= prec->_pc) size *= 2;
+		if(!(ptr->_raw = realloc(ptr->_raw, size * sizeof(uint32_t)))){
+			perror("Erreur d'allocation mémoire pour la trace binaire dans <btrace.c:btrace_read>");
+			exit(1);
+		}
+		memset(ptr->_raw + ptr->_rawsize, 0, (size - ptr->_rawsize) * sizeof(uint32_t));
+		ptr->_rawsize = size;
+	}
+	if(flags & BT_RAW){
+		uint32_t raw = 0;
+		for(int i = 0 ; i < 4 ; i++) raw |= (uint32_t) get_byte(ptr) << (8 * i);
+		ptr->_raw[prec->_pc] = raw;
+	}
+	prec->_raw = ptr->_raw[prec->_pc];
+
+	if(flags & BT_REG){
+		prec->_reg = get_byte(ptr) % NREGISTERS;
+		prec->_regval = ptr->_regs[prec->_reg] ^= get_varint(ptr);
+	}
+	if(flags & BT_CC){
+		prec->_cc = (flags >> BT_CCSHIFT) & 3;
+	}
+	if(flags & BT_MEM){
+		uint32_t zz = get_varint(ptr);
+		ptr->_lastmem += (zz >> 1) ^ -(zz & 1);
+		prec->_memaddr = ptr->_lastmem;
+		prec->_memval = get_varint(ptr);
+	}
+	return true;
+}
+
+/*!
+ * \param ptr le lecteur
+ */
+void btrace_close(Trace_Reader *ptr){
+	fclose(ptr->_file);
+	free(ptr->_raw);
+	ptr->_file = NULL;
+	ptr->_raw = NULL;
+}
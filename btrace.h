@@ -0,0 +1,166 @@
+#ifndef _BTRACE_H_
+#define _BTRACE_H_
+
+/*!
+ * \file btrace.h
+ * \brief Trace binaire de l'exécution.
+ *
+ * La trace textuelle de trace() coûte une soixantaine d'octets et plusieurs
+ * appels à printf() par instruction. La trace binaire enregistre, pour chaque
+ * instruction exécutée, son adresse, son mot d'instruction et ses effets : le
+ * registre modifié, le nouveau code condition, le mot de données écrit. Les
+ * enregistrements sont accumulés dans un tampon propre à la machine tracée,
+ * vidé dans le fichier par une seule grande écriture quand il est plein.
+ *
+ * L'outil \c simul-trace relit le fichier et le restitue au format de
+ * trace().
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "machine.h"
+#include "probe.h"
+
+//! Signature d'un fichier de trace binaire
+#define BTRACE_MAGIC "STRC"
+
+//! Version du format de trace binaire
+#define BTRACE_VERSION 1
+
+//! Taille du tampon d'écriture (en octets)
+#define BTRACE_BUFSIZE (1 << 20)
+
+//! Indicateurs de l'en-tête
+enum
+{
+    BTRACE_DELTA = 1,   //!< Enregistrements compressés (voir btrace_start())
+};
+
+//! Effets d'une instruction (champ \c _flags d'un enregistrement)
+enum
+{
+    BT_REG = 1,         //!< Un registre a été modifié
+    BT_CC = 2,          //!< Le code condition a été modifié
+    BT_MEM = 4,         //!< Un mot de données a été écrit
+};
+
+//! En-tête d'un fichier de trace binaire
+typedef struct
+{
+    char _magic[4];     //!< BTRACE_MAGIC
+    uint16_t _version;  //!< BTRACE_VERSION
+    uint16_t _flags;    //!< BTRACE_DELTA si les enregistrements sont compressés
+} Trace_Header;
+
+//! Enregistrement de trace
+/*!
+ * C'est aussi le format, de taille fixe, des enregistrements non compressés.
+ * Une instruction de ce processeur modifie au plus un registre et écrit au
+ * plus un mot de données. Les champs d'un effet absent valent 0.
+ */
+typedef struct
+{
+    uint32_t _pc;       //!< Adresse de l'instruction
+    uint32_t _raw;      //!< Mot d'instruction
+    uint8_t _flags;     //!< Effets présents (BT_REG, BT_CC, BT_MEM)
+    uint8_t _reg;       //!< Numéro du registre modifié
+    uint8_t _cc;        //!< Nouveau code condition
+    uint8_t _pad;       //!< Inutilisé (0)
+    uint32_t _regval;   //!< Nouvelle valeur du registre
+    uint32_t _memaddr;  //!< Adresse du mot de données écrit
+    uint32_t _memval;   //!< Valeur écrite
+} Trace_Record;
+
+//! Écrivain de trace binaire
+/*!
+ * C'est une sonde (voir probe.h) : elle est attachée à la machine par
+ * btrace_start() et en est détachée par btrace_stop().
+ */
+typedef struct Binary_Trace
+{
+    Probe _probe;               //!< Sonde (premier champ)
+    Machine *_pmach;            //!< Machine tracée
+    FILE *_file;                //!< Fichier de trace
+    bool _delta;                //!< Compression des enregistrements ?
+
+    uint8_t *_buf;              //!< Tampon d'écriture (BTRACE_BUFSIZE octets)
+    size_t _len;                //!< Nombre d'octets en attente dans le tampon
+
+    Trace_Record _rec;          //!< Enregistrement de l'instruction en cours
+    Word _before[NREGISTERS];   //!< Registres avant l'instruction en cours
+    Condition_Code _cc;         //!< Code condition avant l'instruction en cours
+
+    // État de la compression
+    uint32_t _lastpc;           //!< Adresse de l'instruction précédente
+    uint32_t _lastmem;          //!< Dernière adresse de données écrite
+    Word _regs[NREGISTERS];     //!< Dernières valeurs enregistrées des registres
+    uint8_t *_seen;             //!< Instructions déjà enregistrées (une fois par adresse)
+
+    struct Binary_Trace *_next; //!< Trace active suivante
+} Binary_Trace;
+
+//! Début de la trace binaire d'une machine
+/*!
+ * Le fichier est créé (ou remplacé) et la sonde attachée à la machine. Avec
+ * la compression, chaque enregistrement ne contient que ce qui ne se déduit
+ * pas du précédent : l'adresse est omise si l'exécution est séquentielle, le
+ * mot d'instruction n'est écrit qu'à la première exécution de chaque
+ * adresse, les valeurs sont codées en différence et sur un nombre variable
+ * d'octets.
+ *
+ * Le tampon est aussi vidé si le simulateur s'arrête sur une erreur : le
+ * dernier enregistrement est celui de la dernière instruction terminée,
+ * l'instruction fautive n'étant pas enregistrée.
+ *
+ * \param pbt l'écrivain de trace
+ * \param pmach la machine à tracer (déjà chargée)
+ * \param file le nom du fichier de trace
+ * \param delta compresser les enregistrements ?
+ */
+void btrace_start(Binary_Trace *pbt, Machine *pmach, const char *file, bool delta);
+
+//! Fin de la trace binaire
+/*!
+ * Le tampon est vidé, le fichier fermé et la sonde détachée.
+ *
+ * \param pbt l'écrivain de trace
+ */
+void btrace_stop(Binary_Trace *pbt);
+
+//! Lecteur de trace binaire
+typedef struct
+{
+    FILE *_file;                //!< Fichier de trace
+    bool _delta;                //!< Enregistrements compressés ?
+
+    // État de la décompression
+    uint32_t _lastpc;           //!< Adresse de l'instruction précédente
+    uint32_t _lastmem;          //!< Dernière adresse de données écrite
+    Word _regs[NREGISTERS];     //!< Dernières valeurs lues des registres
+    uint32_t *_raw;             //!< Mots d'instruction déjà lus, par adresse
+    size_t _rawsize;            //!< Taille du tableau \c _raw
+} Trace_Reader;
+
+//! Ouverture d'un fichier de trace binaire
+/*!
+ * \param ptr le lecteur
+ * \param file le nom du fichier de trace
+ */
+void btrace_open(Trace_Reader *ptr, const char *file);
+
+//! Lecture de l'enregistrement suivant
+/*!
+ * \param ptr le lecteur
+ * \param prec l'enregistrement lu (décompressé)
+ * \return faux à la fin du fichier
+ */
+bool btrace_read(Trace_Reader *ptr, Trace_Record *prec);
+
+//! Fermeture d'un fichier de trace binaire
+/*!
+ * \param ptr le lecteur
+ */
+void btrace_close(Trace_Reader *ptr);
+
+#endif
@@ -0,0 +1,290 @@
+/*!
+ * \file cache.c
+ * \brief Simulation d'une hiérarchie de caches de données.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "cache.h"
+
+//! Voie libre (aucune adresse de ligne ne vaut cette valeur)
+#define CACHE_INVALID UINT32_MAX
+
+//! Noms des politiques de remplacement
+static const char *policy_names[] = { "lru", "plru", "random" };
+
+//! Est-ce une puissance de 2 ?
+static inline bool power_of_two(unsigned n){
+	return n && !(n & (n - 1));
+}
+
+//! Logarithme en base 2 d'une puissance de 2
+static inline unsigned log2_of(unsigned n){
+	unsigned l = 0;
+	while(n >>= 1) l++;
+	return l;
+}
+
+//! Lecture d'un niveau \c taille:associativité:ligne[:politique]
+static bool parse_level(Cache_Level_Config *plc, const char *spec, size_t len){
+	char buf[64], policy[16] = "lru", extra[2];
+	int n;
+
+	if(len >= sizeof(buf)) return false;
+	memcpy(buf, spec, len);
+	buf[len] = '\0';
+	n = sscanf(buf, "%u:%u:%u:%15[a-z]%1s", &plc->_size, &plc->_assoc, &plc->_line, policy, extra);
+	if(n != 3 && n != 4) return false;
+	for(plc->_policy = CACHE_LRU ; plc->_policy <= CACHE_RANDOM ; plc->_policy++){
+		if(strcmp(policy, policy_names[plc->_policy]) == 0) break;
+	}
+	if(plc->_policy > CACHE_RANDOM) return false;
+
+	//géométrie
+	if(!plc->_assoc || plc->_assoc > CACHE_MAXASSOC || !power_of_two(plc->_line)) return false;
+	if(plc->_policy == CACHE_PLRU && !power_of_two(plc->_assoc)) return false;
+	if(plc->_size % (plc->_assoc * plc->_line)) return false;
+	return power_of_two(plc->_size / (plc->_assoc * plc->_line));
+}
+
+/*!
+ * \param pconf les paramètres lus
+ * \param spec la description (voir cache.h)
+ * \return faux si la description est invalide
+ */
+bool parse_cache_config(Cache_Config *pconf, const char *spec){
+	pconf->_nlevels = 0;
+	for(;;){
+		size_t len = strcspn(spec, ",");
+		if(pconf->_nlevels == CACHE_MAXLEVELS
+		   || !parse_level(&pconf->_levels[pconf->_nlevels++], spec, len)){
+			errno = EINVAL;
+			return false;
+		}
+		if(!spec[len]) return true;
+		spec += len + 1;
+	}
+}
+
+//! Voie choisie par l'arbre pseudo-LRU
+/*!
+ * Chaque nœud interne de l'arbre (numérotés à partir de 1, les fils de \c n
+ * étant \c 2n et \c 2n+1) indique de quel côté se trouve la prochaine
+ * victime.
+ */
+static inline unsigned plru_victim(uint64_t tree, unsigned assoc){
+	unsigned node = 1;
+	while(node < assoc) node = 2 * node + ((tree >> node) & 1);
+	return node - assoc;
+}
+
+//! Mise à jour de l'arbre pseudo-LRU après un accès à la voie \c way
+static inline uint64_t plru_touch(uint64_t tree, unsigned assoc, unsigned way){
+	//du bas vers le haut : chaque nœud désigne le côté opposé
+	for(unsigned node = way + assoc ; node > 1 ; node >>= 1){
+		unsigned parent = node >> 1;
+		if(node & 1) tree &= ~((uint64_t) 1 << parent);
+		else tree |= (uint64_t) 1 << parent;
+	}
+	return tree;
+}
+
+//! Tirage pseudo-aléatoire (xorshift 32 bits)
+static inline uint32_t next_random(uint32_t *pstate){
+	uint32_t x = *pstate;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *pstate = x;
+}
+
+//! Consultation d'un niveau
+/*!
+ * Avec LRU, les voies d'un ensemble sont rangées de la plus récente à la plus
+ * ancienne : la victime est la dernière. Avec les autres politiques, une
+ * ligne garde sa voie.
+ *
+ * \return vrai en cas de succès
+ */
+static bool lookup(Cache_Level *pl, uint32_t *prandom, unsigned daddr){
+	const unsigned assoc = pl->_config._assoc;
+	uint32_t line = daddr >> pl->_lineshift;
+	unsigned set = line & pl->_setmask;
+	uint32_t *ways = pl->_tags + (size_t) set * assoc;
+	unsigned w;
+
+	pl->_accesses++;
+	for(w = 0 ; w < assoc ; w++){
+		if(ways[w] == line) break;
+	}
+	bool hit = w < assoc;
+
+	switch(pl->_config._policy){
+		case CACHE_LRU :
+			if(!hit) w = assoc - 1;
+			memmove(ways + 1, ways, w * sizeof(uint32_t));
+			ways[0] = line;
+			break;
+		case CACHE_PLRU :
+			if(!hit){
+				for(w = 0 ; w < assoc && ways[w] != CACHE_INVALID ; w++);
+				if(w == assoc) w = plru_victim(pl->_plru[set], assoc);
+				ways[w] = line;
+			}
+			pl->_plru[set] = plru_touch(pl->_plru[set], assoc, w);
+			break;
+		case CACHE_RANDOM :
+			if(!hit){
+				for(w = 0 ; w < assoc && ways[w] != CACHE_INVALID ; w++);
+				if(w == assoc) w = next_random(prandom) % assoc;
+				ways[w] = line;
+			}
+			break;
+	}
+	if(!hit) pl->_misses++;
+	return hit;
+}
+
+/*!
+ * \param pcs le simulateur
+ * \param pc l'adresse de l'instruction
+ * \param daddr l'adresse du mot de données
+ */
+void cache_access(Cache_Sim *pcs, unsigned pc, unsigned daddr){
+	pcs->_pc_accesses[pc]++;
+	for(unsigned l = 0 ; l < pcs->_nlevels ; l++){
+		if(lookup(&pcs->_levels[l], &pcs->_random, daddr)) return;
+		pcs->_levels[l]._pc_misses[pc]++;
+	}
+}
+
+//! Sonde : lecture d'un mot de données
+static void on_read(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr){
+	cache_access((Cache_Sim *) pp, addr, daddr);
+}
+
+//! Sonde : écriture d'un mot de données
+static void on_write(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr, Word value){
+	cache_access((Cache_Sim *) pp, addr, daddr);
+}
+
+//! Allocation d'un tableau nul
+static void *cache_alloc(size_t n, size_t size){
+	void *p = calloc(n ? n : 1, size);
+	if(!p){
+		perror("Erreur d'allocation mémoire pour les caches dans <cache.c:cache_start>");
+		exit(1);
+	}
+	return p;
+}
+
+/*!
+ * \param pcs le simulateur
+ * \param pmach la machine à observer (déjà chargée)
+ * \param pconf les paramètres (valides)
+ */
+void cache_start(Cache_Sim *pcs, Machine *pmach, const Cache_Config *pconf){
+	memset(pcs, 0, sizeof(Cache_Sim));
+	pcs->_pmach = pmach;
+	pcs->_nlevels = pconf->_nlevels;
+	pcs->_random = 2463534242u;
+	pcs->_pc_accesses = cache_alloc(pmach->_textsize, sizeof(uint64_t));
+	for(unsigned l = 0 ; l < pcs->_nlevels ; l++){
+		Cache_Level *pl = &pcs->_levels[l];
+		const Cache_Level_Config *plc = &pconf->_levels[l];
+		unsigned nsets = plc->_size / (plc->_assoc * plc->_line);
+
+		pl->_config = *plc;
+		pl->_lineshift = log2_of(plc->_line);
+		pl->_setmask = nsets - 1;
+		pl->_tags = cache_alloc((size_t) nsets * plc->_assoc, sizeof(uint32_t));
+		memset(pl->_tags, 0xff, (size_t) nsets * plc->_assoc * sizeof(uint32_t));
+		pl->_plru = cache_alloc(nsets, sizeof(uint64_t));
+		pl->_pc_misses = cache_alloc(pmach->_textsize, sizeof(uint64_t));
+	}
+
+	pcs->_probe._read = on_read;
+	pcs->_probe._write = on_write;
+	attach_probe(pmach, &pcs->_probe);
+	pcs->_running = true;
+}
+
+/*!
+ * \param pcs le simulateur
+ */
+void cache_stop(Cache_Sim *pcs){
+	if(!pcs->_running) return;
+	detach_probe(pcs->_pmach, &pcs->_probe);
+	pcs->_running = false;
+}
+
+//! Adresses par défauts décroissants au premier niveau (qsort)
+static const uint64_t *sort_misses;
+static int by_misses(const void *a, const void *b){
+	unsigned x = *(const unsigned *) a, y = *(const unsigned *) b;
+	if(sort_misses[x] != sort_misses[y]) return sort_misses[x] < sort_misses[y] ? 1 : -1;
+	return x < y ? -1 : x > y;
+}
+
+//! Proportion en pour cent
+static inline double percent(uint64_t part, uint64_t whole){
+	return whole ? 100.0 * part / whole : 0;
+}
+
+/*!
+ * \param pcs le simulateur (arrêté)
+ * \param top le nombre d'instructions à afficher
+ */
+void print_cache(const Cache_Sim *pcs, unsigned top){
+	const Machine *pmach = pcs->_pmach;
+	unsigned *order = cache_alloc(pmach->_textsize, sizeof(unsigned));
+	unsigned n = 0;
+
+	printf("\n### CACHES ###\n\n");
+	for(unsigned l = 0 ; l < pcs->_nlevels ; l++){
+		const Cache_Level *pl = &pcs->_levels[l];
+		printf(" L%u : %u words, %u-way, %u words/line, %s\n", l + 1, pl->_config._size,
+		       pl->_config._assoc, pl->_config._line, policy_names[pl->_config._policy]);
+		printf("      accesses : %" PRIu64 ", hits : %" PRIu64 " (%.2f%%), misses : %" PRIu64 " (%.2f%%)\n",
+		       pl->_accesses, pl->_accesses - pl->_misses, percent(pl->_accesses - pl->_misses, pl->_accesses),
+		       pl->_misses, percent(pl->_misses, pl->_accesses));
+	}
+	if(!pcs->_nlevels) return;
+
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		if(pcs->_levels[0]._pc_misses[addr]) order[n++] = addr;
+	}
+	sort_misses = pcs->_levels[0]._pc_misses;
+	qsort(order, n, sizeof(unsigned), by_misses);
+	if(top > n) top = n;
+	printf("\n Misses by instruction :\n\n\t    accesses");
+	for(unsigned l = 0 ; l < pcs->_nlevels ; l++) printf("   L%u misses", l + 1);
+	printf("\n");
+	for(unsigned i = 0 ; i < top ; i++){
+		unsigned addr = order[i];
+		printf("\t%12" PRIu64, pcs->_pc_accesses[addr]);
+		for(unsigned l = 0 ; l < pcs->_nlevels ; l++) printf(" %11" PRIu64, pcs->_levels[l]._pc_misses[addr]);
+		printf("  %5.1f%%  0x%04x : ", percent(pcs->_levels[0]._pc_misses[addr], pcs->_pc_accesses[addr]), addr);
+		print_prefixed(text_prefix(pmach->_text, addr), pmach->_text[addr], addr);
+		printf("\n");
+	}
+	free(order);
+}
+
+/*!
+ * \param pcs le simulateur (arrêté)
+ */
+void free_cache(Cache_Sim *pcs){
+	for(unsigned l = 0 ; l < pcs->_nlevels ; l++){
+		free(pcs->_levels[l]._tags);
+		free(pcs->_levels[l]._plru);
+		free(pcs->_levels[l]._pc_misses);
+	}
+	free(pcs->_pc_accesses);
+	pcs->_nlevels = 0;
+	pcs->_pc_accesses = NULL;
+}
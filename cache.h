@@ -0,0 +1,139 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+/*!
+ * \file cache.h
+ * \brief Simulation d'une hiérarchie de caches de données.
+ *
+ * Le simulateur de caches est une sonde (voir probe.h) : il voit chaque
+ * lecture et chaque écriture d'un mot de données, qu'elle passe par
+ * generate_address() ou par la pile (\c PUSH, \c POP, \c CALL, \c RET).
+ * Sans cache configuré, la sonde n'est pas attachée et ne coûte rien.
+ *
+ * Chaque niveau est un cache associatif par ensembles, en
+ * écriture-allocation ; un défaut d'un niveau est une consultation du niveau
+ * suivant. Les tailles sont en mots. Un niveau est décrit par
+ *
+ * \code
+ * taille:associativité:ligne[:politique]
+ * \endcode
+ *
+ * où la politique de remplacement est \c lru (par défaut), \c plru (arbre
+ * pseudo-LRU) ou \c random ; la ligne et le nombre d'ensembles (taille /
+ * (associativité × ligne)) sont des puissances de 2, de même que
+ * l'associativité pour \c plru. Les niveaux sont séparés par des virgules,
+ * du plus proche au plus éloigné : \c 256:4:4,4096:8:8:plru.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+#include "probe.h"
+
+//! Nombre maximal de niveaux de cache
+#define CACHE_MAXLEVELS 2
+
+//! Associativité maximale (bits de l'arbre pseudo-LRU d'un ensemble)
+#define CACHE_MAXASSOC 64
+
+//! Politique de remplacement
+typedef enum
+{
+    CACHE_LRU = 0,      //!< Le moins récemment utilisé
+    CACHE_PLRU,         //!< Arbre pseudo-LRU
+    CACHE_RANDOM,       //!< Au hasard
+} Cache_Policy;
+
+//! Paramètres d'un niveau de cache
+typedef struct
+{
+    unsigned _size;         //!< Taille (en mots)
+    unsigned _assoc;        //!< Associativité (nombre de voies)
+    unsigned _line;         //!< Taille d'une ligne (en mots)
+    Cache_Policy _policy;   //!< Politique de remplacement
+} Cache_Level_Config;
+
+//! Paramètres de la hiérarchie
+typedef struct
+{
+    unsigned _nlevels;                              //!< Nombre de niveaux
+    Cache_Level_Config _levels[CACHE_MAXLEVELS];    //!< Niveaux, du plus proche au plus éloigné
+} Cache_Config;
+
+//! État d'un niveau de cache
+typedef struct
+{
+    Cache_Level_Config _config; //!< Paramètres
+    unsigned _lineshift;        //!< log2 de la taille d'une ligne
+    unsigned _setmask;          //!< Nombre d'ensembles - 1
+    uint32_t *_tags;            //!< Lignes présentes, par ensemble (\c CACHE_INVALID : voie libre)
+    uint64_t *_plru;            //!< Arbre pseudo-LRU de chaque ensemble
+    uint64_t _accesses;         //!< Consultations
+    uint64_t _misses;           //!< Défauts
+    uint64_t *_pc_misses;       //!< Défauts, par adresse d'instruction
+} Cache_Level;
+
+//! Simulateur de caches attaché à une machine
+typedef struct
+{
+    Probe _probe;                           //!< Sonde (premier champ)
+    Machine *_pmach;                        //!< Machine observée
+    bool _running;                          //!< Sonde attachée ?
+    unsigned _nlevels;                      //!< Nombre de niveaux
+    Cache_Level _levels[CACHE_MAXLEVELS];   //!< Niveaux
+    uint64_t *_pc_accesses;                 //!< Accès aux données, par adresse d'instruction
+    uint32_t _random;                       //!< État du générateur de la politique \c random
+} Cache_Sim;
+
+//! Lecture d'une description de hiérarchie
+/*!
+ * \param pconf les paramètres lus
+ * \param spec la description (voir cache.h)
+ * \return faux si la description est invalide (\c errno vaut \c EINVAL)
+ */
+bool parse_cache_config(Cache_Config *pconf, const char *spec);
+
+//! Début de la simulation (caches vides)
+/*!
+ * \param pcs le simulateur
+ * \param pmach la machine à observer (déjà chargée)
+ * \param pconf les paramètres (valides)
+ */
+void cache_start(Cache_Sim *pcs, Machine *pmach, const Cache_Config *pconf);
+
+//! Accès à un mot de données
+/*!
+ * C'est ce que fait la sonde à chaque lecture ou écriture.
+ *
+ * \param pcs le simulateur
+ * \param pc l'adresse de l'instruction (dans le segment de texte)
+ * \param daddr l'adresse du mot de données
+ */
+void cache_access(Cache_Sim *pcs, unsigned pc, unsigned daddr);
+
+//! Fin de la simulation
+/*!
+ * La sonde est détachée. Sans effet si la simulation est déjà arrêtée.
+ *
+ * \param pcs le simulateur
+ */
+void cache_stop(Cache_Sim *pcs);
+
+//! Affichage du bilan
+/*!
+ * Consultations, succès et défauts de chaque niveau, puis les \c top
+ * instructions qui causent le plus de défauts au premier niveau.
+ *
+ * \param pcs le simulateur (arrêté)
+ * \param top le nombre d'instructions à afficher
+ */
+void print_cache(const Cache_Sim *pcs, unsigned top);
+
+//! Libération des caches
+/*!
+ * \param pcs le simulateur (arrêté)
+ */
+void free_cache(Cache_Sim *pcs);
+
+#endif
@@ -0,0 +1,305 @@
+/*!
+ * \file callgraph.c
+ * \brief Profil exact par sous-programme (graphe d'appels).
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "callgraph.h"
+
+//! Capacité initiale de la pile, de l'arbre et de la table des arcs
+#define INITIAL_SIZE 64
+
+//! Agrandissement d'un tableau (doublement de sa capacité)
+/*!
+ * \param p le tableau
+ * \param psize sa capacité, mise à jour
+ * \param elemsize la taille d'un élément
+ * \return le tableau agrandi
+ */
+static void *grow(void *p, unsigned *psize, size_t elemsize){
+	unsigned size = *psize ? 2 * *psize : INITIAL_SIZE;
+	if(!(p = realloc(p, size * elemsize))){
+		perror("Erreur d'allocation mémoire pour le profil d'appels dans <callgraph.c:grow>");
+		exit(1);
+	}
+	*psize = size;
+	return p;
+}
+
+//! Allocation d'un tableau nul
+static void *cg_alloc(size_t n, size_t size){
+	void *p = calloc(n, size);
+	if(!p){
+		perror("Erreur d'allocation mémoire pour le profil d'appels dans <callgraph.c:callgraph_start>");
+		exit(1);
+	}
+	return p;
+}
+
+//! Création d'un contexte d'appel
+static unsigned new_node(Call_Profile *pcp, unsigned parent, unsigned entry){
+	if(pcp->_nnodes == pcp->_nodesize) pcp->_nodes = grow(pcp->_nodes, &pcp->_nodesize, sizeof(Call_Node));
+	unsigned n = pcp->_nnodes++;
+	pcp->_nodes[n] = (Call_Node) { entry, parent, 0, 0, 0 };
+	return n;
+}
+
+//! Contexte appelé depuis \c parent pour le sous-programme \c entry
+/*!
+ * Le contexte trouvé passe en tête de la liste des appelés : les appels
+ * répétés depuis une boucle le trouvent tout de suite. L'indice 0 (la
+ * racine) n'est jamais un appelé et termine les listes.
+ */
+static unsigned child_node(Call_Profile *pcp, unsigned parent, unsigned entry){
+	Call_Node *nodes = pcp->_nodes;
+	unsigned prev = 0;
+
+	for(unsigned c = nodes[parent]._child ; c ; prev = c, c = nodes[c]._sibling){
+		if(nodes[c]._entry != entry) continue;
+		if(prev){
+			nodes[prev]._sibling = nodes[c]._sibling;
+			nodes[c]._sibling = nodes[parent]._child;
+			nodes[parent]._child = c;
+		}
+		return c;
+	}
+	unsigned c = new_node(pcp, parent, entry);
+	nodes = pcp->_nodes;
+	nodes[c]._sibling = nodes[parent]._child;
+	nodes[parent]._child = c;
+	return c;
+}
+
+//! Position d'un arc dans la table de hachage
+static unsigned edge_slot(const Call_Profile *pcp, unsigned caller, unsigned callee){
+	unsigned mask = pcp->_edgesize - 1;
+	unsigned h = (caller * 0x9e3779b1u ^ callee * 0x85ebca77u) & mask;
+	while(pcp->_edges[h]._count
+	      && (pcp->_edges[h]._caller != caller || pcp->_edges[h]._callee != callee)){
+		h = (h + 1) & mask;
+	}
+	return h;
+}
+
+//! Comptage d'un appel sur l'arc \c caller → \c callee
+static void count_edge(Call_Profile *pcp, unsigned caller, unsigned callee){
+	//la table reste au plus à moitié pleine
+	if(2 * (pcp->_nedges + 1) > pcp->_edgesize){
+		Call_Edge *old = pcp->_edges;
+		unsigned oldsize = pcp->_edgesize;
+		pcp->_edgesize = oldsize ? 2 * oldsize : INITIAL_SIZE;
+		pcp->_edges = cg_alloc(pcp->_edgesize, sizeof(Call_Edge));
+		for(unsigned i = 0 ; i < oldsize ; i++){
+			if(old[i]._count) pcp->_edges[edge_slot(pcp, old[i]._caller, old[i]._callee)] = old[i];
+		}
+		free(old);
+	}
+	Call_Edge *pe = &pcp->_edges[edge_slot(pcp, caller, callee)];
+	if(!pe->_count){
+		pe->_caller = caller;
+		pe->_callee = callee;
+		pcp->_nedges++;
+	}
+	pe->_count++;
+}
+
+//! Empilement d'un cadre
+static void push_frame(Call_Profile *pcp, unsigned node, Word slot){
+	if(pcp->_depth == pcp->_stacksize) pcp->_stack = grow(pcp->_stack, &pcp->_stacksize, sizeof(Call_Frame));
+	pcp->_stack[pcp->_depth++] = (Call_Frame) { node, slot, pcp->_total };
+	pcp->_active[pcp->_nodes[node]._entry]++;
+}
+
+//! Dépilement d'un cadre
+/*!
+ * Le compte inclusif n'est arrêté qu'à la fin de l'activation la plus
+ * externe d'un sous-programme récursif.
+ */
+static void pop_frame(Call_Profile *pcp){
+	Call_Frame *pf = &pcp->_stack[--pcp->_depth];
+	unsigned entry = pcp->_nodes[pf->_node]._entry;
+	if(--pcp->_active[entry] == 0) pcp->_inclusive[entry] += pcp->_total - pf->_start;
+}
+
+//! Sonde : début d'une instruction
+static void on_before(Probe *pp, Machine *pmach, unsigned addr){
+	Call_Profile *pcp = (Call_Profile *) pp;
+	pcp->_total++;
+	pcp->_nodes[pcp->_stack[pcp->_depth - 1]._node]._self++;
+}
+
+//! Sonde : appel de sous-programme
+static void on_call(Probe *pp, Machine *pmach, unsigned addr, unsigned target){
+	Call_Profile *pcp = (Call_Profile *) pp;
+	Word slot = pmach->_sp + 1;
+
+	//la prochaine instruction échoue (ERR_SEGTEXT) : ce n'est pas un sous-programme
+	if(target >= pmach->_textsize) return;
+	//cadres abandonnés par le programme (SP remonté au-dessus d'eux)
+	while(pcp->_depth > 1 && pcp->_stack[pcp->_depth - 1]._slot <= slot) pop_frame(pcp);
+
+	unsigned caller = pcp->_stack[pcp->_depth - 1]._node;
+	count_edge(pcp, pcp->_nodes[caller]._entry, target);
+	pcp->_calls[target]++;
+	push_frame(pcp, child_node(pcp, caller, target), slot);
+}
+
+//! Sonde : retour de sous-programme
+static void on_ret(Probe *pp, Machine *pmach, unsigned addr){
+	Call_Profile *pcp = (Call_Profile *) pp;
+	Word slot = pmach->_sp;
+	unsigned i = pcp->_depth - 1;
+
+	//cadre dont l'adresse de retour vient d'être lue
+	while(i > 0 && pcp->_stack[i]._slot < slot) i--;
+	if(i == 0 || pcp->_stack[i]._slot != slot) return;
+	while(pcp->_depth > i) pop_frame(pcp);
+}
+
+/*!
+ * \param pcp le profil
+ * \param pmach la machine à observer (déjà chargée)
+ */
+void callgraph_start(Call_Profile *pcp, Machine *pmach){
+	memset(pcp, 0, sizeof(Call_Profile));
+	pcp->_pmach = pmach;
+	pcp->_root = pmach->_textsize;
+	pcp->_inclusive = cg_alloc(pcp->_root + 1, sizeof(uint64_t));
+	pcp->_calls = cg_alloc(pcp->_root + 1, sizeof(uint64_t));
+	pcp->_active = cg_alloc(pcp->_root + 1, sizeof(unsigned));
+
+	//le programme principal, au fond de la pile, n'est jamais dépilé par RET
+	new_node(pcp, 0, pcp->_root);
+	push_frame(pcp, 0, (Word) -1);
+
+	pcp->_probe._before = on_before;
+	pcp->_probe._call = on_call;
+	pcp->_probe._ret = on_ret;
+	attach_probe(pmach, &pcp->_probe);
+}
+
+/*!
+ * \param pcp le profil
+ */
+void callgraph_stop(Call_Profile *pcp){
+	if(!pcp->_depth) return;
+	while(pcp->_depth) pop_frame(pcp);
+	detach_probe(pcp->_pmach, &pcp->_probe);
+}
+
+//! Nom d'un sous-programme dans les rapports
+static const char *entry_name(const Call_Profile *pcp, unsigned entry, char *buf){
+	if(entry == pcp->_root) return "main";
+	sprintf(buf, "0x%04x", entry);
+	return buf;
+}
+
+//! Critères de tri de print_callgraph() (qsort)
+static const Call_Profile *sort_profile;
+static int by_inclusive(const void *a, const void *b){
+	unsigned x = *(const unsigned *) a, y = *(const unsigned *) b;
+	const uint64_t *incl = sort_profile->_inclusive;
+	if(incl[x] != incl[y]) return incl[x] < incl[y] ? 1 : -1;
+	return x < y ? -1 : x > y;
+}
+static int by_edge(const void *a, const void *b){
+	const Call_Edge *x = a, *y = b;
+	if(x->_caller != y->_caller) return x->_caller < y->_caller ? -1 : 1;
+	return x->_callee < y->_callee ? -1 : x->_callee > y->_callee;
+}
+
+/*!
+ * \param pcp le profil (arrêté)
+ */
+void print_callgraph(const Call_Profile *pcp){
+	const unsigned n = pcp->_root + 1;
+	uint64_t *exclusive = cg_alloc(n, sizeof(uint64_t));
+	unsigned *order = cg_alloc(n, sizeof(unsigned));
+	Call_Edge *edges = cg_alloc(pcp->_nedges + 1, sizeof(Call_Edge));
+	double total = pcp->_total ? pcp->_total : 1;
+	unsigned count = 0, nedges = 0;
+	char name[16], name2[16];
+
+	for(unsigned i = 0 ; i < pcp->_nnodes ; i++) exclusive[pcp->_nodes[i]._entry] += pcp->_nodes[i]._self;
+	for(unsigned e = 0 ; e < n ; e++){
+		if(e == pcp->_root || pcp->_calls[e]) order[count++] = e;
+	}
+	sort_profile = pcp;
+	qsort(order, count, sizeof(unsigned), by_inclusive);
+
+	printf("\n### CALL GRAPH ###\n\n");
+	printf("\t   inclusive          exclusive        calls  entry\n");
+	for(unsigned i = 0 ; i < count ; i++){
+		unsigned e = order[i];
+		printf("\t%12" PRIu64 " %5.1f%% %12" PRIu64 " %5.1f%% %8" PRIu64 "  %s\n",
+		       pcp->_inclusive[e], 100 * pcp->_inclusive[e] / total,
+		       exclusive[e], 100 * exclusive[e] / total, pcp->_calls[e], entry_name(pcp, e, name));
+	}
+
+	for(unsigned i = 0 ; i < pcp->_edgesize ; i++){
+		if(pcp->_edges[i]._count) edges[nedges++] = pcp->_edges[i];
+	}
+	qsort(edges, nedges, sizeof(Call_Edge), by_edge);
+	printf("\n Calls :\n\n");
+	for(unsigned i = 0 ; i < nedges ; i++){
+		printf("\t%s -> %s : %" PRIu64 "\n", entry_name(pcp, edges[i]._caller, name),
+		       entry_name(pcp, edges[i]._callee, name2), edges[i]._count);
+	}
+
+	free(exclusive);
+	free(order);
+	free(edges);
+}
+
+/*!
+ * \param pcp le profil (arrêté)
+ * \param f le fichier, ouvert en écriture
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_folded_stacks(const Call_Profile *pcp, FILE *f){
+	const Call_Node *nodes = pcp->_nodes;
+	unsigned *path = cg_alloc(pcp->_nnodes, sizeof(unsigned));
+	unsigned depth = 0, v = 0;
+	char name[16];
+
+	//parcours préfixe de l'arbre, le chemin depuis la racine dans path
+	for(;;){
+		path[depth] = v;
+		if(nodes[v]._self){
+			for(unsigned d = 0 ; d <= depth ; d++){
+				fprintf(f, "%s%s", d ? ";" : "", entry_name(pcp, nodes[path[d]]._entry, name));
+			}
+			fprintf(f, " %" PRIu64 "\n", nodes[v]._self);
+		}
+		if(nodes[v]._child){
+			v = nodes[v]._child;
+			depth++;
+			continue;
+		}
+		while(depth && !nodes[v]._sibling){
+			v = nodes[v]._parent;
+			depth--;
+		}
+		if(!depth) break;
+		v = nodes[v]._sibling;
+	}
+
+	free(path);
+	return !ferror(f);
+}
+
+/*!
+ * \param pcp le profil (arrêté)
+ */
+void free_callgraph(Call_Profile *pcp){
+	free(pcp->_stack);
+	free(pcp->_nodes);
+	free(pcp->_edges);
+	free(pcp->_inclusive);
+	free(pcp->_calls);
+	free(pcp->_active);
+	memset(pcp, 0, sizeof(Call_Profile));
+}
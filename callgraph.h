@@ -0,0 +1,136 @@
+#ifndef _CALLGRAPH_H_
+#define _CALLGRAPH_H_
+
+/*!
+ * \file callgraph.h
+ * \brief Profil exact par sous-programme (graphe d'appels).
+ *
+ * Le profileur d'appels est une sonde (voir probe.h) qui tient, du côté de
+ * l'hôte, une pile d'appels parallèle à celle du programme simulé : chaque
+ * \c CALL pris y empile un cadre (le sous-programme appelé et le mot de pile
+ * où est rangée son adresse de retour), chaque \c RET en dépile un. Chaque
+ * instruction exécutée est attribuée au sous-programme en sommet de pile et
+ * au chemin d'appels qui y mène (arbre des contextes d'appel).
+ *
+ * Le programme peut manipuler R15 (SP) directement. Les cadres sont donc
+ * reconnus par leur mot de pile et non par leur ordre :
+ *
+ *    - un \c RET dont l'adresse de retour est lue au mot \c s termine le
+ *    cadre de mot \c s et tous les cadres plus profonds, abandonnés par le
+ *    programme ; s'il n'existe pas de cadre de mot \c s (adresse empilée par
+ *    \c PUSH), c'est un simple saut et la pile parallèle est inchangée ;
+ *
+ *    - un \c CALL qui range son adresse de retour au mot \c s termine d'abord
+ *    les cadres de mot inférieur ou égal à \c s, que le programme a abandonnés
+ *    en remontant SP.
+ *
+ * Le compte inclusif d'un sous-programme est le nombre d'instructions
+ * exécutées pendant qu'il est actif ; une activation récursive n'est comptée
+ * qu'une fois. Le compte exclusif ne compte que ses propres instructions.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+#include "probe.h"
+
+//! Cadre de la pile d'appels parallèle
+typedef struct
+{
+    unsigned _node;     //!< Contexte d'appel (nœud de l'arbre)
+    Word _slot;         //!< Mot de pile de l'adresse de retour
+    uint64_t _start;    //!< Instructions exécutées à l'appel
+} Call_Frame;
+
+//! Nœud de l'arbre des contextes d'appel
+typedef struct
+{
+    unsigned _entry;    //!< Adresse du sous-programme (\c _textsize : programme principal)
+    unsigned _parent;   //!< Contexte appelant
+    unsigned _child;    //!< Premier contexte appelé
+    unsigned _sibling;  //!< Contexte suivant du même appelant
+    uint64_t _self;     //!< Instructions exécutées dans ce contexte même
+} Call_Node;
+
+//! Arc du graphe d'appels
+typedef struct
+{
+    unsigned _caller;   //!< Appelant (\c _textsize : programme principal)
+    unsigned _callee;   //!< Appelé
+    uint64_t _count;    //!< Nombre d'appels
+} Call_Edge;
+
+//! Profil par sous-programme
+typedef struct
+{
+    Probe _probe;           //!< Sonde (premier champ)
+    Machine *_pmach;        //!< Machine observée
+    unsigned _root;         //!< Indice du programme principal (\c _textsize)
+    uint64_t _total;        //!< Nombre d'instructions exécutées
+
+    Call_Frame *_stack;     //!< Pile d'appels parallèle (le fond est le programme principal)
+    unsigned _depth;        //!< Nombre de cadres
+    unsigned _stacksize;    //!< Capacité de la pile
+
+    Call_Node *_nodes;      //!< Arbre des contextes d'appel (la racine est le nœud 0)
+    unsigned _nnodes;       //!< Nombre de nœuds
+    unsigned _nodesize;     //!< Capacité de l'arbre
+
+    Call_Edge *_edges;      //!< Table de hachage des arcs (adressage ouvert)
+    unsigned _nedges;       //!< Nombre d'arcs
+    unsigned _edgesize;     //!< Capacité de la table (puissance de 2)
+
+    uint64_t *_inclusive;   //!< Compte inclusif, par adresse d'entrée
+    uint64_t *_calls;       //!< Nombre d'appels reçus, par adresse d'entrée
+    unsigned *_active;      //!< Activations en cours, par adresse d'entrée
+} Call_Profile;
+
+//! Début du profil par sous-programme
+/*!
+ * \param pcp le profil
+ * \param pmach la machine à observer (déjà chargée)
+ */
+void callgraph_start(Call_Profile *pcp, Machine *pmach);
+
+//! Fin du profil
+/*!
+ * Les cadres encore actifs sont terminés (leurs comptes inclusifs sont
+ * arrêtés) et la sonde est détachée. Sans effet si le profil est déjà
+ * arrêté.
+ *
+ * \param pcp le profil
+ */
+void callgraph_stop(Call_Profile *pcp);
+
+//! Affichage du profil par sous-programme
+/*!
+ * Les sous-programmes par comptes inclusifs décroissants, puis les arcs
+ * appelant → appelé.
+ *
+ * \param pcp le profil (arrêté)
+ */
+void print_callgraph(const Call_Profile *pcp);
+
+//! Écriture des piles repliées (« folded stacks »)
+/*!
+ * Une ligne par contexte d'appel ayant exécuté des instructions : les
+ * sous-programmes du chemin séparés par des points-virgules (\c main pour le
+ * programme principal, l'adresse d'entrée pour les autres), une espace et le
+ * nombre d'instructions. C'est le format d'entrée de \c flamegraph.pl et des
+ * outils équivalents.
+ *
+ * \param pcp le profil (arrêté)
+ * \param f le fichier, ouvert en écriture
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_folded_stacks(const Call_Profile *pcp, FILE *f);
+
+//! Libération du profil
+/*!
+ * \param pcp le profil (arrêté)
+ */
+void free_callgraph(Call_Profile *pcp);
+
+#endif
@@ -0,0 +1,604 @@
+/*!
+ * \file cfg.c
+ * \brief Graphe de flot de contrôle du segment de texte.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "cfg.h"
+
+//! Allocation d'un tableau du graphe (initialisé à zéro)
+/*!
+ * \param n le nombre d'éléments (au moins un est alloué)
+ * \param size la taille d'un élément
+ * \return le tableau
+ */
+static void *cfg_alloc(size_t n, size_t size){
+	void *p = calloc(n ? n : 1, size);
+	if(!p){
+		perror("Erreur d'allocation mémoire pour le graphe de flot de contrôle dans <cfg.c:build_cfg>");
+		exit(1);
+	}
+	return p;
+}
+
+//! Tableau d'indices initialisés à CFG_NONE
+static unsigned *none_array(size_t n){
+	unsigned *p = cfg_alloc(n, sizeof(unsigned));
+	for(size_t i = 0 ; i < n ; i++) p[i] = CFG_NONE;
+	return p;
+}
+
+//! La micro-opération termine-t-elle un bloc ?
+static bool ends_block(unsigned uop){
+	switch(uop){
+		case UOP_BRANCH_ABS : case UOP_BRANCH_IDX : case UOP_BRANCH_CHK :
+		case UOP_CALL_ABS : case UOP_CALL_IDX : case UOP_CALL_CHK :
+		case UOP_RET : case UOP_HALT : case UOP_RTT : case UOP_FAULT :
+			return true;
+		default:
+			return false;
+	}
+}
+
+//! Cible connue d'un branchement ou d'un appel, ou CFG_NONE
+/*!
+ * Seules les cibles prouvées par le vérificateur (voir verify.h) sont des
+ * adresses de texte : une micro-opération \c UOP_xxx_CHK échouerait.
+ */
+static unsigned target_of(const Decoded_Text *pdec, unsigned addr){
+	switch(pdec->_uop[addr]){
+		case UOP_BRANCH_ABS : case UOP_CALL_ABS :
+			return pdec->_operand[addr];
+		default:
+			return CFG_NONE;
+	}
+}
+
+//! Ajout d'un successeur (sans doublon)
+static void add_succ(Basic_Block *pb, unsigned s){
+	for(unsigned i = 0 ; i < pb->_nsucc ; i++){
+		if(pb->_succ[i] == s) return;
+	}
+	pb->_succ[pb->_nsucc++] = s;
+}
+
+//! Découpage en blocs et successeurs
+static void build_blocks(Cfg *pcfg, const Machine *pmach){
+	const Decoded_Text *pdec = &pmach->_decoded;
+	const unsigned textsize = pmach->_textsize;
+	uint8_t *leader = cfg_alloc(textsize, sizeof(uint8_t));
+	unsigned n = 0;
+
+	//débuts de blocs
+	if(textsize) leader[0] = 1;
+	for(unsigned a = 0 ; a < textsize ; a++){
+		unsigned t = target_of(pdec, a);
+		if(t != CFG_NONE) leader[t] = 1;
+		if(ends_block(pdec->_uop[a]) && a + 1 < textsize) leader[a + 1] = 1;
+	}
+	for(unsigned a = 0 ; a < textsize ; a++) n += leader[a];
+
+	pcfg->_nblocks = n;
+	pcfg->_blocks = cfg_alloc(n, sizeof(Basic_Block));
+	pcfg->_block_of = cfg_alloc(textsize, sizeof(unsigned));
+	for(unsigned a = 0, b = CFG_NONE ; a < textsize ; a++){
+		if(leader[a]){
+			b++;
+			pcfg->_blocks[b]._start = a;
+		}
+		pcfg->_blocks[b]._end = a + 1;
+		pcfg->_block_of[a] = b;
+	}
+	free(leader);
+
+	//successeurs
+	for(unsigned b = 0 ; b < n ; b++){
+		Basic_Block *pb = &pcfg->_blocks[b];
+		unsigned last = pb->_end - 1;
+		unsigned t = target_of(pdec, last);
+		bool falls = pb->_end < textsize;
+
+		pb->_callee = pb->_idom = pb->_sub = pb->_loop = CFG_NONE;
+		switch(pdec->_uop[last]){
+			case UOP_BRANCH_ABS : case UOP_BRANCH_IDX : case UOP_BRANCH_CHK :
+				if(t != CFG_NONE) add_succ(pb, pcfg->_block_of[t]);
+				if(pdec->_uop[last] == UOP_BRANCH_IDX) pb->_flags |= BB_INDIRECT;
+				//seul un branchement conditionnel peut continuer en séquence
+				falls = falls && pdec->_regcond[last] != NC;
+				if(pdec->_uop[last] == UOP_BRANCH_CHK && !falls) pb->_flags |= BB_EXIT;
+				break;
+			case UOP_CALL_ABS : case UOP_CALL_IDX : case UOP_CALL_CHK :
+				if(t != CFG_NONE) pb->_callee = pcfg->_block_of[t];
+				if(pdec->_uop[last] == UOP_CALL_IDX) pb->_flags |= BB_INDIRECT;
+				break;
+			case UOP_RET : case UOP_HALT : case UOP_RTT : case UOP_FAULT :
+				falls = false;
+				pb->_flags |= BB_EXIT;
+				break;
+			default:
+				break;
+		}
+		if(falls) add_succ(pb, b + 1);
+	}
+}
+
+//! Prédécesseurs, rangés bloc par bloc
+static void build_preds(Cfg *pcfg){
+	const unsigned n = pcfg->_nblocks;
+	unsigned *start = cfg_alloc(n + 1, sizeof(unsigned));
+	unsigned *fill = cfg_alloc(n, sizeof(unsigned));
+
+	for(unsigned b = 0 ; b < n ; b++){
+		for(unsigned i = 0 ; i < pcfg->_blocks[b]._nsucc ; i++) start[pcfg->_blocks[b]._succ[i] + 1]++;
+	}
+	for(unsigned b = 0 ; b < n ; b++) start[b + 1] += start[b];
+	pcfg->_preds = cfg_alloc(start[n], sizeof(unsigned));
+	for(unsigned b = 0 ; b < n ; b++){
+		for(unsigned i = 0 ; i < pcfg->_blocks[b]._nsucc ; i++){
+			unsigned s = pcfg->_blocks[b]._succ[i];
+			pcfg->_preds[start[s] + fill[s]++] = b;
+		}
+	}
+	pcfg->_predstart = start;
+	free(fill);
+}
+
+//! Code accessible et sous-programmes
+/*!
+ * On parcourt le flot et les appels depuis l'adresse 0. Les cibles des
+ * appels rencontrés deviennent des sous-programmes, dans l'ordre de leur
+ * découverte ; chacun s'attribue ensuite les blocs qu'il atteint et qui ne
+ * sont encore à personne.
+ */
+static void find_subroutines(Cfg *pcfg){
+	const unsigned n = pcfg->_nblocks;
+	Basic_Block *blocks = pcfg->_blocks;
+	unsigned *stack = cfg_alloc(n, sizeof(unsigned));
+	unsigned sp = 0;
+
+	pcfg->_subs = cfg_alloc(n, sizeof(Subroutine));
+	pcfg->_nsubs = 0;
+	if(!n){
+		free(stack);
+		return;
+	}
+
+	blocks[0]._flags |= BB_REACHABLE | BB_ENTRY;
+	pcfg->_subs[pcfg->_nsubs++]._entry = 0;
+	stack[sp++] = 0;
+	while(sp){
+		Basic_Block *pb = &blocks[stack[--sp]];
+		unsigned c = pb->_callee;
+		for(unsigned i = 0 ; i < pb->_nsucc ; i++){
+			unsigned s = pb->_succ[i];
+			if(!(blocks[s]._flags & BB_REACHABLE)){
+				blocks[s]._flags |= BB_REACHABLE;
+				stack[sp++] = s;
+			}
+		}
+		if(c != CFG_NONE && !(blocks[c]._flags & BB_ENTRY)){
+			blocks[c]._flags |= BB_ENTRY;
+			pcfg->_subs[pcfg->_nsubs++]._entry = c;
+			if(!(blocks[c]._flags & BB_REACHABLE)){
+				blocks[c]._flags |= BB_REACHABLE;
+				stack[sp++] = c;
+			}
+		}
+	}
+
+	//chaque entrée appartient à son sous-programme
+	for(unsigned s = 0 ; s < pcfg->_nsubs ; s++){
+		blocks[pcfg->_subs[s]._entry]._sub = s;
+		pcfg->_subs[s]._nblocks = 1;
+	}
+	for(unsigned s = 0 ; s < pcfg->_nsubs ; s++){
+		stack[sp++] = pcfg->_subs[s]._entry;
+		while(sp){
+			Basic_Block *pb = &blocks[stack[--sp]];
+			for(unsigned i = 0 ; i < pb->_nsucc ; i++){
+				unsigned b = pb->_succ[i];
+				if(blocks[b]._sub == CFG_NONE){
+					blocks[b]._sub = s;
+					pcfg->_subs[s]._nblocks++;
+					stack[sp++] = b;
+				}
+			}
+		}
+	}
+	free(stack);
+}
+
+//! État de l'algorithme de Lengauer et Tarjan
+/*!
+ * Les sommets sont les blocs et une racine fictive d'indice \c _nblocks,
+ * dont les successeurs sont les entrées des sous-programmes.
+ */
+typedef struct
+{
+    const Cfg *_pcfg;
+    unsigned _root;         //!< Racine fictive
+    unsigned *_dfnum;       //!< Rang préfixe du parcours (CFG_NONE : non atteint)
+    unsigned *_vertex;      //!< Sommet de chaque rang
+    unsigned *_parent;      //!< Père dans l'arbre du parcours
+    unsigned *_semi;        //!< Rang du semi-dominateur
+    unsigned *_ancestor;    //!< Forêt de l'évaluation (CFG_NONE : racine)
+    unsigned *_label;       //!< Sommet de plus petit semi-dominateur sur le chemin
+    unsigned *_path;        //!< Pile de la compression de chemins
+} Dominators;
+
+//! Nombre de successeurs d'un sommet
+static inline unsigned dom_nsucc(const Dominators *pd, unsigned v){
+	return v == pd->_root ? pd->_pcfg->_nsubs : pd->_pcfg->_blocks[v]._nsucc;
+}
+
+//! i-ème successeur d'un sommet
+static inline unsigned dom_succ(const Dominators *pd, unsigned v, unsigned i){
+	return v == pd->_root ? pd->_pcfg->_subs[i]._entry : pd->_pcfg->_blocks[v]._succ[i];
+}
+
+//! Évaluation avec compression de chemin (itérative)
+static unsigned dom_eval(Dominators *pd, unsigned v){
+	unsigned n = 0;
+
+	if(pd->_ancestor[v] == CFG_NONE) return v;
+	//chemin jusqu'au dernier sommet dont l'ancêtre est une racine
+	for(unsigned x = v ; pd->_ancestor[pd->_ancestor[x]] != CFG_NONE ; x = pd->_ancestor[x]){
+		pd->_path[n++] = x;
+	}
+	//compression, du haut vers le bas
+	while(n){
+		unsigned x = pd->_path[--n];
+		unsigned a = pd->_ancestor[x];
+		if(pd->_semi[pd->_label[a]] < pd->_semi[pd->_label[x]]) pd->_label[x] = pd->_label[a];
+		pd->_ancestor[x] = pd->_ancestor[a];
+	}
+	return pd->_label[v];
+}
+
+//! Calcul des dominateurs immédiats
+/*!
+ * \param pcfg le graphe
+ * \param order reçoit les blocs accessibles dans l'ordre préfixe du parcours
+ * \return le nombre de blocs rangés dans \c order
+ */
+static unsigned find_dominators(Cfg *pcfg, unsigned *order){
+	const unsigned n = pcfg->_nblocks;
+	const unsigned nv = n + 1;
+	Dominators d = { pcfg, n };
+	unsigned *idom = none_array(nv);
+	unsigned *bucket = none_array(nv);
+	unsigned *next = none_array(nv);
+	unsigned *stack = cfg_alloc(nv, sizeof(unsigned));
+	unsigned *iter = cfg_alloc(nv, sizeof(unsigned));
+	unsigned count = 0, sp = 0;
+
+	d._dfnum = none_array(nv);
+	d._vertex = cfg_alloc(nv, sizeof(unsigned));
+	d._parent = none_array(nv);
+	d._semi = cfg_alloc(nv, sizeof(unsigned));
+	d._ancestor = none_array(nv);
+	d._label = cfg_alloc(nv, sizeof(unsigned));
+	d._path = cfg_alloc(nv, sizeof(unsigned));
+
+	//parcours en profondeur depuis la racine fictive
+	d._dfnum[d._root] = count;
+	d._vertex[count++] = d._root;
+	stack[sp++] = d._root;
+	while(sp){
+		unsigned v = stack[sp - 1];
+		if(iter[v] == dom_nsucc(&d, v)){
+			sp--;
+			continue;
+		}
+		unsigned w = dom_succ(&d, v, iter[v]++);
+		if(d._dfnum[w] == CFG_NONE){
+			d._dfnum[w] = count;
+			d._vertex[count++] = w;
+			d._parent[w] = v;
+			stack[sp++] = w;
+		}
+	}
+	for(unsigned v = 0 ; v < nv ; v++){
+		d._semi[v] = d._dfnum[v];
+		d._label[v] = v;
+	}
+
+	//semi-dominateurs, par rangs décroissants
+	for(unsigned i = count - 1 ; i > 0 ; i--){
+		unsigned w = d._vertex[i];
+		unsigned p = d._parent[w];
+		//la racine fictive précède chaque entrée
+		if(pcfg->_blocks[w]._flags & BB_ENTRY) d._semi[w] = 0;
+		for(unsigned k = pcfg->_predstart[w] ; k < pcfg->_predstart[w + 1] ; k++){
+			unsigned v = pcfg->_preds[k];
+			if(d._dfnum[v] == CFG_NONE) continue;
+			unsigned u = dom_eval(&d, v);
+			if(d._semi[u] < d._semi[w]) d._semi[w] = d._semi[u];
+		}
+		unsigned s = d._vertex[d._semi[w]];
+		next[w] = bucket[s];
+		bucket[s] = w;
+		d._ancestor[w] = p;
+		for(unsigned v = bucket[p] ; v != CFG_NONE ; v = next[v]){
+			unsigned u = dom_eval(&d, v);
+			idom[v] = d._semi[u] < d._semi[v] ? u : p;
+		}
+		bucket[p] = CFG_NONE;
+	}
+	for(unsigned i = 1 ; i < count ; i++){
+		unsigned w = d._vertex[i];
+		if(idom[w] != d._vertex[d._semi[w]]) idom[w] = idom[idom[w]];
+		pcfg->_blocks[w]._idom = idom[w] == d._root ? CFG_NONE : idom[w];
+	}
+
+	//numérotation de l'arbre des dominateurs (fils rangés comme les prédécesseurs)
+	unsigned *start = cfg_alloc(nv + 1, sizeof(unsigned));
+	unsigned *child = cfg_alloc(nv, sizeof(unsigned));
+	for(unsigned i = 1 ; i < count ; i++) start[idom[d._vertex[i]] + 1]++;
+	for(unsigned v = 0 ; v < nv ; v++) start[v + 1] += start[v];
+	for(unsigned v = 0 ; v < nv ; v++) iter[v] = start[v];
+	for(unsigned i = 1 ; i < count ; i++){
+		unsigned w = d._vertex[i];
+		child[iter[idom[w]]++] = w;
+	}
+	pcfg->_dompre = none_array(nv);
+	pcfg->_dompost = none_array(nv);
+	unsigned pre = 0, post = 0;
+	for(unsigned v = 0 ; v < nv ; v++) iter[v] = start[v];
+	pcfg->_dompre[d._root] = pre++;
+	stack[sp++] = d._root;
+	while(sp){
+		unsigned v = stack[sp - 1];
+		if(iter[v] == start[v + 1]){
+			pcfg->_dompost[v] = post++;
+			sp--;
+			continue;
+		}
+		unsigned w = child[iter[v]++];
+		pcfg->_dompre[w] = pre++;
+		stack[sp++] = w;
+	}
+
+	//ordre du parcours, sans la racine fictive
+	for(unsigned i = 1 ; i < count ; i++) order[i - 1] = d._vertex[i];
+
+	free(start);
+	free(child);
+	free(idom);
+	free(bucket);
+	free(next);
+	free(stack);
+	free(iter);
+	free(d._dfnum);
+	free(d._vertex);
+	free(d._parent);
+	free(d._semi);
+	free(d._ancestor);
+	free(d._label);
+	free(d._path);
+	return count - 1;
+}
+
+/*!
+ * \param pcfg le graphe
+ * \param a un bloc
+ * \param b un autre bloc
+ * \return vrai si \c a domine \c b (tout bloc accessible se domine lui-même)
+ */
+bool dominates(const Cfg *pcfg, unsigned a, unsigned b){
+	if(pcfg->_dompre[a] == CFG_NONE || pcfg->_dompre[b] == CFG_NONE) return false;
+	return pcfg->_dompre[a] <= pcfg->_dompre[b] && pcfg->_dompost[b] <= pcfg->_dompost[a];
+}
+
+//! Représentant d'un bloc dans les boucles déjà construites (avec compression)
+static unsigned loop_find(unsigned *rep, unsigned b){
+	while(rep[b] != b){
+		rep[b] = rep[rep[b]];
+		b = rep[b];
+	}
+	return b;
+}
+
+//! Recherche des boucles naturelles
+/*!
+ * Un en-tête est la cible d'un arc de retour (vers un bloc qui domine sa
+ * source). Les en-têtes sont traités dans l'ordre préfixe décroissant du
+ * parcours : une boucle interne l'est avant celle qui l'englobe. Le corps
+ * d'une boucle est remonté depuis les sources de ses arcs de retour ; une
+ * boucle interne déjà construite y est réduite à son en-tête (union de
+ * classes), de sorte que chaque arc n'est examiné qu'une fois par niveau
+ * d'imbrication.
+ *
+ * \param pcfg le graphe
+ * \param order les blocs accessibles dans l'ordre préfixe du parcours
+ * \param count leur nombre
+ */
+static void find_loops(Cfg *pcfg, const unsigned *order, unsigned count){
+	const unsigned n = pcfg->_nblocks;
+	Basic_Block *blocks = pcfg->_blocks;
+	unsigned *rep = cfg_alloc(n, sizeof(unsigned));
+	unsigned *loop_of = none_array(n);
+	unsigned *mark = none_array(n);
+	unsigned *stack = cfg_alloc(n, sizeof(unsigned));
+
+	pcfg->_loops = cfg_alloc(n, sizeof(Loop));
+	pcfg->_nloops = 0;
+	for(unsigned b = 0 ; b < n ; b++) rep[b] = b;
+
+	for(unsigned i = count ; i-- > 0 ; ){
+		unsigned h = order[i];
+		unsigned sp = 0;
+
+		//sources des arcs de retour
+		for(unsigned k = pcfg->_predstart[h] ; k < pcfg->_predstart[h + 1] ; k++){
+			unsigned p = pcfg->_preds[k];
+			if(!dominates(pcfg, h, p)) continue;
+			unsigned x = loop_find(rep, p);
+			if(x != h && mark[x] != h){
+				mark[x] = h;
+				stack[sp++] = x;
+			}
+			blocks[h]._flags |= BB_HEADER;
+		}
+		if(!(blocks[h]._flags & BB_HEADER)) continue;
+
+		unsigned l = pcfg->_nloops++;
+		Loop *pl = &pcfg->_loops[l];
+		pl->_header = h;
+		pl->_parent = CFG_NONE;
+		pl->_nblocks = 1;
+		loop_of[h] = l;
+		if(blocks[h]._loop == CFG_NONE) blocks[h]._loop = l;
+
+		while(sp){
+			unsigned x = stack[--sp];
+			if(loop_of[x] != CFG_NONE){
+				//boucle interne, réduite à son en-tête
+				pcfg->_loops[loop_of[x]]._parent = l;
+				pl->_nblocks += pcfg->_loops[loop_of[x]]._nblocks;
+			} else {
+				pl->_nblocks++;
+				blocks[x]._loop = l;
+			}
+			rep[x] = h;
+			for(unsigned k = pcfg->_predstart[x] ; k < pcfg->_predstart[x + 1] ; k++){
+				unsigned p = pcfg->_preds[k];
+				//une entrée qui contourne l'en-tête (graphe irréductible) est ignorée
+				if(!dominates(pcfg, h, p)) continue;
+				unsigned y = loop_find(rep, p);
+				if(y != h && mark[y] != h){
+					mark[y] = h;
+					stack[sp++] = y;
+				}
+			}
+		}
+	}
+
+	//les boucles englobantes ont été construites après leurs boucles internes
+	for(unsigned l = pcfg->_nloops ; l-- > 0 ; ){
+		Loop *pl = &pcfg->_loops[l];
+		pl->_depth = pl->_parent == CFG_NONE ? 1 : pcfg->_loops[pl->_parent]._depth + 1;
+	}
+
+	free(rep);
+	free(loop_of);
+	free(mark);
+	free(stack);
+}
+
+/*!
+ * \param pcfg le graphe à construire
+ * \param pmach la machine dont on analyse le segment de texte
+ */
+void build_cfg(Cfg *pcfg, const Machine *pmach){
+	build_blocks(pcfg, pmach);
+	build_preds(pcfg);
+	find_subroutines(pcfg);
+
+	unsigned *order = cfg_alloc(pcfg->_nblocks, sizeof(unsigned));
+	unsigned count = find_dominators(pcfg, order);
+	find_loops(pcfg, order, count);
+	free(order);
+}
+
+/*!
+ * \param pcfg le graphe
+ * \param f le fichier, ouvert en écriture
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_cfg_dot(const Cfg *pcfg, FILE *f){
+	const unsigned n = pcfg->_nblocks;
+	const Basic_Block *blocks = pcfg->_blocks;
+	unsigned *start = cfg_alloc(pcfg->_nsubs + 2, sizeof(unsigned));
+	unsigned *byfunc = cfg_alloc(n, sizeof(unsigned));
+
+	//blocs regroupés par sous-programme, le code mort en dernier
+	for(unsigned b = 0 ; b < n ; b++){
+		unsigned s = blocks[b]._sub == CFG_NONE ? pcfg->_nsubs : blocks[b]._sub;
+		start[s + 1]++;
+	}
+	for(unsigned s = 0 ; s <= pcfg->_nsubs ; s++) start[s + 1] += start[s];
+	for(unsigned b = 0 ; b < n ; b++){
+		unsigned s = blocks[b]._sub == CFG_NONE ? pcfg->_nsubs : blocks[b]._sub;
+		byfunc[start[s]++] = b;
+	}
+	for(unsigned s = pcfg->_nsubs + 1 ; s > 0 ; s--) start[s] = start[s - 1];
+	start[0] = 0;
+
+	fprintf(f, "digraph cfg {\n");
+	fprintf(f, "\tnode [shape=box, fontname=\"monospace\"];\n");
+	for(unsigned s = 0 ; s <= pcfg->_nsubs ; s++){
+		bool dead = s == pcfg->_nsubs;
+		if(!dead){
+			fprintf(f, "\tsubgraph cluster_%u {\n\t\tlabel=\"sub 0x%04x\";\n", s,
+			        blocks[pcfg->_subs[s]._entry]._start);
+		}
+		for(unsigned i = start[s] ; i < start[s + 1] ; i++){
+			const Basic_Block *pb = &blocks[byfunc[i]];
+			fprintf(f, "\t\tb%u [label=\"0x%04x-0x%04x%s\"", byfunc[i], pb->_start, pb->_end - 1,
+			        pb->_flags & BB_INDIRECT ? " (indirect)" : "");
+			if(pb->_flags & BB_HEADER) fprintf(f, ", peripheries=2");
+			if(dead) fprintf(f, ", style=dashed, color=gray, fontcolor=gray");
+			fprintf(f, "];\n");
+		}
+		if(!dead) fprintf(f, "\t}\n");
+	}
+	for(unsigned b = 0 ; b < n ; b++){
+		const Basic_Block *pb = &blocks[b];
+		for(unsigned i = 0 ; i < pb->_nsucc ; i++){
+			//arc de retour d'une boucle
+			bool back = dominates(pcfg, pb->_succ[i], b);
+			fprintf(f, "\tb%u -> b%u%s;\n", b, pb->_succ[i], back ? " [color=blue]" : "");
+		}
+		if(pb->_callee != CFG_NONE){
+			fprintf(f, "\tb%u -> b%u [style=dashed, label=\"call\"];\n", b, pb->_callee);
+		}
+	}
+	fprintf(f, "}\n");
+
+	free(start);
+	free(byfunc);
+	return !ferror(f);
+}
+
+/*!
+ * \param pcfg le graphe
+ */
+void print_cfg(const Cfg *pcfg){
+	unsigned dead = 0;
+
+	printf("\n### CONTROL FLOW GRAPH ###\n\n");
+	for(unsigned s = 0 ; s < pcfg->_nsubs ; s++){
+		printf("\tsub  0x%04x : %u blocks\n",
+		       pcfg->_blocks[pcfg->_subs[s]._entry]._start, pcfg->_subs[s]._nblocks);
+	}
+	for(unsigned l = 0 ; l < pcfg->_nloops ; l++){
+		const Loop *pl = &pcfg->_loops[l];
+		printf("\tloop 0x%04x : %u blocks, depth %u\n",
+		       pcfg->_blocks[pl->_header]._start, pl->_nblocks, pl->_depth);
+	}
+	for(unsigned b = 0 ; b < pcfg->_nblocks ; b++){
+		if(!(pcfg->_blocks[b]._flags & BB_REACHABLE)) dead++;
+	}
+	printf("\n Blocks : %u, subroutines : %u, loops : %u, dead blocks : %u\n",
+	       pcfg->_nblocks, pcfg->_nsubs, pcfg->_nloops, dead);
+}
+
+/*!
+ * \param pcfg le graphe
+ */
+void free_cfg(Cfg *pcfg){
+	free(pcfg->_blocks);
+	free(pcfg->_block_of);
+	free(pcfg->_preds);
+	free(pcfg->_predstart);
+	free(pcfg->_subs);
+	free(pcfg->_loops);
+	free(pcfg->_dompre);
+	free(pcfg->_dompost);
+	pcfg->_blocks = NULL;
+	pcfg->_nblocks = 0;
+}
@@ -0,0 +1,138 @@
+#ifndef _CFG_H_
+#define _CFG_H_
+
+/*!
+ * \file cfg.h
+ * \brief Graphe de flot de contrôle du segment de texte.
+ *
+ * Le segment de texte est découpé en blocs de base : un bloc commence à
+ * l'adresse 0, à la cible d'un branchement ou d'un appel à une adresse
+ * absolue, ou après une instruction qui rompt la séquence (branchement,
+ * appel, retour, arrêt, instruction fautive). Les arcs du graphe sont les
+ * successeurs de chaque bloc dans son sous-programme ; un appel a pour
+ * successeur l'instruction qui le suit, et le bloc appelé est noté à part.
+ *
+ * Les sous-programmes sont le programme principal (adresse 0) et les cibles
+ * des appels accessibles depuis celui-ci. Les blocs que l'on ne peut
+ * atteindre ni par le flot ni par un appel sont du code mort. Les
+ * dominateurs sont calculés pour tous les sous-programmes à la fois (une
+ * racine fictive précède toutes les entrées) par l'algorithme de Lengauer
+ * et Tarjan ; les boucles naturelles s'en déduisent (arc vers un bloc
+ * dominant) et sont imbriquées les unes dans les autres.
+ *
+ * Toute la construction est itérative et en temps quasi linéaire : elle
+ * convient aux programmes engendrés de plusieurs centaines de milliers
+ * d'instructions. Un branchement ou un appel indexé n'a pas de cible
+ * connue : le bloc est seulement marqué (\c BB_INDIRECT).
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "machine.h"
+
+//! Indice de bloc, de sous-programme ou de boucle inexistant
+#define CFG_NONE (~0u)
+
+//! Indicateurs d'un bloc de base
+enum
+{
+    BB_REACHABLE = 1,   //!< Accessible depuis l'adresse 0 (sinon code mort)
+    BB_ENTRY = 2,       //!< Entrée d'un sous-programme
+    BB_INDIRECT = 4,    //!< Se termine par un branchement ou un appel indexé
+    BB_HEADER = 8,      //!< En-tête d'une boucle
+    BB_EXIT = 16,       //!< Se termine par RET, HALT, RTT ou une erreur
+};
+
+//! Bloc de base
+typedef struct
+{
+    unsigned _start;    //!< Adresse de la première instruction
+    unsigned _end;      //!< Adresse qui suit la dernière instruction
+    unsigned _succ[2];  //!< Successeurs dans le sous-programme
+    unsigned _nsucc;    //!< Nombre de successeurs
+    unsigned _callee;   //!< Bloc appelé par le CALL final (CFG_NONE sinon)
+    unsigned _idom;     //!< Dominateur immédiat (CFG_NONE : entrée ou code mort)
+    unsigned _sub;      //!< Sous-programme (CFG_NONE : code mort)
+    unsigned _loop;     //!< Boucle la plus interne qui le contient (CFG_NONE sinon)
+    unsigned _flags;    //!< Indicateurs (BB_REACHABLE...)
+} Basic_Block;
+
+//! Sous-programme
+typedef struct
+{
+    unsigned _entry;    //!< Bloc d'entrée
+    unsigned _nblocks;  //!< Nombre de blocs qui lui sont attribués
+} Subroutine;
+
+//! Boucle naturelle
+typedef struct
+{
+    unsigned _header;   //!< Bloc d'en-tête
+    unsigned _parent;   //!< Boucle englobante (CFG_NONE si aucune)
+    unsigned _depth;    //!< Profondeur d'imbrication (1 pour une boucle externe)
+    unsigned _nblocks;  //!< Nombre de blocs, boucles internes comprises
+} Loop;
+
+//! Graphe de flot de contrôle
+typedef struct
+{
+    Basic_Block *_blocks;   //!< Blocs, par adresses croissantes
+    unsigned _nblocks;      //!< Nombre de blocs
+    unsigned *_block_of;    //!< Bloc de chaque instruction (indicé par adresse)
+    unsigned *_preds;       //!< Prédécesseurs, bloc par bloc
+    unsigned *_predstart;   //!< Début des prédécesseurs de chaque bloc (_nblocks + 1 entrées)
+    Subroutine *_subs;      //!< Sous-programmes (le premier est le programme principal)
+    unsigned _nsubs;        //!< Nombre de sous-programmes
+    Loop *_loops;           //!< Boucles naturelles
+    unsigned _nloops;       //!< Nombre de boucles
+    unsigned *_dompre;      //!< Rang préfixe de chaque bloc dans l'arbre des dominateurs
+    unsigned *_dompost;     //!< Rang postfixe de chaque bloc dans l'arbre des dominateurs
+} Cfg;
+
+//! Construction du graphe de flot de contrôle
+/*!
+ * Le graphe est construit à partir de la table de micro-opérations de la
+ * machine : les instructions fautives y sont déjà repérées.
+ *
+ * \param pcfg le graphe à construire
+ * \param pmach la machine dont on analyse le segment de texte
+ */
+void build_cfg(Cfg *pcfg, const Machine *pmach);
+
+//! Test de dominance
+/*!
+ * \param pcfg le graphe
+ * \param a un bloc
+ * \param b un autre bloc
+ * \return vrai si \c a domine \c b (tout bloc accessible se domine lui-même)
+ */
+bool dominates(const Cfg *pcfg, unsigned a, unsigned b);
+
+//! Écriture du graphe au format DOT (Graphviz)
+/*!
+ * Chaque sous-programme est un sous-graphe ; les appels sont en pointillés,
+ * le code mort est grisé et les en-têtes de boucle sont entourés deux fois.
+ *
+ * \param pcfg le graphe
+ * \param f le fichier, ouvert en écriture
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_cfg_dot(const Cfg *pcfg, FILE *f);
+
+//! Affichage des sous-programmes et des boucles
+/*!
+ * Chaque sous-programme et chaque boucle est listé avec son adresse de
+ * début, puis le bilan (blocs, sous-programmes, boucles, blocs morts).
+ *
+ * \param pcfg le graphe
+ */
+void print_cfg(const Cfg *pcfg);
+
+//! Libération d'un graphe de flot de contrôle
+/*!
+ * \param pcfg le graphe
+ */
+void free_cfg(Cfg *pcfg);
+
+#endif
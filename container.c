@@ -0,0 +1,670 @@
+/*!
+ * \file container.c
+ * \brief Format conteneur des programmes binaires.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+// EBADMSG est POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "container.h"
+
+//! Taille de l'en-tête (en octets)
+#define HEADER_SIZE 16
+
+//! Taille d'un descripteur de section dans le fichier (en octets)
+#define DESCRIPTOR_SIZE 24
+
+//! Nombre maximal de sections (le nombre est codé sur un octet)
+#define MAX_SECTIONS 255
+
+//! Nombre de bits de la table de hachage du compresseur
+#define LZ_HASHBITS 12
+
+//! Longueur minimale d'une copie
+#define LZ_MINMATCH 4
+
+//! Les derniers octets d'un bloc sont toujours des littéraux
+#define LZ_LASTLITERALS 5
+
+//! Une copie commence au moins à cette distance de la fin du bloc
+#define LZ_MFLIMIT 12
+
+//! Taille maximale d'un bloc compressé de \c n octets
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+//! Taille du tampon de lecture d'une section
+#define READ_CHUNK 4096
+
+//! Table du CRC-32 (polynôme 0xEDB88320), quatre bits à la fois
+static const uint32_t crc_table[16] = {
+	0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+	0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+	0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+	0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+//! Calcul du CRC-32
+/*!
+ * \param crc le CRC des octets précédents (0 au début)
+ * \param p les octets suivants
+ * \param n leur nombre
+ * \return le CRC de l'ensemble des octets
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t n){
+	crc = ~crc;
+	while(n--){
+		crc = crc_table[(crc ^ *p) & 0xf] ^ (crc >> 4);
+		crc = crc_table[(crc ^ (*p++ >> 4)) & 0xf] ^ (crc >> 4);
+	}
+	return ~crc;
+}
+
+//! Ordre des octets de l'hôte
+static inline Container_Order host_order(void){
+	const uint32_t one = 1;
+	return *(const uint8_t *) &one ? CONTAINER_LITTLE : CONTAINER_BIG;
+}
+
+//! Lecture d'un entier de 32 bits dans l'ordre du fichier
+static inline uint32_t get32(const uint8_t *p, Container_Order order){
+	if(order == CONTAINER_BIG)
+		return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+	return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+//! Lecture d'un entier de 16 bits dans l'ordre du fichier
+static inline uint16_t get16(const uint8_t *p, Container_Order order){
+	if(order == CONTAINER_BIG) return (uint16_t) (p[0] << 8 | p[1]);
+	return (uint16_t) (p[0] | p[1] << 8);
+}
+
+//! Écriture d'un entier de 32 bits, poids faible en tête
+static inline void put32(uint8_t *p, uint32_t v){
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+/*!
+ * \param head les 4 premiers octets du fichier
+ * \return vrai si c'est la signature d'un fichier conteneur
+ */
+bool is_container(const void *head){
+	return memcmp(head, CONTAINER_MAGIC, 4) == 0;
+}
+
+//! Longueur d'un littéral ou d'une copie au-delà de 15 (octets 255 puis reste)
+/*!
+ * \param op la position d'écriture
+ * \param len la longueur, moins 15
+ * \return la position qui suit la longueur codée
+ */
+static uint8_t *lz_put_length(uint8_t *op, size_t len){
+	while(len >= 255){
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (uint8_t) len;
+	return op;
+}
+
+//! Écriture d'une séquence : littéraux puis, si \c matchlen est non nul, une copie
+/*!
+ * \param op la position d'écriture
+ * \param lit les littéraux
+ * \param litlen le nombre de littéraux
+ * \param offset la distance de la copie
+ * \param matchlen la longueur de la copie (0 pour la dernière séquence)
+ * \return la position qui suit la séquence
+ */
+static uint8_t *lz_sequence(uint8_t *op, const uint8_t *lit, size_t litlen, unsigned offset, size_t matchlen){
+	uint8_t *token = op++;
+	*token = (uint8_t) ((litlen < 15 ? litlen : 15) << 4);
+	if(litlen >= 15) op = lz_put_length(op, litlen - 15);
+	memcpy(op, lit, litlen);
+	op += litlen;
+	if(matchlen){
+		*op++ = (uint8_t) offset;
+		*op++ = (uint8_t) (offset >> 8);
+		matchlen -= LZ_MINMATCH;
+		*token |= (uint8_t) (matchlen < 15 ? matchlen : 15);
+		if(matchlen >= 15) op = lz_put_length(op, matchlen - 15);
+	}
+	return op;
+}
+
+//! Compression d'un bloc
+/*!
+ * Recherche gloutonne : chaque groupe de 4 octets est cherché dans une table
+ * de hachage des positions déjà vues.
+ * \param in les octets à compresser
+ * \param n leur nombre
+ * \param out le bloc compressé (au moins LZ_BOUND(n) octets)
+ * \return la taille du bloc compressé
+ */
+static size_t lz_compress(const uint8_t *in, size_t n, uint8_t *out){
+	uint32_t table[1 << LZ_HASHBITS] = { 0 };
+	const uint8_t *ip = in, *anchor = in, *end = in + n;
+	uint8_t *op = out;
+
+	if(n >= LZ_MFLIMIT){
+		const uint8_t *limit = end - LZ_MFLIMIT, *matchend = end - LZ_LASTLITERALS;
+		while(ip <= limit){
+			uint32_t seq;
+			memcpy(&seq, ip, sizeof(seq));
+			uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASHBITS);
+			const uint8_t *ref = in + table[h];
+			table[h] = (uint32_t) (ip - in);
+			if(ref >= ip || ip - ref > 0xffff || memcmp(ref, ip, LZ_MINMATCH) != 0){
+				ip++;
+				continue;
+			}
+			//on prolonge la copie aussi loin que possible
+			const uint8_t *mp = ip + LZ_MINMATCH, *rp = ref + LZ_MINMATCH;
+			while(mp < matchend && *mp == *rp){
+				mp++;
+				rp++;
+			}
+			op = lz_sequence(op, anchor, ip - anchor, (unsigned) (ip - ref), mp - ip);
+			ip = anchor = mp;
+		}
+	}
+	//dernière séquence : les littéraux restants
+	return lz_sequence(op, anchor, end - anchor, 0, 0) - out;
+}
+
+//! Lecture au fil du fichier du contenu d'une section
+typedef struct
+{
+    FILE *_file;                //!< Fichier
+    uint32_t _left;             //!< Octets de la section pas encore lus dans le fichier
+    size_t _pos;                //!< Position dans le tampon
+    size_t _len;                //!< Nombre d'octets dans le tampon
+    uint8_t _buf[READ_CHUNK];   //!< Tampon
+} Section_Input;
+
+//! Remplissage du tampon
+/*!
+ * \param pin l'entrée
+ * \return faux à la fin de la section ou si le fichier est trop court
+ */
+static bool input_fill(Section_Input *pin){
+	size_t want = pin->_left < READ_CHUNK ? pin->_left : READ_CHUNK;
+	if(!want || fread(pin->_buf, 1, want, pin->_file) != want) return false;
+	pin->_left -= want;
+	pin->_pos = 0;
+	pin->_len = want;
+	return true;
+}
+
+//! Lecture d'un octet
+/*!
+ * \param pin l'entrée
+ * \return l'octet, ou -1 à la fin de la section
+ */
+static inline int input_byte(Section_Input *pin){
+	if(pin->_pos == pin->_len && !input_fill(pin)) return -1;
+	return pin->_buf[pin->_pos++];
+}
+
+//! Lecture de \c n octets
+/*!
+ * \param pin l'entrée
+ * \param dest la destination
+ * \param n le nombre d'octets
+ * \return faux si la section est trop courte
+ */
+static bool input_copy(Section_Input *pin, uint8_t *dest, size_t n){
+	while(n){
+		if(pin->_pos == pin->_len && !input_fill(pin)) return false;
+		size_t k = pin->_len - pin->_pos < n ? pin->_len - pin->_pos : n;
+		memcpy(dest, pin->_buf + pin->_pos, k);
+		pin->_pos += k;
+		dest += k;
+		n -= k;
+	}
+	return true;
+}
+
+//! Lecture d'une longueur au-delà de 15
+/*!
+ * \param pin l'entrée
+ * \param plen la longueur, à laquelle on ajoute les octets lus
+ * \return faux si la section est trop courte
+ */
+static bool input_length(Section_Input *pin, size_t *plen){
+	int c;
+	do{
+		if((c = input_byte(pin)) < 0) return false;
+		*plen += c;
+	} while(c == 255);
+	return true;
+}
+
+//! Décompression d'une section directement dans sa destination
+/*!
+ * \param pin l'entrée, limitée au contenu compressé de la section
+ * \param dest la destination
+ * \param size la taille décompressée attendue
+ * \return faux si le bloc est incohérent
+ */
+static bool lz_decompress(Section_Input *pin, uint8_t *dest, size_t size){
+	uint8_t *op = dest, *end = dest + size;
+	int token;
+
+	while((token = input_byte(pin)) >= 0){
+		size_t len = token >> 4;
+		if(len == 15 && !input_length(pin, &len)) return false;
+		if(len > (size_t) (end - op) || !input_copy(pin, op, len)) return false;
+		op += len;
+		//la dernière séquence n'a que des littéraux
+		if(pin->_left == 0 && pin->_pos == pin->_len) break;
+		int lo = input_byte(pin), hi = input_byte(pin);
+		if(lo < 0 || hi < 0) return false;
+		size_t offset = (size_t) (lo | hi << 8);
+		if(offset == 0 || offset > (size_t) (op - dest)) return false;
+		len = token & 15;
+		if(len == 15 && !input_length(pin, &len)) return false;
+		len += LZ_MINMATCH;
+		if(len > (size_t) (end - op)) return false;
+		//la copie peut recouvrir sa source : octet par octet
+		for(const uint8_t *m = op - offset ; len-- ; ) *op++ = *m++;
+	}
+	return op == end;
+}
+
+//! Lecture du contenu d'une section
+/*!
+ * Le contenu est lu (ou décompressé) directement dans la destination, puis
+ * son CRC est vérifié.
+ * \param f le fichier, positionné au début du contenu
+ * \param pd le descripteur de la section
+ * \param dest la destination (\c _size octets)
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+static bool read_section(FILE *f, const Section_Descriptor *pd, uint8_t *dest){
+	if(pd->_flags & SEC_LZ){
+		Section_Input in = { f, pd->_stored, 0, 0 };
+		if(!lz_decompress(&in, dest, pd->_size)){
+			errno = ferror(f) ? errno : ENOEXEC;
+			return false;
+		}
+	} else if(fread(dest, 1, pd->_size, f) != pd->_size){
+		errno = ferror(f) ? errno : ENOEXEC;
+		return false;
+	}
+	if(crc32_update(0, dest, pd->_size) != pd->_crc){
+		errno = EBADMSG;
+		return false;
+	}
+	return true;
+}
+
+//! Saut du contenu d'une section
+/*!
+ * Le fichier peut être un tube : on lit le contenu sans le garder.
+ * \param f le fichier, positionné au début du contenu
+ * \param pd le descripteur de la section
+ * \return faux si le fichier est trop court
+ */
+static bool skip_section(FILE *f, const Section_Descriptor *pd){
+	Section_Input in = { f, pd->_stored, 0, 0 };
+	while(in._left){
+		if(!input_fill(&in)){
+			errno = ferror(f) ? errno : ENOEXEC;
+			return false;
+		}
+	}
+	return true;
+}
+
+//! Remise des mots d'un segment dans l'ordre des octets de l'hôte
+/*!
+ * \param w les mots, dans l'ordre du fichier
+ * \param n leur nombre
+ * \param order l'ordre des octets du fichier
+ */
+static void fix_order(Word *w, size_t n, Container_Order order){
+	if(order == host_order()) return;
+	for(size_t i = 0 ; i < n ; i++) w[i] = get32((const uint8_t *) &w[i], order);
+}
+
+//! Décodage de la section des symboles
+/*!
+ * \param p le contenu de la section
+ * \param size sa taille
+ * \param order l'ordre des octets du fichier
+ * \param psyms la table à remplir
+ * \return faux si la section est incohérente (voir \c errno)
+ */
+static bool parse_symbols(const uint8_t *p, uint32_t size, Container_Order order, Symbol_Table *psyms){
+	unsigned count = 0;
+	//premier passage : nombre de symboles
+	for(uint32_t i = 0 ; i < size ; i += 6 + p[i + 5], count++){
+		if(size - i < 6 || size - i - 6 < p[i + 5]){
+			errno = ENOEXEC;
+			return false;
+		}
+	}
+	if(!(psyms->_symbols = calloc(count ? count : 1, sizeof(Symbol)))) return false;
+	//second passage : les symboles
+	for(uint32_t i = 0 ; psyms->_count < count ; i += 6 + p[i + 5]){
+		Symbol *ps = &psyms->_symbols[psyms->_count];
+		if(!(ps->_name = malloc(p[i + 5] + 1))) return false;
+		memcpy(ps->_name, p + i + 6, p[i + 5]);
+		ps->_name[p[i + 5]] = '\0';
+		ps->_value = get32(p + i, order);
+		ps->_data = p[i + 4] != 0;
+		psyms->_count++;
+	}
+	return true;
+}
+
+/*!
+ * \param pmach la machine à simuler
+ * \param f le fichier, positionné juste après la signature
+ * \param psyms table où ranger les symboles (ignorés si NULL)
+ * \return vrai si le programme a été chargé ; faux sinon (voir \c errno)
+ */
+bool read_container(Machine *pmach, FILE *f, Symbol_Table *psyms){
+	uint8_t header[HEADER_SIZE];
+	uint8_t table[MAX_SECTIONS * DESCRIPTOR_SIZE];
+	Section_Descriptor sec[MAX_SECTIONS];
+	const Section_Descriptor *ptext = NULL, *pdata = NULL, *pbss = NULL, *pstate = NULL;
+	uint8_t state[CONTAINER_STATE_WORDS * sizeof(Word)];
+	Instruction *text = NULL;
+	Word *data = NULL;
+	size_t datalen = 0;
+	uint8_t *payload = NULL;
+	int saved_errno;
+
+	if(psyms){
+		psyms->_symbols = NULL;
+		psyms->_count = 0;
+	}
+
+	//en-tête et table des sections
+	memcpy(header, CONTAINER_MAGIC, 4);
+	if(fread(header + 4, 1, HEADER_SIZE - 4, f) != HEADER_SIZE - 4) goto truncated;
+	Container_Order order = header[6];
+	unsigned nsec = header[7];
+	if((order != CONTAINER_LITTLE && order != CONTAINER_BIG) || get16(header + 4, order) != CONTAINER_VERSION)
+		goto bad_format;
+	if(fread(table, DESCRIPTOR_SIZE, nsec, f) != nsec) goto truncated;
+	if(crc32_update(crc32_update(0, header, 12), table, nsec * DESCRIPTOR_SIZE) != get32(header + 12, order)){
+		errno = EBADMSG;
+		goto fail;
+	}
+
+	//descripteurs
+	for(unsigned i = 0 ; i < nsec ; i++){
+		const uint8_t *p = table + i * DESCRIPTOR_SIZE;
+		Section_Descriptor *pd = &sec[i];
+		pd->_type = get32(p, order);
+		pd->_flags = get32(p + 4, order);
+		pd->_size = get32(p + 8, order);
+		pd->_stored = get32(p + 12, order);
+		pd->_info = get32(p + 16, order);
+		pd->_crc = get32(p + 20, order);
+		if(!(pd->_flags & SEC_LZ) && pd->_stored != pd->_size && pd->_type != SEC_BSS) goto bad_format;
+		const Section_Descriptor **pp = pd->_type == SEC_TEXT ? &ptext
+			: pd->_type == SEC_DATA ? &pdata : pd->_type == SEC_BSS ? &pbss
+			: pd->_type == SEC_STATE ? &pstate : NULL;
+		if(!pp) continue;
+		//une seule section de chaque type de segment, en mots entiers
+		if(*pp || pd->_size % sizeof(Word)) goto bad_format;
+		*pp = pd;
+	}
+	if(!ptext || (pbss && pbss->_stored) || (pstate && pstate->_size != sizeof(state))) goto bad_format;
+
+	//tailles des segments
+	unsigned textsize = ptext->_size / sizeof(Instruction);
+	uint64_t nbss = !pbss ? 0 : pbss->_info ? pbss->_info : pbss->_size / sizeof(Word);
+	uint64_t datasize64 = (pdata ? pdata->_size / sizeof(Word) : 0) + nbss;
+	if(datasize64 > UINT32_MAX) goto bad_format;
+	unsigned datasize = (unsigned) datasize64, dataend = pdata ? pdata->_info : 0;
+	unsigned memsize = data_memsize(datasize, dataend);
+	if(memsize < datasize) goto bad_format;
+
+	if(!(text = calloc(textsize ? textsize : 1, sizeof(Instruction)))
+	   || !(data = map_data(memsize, &datalen))) goto fail;
+
+	//contenu des sections, au fil du fichier
+	for(unsigned i = 0 ; i < nsec ; i++){
+		const Section_Descriptor *pd = &sec[i];
+		if(pd == ptext){
+			if(!read_section(f, pd, (uint8_t *) text)) goto fail;
+			fix_order((Word *) text, textsize, order);
+		} else if(pd == pdata){
+			if(!read_section(f, pd, (uint8_t *) data)) goto fail;
+			fix_order(data, pd->_size / sizeof(Word), order);
+		} else if(pd == pbss){
+			continue;
+		} else if(pd == pstate){
+			if(!read_section(f, pd, state)) goto fail;
+		} else if(pd->_type == SEC_SYMBOLS && psyms && !psyms->_symbols){
+			if(!(payload = malloc(pd->_size ? pd->_size : 1)) || !read_section(f, pd, payload)) goto fail;
+			if(!parse_symbols(payload, pd->_size, order, psyms)) goto fail;
+			free(payload);
+			payload = NULL;
+		} else if(!skip_section(f, pd)){
+			goto fail;
+		}
+	}
+
+	//on réinitialise la machine avec les nouvelles données du programme
+	load_program(pmach, textsize, text, memsize, data, dataend);
+	pmach->_datamap = data;
+	pmach->_datamaplen = datalen;
+
+	//reprise d'une exécution
+	if(pstate){
+		const uint8_t *p = state;
+		pmach->_pc = get32(p, order);
+		pmach->_cc = get32(p + 4, order);
+		pmach->_trapbase = get32(p + 8, order);
+		pmach->_intrap = get32(p + 12, order) != 0;
+		pmach->_trapcc = get32(p + 16, order);
+		pmach->_steps = get32(p + 20, order) | (uint64_t) get32(p + 24, order) << 32;
+		for(int r = 0 ; r < NREGISTERS ; r++) pmach->_registers[r] = get32(p + 28 + 4 * r, order);
+	}
+	return true;
+
+truncated:
+	errno = ferror(f) ? errno : ENOEXEC;
+	goto fail;
+bad_format:
+	errno = ENOEXEC;
+fail:
+	saved_errno = errno;
+	free(text);
+	if(data) munmap(data, datalen);
+	free(payload);
+	if(psyms) free_symbols(psyms);
+	errno = saved_errno;
+	return false;
+}
+
+//! Section en cours d'écriture
+typedef struct
+{
+    Section_Descriptor _desc;   //!< Descripteur
+    uint8_t *_content;          //!< Contenu stocké (alloué)
+} Out_Section;
+
+//! Préparation du contenu d'une section
+/*!
+ * Le CRC est calculé sur le contenu brut, puis le contenu est compressé si
+ * on le demande et si c'est rentable.
+ * \param ps la section (type et \c _info déjà remplis)
+ * \param raw le contenu brut (alloué ; libéré ou conservé)
+ * \param size sa taille
+ * \param flags options de write_container() (CONTAINER_LZ)
+ */
+static void prepare_section(Out_Section *ps, uint8_t *raw, uint32_t size, unsigned flags){
+	ps->_desc._flags = 0;
+	ps->_desc._size = size;
+	ps->_desc._stored = size;
+	ps->_desc._crc = crc32_update(0, raw, size);
+	ps->_content = raw;
+	if(!(flags & CONTAINER_LZ) || size < CONTAINER_LZ_MIN) return;
+	uint8_t *packed = malloc(LZ_BOUND((size_t) size));
+	if(!packed) return;
+	size_t stored = lz_compress(raw, size, packed);
+	if(stored < size){
+		free(raw);
+		ps->_content = packed;
+		ps->_desc._flags = SEC_LZ;
+		ps->_desc._stored = (uint32_t) stored;
+	} else {
+		free(packed);
+	}
+}
+
+//! Copie de mots, poids faible en tête
+/*!
+ * \param w les mots
+ * \param n leur nombre
+ * \return la copie (allouée), ou NULL
+ */
+static uint8_t *le_words(const Word *w, size_t n){
+	uint8_t *p = malloc(n ? n * sizeof(Word) : 1);
+	if(p) for(size_t i = 0 ; i < n ; i++) put32(p + i * sizeof(Word), w[i]);
+	return p;
+}
+
+/*!
+ * \param pmach la machine dont on écrit le programme et les données
+ * \param f le fichier, ouvert en écriture
+ * \param psyms les symboles à écrire (aucun si NULL)
+ * \param flags options (CONTAINER_LZ, CONTAINER_STATE)
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool write_container(const Machine *pmach, FILE *f, const Symbol_Table *psyms, unsigned flags){
+	Out_Section sec[5];
+	unsigned nsec = 0;
+	uint8_t header[HEADER_SIZE];
+	uint8_t table[5 * DESCRIPTOR_SIZE];
+	bool ok = false;
+
+	//données stockées : jusqu'au dernier mot non nul, et au moins jusqu'à dataend
+	//(les pages nulles de la fin sont sautées d'un coup)
+	unsigned ndata = pmach->_datasize;
+	while(ndata > pmach->_dataend && ndata - pmach->_dataend >= DATA_PAGE_WORDS && zero_words(pmach->_data + ndata - DATA_PAGE_WORDS, DATA_PAGE_WORDS))
+		ndata -= DATA_PAGE_WORDS;
+	while(ndata > pmach->_dataend && pmach->_data[ndata - 1] == 0) ndata--;
+
+	//la taille d'une section stockée tient sur 32 bits (en octets)
+	if(pmach->_textsize > UINT32_MAX / sizeof(Word) || ndata > UINT32_MAX / sizeof(Word)){
+		errno = EFBIG;
+		return false;
+	}
+
+	uint8_t *raw;
+	if(!(raw = le_words((const Word *) pmach->_text, pmach->_textsize))) goto done;
+	sec[nsec]._desc._type = SEC_TEXT;
+	sec[nsec]._desc._info = 0;
+	prepare_section(&sec[nsec++], raw, pmach->_textsize * sizeof(Word), flags);
+
+	if(!(raw = le_words(pmach->_data, ndata))) goto done;
+	sec[nsec]._desc._type = SEC_DATA;
+	sec[nsec]._desc._info = pmach->_dataend;
+	prepare_section(&sec[nsec++], raw, ndata * sizeof(Word), flags);
+
+	if(ndata < pmach->_datasize){
+		//au-delà de 4 Gio, la taille est donnée en mots
+		unsigned nbss = pmach->_datasize - ndata;
+		bool wide = nbss > UINT32_MAX / sizeof(Word);
+		sec[nsec]._desc = (Section_Descriptor) { SEC_BSS, 0, wide ? 0 : nbss * sizeof(Word), 0, wide ? nbss : 0, 0 };
+		sec[nsec++]._content = NULL;
+	}
+
+	if(psyms && psyms->_count){
+		size_t size = 0;
+		for(unsigned i = 0 ; i < psyms->_count ; i++){
+			size_t len = strlen(psyms->_symbols[i]._name);
+			if(len > 255){
+				errno = ENAMETOOLONG;
+				goto done;
+			}
+			size += 6 + len;
+		}
+		if(size > UINT32_MAX || !(raw = malloc(size))) goto done;
+		uint8_t *p = raw;
+		for(unsigned i = 0 ; i < psyms->_count ; i++){
+			const Symbol *ps = &psyms->_symbols[i];
+			size_t len = strlen(ps->_name);
+			put32(p, ps->_value);
+			p[4] = ps->_data;
+			p[5] = (uint8_t) len;
+			memcpy(p + 6, ps->_name, len);
+			p += 6 + len;
+		}
+		sec[nsec]._desc._type = SEC_SYMBOLS;
+		sec[nsec]._desc._info = 0;
+		prepare_section(&sec[nsec++], raw, (uint32_t) size, flags);
+	}
+
+	if(flags & CONTAINER_STATE){
+		if(!(raw = malloc(CONTAINER_STATE_WORDS * sizeof(Word)))) goto done;
+		put32(raw, pmach->_pc);
+		put32(raw + 4, pmach->_cc);
+		put32(raw + 8, pmach->_trapbase);
+		put32(raw + 12, pmach->_intrap);
+		put32(raw + 16, pmach->_trapcc);
+		put32(raw + 20, (uint32_t) pmach->_steps);
+		put32(raw + 24, (uint32_t) (pmach->_steps >> 32));
+		for(int r = 0 ; r < NREGISTERS ; r++) put32(raw + 28 + 4 * r, pmach->_registers[r]);
+		sec[nsec]._desc._type = SEC_STATE;
+		sec[nsec]._desc._info = 0;
+		prepare_section(&sec[nsec++], raw, CONTAINER_STATE_WORDS * sizeof(Word), flags);
+	}
+
+	//en-tête et table des sections
+	memcpy(header, CONTAINER_MAGIC, 4);
+	header[4] = CONTAINER_VERSION & 0xff;
+	header[5] = CONTAINER_VERSION >> 8;
+	header[6] = CONTAINER_LITTLE;
+	header[7] = (uint8_t) nsec;
+	put32(header + 8, 0);
+	for(unsigned i = 0 ; i < nsec ; i++){
+		uint8_t *p = table + i * DESCRIPTOR_SIZE;
+		put32(p, sec[i]._desc._type);
+		put32(p + 4, sec[i]._desc._flags);
+		put32(p + 8, sec[i]._desc._size);
+		put32(p + 12, sec[i]._desc._stored);
+		put32(p + 16, sec[i]._desc._info);
+		put32(p + 20, sec[i]._desc._crc);
+	}
+	put32(header + 12, crc32_update(crc32_update(0, header, 12), table, nsec * DESCRIPTOR_SIZE));
+
+	if(fwrite(header, 1, HEADER_SIZE, f) != HEADER_SIZE
+	   || fwrite(table, DESCRIPTOR_SIZE, nsec, f) != nsec) goto done;
+	for(unsigned i = 0 ; i < nsec ; i++){
+		//la section SEC_BSS n'a pas de contenu
+		if(sec[i]._content && fwrite(sec[i]._content, 1, sec[i]._desc._stored, f) != sec[i]._desc._stored) goto done;
+	}
+	ok = true;
+
+done:
+	for(unsigned i = 0 ; i < nsec ; i++) free(sec[i]._content);
+	return ok;
+}
+
+/*!
+ * \param psyms la table
+ */
+void free_symbols(Symbol_Table *psyms){
+	if(psyms->_symbols){
+		for(unsigned i = 0 ; i < psyms->_count ; i++) free(psyms->_symbols[i]._name);
+		free(psyms->_symbols);
+	}
+	psyms->_symbols = NULL;
+	psyms->_count = 0;
+}
@@ -0,0 +1,167 @@
+#ifndef _CONTAINER_H_
+#define _CONTAINER_H_
+
+/*!
+ * \file container.h
+ * \brief Format conteneur des programmes binaires.
+ *
+ * L'ancien format (voir read_program()) n'est qu'une suite d'entiers dans
+ * l'ordre des octets de l'hôte, sans signature ni contrôle. Le format
+ * conteneur le remplace :
+ *
+ *    - un en-tête de 16 octets : la signature CONTAINER_MAGIC, la version
+ *    sur 2 octets, l'ordre des octets du fichier (Container_Order), le
+ *    nombre de sections, 4 octets réservés (nuls) et le CRC-32 de l'en-tête
+ *    et de la table des sections ;
+ *
+ *    - la table des sections : un descripteur de 24 octets par section
+ *    (voir Section_Descriptor) ;
+ *
+ *    - le contenu des sections, dans l'ordre de la table.
+ *
+ * Tous les entiers, y compris les mots des segments, sont dans l'ordre
+ * indiqué par l'en-tête ; les fichiers produits sont en petit-boutiste.
+ * La section de texte est obligatoire. La section de données contient les
+ * données initiales ; la pile et la fin nulle du segment de données ne sont
+ * pas stockées mais décrites par la section \c SEC_BSS. La section des
+ * symboles, facultative, associe des noms à des adresses. La section d'état,
+ * facultative elle aussi, fait d'un fichier un instantané d'une exécution
+ * en cours (voir snapshot.h).
+ *
+ * Le contenu d'une section peut être compressé (indicateur \c SEC_LZ) : c'est
+ * alors une suite de séquences au format d'un bloc LZ4 (un octet de jeton,
+ * des littéraux, puis une copie d'au plus 64 Kio en arrière). Le CRC porte
+ * toujours sur le contenu décompressé.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+
+//! Signature d'un fichier conteneur
+#define CONTAINER_MAGIC "SIMB"
+
+//! Version du format conteneur
+#define CONTAINER_VERSION 1
+
+//! Taille minimale (en octets) d'une section compressée par write_container()
+#define CONTAINER_LZ_MIN 1024
+
+//! Ordre des octets d'un fichier conteneur
+typedef enum
+{
+    CONTAINER_LITTLE = 1,   //!< Poids faible en tête
+    CONTAINER_BIG = 2,      //!< Poids fort en tête
+} Container_Order;
+
+//! Types de section
+typedef enum
+{
+    SEC_TEXT = 1,   //!< Segment de texte (mots d'instruction)
+    SEC_DATA,       //!< Données initiales (mots) ; \c _info est \c dataend
+    SEC_BSS,        //!< Mots nuls qui complètent le segment de données (rien n'est stocké) ; \c _info est leur nombre s'il dépasse 4 Gio (\c _size est alors nul)
+    SEC_SYMBOLS,    //!< Table des symboles
+    SEC_STATE,      //!< État du processeur (CONTAINER_STATE_WORDS mots)
+} Section_Type;
+
+//! Taille de la section d'état (en mots)
+/*!
+ * Mots successifs : \c _pc, \c _cc, \c _trapbase, \c _intrap, \c _trapcc,
+ * \c _steps (poids faible puis poids fort) et les registres R00 à R15.
+ */
+#define CONTAINER_STATE_WORDS (7 + NREGISTERS)
+
+//! Options de write_container()
+enum
+{
+    CONTAINER_LZ = 1,       //!< Compresser les sections d'au moins CONTAINER_LZ_MIN octets
+    CONTAINER_STATE = 2,    //!< Écrire aussi l'état du processeur
+};
+
+//! Indicateurs d'une section
+enum
+{
+    SEC_LZ = 1,     //!< Contenu compressé
+};
+
+//! Descripteur d'une section
+/*!
+ * Une section de type inconnu est ignorée par le chargeur.
+ */
+typedef struct
+{
+    uint32_t _type;     //!< Type (Section_Type)
+    uint32_t _flags;    //!< Indicateurs (SEC_LZ)
+    uint32_t _size;     //!< Taille du contenu décompressé (en octets)
+    uint32_t _stored;   //!< Taille du contenu dans le fichier (en octets)
+    uint32_t _info;     //!< Information propre au type
+    uint32_t _crc;      //!< CRC-32 du contenu décompressé
+} Section_Descriptor;
+
+//! Symbole
+/*!
+ * Dans le fichier, un symbole est codé par sa valeur sur 4 octets, son
+ * segment sur un octet (0 : texte, 1 : données), la longueur de son nom sur
+ * un octet puis les caractères du nom.
+ */
+typedef struct
+{
+    char *_name;        //!< Nom (alloué)
+    unsigned _value;    //!< Adresse
+    bool _data;         //!< Adresse dans le segment de données ?
+} Symbol;
+
+//! Table des symboles
+typedef struct
+{
+    Symbol *_symbols;   //!< Symboles (alloués)
+    unsigned _count;    //!< Nombre de symboles
+} Symbol_Table;
+
+//! Reconnaissance d'un fichier conteneur
+/*!
+ * \param head les 4 premiers octets du fichier
+ * \return vrai si c'est la signature d'un fichier conteneur
+ */
+bool is_container(const void *head);
+
+//! Chargement d'un programme au format conteneur
+/*!
+ * Les tailles des segments sont connues dès la lecture de la table des
+ * sections : les segments sont alloués une fois, puis le contenu des
+ * sections y est lu (ou décompressé) directement au fil du fichier, qui
+ * peut donc être un tube. La machine est initialisée comme par
+ * load_program() puis, si le fichier contient une section d'état, placée
+ * dans cet état : l'exécution reprend là où l'instantané a été pris.
+ *
+ * \param pmach la machine à simuler
+ * \param f le fichier, positionné juste après la signature
+ * \param psyms table où ranger les symboles (ignorés si NULL)
+ * \return vrai si le programme a été chargé ; faux sinon, et \c errno vaut
+ * \c ENOEXEC si le fichier est incohérent, \c EBADMSG si un CRC est faux
+ */
+bool read_container(Machine *pmach, FILE *f, Symbol_Table *psyms);
+
+//! Écriture d'un programme au format conteneur
+/*!
+ * Seules les données jusqu'au dernier mot non nul (et au moins jusqu'à \c
+ * dataend) sont stockées.
+ *
+ * \param pmach la machine dont on écrit le programme et les données
+ * \param f le fichier, ouvert en écriture
+ * \param psyms les symboles à écrire (aucun si NULL)
+ * \param flags options (CONTAINER_LZ, CONTAINER_STATE)
+ * \return faux en cas d'erreur d'écriture (voir \c errno, qui vaut \c EFBIG si le
+ * texte ou les données stockées dépassent 4 Gio)
+ */
+bool write_container(const Machine *pmach, FILE *f, const Symbol_Table *psyms, unsigned flags);
+
+//! Libération d'une table des symboles
+/*!
+ * \param psyms la table
+ */
+void free_symbols(Symbol_Table *psyms);
+
+#endif
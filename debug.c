@@ -6,73 +6,510 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <ctype.h>
+#include <inttypes.h>
 #include "machine.h"
+#include "exec.h"
+#include "instruction.h"
 
 #include "debug.h"
 
+//! Longueur maximale d'une ligne de commande
+#define DEBUG_LINE 256
+
 void options(void){
-	printf("Available commands:\nh	help\nc	continue (exit interactive debug mode)\ns	step by step (next instruction)\nRET	step by step (next instruction)\nr	print registers\nd	print data memory\nt	print text (program) memory\np	print text (program) memory\nm	print registers and data memory\n");
+	printf("Available commands:\nh	help\nc	continue (until a breakpoint or a watchpoint, or to the end)\ns	step by step (next instruction)\nRET	step by step (next instruction)\nr	print registers\nd	print data memory\nt	print text (program) memory\np	print text (program) memory\nm	print registers and data memory\n"
+	       "b ADDR [if COND] [after N]	breakpoint on the instruction at ADDR\nw ADDR [r|w|rw] [if COND] [after N]	watchpoint on the data word at ADDR (default: w)\nl	list breakpoints and watchpoints\nx [NUM]	delete breakpoint or watchpoint NUM (all without NUM)\n"
+	       "rs [N]	reverse step: go back N instructions (default: 1)\nrc	reverse continue: go back to the previous breakpoint or watched write\ng STEP	go to the state after instruction number STEP (forward: untraced run)\nwho ADDR	last instruction that wrote the data word at ADDR\n"
+	       "COND is Rn OP VALUE (OP: == != < <= > >=, signed) or CC == U|Z|P|N (or !=);\nthe point stops the execution from its N-th hit with COND true.\nReverse commands need a recorded execution (option -R).\n");
+}
+
+//! Espaces sautés
+static const char *skip(const char *p){
+	while(*p == ' ' || *p == '\t') p++;
+	return p;
+}
+
+//! Mot-clé \c word, suivi d'un espace ou de la fin de la ligne
+static bool keyword(const char **pp, const char *word){
+	const char *p = skip(*pp);
+	size_t n = strlen(word);
+	if(strncmp(p, word, n) || (p[n] && !isspace((unsigned char) p[n]))) return false;
+	*pp = p + n;
+	return true;
+}
+
+//! Entier (décimal, ou hexadécimal préfixé par 0x)
+static bool number(const char **pp, long long *pv){
+	const char *p = skip(*pp);
+	char *end;
+	long long v = strtoll(p, &end, 0);
+	if(end == p) return false;
+	*pv = v;
+	*pp = end;
+	return true;
+}
+
+//! Condition : <tt>Rn OP VALUE</tt> ou <tt>CC OP U|Z|P|N</tt>
+static bool condition(const char **pp, Debug_Point *pt){
+	static const char *const ops[] = {"==", "!=", "<=", ">=", "<", ">", "="};
+	static const Debug_Compare cmps[] = {CMP_EQ, CMP_NE, CMP_LE, CMP_GE, CMP_LT, CMP_GT, CMP_EQ};
+	const char *p = skip(*pp);
+	long long v;
+	unsigned i;
+
+	if(toupper((unsigned char) p[0]) == 'C' && toupper((unsigned char) p[1]) == 'C'){
+		pt->_reg = DEBUG_CC;
+		p += 2;
+	} else if(toupper((unsigned char) p[0]) == 'R' && isdigit((unsigned char) p[1])){
+		char *end;
+		unsigned long reg = strtoul(p + 1, &end, 10);
+		if(reg >= NREGISTERS) return false;
+		pt->_reg = reg;
+		p = end;
+	} else return false;
+
+	p = skip(p);
+	for(i = 0 ; i < sizeof(ops) / sizeof(ops[0]) ; i++){
+		if(!strncmp(p, ops[i], strlen(ops[i]))) break;
+	}
+	if(i == sizeof(ops) / sizeof(ops[0])) return false;
+	pt->_cmp = cmps[i];
+	p = skip(p + strlen(ops[i]));
+
+	if(pt->_reg == DEBUG_CC){
+		const char *cc = strchr("UZPN", toupper((unsigned char) *p));
+		if(!*p || !cc || (pt->_cmp != CMP_EQ && pt->_cmp != CMP_NE)) return false;
+		pt->_value = cc - "UZPN";
+		p++;
+	} else {
+		if(!number(&p, &v) || v < INT32_MIN || v > UINT32_MAX) return false;
+		pt->_value = (int32_t) (uint32_t) v;
+	}
+	*pp = p;
+	return true;
+}
+
+//! Condition d'un point satisfaite ?
+static bool holds(const Debug_Point *pt, const Machine *pmach){
+	int32_t v;
+	if(pt->_cmp == CMP_NONE) return true;
+	v = pt->_reg == DEBUG_CC ? (int32_t) pmach->_cc : (int32_t) pmach->_registers[pt->_reg];
+	switch(pt->_cmp){
+		case CMP_EQ: return v == pt->_value;
+		case CMP_NE: return v != pt->_value;
+		case CMP_LT: return v < pt->_value;
+		case CMP_LE: return v <= pt->_value;
+		case CMP_GT: return v > pt->_value;
+		default: return v >= pt->_value;
+	}
+}
+
+//! Passage sur un point : faut-il s'arrêter ?
+static inline bool hit(Debug_Point *pt, const Machine *pmach){
+	return holds(pt, pmach) && ++pt->_hits >= pt->_after;
+}
+
+//! Sonde : fin d'une instruction (point d'arrêt sur l'instruction suivante ?)
+static void on_after(Probe *pp, Machine *pmach, unsigned addr){
+	Debugger *pdbg = (Debugger *) pp;
+	unsigned pc = pmach->_pc;
+	if(pc >= pmach->_textsize || !(pdbg->_map[pc / 64] >> (pc % 64) & 1)) return;
+	for(unsigned i = 0 ; i < pdbg->_npoints ; i++){
+		Debug_Point *pt = &pdbg->_points[i];
+		if(pt->_access || pt->_addr != pc || !hit(pt, pmach)) continue;
+		printf("Breakpoint %u at 0x%04x (hit %" PRIu64 ")\n", pt->_id, pc, pt->_hits);
+		pmach->_stop = true;
+	}
+}
+
+//! Accès à un mot de données observé ?
+static void watch(Debugger *pdbg, unsigned addr, unsigned daddr, Watch_Access access, Word value){
+	Machine *pmach = pdbg->_pmach;
+	for(unsigned i = 0 ; i < pdbg->_npoints ; i++){
+		Debug_Point *pt = &pdbg->_points[i];
+		if(!(pt->_access & access) || pt->_addr != daddr || !hit(pt, pmach)) continue;
+		if(access == WATCH_WRITE){
+			printf("Watchpoint %u: write 0x%04x at 0x%04x: 0x%08x -> 0x%08x (hit %" PRIu64 ")\n",
+			       pt->_id, daddr, addr, pmach->_data[daddr], value, pt->_hits);
+		} else {
+			printf("Watchpoint %u: read 0x%04x at 0x%04x: 0x%08x (hit %" PRIu64 ")\n",
+			       pt->_id, daddr, addr, pmach->_data[daddr], pt->_hits);
+		}
+		pmach->_stop = true;
+	}
+}
+
+//! Sonde : lecture d'un mot de données
+static void on_read(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr){
+	watch((Debugger *) pp, addr, daddr, WATCH_READ, 0);
+}
+
+//! Sonde : écriture d'un mot de données (l'ancienne valeur est encore en place)
+static void on_write(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr, Word value){
+	watch((Debugger *) pp, addr, daddr, WATCH_WRITE, value);
+}
+
+//! Mise à jour du bit d'une adresse du texte dans la table des points d'arrêt
+static void update_map(Debugger *pdbg, unsigned addr){
+	bool set = false;
+	for(unsigned i = 0 ; i < pdbg->_npoints ; i++){
+		if(!pdbg->_points[i]._access && pdbg->_points[i]._addr == addr) set = true;
+	}
+	if(set) pdbg->_map[addr / 64] |= UINT64_C(1) << (addr % 64);
+	else pdbg->_map[addr / 64] &= ~(UINT64_C(1) << (addr % 64));
+}
+
+//! Affichage d'un point
+static void print_point(const Debug_Point *pt){
+	static const char *const kinds[] = {"break", "watch r", "watch w", "watch rw"};
+	static const char *const cmps[] = {"", "==", "!=", "<", "<=", ">", ">="};
+	printf("\t%u\t%-8s 0x%04x\thits %" PRIu64, pt->_id, kinds[pt->_access], pt->_addr, pt->_hits);
+	if(pt->_cmp != CMP_NONE){
+		if(pt->_reg == DEBUG_CC) printf("\tif CC %s %c", cmps[pt->_cmp], "UZPN"[pt->_value]);
+		else printf("\tif R%02d %s %d", pt->_reg, cmps[pt->_cmp], pt->_value);
+	}
+	if(pt->_after > 1) printf("\tafter %" PRIu64, pt->_after);
+	printf("\n");
+}
+
+//! Commandes \c b et \c w : ajout d'un point
+/*!
+ * \param pdbg l'état de la mise au point
+ * \param p la suite de la ligne de commande
+ * \param data point d'observation (sinon point d'arrêt) ?
+ */
+static void add_point(Debugger *pdbg, const char *p, bool data){
+	const Machine *pmach = pdbg->_pmach;
+	Debug_Point pt = { 0 };
+	long long v;
+
+	if(pdbg->_npoints == DEBUG_MAX_POINTS){
+		printf("Too many breakpoints and watchpoints (%d)\n", DEBUG_MAX_POINTS);
+		return;
+	}
+	if(!number(&p, &v) || v < 0 || v >= (data ? pmach->_datasize : pmach->_textsize)){
+		printf("Invalid address (type h for help)\n");
+		return;
+	}
+	pt._addr = v;
+	pt._after = 1;
+	if(data){
+		pt._access = WATCH_WRITE;
+		if(keyword(&p, "r")) pt._access = WATCH_READ;
+		else if(keyword(&p, "rw")) pt._access = WATCH_READ | WATCH_WRITE;
+		else keyword(&p, "w");
+	}
+	if(keyword(&p, "if") && !condition(&p, &pt)){
+		printf("Invalid condition (type h for help)\n");
+		return;
+	}
+	if(keyword(&p, "after")){
+		if(!number(&p, &v) || v < 1){
+			printf("Invalid hit count (type h for help)\n");
+			return;
+		}
+		pt._after = v;
+	}
+	if(*skip(p) != '\n' && *skip(p)){
+		printf("Invalid command (type h for help)\n");
+		return;
+	}
+
+	pt._id = ++pdbg->_nextid;
+	pdbg->_points[pdbg->_npoints++] = pt;
+	if(!data) update_map(pdbg, pt._addr);
+	print_point(&pt);
+}
+
+//! Commande \c x : suppression d'un point (de tous sans numéro)
+static void delete_point(Debugger *pdbg, const char *p){
+	long long id;
+	unsigned i;
+
+	if(!number(&p, &id)){
+		pdbg->_npoints = 0;
+		memset(pdbg->_map, 0, (pdbg->_pmach->_textsize + 63) / 64 * sizeof(uint64_t));
+		return;
+	}
+	for(i = 0 ; i < pdbg->_npoints && pdbg->_points[i]._id != id ; i++);
+	if(i == pdbg->_npoints){
+		printf("No breakpoint or watchpoint %lld\n", id);
+		return;
+	}
+	Debug_Point pt = pdbg->_points[i];
+	memmove(&pdbg->_points[i], &pdbg->_points[i + 1], (pdbg->_npoints - i - 1) * sizeof(Debug_Point));
+	pdbg->_npoints--;
+	if(!pt._access) update_map(pdbg, pt._addr);
+}
+
+//! L'exécution est-elle enregistrée ? (sinon, message)
+static bool recording(const Debugger *pdbg){
+	if(pdbg->_prec) return true;
+	printf("Reverse execution needs a recorded execution (option -R)\n");
+	return false;
+}
+
+//! Position après un retour en arrière
+static void show_position(Debugger *pdbg){
+	Machine *pmach = pdbg->_pmach;
+	printf("Step %" PRIu64 " (recorded from step %" PRIu64 ")\n", pmach->_steps, record_first(pdbg->_prec));
+	if(pmach->_pc < pmach->_textsize) trace("EXECUTING", pmach, pmach->_text[pmach->_pc], pmach->_pc);
+}
+
+//! Point atteint à rebours ?
+/*!
+ * Un point d'arrêt est atteint quand \c _pc le désigne et que sa condition
+ * est satisfaite ; un point d'observation des écritures, quand l'instruction
+ * qui vient d'être annulée avait écrit le mot observé.
+ */
+static bool reverse_hit(Debugger *pdbg){
+	const Machine *pmach = pdbg->_pmach;
+	const Recorder *prec = pdbg->_prec;
+	unsigned pc = pmach->_pc;
+	unsigned nundone = prec->_nundone < RECORD_MAXWRITES ? prec->_nundone : RECORD_MAXWRITES;
+
+	for(unsigned i = 0 ; i < pdbg->_npoints ; i++){
+		const Debug_Point *pt = &pdbg->_points[i];
+		if(!pt->_access){
+			if(pt->_addr != pc || !holds(pt, pmach)) continue;
+			printf("Breakpoint %u at 0x%04x\n", pt->_id, pc);
+			return true;
+		}
+		if(!(pt->_access & WATCH_WRITE)) continue;
+		for(unsigned j = 0 ; j < nundone ; j++){
+			if(prec->_undone[j] != pt->_addr) continue;
+			printf("Watchpoint %u: write 0x%04x at 0x%04x undone: 0x%08x\n",
+			       pt->_id, pt->_addr, pc, pmach->_data[pt->_addr]);
+			return true;
+		}
+	}
+	return false;
+}
+
+//! Commande \c rs : retour en arrière d'un nombre d'instructions
+static void reverse_step(Debugger *pdbg, const char *p){
+	long long n = 1;
+	if(!recording(pdbg)) return;
+	if(number(&p, &n) && n < 1){
+		printf("Invalid count (type h for help)\n");
+		return;
+	}
+	for( ; n > 0 ; n--){
+		if(!record_undo(pdbg->_prec)){
+			printf("Start of the recording\n");
+			break;
+		}
+	}
+	show_position(pdbg);
+}
+
+//! Commande \c rc : retour au point précédent
+static void reverse_continue(Debugger *pdbg){
+	if(!recording(pdbg)) return;
+	while(true){
+		if(!record_undo(pdbg->_prec)){
+			printf("Start of the recording\n");
+			break;
+		}
+		if(reverse_hit(pdbg)) break;
+	}
+	show_position(pdbg);
+}
+
+//! Commande \c g : déplacement jusqu'à une instruction donnée par son numéro
+static void go_back(Debugger *pdbg, const char *p){
+	long long step;
+	if(!recording(pdbg)) return;
+	if(!number(&p, &step) || step < 0){
+		printf("Invalid step (type h for help)\n");
+		return;
+	}
+	if(!record_goto(pdbg->_prec, step)){
+		printf("Step %lld is not recorded (first recorded step: %" PRIu64 ")\n",
+		       step, record_first(pdbg->_prec));
+		return;
+	}
+	show_position(pdbg);
+}
+
+//! Commande \c who : dernière écriture d'un mot de données
+static void last_write(Debugger *pdbg, const char *p){
+	const Machine *pmach = pdbg->_pmach;
+	Record_Write w;
+	long long addr;
+	if(!recording(pdbg)) return;
+	if(!number(&p, &addr) || addr < 0 || addr >= pmach->_datasize){
+		printf("Invalid address (type h for help)\n");
+		return;
+	}
+	if(!record_last_write(pdbg->_prec, addr, &w)){
+		printf("Data 0x%04llx not written since step %" PRIu64 "\n", addr, record_first(pdbg->_prec));
+		return;
+	}
+	printf("Data 0x%04llx written at step %" PRIu64 " by 0x%04x: 0x%08x -> 0x%08x\t",
+	       addr, w._step, w._pc, w._old, w._new);
+	print_prefixed(text_prefix(pmach->_text, w._pc), pmach->_text[w._pc], w._pc);
+	printf("\n");
+}
+
+/*!
+ * \param pdbg l'état de la mise au point
+ * \param pmach la machine (déjà chargée)
+ */
+void debug_start(Debugger *pdbg, Machine *pmach){
+	memset(pdbg, 0, sizeof(Debugger));
+	pdbg->_pmach = pmach;
+	pdbg->_prec = pmach->_recorder;
+	pdbg->_map = calloc((pmach->_textsize + 63) / 64 + 1, sizeof(uint64_t));
+	if(!pdbg->_map){
+		perror("Erreur d'allocation mémoire pour les points d'arrêt dans <debug.c:debug_start>");
+		exit(1);
+	}
+}
+
+/*!
+ * \param pdbg l'état de la mise au point
+ */
+void debug_end(Debugger *pdbg){
+	free(pdbg->_map);
+	pdbg->_map = NULL;
+	pdbg->_npoints = 0;
 }
 
 //! Dialogue de mise au point interactive pour l'instruction courante.
 /*!
  * Cette fonction gère le dialogue pour l'option \c -d (debug). Dans ce mode,
- * elle est invoquée après l'exécution de chaque instruction.  Elle affiche le
- * menu de mise au point et on exécute le choix de l'utilisateur. Si cette
- * fonction retourne faux, on abandonne le mode de mise au point interactive
- * pour les instructions suivantes et jusqu'à la fin du programme.
- * 
- * \param mach la machine/programme en cours de simulation
- * \return vrai si l'on doit continuer en mode debug, faux sinon
+ * elle est invoquée avant l'exécution de chaque instruction. Elle lit les
+ * commandes de l'utilisateur, une par ligne, et les exécute. Si cette
+ * fonction retourne faux, on quitte le pas à pas : l'exécution continue
+ * jusqu'au prochain point d'arrêt (voir debug_continue()) ou, s'il n'y en a
+ * aucun, jusqu'à la fin du programme.
+ *
+ * \param pdbg l'état de la mise au point
+ * \return vrai si l'on doit continuer en pas à pas, faux sinon
  */
-bool debug_ask(Machine *pmach){
-	int c;
+bool debug_ask(Debugger *pdbg){
+	Machine *pmach = pdbg->_pmach;
+	char line[DEBUG_LINE];
 	while(true){
 		printf("DEBUG? ");
-        c = getchar();
-
-        switch(c){
-        	/* step by step (next instruction) */
-        	case '\n': return true;
-        	/* continue (exit interactive debug mode) */
-        	case 'c': return false;
-        	/* help */
-        	case 'h': 
-        		options();
-        		break;
-        	/* step by step (next instruction) */
-        	case 's': return true;
-        	/* print registers */
-        	case 'r':
-        		print_cpu(pmach);
-        		break;
-        	/* print data memory */
-        	case 'd':
-        		print_data(pmach);
-        		break;
-        	/* print text (program) memory */
-        	case 't':
-        	case 'p':
-        		print_program(pmach);
-        		break;
-        	/* print registers and data memory */
-        	case 'm':
-        		print_cpu(pmach);
-        		print_data(pmach);
-        		break;
-        	default:
-        		break;
-
-        }
-        /* On vide sdin pour ne pas que cela soit interpreté comme des commandes  */
-        int t;
-        do
-        {
-            t = getchar();
-        } while(t != '\n' && t != EOF);
+		fflush(stdout);
+		//fin de l'entrée : on continue sans mise au point
+		if(!fgets(line, sizeof(line), stdin)) break;
+		/* On vide stdin pour ne pas que la fin d'une ligne trop longue soit interpretée comme des commandes */
+		if(!strchr(line, '\n')){
+			int t;
+			do
+			{
+				t = getchar();
+			} while(t != '\n' && t != EOF);
+		}
+
+		const char *p = skip(line);
+		/* reverse execution */
+		if(keyword(&p, "rs")){
+			reverse_step(pdbg, p);
+			continue;
+		}
+		if(keyword(&p, "rc")){
+			reverse_continue(pdbg);
+			continue;
+		}
+		if(keyword(&p, "who")){
+			last_write(pdbg, p);
+			continue;
+		}
+		switch(*p++){
+			/* step by step (next instruction) */
+			case '\n':
+			case '\0':
+			case 's': return true;
+			/* continue (until a breakpoint or to the end) */
+			case 'c': return false;
+			/* help */
+			case 'h':
+				options();
+				break;
+			/* print registers */
+			case 'r':
+				print_cpu(pmach);
+				break;
+			/* print data memory */
+			case 'd':
+				print_data(pmach);
+				break;
+			/* print text (program) memory */
+			case 't':
+			case 'p':
+				print_program(pmach);
+				break;
+			/* print registers and data memory */
+			case 'm':
+				print_cpu(pmach);
+				print_data(pmach);
+				break;
+			/* breakpoint */
+			case 'b':
+				add_point(pdbg, p, false);
+				break;
+			/* watchpoint */
+			case 'w':
+				add_point(pdbg, p, true);
+				break;
+			/* list breakpoints and watchpoints */
+			case 'l':
+				for(unsigned i = 0 ; i < pdbg->_npoints ; i++) print_point(&pdbg->_points[i]);
+				break;
+			/* delete breakpoints and watchpoints */
+			case 'x':
+				delete_point(pdbg, p);
+				break;
+			/* go back to a recorded step */
+			case 'g':
+				go_back(pdbg, p);
+				break;
+			default:
+				break;
+		}
 	}
 	printf("\n");
 	return false;
-
 }
 
+/*!
+ * \param pdbg l'état de la mise au point
+ * \return faux après l'exécution de \c HALT ; vrai sur un arrêt
+ */
+bool debug_continue(Debugger *pdbg){
+	Machine *pmach = pdbg->_pmach;
+	jmp_buf resume;
+	volatile bool running = true;
+	unsigned access = 0;
+	bool breaks = false, stopped;
+
+	//la sonde ne s'intéresse qu'aux événements qui portent un point
+	for(unsigned i = 0 ; i < pdbg->_npoints ; i++){
+		access |= pdbg->_points[i]._access;
+		if(!pdbg->_points[i]._access) breaks = true;
+	}
+	pdbg->_probe._after = breaks ? on_after : NULL;
+	pdbg->_probe._read = access & WATCH_READ ? on_read : NULL;
+	pdbg->_probe._write = access & WATCH_WRITE ? on_write : NULL;
+	attach_probe(pmach, &pdbg->_probe);
+	pmach->_stop = false;
+
+	//l'instruction courante, déjà tracée par simul() ; après une trappe, on continue
+	if(pmach->_trapbase != TRAP_NONE){
+		pmach->_resume = &resume;
+		if(!setjmp(resume)) running = execute_decoded(pmach, pmach->_pc++);
+	} else running = execute_decoded(pmach, pmach->_pc++);
+	stopped = running && (pmach->_stop || execute_until(pmach, pmach->_trace));
+
+	pmach->_stop = false;
+	pmach->_resume = NULL;
+	detach_probe(pmach, &pdbg->_probe);
+	return stopped;
+}
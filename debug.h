@@ -4,22 +4,134 @@
 /*!
  * \file debug.h
  * \brief Fonctions de mise au point interactive.
+ *
+ * En plus du pas à pas, le mode de mise au point gère des points d'arrêt
+ * (sur une adresse du segment de texte) et des points d'observation (sur
+ * les lectures ou les écritures d'un mot de données). Chacun peut porter une
+ * condition sur un registre ou sur le code condition, et ne provoquer
+ * l'arrêt qu'à partir de son n-ième passage.
+ *
+ * Les points sont vérifiés par une sonde (voir probe.h) qui n'est attachée
+ * que pendant la commande \c c et seulement si au moins un point existe :
+ * sans point armé, la commande \c c reprend la boucle d'exécution sans sonde
+ * et à pleine vitesse. La sonde ne s'intéresse qu'aux événements utiles :
+ * fin d'instruction (test d'un bit dans la table des adresses du texte)
+ * s'il y a des points d'arrêt, lectures ou écritures s'il y a des points
+ * d'observation correspondants. Un point d'arrêt est atteint quand \c _pc
+ * le désigne après une instruction : il n'est donc pas vu sur la première
+ * instruction d'un traitant de trappe.
+ *
+ * Si l'exécution est enregistrée (voir record.h), on peut aussi revenir en
+ * arrière : d'un nombre d'instructions (\c rs), jusqu'au point d'arrêt ou à
+ * l'écriture observée précédents (\c rc), ou jusqu'à une instruction
+ * donnée par son numéro (\c g, qui sait aussi repartir en avant). La
+ * commande \c who donne la dernière instruction qui a écrit un mot de
+ * données. À rebours, les points d'observation des lectures et les nombres
+ * de passages sont ignorés.
  */
+#include <stdint.h>
 #include <stdbool.h>
 
 #include "machine.h"
+#include "probe.h"
+#include "record.h"
+
+//! Nombre maximal de points d'arrêt et d'observation
+#define DEBUG_MAX_POINTS 32
+
+//! Registre d'une condition désignant le code condition
+#define DEBUG_CC (-1)
+
+//! Comparaison d'une condition
+typedef enum
+{
+    CMP_NONE = 0,	//!< Pas de condition
+    CMP_EQ,		//!< ==
+    CMP_NE,		//!< !=
+    CMP_LT,		//!< < (comparaison signée)
+    CMP_LE,		//!< <=
+    CMP_GT,		//!< >
+    CMP_GE,		//!< >=
+} Debug_Compare;
+
+//! Accès observés par un point d'observation
+typedef enum
+{
+    WATCH_READ = 1,	//!< Lectures
+    WATCH_WRITE = 2,	//!< Écritures
+} Watch_Access;
+
+//! Point d'arrêt ou d'observation
+typedef struct
+{
+    unsigned _id;		//!< Numéro (affiché par la commande \c l)
+    unsigned _access;		//!< Accès observés (0 : point d'arrêt)
+    unsigned _addr;		//!< Adresse de l'instruction ou du mot de données
+    int _reg;			//!< Registre de la condition (DEBUG_CC : code condition)
+    Debug_Compare _cmp;		//!< Comparaison de la condition (CMP_NONE : aucune)
+    int32_t _value;		//!< Valeur comparée
+    uint64_t _after;		//!< Passage à partir duquel le point arrête l'exécution
+    uint64_t _hits;		//!< Passages, condition satisfaite
+} Debug_Point;
+
+//! État du mode de mise au point
+typedef struct
+{
+    Probe _probe;		//!< Sonde (premier champ)
+    Machine *_pmach;		//!< Machine en cours de mise au point
+    Recorder *_prec;		//!< Enregistreur de la machine (NULL : pas de retour en arrière)
+    uint64_t *_map;		//!< Un bit par adresse du texte portant un point d'arrêt
+    Debug_Point _points[DEBUG_MAX_POINTS]; //!< Points, par numéros croissants
+    unsigned _npoints;		//!< Nombre de points
+    unsigned _nextid;		//!< Numéro du prochain point
+} Debugger;
+
+//! Début de la mise au point d'une machine
+/*!
+ * L'exécution à rebours est possible si un enregistreur est déjà attaché à
+ * la machine (voir record_start()).
+ *
+ * \param pdbg l'état de la mise au point
+ * \param pmach la machine (déjà chargée)
+ */
+void debug_start(Debugger *pdbg, Machine *pmach);
+
+//! Fin de la mise au point (libération de la table des points d'arrêt)
+/*!
+ * \param pdbg l'état de la mise au point
+ */
+void debug_end(Debugger *pdbg);
 
 //! Dialogue de mise au point interactive pour l'instruction courante.
 /*!
  * Cette fonction gère le dialogue pour l'option \c -d (debug). Dans ce mode,
- * elle est invoquée après l'exécution de chaque instruction.  Elle affiche le
- * menu de mise au point et on exécute le choix de l'utilisateur. Si cette
- * fonction retourne faux, on abandonne le mode de mise au point interactive
- * pour les instructions suivantes et jusqu'à la fin du programme.
- * 
- * \param mach la machine/programme en cours de simulation
- * \return vrai si l'on doit continuer en mode debug, faux sinon
+ * elle est invoquée avant l'exécution de chaque instruction. Elle lit les
+ * commandes de l'utilisateur, une par ligne, et les exécute. Si cette
+ * fonction retourne faux, on quitte le pas à pas : l'exécution continue
+ * jusqu'au prochain point d'arrêt (voir debug_continue()) ou, s'il n'y en a
+ * aucun, jusqu'à la fin du programme.
+ *
+ * \param pdbg l'état de la mise au point
+ * \return vrai si l'on doit continuer en pas à pas, faux sinon
+ */
+bool debug_ask(Debugger *pdbg);
+
+//! Y a-t-il au moins un point d'arrêt ou d'observation ?
+static inline bool debug_armed(const Debugger *pdbg)
+{
+    return pdbg->_npoints > 0;
+}
+
+//! Exécution jusqu'au prochain point d'arrêt ou d'observation
+/*!
+ * La sonde est attachée le temps de l'exécution. L'instruction courante,
+ * déjà tracée par simul(), est exécutée seule, puis les suivantes par
+ * execute_until(). Au retour d'un arrêt, le point atteint a été affiché et
+ * \c _pc désigne l'instruction suivante.
+ *
+ * \param pdbg l'état de la mise au point
+ * \return faux après l'exécution de \c HALT ; vrai sur un arrêt
  */
-bool debug_ask(Machine *pmach);
+bool debug_continue(Debugger *pdbg);
 
 #endif
@@ -0,0 +1,187 @@
+/*!
+ * \file decode.c
+ * \brief Pré-décodage du segment de texte en table de micro-opérations.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "decode.h"
+#include "error.h"
+
+//! Choix de la micro-opération selon le mode d'adressage
+/*!
+ * \param mode le mode d'adressage de l'instruction
+ * \param imm la micro-opération en adressage immédiat
+ * \param abs la micro-opération en adressage absolu
+ * \param idx la micro-opération en adressage indexé
+ * \return la micro-opération correspondant au mode
+ */
+static Micro_Op by_mode(Addressing mode, Micro_Op imm, Micro_Op abs, Micro_Op idx){
+	switch(mode){
+		case ADDR_IMMEDIATE: return imm;
+		case ADDR_INDEXED: return idx;
+		default: return abs;
+	}
+}
+
+//! Traduction d'une instruction erronée
+/*!
+ * L'instruction devient une micro-opération UOP_FAULT dont l'opérande est le
+ * code d'erreur à signaler lors de l'exécution.
+ * \param di l'instruction en cours de décodage
+ * \param err le code de l'erreur
+ * \return l'instruction décodée
+ */
+static Decoded_Instruction decode_fault(Decoded_Instruction di, Error err){
+	di._uop = UOP_FAULT;
+	di._mode = ADDR_NONE;
+	di._operand = err;
+	return di;
+}
+
+/*!
+ * Tous les champs de bits de l'instruction sont extraits une seule fois.
+ * L'ordre des vérifications est celui de l'exécution des instructions
+ * (adressage immédiat puis condition), de sorte que l'erreur signalée est
+ * identique.
+ *
+ * \param instr l'instruction à décoder
+ * \return l'instruction décodée
+ */
+Decoded_Instruction decode_instruction(Instruction instr){
+	Decoded_Instruction di = { 0 };
+
+	di._cop = instr.instr_generic._cop;
+	di._regcond = instr.instr_generic._regcond;
+
+	// Mode d'adressage et opérande étendu sur 32 bits
+	if(instr.instr_generic._immediate){
+		di._mode = ADDR_IMMEDIATE;
+		di._operand = instr.instr_immediate._value;
+	} else if(instr.instr_generic._indexed){
+		di._mode = ADDR_INDEXED;
+		di._rindex = instr.instr_indexed._rindex;
+		di._operand = instr.instr_indexed._offset;
+	} else {
+		di._mode = ADDR_ABSOLUTE;
+		di._operand = instr.instr_absolute._address;
+	}
+
+	switch(instr.instr_generic._cop){
+		case ILLOP :
+			return decode_fault(di, ERR_ILLEGAL);
+		case NOP :
+			di._uop = UOP_NOP;
+			di._mode = ADDR_NONE;
+			break;
+		case LOAD :
+			di._uop = by_mode(di._mode, UOP_LOAD_IMM, UOP_LOAD_ABS, UOP_LOAD_IDX);
+			break;
+		case STORE :
+			if(di._mode == ADDR_IMMEDIATE) return decode_fault(di, ERR_IMMEDIATE);
+			di._uop = by_mode(di._mode, UOP_FAULT, UOP_STORE_ABS, UOP_STORE_IDX);
+			break;
+		case ADD :
+			di._uop = by_mode(di._mode, UOP_ADD_IMM, UOP_ADD_ABS, UOP_ADD_IDX);
+			break;
+		case SUB :
+			di._uop = by_mode(di._mode, UOP_SUB_IMM, UOP_SUB_ABS, UOP_SUB_IDX);
+			break;
+		case BRANCH :
+			if(di._mode == ADDR_IMMEDIATE) return decode_fault(di, ERR_IMMEDIATE);
+			if(di._regcond > LAST_CONDITION) return decode_fault(di, ERR_CONDITION);
+			di._uop = by_mode(di._mode, UOP_FAULT, UOP_BRANCH_ABS, UOP_BRANCH_IDX);
+			break;
+		case CALL :
+			if(di._mode == ADDR_IMMEDIATE) return decode_fault(di, ERR_IMMEDIATE);
+			if(di._regcond > LAST_CONDITION) return decode_fault(di, ERR_CONDITION);
+			di._uop = by_mode(di._mode, UOP_FAULT, UOP_CALL_ABS, UOP_CALL_IDX);
+			break;
+		case RET :
+			di._uop = UOP_RET;
+			di._mode = ADDR_NONE;
+			break;
+		case PUSH :
+			di._uop = by_mode(di._mode, UOP_PUSH_IMM, UOP_PUSH_ABS, UOP_PUSH_IDX);
+			break;
+		case POP :
+			if(di._mode == ADDR_IMMEDIATE) return decode_fault(di, ERR_IMMEDIATE);
+			di._uop = by_mode(di._mode, UOP_FAULT, UOP_POP_ABS, UOP_POP_IDX);
+			break;
+		case HALT :
+			di._uop = UOP_HALT;
+			di._mode = ADDR_NONE;
+			break;
+		case RTT :
+			di._uop = UOP_RTT;
+			di._mode = ADDR_NONE;
+			break;
+		//le préfixe ne fait rien : il est lu avec l'instruction suivante
+		case EXT :
+			di._uop = UOP_NOP;
+			di._mode = ADDR_NONE;
+			break;
+		default:
+			return decode_fault(di, ERR_UNKNOWN);
+	}
+	return di;
+}
+
+/*!
+ * \param prefix le mot qui précède l'instruction
+ * \param instr l'instruction à décoder
+ * \return l'instruction décodée
+ */
+Decoded_Instruction decode_prefixed(Instruction prefix, Instruction instr){
+	Decoded_Instruction di = decode_instruction(instr);
+	//une instruction erronée garde son code d'erreur
+	if(prefix.instr_generic._cop == EXT && di._mode != ADDR_NONE) di._operand = extend_operand(prefix, instr);
+	return di;
+}
+
+/*!
+ * Les tableaux de la table sont alloués d'un seul bloc : d'abord les
+ * opérandes (alignés sur 32 bits) puis les champs d'un octet.
+ *
+ * \param pdec la table à construire
+ * \param textsize taille utile du segment de texte
+ * \param text le contenu du segment de texte
+ */
+void decode_text(Decoded_Text *pdec, unsigned textsize, const Instruction text[textsize]){
+	// Au moins une entrée, pour que calloc() ne renvoie jamais NULL
+	size_t n = textsize ? textsize : 1;
+	char *block;
+
+	if(!(block = calloc(n, sizeof(int32_t) + 5 * sizeof(uint8_t)))){
+		perror("Erreur d'allocation mémoire pour la table de micro-opérations dans <decode.c:decode_text>");
+		exit(1);
+	}
+
+	pdec->_operand = (int32_t *) block;
+	pdec->_uop = (uint8_t *) (block + n * sizeof(int32_t));
+	pdec->_cop = pdec->_uop + n;
+	pdec->_mode = pdec->_cop + n;
+	pdec->_regcond = pdec->_mode + n;
+	pdec->_rindex = pdec->_regcond + n;
+
+	for(unsigned i = 0 ; i < textsize ; i++){
+		Decoded_Instruction di = decode_prefixed(text_prefix(text, i), text[i]);
+		pdec->_operand[i] = di._operand;
+		pdec->_uop[i] = di._uop;
+		pdec->_cop[i] = di._cop;
+		pdec->_mode[i] = di._mode;
+		pdec->_regcond[i] = di._regcond;
+		pdec->_rindex[i] = di._rindex;
+	}
+}
+
+/*!
+ * \param pdec la table à libérer
+ */
+void free_decoded(Decoded_Text *pdec){
+	// Tous les tableaux sont dans le bloc des opérandes
+	free(pdec->_operand);
+	pdec->_operand = NULL;
+	pdec->_uop = pdec->_cop = pdec->_mode = pdec->_regcond = pdec->_rindex = NULL;
+}
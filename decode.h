@@ -0,0 +1,160 @@
+#ifndef _DECODE_H_
+#define _DECODE_H_
+
+/*!
+ * \file decode.h
+ * \brief Pré-décodage du segment de texte en table de micro-opérations.
+ */
+
+#include <stdint.h>
+
+#include "instruction.h"
+
+//! Micro-opérations
+/*!
+ * Chaque instruction est traduite une fois pour toutes, au chargement du
+ * programme, en une micro-opération qui combine le code opération et le mode
+ * d'adressage. C'est l'indice du traitant à invoquer lors de l'exécution.
+ *
+ * Les instructions qui provoqueraient à coup sûr une erreur lors de leur
+ * exécution (code opération inconnu, adressage immédiat interdit, condition
+ * inexistante...) sont traduites en \c UOP_FAULT : le code d'erreur est alors
+ * rangé dans l'opérande. L'erreur n'est signalée que si l'instruction est
+ * effectivement exécutée.
+ *
+ * Les adresses absolues ne sont vérifiées qu'ensuite, par verify_text(),
+ * quand la taille du segment de données est connue : c'est lui qui produit
+ * les micro-opérations \c UOP_xxx_CHK.
+ */
+typedef enum
+{
+    UOP_FAULT = 0,      //!< Erreur à signaler (code d'erreur dans l'opérande)
+    UOP_NOP,            //!< Instruction sans effet
+    UOP_LOAD_IMM,       //!< R ← Val
+    UOP_LOAD_ABS,       //!< R ← Data[Addr]
+    UOP_LOAD_IDX,       //!< R ← Data[(Rx) + Offset]
+    UOP_STORE_ABS,      //!< Data[Addr] ← R
+    UOP_STORE_IDX,      //!< Data[(Rx) + Offset] ← R
+    UOP_ADD_IMM,        //!< R ← (R) + Val
+    UOP_ADD_ABS,        //!< R ← (R) + Data[Addr]
+    UOP_ADD_IDX,        //!< R ← (R) + Data[(Rx) + Offset]
+    UOP_SUB_IMM,        //!< R ← (R) - Val
+    UOP_SUB_ABS,        //!< R ← (R) - Data[Addr]
+    UOP_SUB_IDX,        //!< R ← (R) - Data[(Rx) + Offset]
+    UOP_BRANCH_ABS,     //!< Branchement à une adresse absolue
+    UOP_BRANCH_IDX,     //!< Branchement à une adresse indexée
+    UOP_CALL_ABS,       //!< Appel à une adresse absolue
+    UOP_CALL_IDX,       //!< Appel à une adresse indexée
+    UOP_RET,            //!< Retour de sous-programme
+    UOP_PUSH_IMM,       //!< Empilement d'une valeur immédiate
+    UOP_PUSH_ABS,       //!< Empilement de Data[Addr]
+    UOP_PUSH_IDX,       //!< Empilement de Data[(Rx) + Offset]
+    UOP_POP_ABS,        //!< Dépilement vers Data[Addr]
+    UOP_POP_IDX,        //!< Dépilement vers Data[(Rx) + Offset]
+    UOP_HALT,           //!< Arrêt normal du programme
+    UOP_RTT,            //!< Retour de trappe
+    UOP_BRANCH_CHK,     //!< Branchement à une adresse absolue vérifiée à l'exécution
+    UOP_CALL_CHK,       //!< Appel à une adresse absolue vérifiée à l'exécution
+    UOP_PUSH_CHK,       //!< Empilement de Data[Addr], adresse vérifiée à l'exécution
+    UOP_POP_CHK,        //!< Dépilement vers Data[Addr], adresse vérifiée à l'exécution
+} Micro_Op;
+
+//! Nombre de micro-opérations
+#define NUOPS (UOP_POP_CHK + 1)
+
+//! Mode d'adressage de l'opérande
+typedef enum
+{
+    ADDR_NONE = 0,      //!< Pas d'opérande
+    ADDR_IMMEDIATE,     //!< Valeur immédiate
+    ADDR_ABSOLUTE,      //!< Adresse absolue
+    ADDR_INDEXED,       //!< Registre d'index et déplacement
+} Addressing;
+
+//! Une instruction pré-décodée
+/*!
+ * Tous les champs de bits de l'instruction sont extraits et l'opérande
+ * (valeur immédiate, adresse absolue ou déplacement) est étendu sur 32 bits
+ * avec son signe, ou complété par le préfixe \c EXT qui précède
+ * l'instruction (voir decode_prefixed()).
+ */
+typedef struct
+{
+    uint8_t _uop;       //!< Micro-opération (indice du traitant)
+    uint8_t _cop;       //!< Code opération d'origine
+    uint8_t _mode;      //!< Mode d'adressage (voir \link Addressing \endlink)
+    uint8_t _regcond;   //!< Numéro de registre ou condition
+    uint8_t _rindex;    //!< Numéro du registre d'index
+    int32_t _operand;   //!< Valeur, adresse, déplacement ou code d'erreur
+} Decoded_Instruction;
+
+//! Table des micro-opérations du segment de texte
+/*!
+ * La table est organisée en « structure de tableaux » : chaque champ de
+ * Decoded_Instruction a son propre tableau, indicé par l'adresse de
+ * l'instruction. La boucle de simulation ne parcourt ainsi que les octets
+ * dont elle a besoin. Tous les tableaux sont alloués d'un seul bloc.
+ */
+typedef struct
+{
+    int32_t *_operand;  //!< Opérandes étendus sur 32 bits
+    uint8_t *_uop;      //!< Micro-opérations
+    uint8_t *_cop;      //!< Codes opérations d'origine
+    uint8_t *_mode;     //!< Modes d'adressage
+    uint8_t *_regcond;  //!< Numéros de registre ou conditions
+    uint8_t *_rindex;   //!< Numéros de registre d'index
+} Decoded_Text;
+
+//! Décodage d'une instruction
+/*!
+ * \param instr l'instruction à décoder
+ * \return l'instruction décodée
+ */
+Decoded_Instruction decode_instruction(Instruction instr);
+
+//! Décodage d'une instruction précédée de son préfixe éventuel
+/*!
+ * Si \c prefix est un préfixe \c EXT et que l'instruction a un opérande,
+ * celui-ci est remplacé par l'opérande étendu (voir extend_operand()). Le
+ * préfixe appartient statiquement au mot qui le suit : un branchement
+ * directement sur ce mot utilise lui aussi l'opérande étendu.
+ *
+ * \param prefix le mot qui précède l'instruction (voir text_prefix())
+ * \param instr l'instruction à décoder
+ * \return l'instruction décodée
+ */
+Decoded_Instruction decode_prefixed(Instruction prefix, Instruction instr);
+
+//! Décodage de tout le segment de texte
+/*!
+ * Les tableaux de la table sont alloués ; une table précédemment construite
+ * doit avoir été libérée par free_decoded().
+ *
+ * \param pdec la table à construire
+ * \param textsize taille utile du segment de texte
+ * \param text le contenu du segment de texte
+ */
+void decode_text(Decoded_Text *pdec, unsigned textsize, const Instruction text[textsize]);
+
+//! Relecture d'une entrée de la table
+/*!
+ * \param pdec la table des micro-opérations
+ * \param addr l'adresse de l'instruction
+ * \return l'instruction décodée correspondante
+ */
+static inline Decoded_Instruction decoded_at(const Decoded_Text *pdec, unsigned addr)
+{
+    Decoded_Instruction di = {
+        pdec->_uop[addr], pdec->_cop[addr], pdec->_mode[addr],
+        pdec->_regcond[addr], pdec->_rindex[addr], pdec->_operand[addr]
+    };
+    return di;
+}
+
+//! Libération de la table des micro-opérations
+/*!
+ * \param pdec la table à libérer
+ */
+void free_decoded(Decoded_Text *pdec);
+
+#endif
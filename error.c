@@ -12,6 +12,34 @@
 #include "exec.h"
 #include "debug.h"
 
+//! Nom d'une erreur
+/*!
+ * \param err code de l'erreur
+ * \return le nom de l'erreur (par exemple \c "SEGDATA")
+ */
+const char *error_name(Error err){
+	switch(err){
+		case ERR_NOERROR: return "NOERROR";
+		case ERR_UNKNOWN: return "UNKNOWN";
+		case ERR_ILLEGAL: return "ILLEGAL";
+		case ERR_CONDITION: return "CONDITION";
+		case ERR_IMMEDIATE: return "IMMEDIATE";
+		case ERR_SEGTEXT: return "SEGTEXT";
+		case ERR_SEGDATA: return "SEGDATA";
+		case ERR_SEGSTACK: return "SEGSTACK";
+		default: return "SEGSTACK";
+	}
+}
+
+//! Affichage d'une erreur
+/*!
+ * \param err code de l'erreur
+ * \param addr adresse de l'erreur
+ */
+void print_error(Error err, unsigned addr){
+	fprintf(stderr, "Erreur %s à l'adresse 0x%x.\n", error_name(err), addr);
+}
+
 //! Affichage d'une erreur et fin du simulateur
 /*!
  * \note Toutes les erreurs étant fatales on ne revient jamais de cette
@@ -22,19 +50,7 @@
  * \param addr adresse de l'erreur
  */
 void error(Error err, unsigned addr){
-	char *err_to_print = "";
-	switch(err){
-		case ERR_NOERROR: err_to_print="NOERROR";break;
-		case ERR_UNKNOWN: err_to_print="UNKNOWN";break;
-		case ERR_ILLEGAL: err_to_print="ILLEGAL";break;
-		case ERR_CONDITION: err_to_print="CONDITION";break;
-		case ERR_IMMEDIATE: err_to_print="IMMEDIATE";break;
-		case ERR_SEGTEXT: err_to_print="SEGTEXT";break;
-		case ERR_SEGDATA: err_to_print="SEGDATA";break;
-		case ERR_SEGSTACK: err_to_print="SEGSTACK";break;
-		default: err_to_print="SEGSTACK";
-	}
-	fprintf(stderr, "Erreur %s à l'adresse 0x%x.\n", err_to_print, addr);
+	print_error(err, addr);
 	exit(1);
 }
 
@@ -11,9 +11,10 @@
 //! Erreur d'exécution
 /*!
  * Ce sont les différentes sortes d'erreur rencontrées lors du décodage ou de
- * l'exécution des instructions. Elles sont toutes fatales et provoquent la
- * terminaison du programme (du programme simulé comme du simulateur lui-même
- * !).
+ * l'exécution des instructions. Une erreur d'exécution passe par fault() :
+ * elle est délivrée comme une trappe si le programme a un traitant pour
+ * elle, rendue à l'hôte s'il a établi un point de reprise (\c _abort), et
+ * sinon fatale : error() termine alors le simulateur.
  */
 typedef enum 
 {
@@ -43,11 +44,28 @@ typedef enum
 //! Dernière valeur possible du code d'avertissement
 static const unsigned LAST_WARNING = WARN_HALT;
 
+//! Nom d'une erreur
+/*!
+ * \param err code de l'erreur
+ * \return le nom de l'erreur (par exemple \c "SEGDATA")
+ */
+const char *error_name(Error err);
+
+//! Affichage d'une erreur, sans fin du simulateur
+/*!
+ * Le mode de mise au point s'en sert pour rendre la main à l'utilisateur
+ * après une erreur (voir simul()).
+ *
+ * \param err code de l'erreur
+ * \param addr adresse de l'erreur
+ */
+void print_error(Error err, unsigned addr);
+
 //! Affichage d'une erreur et fin du simulateur
 /*!
- * \note Toutes les erreurs étant fatales on ne revient jamais de cette
- * fonction. L'attribut \a noreturn est une extension (non standard) de GNU C
- * qui indique ce fait.
+ * \note On ne revient jamais de cette fonction : fault() ne l'appelle que
+ * pour une erreur qu'aucune trappe ni aucun hôte ne reprend. L'attribut \a
+ * noreturn est une extension (non standard) de GNU C qui indique ce fait.
  * 
  * \param err code de l'erreur
  * \param addr adresse de l'erreur
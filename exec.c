@@ -5,51 +5,101 @@
  */
  
  #include "exec.h"
+ #include "probe.h"
+ #include "record.h"
  #include "error.h"
+ #include "verify.h"
  #include <stdio.h>
+ #include <setjmp.h>
 
-//! Vérifie si l'instruction peut avoir un opérande immédiat
+//! Intégration forcée d'une fonction dans son appelant
 /*!
- * Si l'opérande est immédiat et que l'instruction ne le supporte pas,
- * alors un message d'erreur est affiché (arrêt de l'exécution du programme)
- * \param instr l'instruction à exécuter 
- * \param addr l'adresse de l'instruction à exécuter
- * 
+ * Les boucles d'exécution sont spécialisées par des paramètres constants :
+ * l'intégration garantit que le compilateur élimine les tests correspondants.
  */
-void check_immediate(Instruction instr, unsigned addr) {
-	if(instr.instr_generic._immediate) {
-		error(ERR_IMMEDIATE, addr);
+#ifdef __GNUC__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+//! Adresse absolue vérifiée à l'exécution (voir verify.h)
+/*!
+ * Ce n'est pas un mode de la table de micro-opérations : seulement la
+ * constante qui spécialise les traitants des micro-opérations \c
+ * UOP_xxx_CHK, lesquels vérifient l'adresse comme pour un accès indexé.
+ */
+#define ADDR_CHECKED ((Addressing) (ADDR_INDEXED + 1))
+
+//! Délivrance d'une trappe
+/*!
+ * La cause et l'adresse de l'instruction fautive sont rangées dans la table
+ * des trappes et l'exécution continue au traitant de l'erreur (voir
+ * \link Trap_Slot \endlink). L'instruction fautive est considérée comme
+ * terminée pour les sondes. ERR_SEGTEXT est levée avant qu'une instruction
+ * ne commence (voir execute_loop()) : il n'y a pas d'instruction fautive, et
+ * les sondes ne sont pas notifiées.
+ * \param pmach la machine/programme en cours d'exécution
+ * \param err code de l'erreur
+ * \param addr adresse de l'instruction fautive
+ * \return vrai si la trappe est délivrée ; faux si l'erreur doit être
+ * signalée à l'hôte
+ */
+static bool trap(Machine *pmach, Error err, unsigned addr){
+	unsigned base = pmach->_trapbase;
+	// Double faute, table absente ou hors du segment de données
+	if(pmach->_intrap || base == TRAP_NONE || err < 1 || err > LAST_ERROR
+	   || pmach->_datasize < TRAP_TABLESIZE || base > pmach->_datasize - TRAP_TABLESIZE) {
+		return false;
+	}
+	Word handler = pmach->_data[base + TRAP_VECTORS + err - 1];
+	// Pas de traitant pour cette erreur
+	if(handler == 0) {
+		return false;
 	}
+	bool probed = pmach->_probes && addr < pmach->_textsize;
+	if(probed){
+		probe_write(pmach, addr, base + TRAP_CAUSE, err);
+		probe_write(pmach, addr, base + TRAP_EPC, addr);
+	}
+	pmach->_data[base + TRAP_CAUSE] = err;
+	pmach->_data[base + TRAP_EPC] = addr;
+	pmach->_trapcc = pmach->_cc;
+	pmach->_intrap = true;
+	pmach->_pc = handler;
+	if(probed) probe_after(pmach, addr);
+	return true;
+}
+
+/*!
+ * Une trappe est délivrée si la boucle d'exécution a établi un point de
+ * reprise (\c _resume) et si le programme a un traitant pour cette erreur.
+ * Sinon l'erreur est rangée dans \c _fault et \c _fault_addr, puis
+ * signalée à l'hôte.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param err code de l'erreur
+ * \param addr adresse de l'instruction fautive
+ */
+void fault(Machine *pmach, Error err, unsigned addr){
+	if(pmach->_resume && trap(pmach, err, addr)) longjmp(*pmach->_resume, 1);
+	pmach->_fault = err;
+	pmach->_fault_addr = addr;
+	if(pmach->_abort) longjmp(*pmach->_abort, 1);
+	error(err, addr);
 }
 
 //! Teste une condition par rapport au code condition CC
 /*! 
+ * Une condition impossible est écartée au décodage : il n'y a plus rien à
+ * vérifier ici.
+ * \param pmach la machine/programme en cours d'exécution
  * \param cond la condition à tester
- * \param cc le code condition par rapport auquel la condition doit être testée
- * \param addr l'adresse de l'instruction comportant cette condition
  * \return vrai si la condition est satisfaite, faux sinon
  * 
  */
-bool check_condition(Machine *pmach, Instruction instr) {
-	switch(instr.instr_generic._regcond){
-		case NC : // Pas de condition, donc toujours vrai
-			return true;
-		case EQ : // Le résultat précédent doit être nul
-			return (pmach->_cc == CC_Z);
-		case NE : // Le résultat précédent doit être non nul
-			return (pmach->_cc != CC_Z);
-		case GT : // Le résultat précédent doit être strictement positif
-			return (pmach->_cc == CC_P);
-		case GE : // Le résultat précédent doit être positif ou nul
-			return (pmach->_cc == CC_P || pmach->_cc == CC_Z);
-		case LT : // Le résultat précédent doit être strictement négatif
-			return (pmach->_cc == CC_N);
-		case LE : // Le résultat précédent doit être négatif ou nul
-			return (pmach->_cc == CC_N || pmach->_cc == CC_Z);
-		default: // Valeur impossible de la condition
-			error(ERR_CONDITION, pmach->_pc-1);
-			break;
-	}
+static inline bool check_condition(Machine *pmach, unsigned cond) {
+	return condition_holds(pmach->_cc, cond);
 }
 
 //! Mise à jour du code condition CC
@@ -59,14 +109,8 @@ bool check_condition(Machine *pmach, Instruction instr) {
  * \param pmach la machine/programme en cours d'exécution
  * \param reg le numéro du registre dont le signe du contenu nous intéresse
  */
-void update_CC(Machine *pmach, Instruction instr) {
-	if(pmach->_registers[instr.instr_generic._regcond] < 0) {
-		pmach->_cc = CC_N;
-	} else if (pmach->_registers[instr.instr_generic._regcond] > 0) {
-		pmach->_cc = CC_P;
-	} else { //pmach->_registers[instr.instr_generic._regcond] == 0
-		pmach->_cc = CC_Z;
-	}
+static inline void update_CC(Machine *pmach, unsigned reg) {
+	pmach->_cc = condition_code(pmach->_registers[reg]);
 }
 
 //! Vérifie que l'adresse appartient bien au segment de Données
@@ -74,92 +118,136 @@ void update_CC(Machine *pmach, Instruction instr) {
  * Si on est en-dehors du segment, on affiche une erreur (arrêt programme)
  * \param pmach la machine/programme en cours d'exécution
  * \param addr_mem l'adresse mémoire à laquelle on veut accéder
+ * \param addr l'adresse de l'instruction en cours
  */
-void check_seg_data(Machine *pmach, unsigned addr_mem) {
-	if(addr_mem < 0 || addr_mem > pmach->_datasize-1) {
-		error(ERR_SEGDATA, pmach->_pc-1);
+static inline void check_seg_data(Machine *pmach, unsigned addr_mem, unsigned addr) {
+	if(addr_mem > pmach->_datasize-1) {
+		fault(pmach, ERR_SEGDATA, addr);
 	} 
 }
 
-//! Vérifie que sp pointe bien le segment de Données
+//! Vérifie qu'une valeur de sp pointe bien la pile
 /*!
- * Si on est en-dehors du segment, on affiche une erreur (arrêt programme)
+ * Si on est en-dehors de la pile, on affiche une erreur (arrêt programme).
+ * La valeur est vérifiée avant d'être rangée dans SP : une erreur laisse SP
+ * inchangé.
  * \param pmach la machine/programme en cours d'exécution
+ * \param sp la valeur de SP à vérifier
+ * \param addr l'adresse de l'instruction en cours
  */
-void check_seg_stack(Machine *pmach) {
-	if (pmach->_sp < pmach->_dataend || pmach->_sp >= pmach->_datasize) {
-		error(ERR_SEGSTACK, pmach->_pc-1);
+static inline void check_seg_stack(Machine *pmach, unsigned sp, unsigned addr) {
+	if (sp < pmach->_dataend || sp >= pmach->_datasize) {
+		fault(pmach, ERR_SEGSTACK, addr);
 	}
 }
 
-//! Vérifie que le registre est un des 16 registres
+//! Calcule l'adresse d'un opérande selon si elle est indexée ou absolue
 /*!
- * Si on est en-dehors du tableau de registres, on affiche une erreur (arrêt programme)
  * \param pmach la machine/programme en cours d'exécution
- * \param reg le numéro du registre auquel on veut accéder
+ * \param di l'instruction décodée à exécuter
+ * \param mode le mode d'adressage (absolu ou indexé)
+ * \return l'adresse, non vérifiée
  */
-void check_seg_registers(Machine *pmach, unsigned reg) {
-	if(reg < 0 || reg > NREGISTERS - 1) {
-		error(ERR_ILLEGAL, pmach->_pc-1);
+static inline unsigned effective_address(Machine *pmach, Decoded_Instruction di, Addressing mode){
+	// L'adresse est indexée
+	if(mode == ADDR_INDEXED){
+		return pmach->_registers[di._rindex] + di._operand;
 	}
+	// L'adresse est en absolue
+	return di._operand;
 }
 
 //! Génère une adresse valide selon si elle est indexée ou absolu
 /*!
- * Si l'adresse n'est pas valide, on affiche une erreur (arrêt de l'exécution)
+ * Si l'adresse n'est pas valide, on affiche une erreur (arrêt de l'exécution).
+ * Une adresse absolue a été prouvée par le vérificateur : elle n'est pas
+ * vérifiée de nouveau.
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction à exécuter
+ * \param di l'instruction décodée à exécuter
+ * \param mode le mode d'adressage (absolu, indexé ou absolu vérifié à l'exécution)
+ * \param addr l'adresse de l'instruction en cours
  */
-unsigned generate_address(Machine *pmach, Instruction instr){
-	unsigned address;
-	// L'adresse est indexée
-	if(instr.instr_generic._indexed){
-		address = pmach->_registers[instr.instr_indexed._rindex] + instr.instr_indexed._offset;
-	// L'adresse est en absolue
-	} else {
-		address = instr.instr_absolute._address;
-	}
+static inline unsigned generate_address(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr){
+	unsigned address = effective_address(pmach, di, mode);
 	// Vérifie que l'adresse est valide
-	check_seg_data(pmach,address);
+	if(mode != ADDR_ABSOLUTE) check_seg_data(pmach, address, addr);
 	return address;
 }
 
+//! Lecture d'un mot de données
+/*!
+ * Tous les accès en lecture au segment de données passent par cette fonction.
+ * \param pmach la machine/programme en cours d'exécution
+ * \param daddr l'adresse (vérifiée) du mot de données
+ * \param addr l'adresse de l'instruction en cours
+ * \param probed faut-il notifier les sondes ? (constante)
+ * \return le mot lu
+ */
+static ALWAYS_INLINE Word read_data(Machine *pmach, unsigned daddr, unsigned addr, const bool probed){
+	if(probed) probe_read(pmach, addr, daddr);
+	return pmach->_data[daddr];
+}
+
+//! Écriture d'un mot de données
+/*!
+ * Tous les accès en écriture au segment de données passent par cette
+ * fonction. Les sondes sont notifiées avant l'écriture.
+ * \param pmach la machine/programme en cours d'exécution
+ * \param daddr l'adresse (vérifiée) du mot de données
+ * \param value la valeur à écrire
+ * \param addr l'adresse de l'instruction en cours
+ * \param probed faut-il notifier les sondes ? (constante)
+ */
+static ALWAYS_INLINE void write_data(Machine *pmach, unsigned daddr, Word value, unsigned addr, const bool probed){
+	if(probed) probe_write(pmach, addr, daddr, value);
+	pmach->_data[daddr] = value;
+}
+
+//! Valeur de l'opérande source
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param di l'instruction décodée à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction en cours
+ * \param probed faut-il notifier les sondes ?
+ * \return Val si I = 1, Data[Addr] sinon
+ */
+static ALWAYS_INLINE Word operand_value(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed){
+	if(mode == ADDR_IMMEDIATE) {
+		return di._operand;
+	}
+	return read_data(pmach, generate_address(pmach, di, mode, addr), addr, probed);
+}
+
 //! Chargement d'un registre 
 /*!
  * si I = 0 : R ← Data[Addr]
  * si I = 1 : R ← Val
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction load à exécuter
- */
-void load(Machine *pmach, Instruction instr){
-	//Vérifie que le registre est cohérent
-	check_seg_registers(pmach, instr.instr_generic._regcond);
-	// Cas I = 1 : R ← Val
-	if(instr.instr_generic._immediate) {
-		pmach->_registers[instr.instr_immediate._regcond] = instr.instr_immediate._value;
-	// Cas I = 0 : R ← Data[Addr]
-	} else {
-		pmach->_registers[instr.instr_generic._regcond] = pmach->_data[generate_address(pmach,instr)];
-	}
+ * \param di l'instruction load à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
+ */
+static ALWAYS_INLINE void load(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed){
+	pmach->_registers[di._regcond] = operand_value(pmach, di, mode, addr, probed);
 	//Met à jour le code condition
-	update_CC(pmach, instr);
+	update_CC(pmach, di._regcond);
 }
 
 //! Rangement du contenu d'un registre 
 /*!
- * L'instruction store n'accepte pas l'adresse immédiat et ne modifie
- * pas le code condition.
+ * L'instruction store n'accepte pas l'adresse immédiat (écarté au décodage)
+ * et ne modifie pas le code condition.
  * Data[Addr] ← R 
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction load à exécuter
- */
-void store(Machine *pmach, Instruction instr) {
-	// Vérifie que le numéro de registre est cohérent
-	check_seg_registers(pmach, instr.instr_generic._regcond);
-	// Vérifie qu'on est pas en adressage immédiat
-	check_immediate(instr, pmach->_pc-1);
-	// Data[Addr] ← R 
-	pmach->_data[generate_address(pmach, instr)] = pmach->_registers[instr.instr_generic._regcond];
+ * \param di l'instruction store à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
+ */
+static ALWAYS_INLINE void store(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed) {
+	write_data(pmach, generate_address(pmach, di, mode, addr), pmach->_registers[di._regcond], addr, probed);
 }
 
 //! Addition à un registre 
@@ -167,20 +255,15 @@ void store(Machine *pmach, Instruction instr) {
  * si I = 0 : R ← (R) + Data[Addr]
  * si I = 1 : R ← (R) + Val
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction load à exécuter
- */
-void add(Machine *pmach, Instruction instr) {
-	// Vérifie que le numéro du registre est cohérent
-	check_seg_registers(pmach, instr.instr_generic._regcond);
-	// Cas I = 1 : R ← (R) + Val
-	if(instr.instr_generic._immediate) {
-		pmach->_registers[instr.instr_immediate._regcond] += instr.instr_immediate._value;
-	// Cas I = 0 : R ← (R) + Data[Addr]
-	} else {
-		pmach->_registers[instr.instr_generic._regcond] += pmach->_data[generate_address(pmach, instr)];
-	}
+ * \param di l'instruction add à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
+ */
+static ALWAYS_INLINE void add(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed) {
+	pmach->_registers[di._regcond] += operand_value(pmach, di, mode, addr, probed);
 	// Met à jour le code condition CC
-	update_CC(pmach, instr);
+	update_CC(pmach, di._regcond);
 }
 
 //! Soustraction à un registre 
@@ -188,56 +271,61 @@ void add(Machine *pmach, Instruction instr) {
  * si I = 0 : R ← (R) - Data[Addr]
  * si I = 1 : R ← (R) - Val
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction load à exécuter
- */
-void sub(Machine *pmach, Instruction instr) {
-	// Vérifie que le numéro du registre est cohérent
-	check_seg_registers(pmach, instr.instr_generic._regcond);
-	// Cas I = 1 : R ← (R) - Val
-	if(instr.instr_generic._immediate) {
-		pmach->_registers[instr.instr_immediate._regcond] -= instr.instr_immediate._value;
-	// Cas I = 0 : R ← (R) - Data[Addr]
-	} else {
-		pmach->_registers[instr.instr_generic._regcond] -= pmach->_data[generate_address(pmach, instr)];
-	}
+ * \param di l'instruction sub à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
+ */
+static ALWAYS_INLINE void sub(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed) {
+	pmach->_registers[di._regcond] -= operand_value(pmach, di, mode, addr, probed);
 	// Met à jour le code condition CC
-	update_CC(pmach, instr);
+	update_CC(pmach, di._regcond);
 }
 
 //! Branchement conditionnel ou non à une adresse
 /*!
  * Si la condition est vraie, PC ← Addr, sinon on ne fait rien.
- * L'instruction Branch n'accepte pas l'adressage immédiat et ne change 
- * pas la valeur du code condition.
+ * L'instruction Branch ne change pas la valeur du code condition.
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction branch à exécuter
+ * \param di l'instruction branch à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
  */
-void branch(Machine *pmach, Instruction instr) {
-	// Vérifie qu'on est pas en adressage immédiat 
-	check_immediate(instr, pmach->_pc-1);
+static ALWAYS_INLINE void branch(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed) {
 	// Vérifie que la condition est satisfaite
-	if(check_condition(pmach, instr)){
-		pmach->_pc = generate_address(pmach, instr);
+	bool taken = check_condition(pmach, di._regcond);
+	if(probed) probe_branch(pmach, addr, taken);
+	if(taken){
+		pmach->_pc = generate_address(pmach, di, mode, addr);
 	}
 }
 
 //! Appel d'un sous-programme
 /*!
  * Si la condition est vraie on exécute call, sinon on ne fait rien.
- * L'instruction Call n'accepte pas l'adressage immédiat et ne modifie
- * pas le code condition.
+ * L'instruction Call ne modifie pas le code condition.
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction call à exécuter
+ * \param di l'instruction call à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
  */
-void call(Machine *pmach, Instruction instr) {
-	// Vérifie qu'on est pas en adressage immédiat 
-	check_immediate(instr, pmach->_pc-1);
+static ALWAYS_INLINE void call(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed) {
 	// Vérifie que la condition est satisfaite
-	if(check_condition(pmach, instr)) {
+	bool taken = check_condition(pmach, di._regcond);
+	if(probed) probe_branch(pmach, addr, taken);
+	if(taken) {
 		// Vérifie qu'il y a assez de place pour empiler dans la pile
-		check_seg_stack(pmach);
-		pmach->_data[pmach->_sp--] = pmach->_pc; // Data[(SP)] ← (PC) et SP ← (SP) - 1
-		pmach->_pc = generate_address(pmach, instr); // PC ← Addr
+		check_seg_stack(pmach, pmach->_sp, addr);
+		// L'adresse peut être indexée par SP : elle utilise sa valeur après
+		// l'empilement, mais elle est vérifiée avant : une erreur ne modifie rien
+		unsigned target = effective_address(pmach, di, mode);
+		if(mode == ADDR_INDEXED && di._rindex == NREGISTERS - 1) target -= 1;
+		if(mode != ADDR_ABSOLUTE) check_seg_data(pmach, target, addr);
+		write_data(pmach, pmach->_sp--, pmach->_pc, addr, probed); // Data[(SP)] ← (PC) et SP ← (SP) - 1
+		if(probed) probe_call(pmach, addr, target);
+		pmach->_pc = target; // PC ← Addr
 	}
 }
 
@@ -245,13 +333,15 @@ void call(Machine *pmach, Instruction instr) {
 /*!
  * L'instruction Ret ne modifie pas le code condition CC
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction ret à exécuter
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
  */
-void ret(Machine *pmach, Instruction instr){
-	pmach->_sp += 1; // SP ← (SP) + 1
+static ALWAYS_INLINE void ret(Machine *pmach, unsigned addr, const bool probed){
 	//Vérifie qu'on est pas sorti de la pile 
-	check_seg_stack(pmach);
-	pmach->_pc = pmach->_data[pmach->_sp]; // PC ← Data[(SP)]
+	check_seg_stack(pmach, pmach->_sp + 1, addr);
+	pmach->_sp += 1; // SP ← (SP) + 1
+	pmach->_pc = read_data(pmach, pmach->_sp, addr, probed); // PC ← Data[(SP)]
+	if(probed) probe_ret(pmach, addr);
 }
 
 //! Empilement sur la pile d'exécution
@@ -262,18 +352,17 @@ void ret(Machine *pmach, Instruction instr){
  * SP ← (SP) - 1
  * L'instruction Push ne modifie pas le code condition
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction push à exécuter
+ * \param di l'instruction push à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
  */
-void push(Machine *pmach, Instruction instr) {
+static ALWAYS_INLINE void push(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed) {
 	// Vérifie que l'on est bien dans la pile
-	check_seg_stack(pmach);
-	// Cas I = 1 : Data[(SP)] = Val  et SP ← (SP) - 1
-	if(instr.instr_generic._immediate) {
-		pmach->_data[pmach->_sp--] = instr.instr_immediate._value;
-	// Cas I = 0 : Data[(SP)] = Data[Addr]  et SP ← (SP) - 1
-	} else {
-		pmach->_data[pmach->_sp--] = pmach->_data[generate_address(pmach, instr)];
-	}
+	check_seg_stack(pmach, pmach->_sp, addr);
+	// On lit l'opérande avant de toucher à SP
+	Word value = operand_value(pmach, di, mode, addr, probed);
+	write_data(pmach, pmach->_sp--, value, addr, probed);
 }
 
 //! Dépilement de la pile d'exécution
@@ -281,74 +370,258 @@ void push(Machine *pmach, Instruction instr) {
  * On dépile le sommet de pile qu'on met à l'adresse Addr dans la mémoire
  * SP ← (SP) + 1
  * Data[Addr] ← Data[(SP)]
- * L'instruction Pop n'accepte pas l'adressage immédiat
+ * L'instruction Pop n'accepte pas l'adressage immédiat (écarté au décodage)
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction pop à exécuter
+ * \param di l'instruction pop à exécuter
+ * \param mode le mode d'adressage
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
  */
-void pop(Machine *pmach, Instruction instr) {
-	// Vérifie qu'on est pas en adressage immédiat
-	check_immediate(instr, pmach->_pc-1);
-	pmach->_sp += 1; // SP ← (SP) + 1
+static ALWAYS_INLINE void pop(Machine *pmach, Decoded_Instruction di, Addressing mode, unsigned addr, const bool probed) {
 	// Vérifie qu'on est pas sortie de la pile
-	check_seg_stack(pmach);
-	pmach->_data[generate_address(pmach, instr)] = pmach->_data[pmach->_sp]; // Data[Addr] ← Data[(SP)]
+	check_seg_stack(pmach, pmach->_sp + 1, addr);
+	pmach->_sp += 1; // SP ← (SP) + 1
+	// L'adresse peut être indexée par SP : elle utilise sa nouvelle valeur
+	unsigned address = effective_address(pmach, di, mode);
+	if(mode != ADDR_ABSOLUTE && address > pmach->_datasize-1) {
+		pmach->_sp -= 1; // une erreur laisse SP inchangé
+		fault(pmach, ERR_SEGDATA, addr);
+	}
+	write_data(pmach, address, read_data(pmach, pmach->_sp, addr, probed), addr, probed); // Data[Addr] ← Data[(SP)]
 }
 
-//! Décodage et exécution d'une instruction
+//! Retour de trappe
 /*!
+ * PC ← Data[table + TRAP_EPC], le code condition est restauré.
+ * RTT n'est légale que dans un traitant de trappe.
  * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction à exécuter
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ?
+ */
+static ALWAYS_INLINE void rtt(Machine *pmach, unsigned addr, const bool probed){
+	if(!pmach->_intrap) {
+		fault(pmach, ERR_ILLEGAL, addr);
+	}
+	pmach->_pc = read_data(pmach, pmach->_trapbase + TRAP_EPC, addr, probed);
+	pmach->_cc = pmach->_trapcc;
+	pmach->_intrap = false;
+}
+
+//! Exécution d'une micro-opération
+/*!
+ * Le mode d'adressage est une constante dans chaque branche de l'aiguillage :
+ * chaque traitant est donc spécialisé par le compilateur. Il en va de même
+ * pour les notifications aux sondes, selon le paramètre \c probed.
+ * \param pmach la machine/programme en cours d'exécution
+ * \param di l'instruction décodée à exécuter
+ * \param addr l'adresse de l'instruction
+ * \param probed faut-il notifier les sondes ? (constante)
  * \return faux après l'exécution de \c HALT ; vrai sinon
  */
-bool decode_execute(Machine *pmach, Instruction instr){
-	bool keepgoing = 1;
-	// Le code opération nous dit quelle instruction est à exécuter
-	switch(instr.instr_generic._cop){
-		// ILLOP est une opération illégale qui provoque l'arrêt du programme
-		case ILLOP :
-			error(ERR_ILLEGAL, pmach->_pc-1);
-			break;
+static ALWAYS_INLINE bool execute(Machine *pmach, Decoded_Instruction di, unsigned addr, const bool probed){
+	switch(di._uop){
+		// Erreur détectée au décodage (instruction illégale, inconnue...)
+		case UOP_FAULT :
+			fault(pmach, di._operand, addr);
 		// NOP est une opération vide, elle ne fait rien
-		case NOP :
-			break;
-		case LOAD :
-			load(pmach, instr);
-			break;
-		case STORE :
-			store(pmach, instr);
-			break;
-		case ADD :
-			add(pmach, instr);
-			break;
-		case SUB :
-			sub(pmach, instr);
-			break;
-		case BRANCH :
-			branch(pmach, instr);
-			break;
-		case CALL :
-			call(pmach, instr);
-			break;
-		case RET :
-			ret(pmach, instr);
-			break;
-		case PUSH :
-			push(pmach,instr);
-			break;
-		case POP :
-			pop(pmach,instr);
+		case UOP_NOP :
 			break;
+		case UOP_LOAD_IMM : load(pmach, di, ADDR_IMMEDIATE, addr, probed); break;
+		case UOP_LOAD_ABS : load(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_LOAD_IDX : load(pmach, di, ADDR_INDEXED, addr, probed); break;
+		case UOP_STORE_ABS : store(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_STORE_IDX : store(pmach, di, ADDR_INDEXED, addr, probed); break;
+		case UOP_ADD_IMM : add(pmach, di, ADDR_IMMEDIATE, addr, probed); break;
+		case UOP_ADD_ABS : add(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_ADD_IDX : add(pmach, di, ADDR_INDEXED, addr, probed); break;
+		case UOP_SUB_IMM : sub(pmach, di, ADDR_IMMEDIATE, addr, probed); break;
+		case UOP_SUB_ABS : sub(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_SUB_IDX : sub(pmach, di, ADDR_INDEXED, addr, probed); break;
+		case UOP_BRANCH_ABS : branch(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_BRANCH_IDX : branch(pmach, di, ADDR_INDEXED, addr, probed); break;
+		case UOP_CALL_ABS : call(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_CALL_IDX : call(pmach, di, ADDR_INDEXED, addr, probed); break;
+		case UOP_RET : ret(pmach, addr, probed); break;
+		case UOP_PUSH_IMM : push(pmach, di, ADDR_IMMEDIATE, addr, probed); break;
+		case UOP_PUSH_ABS : push(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_PUSH_IDX : push(pmach, di, ADDR_INDEXED, addr, probed); break;
+		case UOP_POP_ABS : pop(pmach, di, ADDR_ABSOLUTE, addr, probed); break;
+		case UOP_POP_IDX : pop(pmach, di, ADDR_INDEXED, addr, probed); break;
 		// HALT indique la fin du programme donc l'arrêt de l'exécution, on retourne faux
-		case HALT :
-			warning(WARN_HALT, pmach->_pc-1);
-			keepgoing = 0;
-			break;
-		// Si le code opération ne correspond à aucune instruction, on affiche une erreur
-		default: {
-			error(ERR_UNKNOWN, pmach->_pc-1);
+		case UOP_HALT :
+			//un programme hôte n'a pas besoin du message
+			if(!pmach->_abort) warning(WARN_HALT, addr);
+			return false;
+		case UOP_RTT : rtt(pmach, addr, probed); break;
+		case UOP_BRANCH_CHK : branch(pmach, di, ADDR_CHECKED, addr, probed); break;
+		case UOP_CALL_CHK : call(pmach, di, ADDR_CHECKED, addr, probed); break;
+		case UOP_PUSH_CHK : push(pmach, di, ADDR_CHECKED, addr, probed); break;
+		case UOP_POP_CHK : pop(pmach, di, ADDR_CHECKED, addr, probed); break;
+		// Micro-opération impossible : la table est corrompue
+		default:
+			fault(pmach, ERR_UNKNOWN, addr);
+	}
+	return true;
+}
+
+//! Exécution d'une instruction isolée
+/*!
+ * Hors des boucles spécialisées, la présence de sondes est testée à chaque
+ * instruction.
+ * \param pmach la machine/programme en cours d'exécution
+ * \param di l'instruction décodée à exécuter
+ * \param addr l'adresse de l'instruction
+ * \return faux après l'exécution de \c HALT ; vrai sinon
+ */
+static bool execute_one(Machine *pmach, Decoded_Instruction di, unsigned addr){
+	pmach->_steps++;
+	if(!pmach->_probes) return execute(pmach, di, addr, false);
+	probe_before(pmach, addr);
+	bool running = execute(pmach, di, addr, true);
+	probe_after(pmach, addr);
+	return running;
+}
+
+//! Décodage et exécution d'une instruction
+/*!
+ * L'instruction est décodée (avec le préfixe \c EXT qui la précède
+ * éventuellement) et vérifiée, puis exécutée par les mêmes traitants que la
+ * table de micro-opérations.
+ * \param pmach la machine/programme en cours d'exécution
+ * \param instr l'instruction à exécuter
+ * \return faux après l'exécution de \c HALT ; vrai sinon
+ */
+bool decode_execute(Machine *pmach, Instruction instr){
+	Decoded_Instruction di = decode_prefixed(text_prefix(pmach->_text, pmach->_pc-1), instr);
+	verify_instruction(&di, pmach->_textsize, pmach->_datasize);
+	return execute_one(pmach, di, pmach->_pc-1);
+}
+
+//! Exécution d'une instruction pré-décodée
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param addr l'adresse de l'instruction dans le segment de texte
+ * \return faux après l'exécution de \c HALT ; vrai sinon
+ */
+bool execute_decoded(Machine *pmach, unsigned addr){
+	return execute_one(pmach, decoded_at(&pmach->_decoded, addr), addr);
+}
+
+//! Boucle d'exécution spécialisée pour un niveau de trace
+/*!
+ * Le niveau et la présence de sondes sont des constantes à chaque appel :
+ * avec TRACE_OFF et sans sonde, la boucle compilée ne contient aucun test de
+ * trace ni aucun appel de sonde. Seule la boucle avec sondes teste \c _stop,
+ * qu'une sonde positionne pour interrompre l'exécution avant l'instruction
+ * suivante (voir execute_until()).
+ *
+ * Si l'exécution est enregistrée, la boucle s'arrête aussi, par le même
+ * test, à l'instruction du prochain point de reprise (voir record.h) : elle
+ * le fait prendre puis repart.
+ * \param pmach la machine/programme en cours d'exécution
+ * \param level le niveau de trace
+ * \param probed faut-il notifier les sondes ?
+ * \param limit valeur de \c _steps à laquelle s'arrêter
+ * \return faux après l'exécution de \c HALT ; vrai si la limite est atteinte
+ * ou si une sonde a demandé l'arrêt
+ */
+static ALWAYS_INLINE bool execute_loop(Machine *pmach, const Trace_Level level, const bool probed, uint64_t limit){
+	const Decoded_Text *pdec = &pmach->_decoded;
+	Recorder *prec = pmach->_recorder;
+	uint64_t bound = prec && prec->_nextcheck < limit ? prec->_nextcheck : limit;
+	unsigned pc;
+	bool running;
+	do{
+		if(pmach->_steps >= bound){
+			if(pmach->_steps >= limit) return true;
+			record_checkpoint(prec);
+			bound = prec->_nextcheck < limit ? prec->_nextcheck : limit;
+		}
+		if(probed && pmach->_stop) return true;
+		pc = pmach->_pc;
+		//on vérifie que pc ne dépasse pas la taille du segment d'instructions
+		if(pc >= pmach->_textsize) fault(pmach, ERR_SEGTEXT, pc);
+		if(trace_wanted(pmach, level, pc)) trace("EXECUTING", pmach, pmach->_text[pc], pc);
+		if(probed) probe_before(pmach, pc);
+		pmach->_pc = pc + 1;
+		pmach->_steps++;
+		running = execute(pmach, decoded_at(pdec, pc), pc, probed);
+		if(probed) probe_after(pmach, pc);
+	} while(running);
+	return false;
+}
+
+//! Exécution du programme jusqu'à HALT
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param level le niveau de trace
+ */
+void execute_program(Machine *pmach, Trace_Level level){
+	jmp_buf resume;
+	//point de reprise après une trappe, établi une fois pour toutes
+	if(pmach->_trapbase != TRAP_NONE){
+		pmach->_resume = &resume;
+		setjmp(resume);
+	}
+	if(pmach->_probes){
+		switch(level){
+			case TRACE_OFF: execute_loop(pmach, TRACE_OFF, true, UINT64_MAX); break;
+			case TRACE_BRANCH: execute_loop(pmach, TRACE_BRANCH, true, UINT64_MAX); break;
+			default: execute_loop(pmach, TRACE_FULL, true, UINT64_MAX); break;
 		}
-	}	
-	return keepgoing;
+	} else {
+		switch(level){
+			case TRACE_OFF: execute_loop(pmach, TRACE_OFF, false, UINT64_MAX); break;
+			case TRACE_BRANCH: execute_loop(pmach, TRACE_BRANCH, false, UINT64_MAX); break;
+			default: execute_loop(pmach, TRACE_FULL, false, UINT64_MAX); break;
+		}
+	}
+	pmach->_resume = NULL;
+}
+
+//! Exécution d'au plus \c limit - \c _steps instructions
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param limit valeur de \c _steps à laquelle s'arrêter
+ * \return faux après l'exécution de \c HALT ; vrai si la limite est atteinte
+ */
+bool execute_budget(Machine *pmach, uint64_t limit){
+	jmp_buf resume;
+	bool exhausted;
+	//point de reprise après une trappe, établi une fois pour toutes
+	if(pmach->_trapbase != TRAP_NONE){
+		pmach->_resume = &resume;
+		setjmp(resume);
+	}
+	if(pmach->_probes) exhausted = execute_loop(pmach, TRACE_OFF, true, limit);
+	else exhausted = execute_loop(pmach, TRACE_OFF, false, limit);
+	pmach->_resume = NULL;
+	return exhausted;
+}
+
+//! Exécution jusqu'à HALT ou jusqu'à un arrêt demandé par une sonde
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param level le niveau de trace
+ * \return faux après l'exécution de \c HALT ; vrai si une sonde a demandé l'arrêt
+ */
+bool execute_until(Machine *pmach, Trace_Level level){
+	jmp_buf resume;
+	bool stopped;
+	pmach->_stop = false;
+	//point de reprise après une trappe, établi une fois pour toutes
+	if(pmach->_trapbase != TRAP_NONE){
+		pmach->_resume = &resume;
+		setjmp(resume);
+	}
+	switch(level){
+		case TRACE_OFF: stopped = execute_loop(pmach, TRACE_OFF, true, UINT64_MAX); break;
+		case TRACE_BRANCH: stopped = execute_loop(pmach, TRACE_BRANCH, true, UINT64_MAX); break;
+		default: stopped = execute_loop(pmach, TRACE_FULL, true, UINT64_MAX); break;
+	}
+	pmach->_resume = NULL;
+	pmach->_stop = false;
+	return stopped;
 }
 
 //! Trace de l'exécution
@@ -362,6 +635,6 @@ bool decode_execute(Machine *pmach, Instruction instr){
  */
 void trace(const char *msg, Machine *pmach, Instruction instr, unsigned addr) {
 	printf("TRACE: %s: 0x%04x: ", msg, addr);
-	print_instruction(instr,addr);
+	print_prefixed(text_prefix(pmach->_text, addr), instr, addr);
 	printf("\n");
 }
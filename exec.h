@@ -8,6 +8,62 @@
 
 #include "machine.h"
 
+//! Code condition correspondant au résultat d'une opération
+/*!
+ * \param value le résultat de l'instruction de calcul ou de transfert
+ * \return le code condition donnant le signe de ce résultat
+ */
+static inline Condition_Code condition_code(Word value)
+{
+    if (value < 0)
+        return CC_N;
+    else if (value > 0)
+        return CC_P;
+    else
+        return CC_Z;
+}
+
+//! Teste une condition par rapport au code condition CC
+/*!
+ * \param cc le code condition courant
+ * \param cond la condition à tester (voir \link Condition \endlink)
+ * \return vrai si la condition est satisfaite, faux sinon (et pour une
+ * condition inexistante)
+ */
+static inline bool condition_holds(Condition_Code cc, unsigned cond)
+{
+    switch (cond)
+    {
+    case NC: return true;
+    case EQ: return cc == CC_Z;
+    case NE: return cc != CC_Z;
+    case GT: return cc == CC_P;
+    case GE: return cc == CC_P || cc == CC_Z;
+    case LT: return cc == CC_N;
+    case LE: return cc == CC_N || cc == CC_Z;
+    default: return false;
+    }
+}
+
+//! Erreur à l'exécution d'une instruction
+/*!
+ * Si le programme a un traitant pour cette erreur et que la boucle
+ * d'exécution a établi un point de reprise (\c _resume), l'erreur est
+ * délivrée comme une trappe. Sinon elle est rangée dans \c _fault et \c
+ * _fault_addr. Si un programme hôte a établi un point de reprise (\c
+ * _abort, voir run_program()), on y retourne ; sinon l'erreur est affichée
+ * et le simulateur s'arrête (voir error()).
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param err code de l'erreur
+ * \param addr adresse de l'instruction fautive
+ */
+#ifdef __GNUC__
+void fault(Machine *pmach, Error err, unsigned addr) __attribute__((noreturn));
+#else
+void fault(Machine *pmach, Error err, unsigned addr);
+#endif
+
 //! Décodage et exécution d'une instruction
 /*!
  * \param pmach la machine/programme en cours d'exécution
@@ -16,6 +72,84 @@
  */
 bool decode_execute(Machine *pmach, Instruction instr);
 
+//! Exécution d'une instruction pré-décodée
+/*!
+ * L'instruction est lue dans la table de micro-opérations construite au
+ * chargement du programme (voir load_program()) : aucun champ de bits n'est
+ * extrait lors de l'exécution.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param addr l'adresse de l'instruction dans le segment de texte
+ * \return faux après l'exécution de \c HALT ; vrai sinon
+ */
+bool execute_decoded(Machine *pmach, unsigned addr);
+
+//! Exécution du programme jusqu'à HALT
+/*!
+ * Exécute les instructions pré-décodées à partir de \c _pc sans mode de mise
+ * au point. Une boucle différente est compilée pour chaque niveau de trace :
+ * au niveau TRACE_OFF elle ne fait aucun test de trace. Les boucles qui
+ * notifient les sondes (voir probe.h) ne sont utilisées que si au moins une
+ * sonde est attachée à la machine.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param level le niveau de trace
+ */
+void execute_program(Machine *pmach, Trace_Level level);
+
+//! Exécution d'au plus \c limit - \c _steps instructions
+/*!
+ * Boucle sans trace utilisée par run_program() : elle s'arrête sur HALT ou
+ * quand le compteur d'instructions \c _steps atteint \c limit.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param limit valeur de \c _steps à laquelle s'arrêter
+ * \return faux après l'exécution de \c HALT ; vrai si la limite est atteinte
+ */
+bool execute_budget(Machine *pmach, uint64_t limit);
+
+//! Exécution jusqu'à HALT ou jusqu'à un arrêt demandé par une sonde
+/*!
+ * Boucle avec sondes utilisée par le mode de mise au point pour les points
+ * d'arrêt (voir debug.h) : une sonde interrompt l'exécution en positionnant
+ * \c _stop, testé avant chaque instruction. L'instruction en cours se termine
+ * donc toujours ; \c _pc désigne l'instruction suivante au retour. Les autres
+ * boucles ne testent jamais \c _stop et ne coûtent rien de plus.
+ *
+ * \param pmach la machine/programme en cours d'exécution (au moins une sonde attachée)
+ * \param level le niveau de trace
+ * \return faux après l'exécution de \c HALT ; vrai si une sonde a demandé l'arrêt
+ */
+bool execute_until(Machine *pmach, Trace_Level level);
+
+//! Faut-il tracer l'instruction ?
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param level le niveau de trace
+ * \param addr l'adresse de l'instruction
+ * \return vrai si l'instruction doit être tracée à ce niveau
+ */
+static inline bool trace_wanted(const Machine *pmach, Trace_Level level, unsigned addr)
+{
+    switch (level)
+    {
+    case TRACE_FULL:
+        return true;
+    case TRACE_BRANCH:
+        switch (pmach->_decoded._uop[addr])
+        {
+        case UOP_BRANCH_ABS: case UOP_BRANCH_IDX: case UOP_BRANCH_CHK:
+        case UOP_CALL_ABS: case UOP_CALL_IDX: case UOP_CALL_CHK:
+        case UOP_RET: case UOP_RTT:
+            return true;
+        default:
+            return false;
+        }
+    default:
+        return false;
+    }
+}
+
 //! Trace de l'exécution
 /*!
  * On écrit l'adresse et l'instruction sous forme lisible.
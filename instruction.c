@@ -17,90 +17,159 @@
  const char* condition_names[] = { "NC", "EQ", "NE", "GT", "GE", "LT", "LE" };
 
  //! Tous les codes des operations : 
- const char* cop_names[] = { "ILLOP", "NOP", "LOAD", "STORE", "ADD", "SUB", "BRANCH", "CALL", "RET", "PUSH", "POP", "HALT" };
+ const char* cop_names[] = { "ILLOP", "NOP", "LOAD", "STORE", "ADD", "SUB", "BRANCH", "CALL", "RET", "PUSH", "POP", "HALT", "RTT", "EXT" };
 
 
 
- //! Impression du code condition .
-/*!
- * \param instr l'instruction corespondante 
- */
+//! Chiffres hexadécimaux
+static const char hex_digits[] = "0123456789abcdef";
 
- void print_condition(Instruction instr){
+char *format_hex(char *p, uint32_t v, unsigned digits){
+	char tmp[8];
+	unsigned n = 0;
+	do {
+		tmp[n++] = hex_digits[v & 0xf];
+		v >>= 4;
+	} while(v);
+	for(; digits > n ; digits--) *p++ = '0';
+	while(n) *p++ = tmp[--n];
+	return p;
+}
 
- 	printf("%s, ", condition_names[instr.instr_generic._regcond] );
- } 
- 
- 
- //! Impression du code operande .
+char *format_udec(char *p, uint32_t v){
+	char tmp[10];
+	unsigned n = 0;
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while(v);
+	while(n) *p++ = tmp[--n];
+	return p;
+}
+
+char *format_dec(char *p, int32_t v){
+	if(v < 0) *p++ = '-';
+	return format_udec(p, v < 0 ? -(uint32_t) v : (uint32_t) v);
+}
+
+//! Copie d'une chaîne, sans le nul final
+static inline char *format_string(char *p, const char *s){
+	while(*s) *p++ = *s++;
+	return p;
+}
+
+ //! Écriture du code condition .
 /*!
+ * Une condition inexistante est écrite sous forme numérique.
+ * \param p où écrire
  * \param instr l'instruction corespondante 
+ * \return la position qui suit le texte
  */
-  void print_code_op(Instruction instr){
-
-	printf("%s ",cop_names[instr.instr_generic._cop]);
+static char *format_condition(char *p, Instruction instr){
+	if(instr.instr_generic._regcond > LAST_CONDITION)
+		p = format_dec(p, instr.instr_generic._regcond);
+	else
+		p = format_string(p, condition_names[instr.instr_generic._regcond]);
+	*p++ = ',';
+	*p++ = ' ';
+	return p;
 }
- 
- 
 
- //! Impression d'un registre  .
+ //! Écriture d'un registre  .
 /*!
+ * \param p où écrire
  * \param instr l'instruction corespondante 
+ * \return la position qui suit le texte
  */
+static char *format_registre(char *p, Instruction instr){
+	*p++ = 'R';
+	//sur deux chiffres jusqu'à R09 (R010 : forme historique de l'affichage)
+	if(instr.instr_generic._regcond <= 10) *p++ = '0';
+	p = format_dec(p, instr.instr_generic._regcond);
+	*p++ = ' ';
+	return p;
+}
 
- void print_registre(Instruction instr){
-	if(instr.instr_generic._regcond>10)
- 	printf("R%d ",instr.instr_generic._regcond );
- else 
- 	printf("R0%d ",instr.instr_generic._regcond );
- }
-
- //! Impression de l'operande   .
+ //! Écriture de l'operande   .
 /*!
+ * \param p où écrire
  * \param instr l'instruction corespondante 
+ * \param prefix le mot qui la précède (préfixe EXT éventuel)
+ * \return la position qui suit le texte
  */
+static char *format_operande(char *p, Instruction instr, Instruction prefix){
+	bool ext = prefix.instr_generic._cop == EXT;
+	if(instr.instr_generic._immediate){
+		// I = 1 => operande = val
+		*p++ = '#';
+		p = format_dec(p, ext ? (int32_t) extend_operand(prefix, instr) : instr.instr_immediate._value);
+	} else if(instr.instr_generic._indexed){
+		// I=0 & X=1 => adr = (RX)+Offset
+		p = format_dec(p, ext ? (int32_t) extend_operand(prefix, instr) : instr.instr_indexed._offset);
+		*p++ = '[';
+		*p++ = 'R';
+		p = format_dec(p, instr.instr_indexed._rindex);
+		*p++ = ']';
+	} else {
+		// I=0 & X=0 => adr = abs
+		*p++ = '@';
+		*p++ = '0';
+		*p++ = 'x';
+		p = format_hex(p, ext ? extend_operand(prefix, instr) : instr.instr_absolute._address, 4);
+	}
+	return p;
+}
 
- void print_operande(Instruction instr){
- 	if(instr.instr_generic._immediate){
- 		printf("#%d",instr.instr_immediate._value); // I = 1 => operande = val ; 
- 	} else {
- 		 if(instr.instr_generic._indexed){
- 		 	printf("%d[R%d]",instr.instr_indexed._offset,instr.instr_indexed._rindex ); // I=0 & X=1 => adr = (RX)+Offset 
- 		 } else {
-			
- 		 	printf("@0x%.4x", instr.instr_absolute._address ); // I=0 & X=1 => adr = abs ;
+unsigned format_instruction(char *buf, Instruction instr, unsigned addr){
+	Instruction none = { ._raw = 0 };
+	return format_prefixed(buf, none, instr, addr);
+}
 
- 		 }
- 	}
- }
- 
-void print_instruction(Instruction instr, unsigned addr){
-	switch (instr.instr_generic._cop) {
+unsigned format_prefixed(char *buf, Instruction prefix, Instruction instr, unsigned addr){
+	char *p = buf;
+	unsigned cop = instr.instr_generic._cop;
+
+	//un code opération inexistant n'est pas affiché
+	if(cop <= LAST_COP){
+		p = format_string(p, cop_names[cop]);
+		*p++ = ' ';
+	}
+	switch (cop) {
 		case LOAD:
 		case STORE:
 		case ADD:
 		case SUB:
-			print_code_op(instr) ;
-			print_registre(instr); 
-			print_operande(instr);
+			p = format_registre(p, instr);
+			p = format_operande(p, instr, prefix);
 			break ; 
 			
 		case BRANCH : 
 		case CALL:
-			print_code_op(instr) ;
-			print_condition(instr); 
-			print_operande(instr);
+			p = format_condition(p, instr);
+			p = format_operande(p, instr, prefix);
 			break ; 
-	    case PUSH:
+		case PUSH:
 		case POP:
-			print_code_op(instr) ; 
-			print_operande(instr);
+			p = format_operande(p, instr, prefix);
+			break;
+		case EXT:
+			*p++ = '0';
+			*p++ = 'x';
+			p = format_hex(p, instr.instr_ext._high, 5);
 			break;
-		case ILLOP:
-		case NOP:
-		case RET:
-		case HALT:
-		print_code_op(instr) ; 
-			break;		
-		}
+		default:
+			break;
+	}
+	*p = '\0';
+	return p - buf;
+}
+
+void print_instruction(Instruction instr, unsigned addr){
+	char buf[INSTR_TEXT_MAX];
+	fwrite(buf, 1, format_instruction(buf, instr, addr), stdout);
+}
+
+void print_prefixed(Instruction prefix, Instruction instr, unsigned addr){
+	char buf[INSTR_TEXT_MAX];
+	fwrite(buf, 1, format_prefixed(buf, prefix, instr, addr), stdout);
 }
@@ -24,10 +24,12 @@ typedef enum
     PUSH,	//!< Empilement sur la pile d'exécution 
     POP,	//!< Dépilement de la pile d'exécution
     HALT,	//!< Arrêt (normal) du programme
+    RTT,	//!< Retour de trappe (voir \link Trap_Slot \endlink)
+    EXT,	//!< Extension de l'opérande de l'instruction suivante
 } Code_Op;
 
 //! Dernière valeur possible du code opération
-const static unsigned LAST_COP = HALT;
+const static unsigned LAST_COP = EXT;
 
 
 //! Structure d'une instruction 
@@ -95,6 +97,20 @@ typedef union Instruction
         signed int _offset : 16;//!< Déplacement
     } instr_indexed;
 
+    //! Format du préfixe d'extension \c EXT
+    /*!
+     * Le préfixe est sans effet à l'exécution ; ses 20 bits de poids fort
+     * complètent l'opérande de l'instruction qui le suit (voir
+     * extend_operand()), qui peut ainsi désigner tout le segment de données
+     * (jusqu'à 2^32 mots) au-delà des 20 bits du champ \c _address.
+     */
+    struct
+    {
+        Code_Op _cop : 6; 	//!< Code opération (\c EXT)
+        unsigned _pad : 6;	//!< Inutilisé (nul)
+        unsigned _high : 20;	//!< Bits de poids fort de l'opérande
+    } instr_ext;
+
 } Instruction;
 
 //! Conditions
@@ -123,12 +139,97 @@ static const unsigned LAST_CONDITION = LE;
 //! Type d'un mot de donnée
 typedef uint32_t Word;
 
+//! Opérande étendu d'une instruction précédée du préfixe \c EXT
+/*!
+ * Les bits de poids fort du préfixe sont placés au-dessus du champ de
+ * l'opérande : 20 bits pour une valeur immédiate ou une adresse absolue, 16
+ * pour un déplacement. Le résultat est tronqué à 32 bits ; il n'est plus
+ * étendu avec son signe.
+ *
+ * \param ext le préfixe
+ * \param instr l'instruction qui le suit
+ * \return l'opérande sur 32 bits
+ */
+static inline uint32_t extend_operand(Instruction ext, Instruction instr)
+{
+    if (instr.instr_generic._immediate)
+        return (uint32_t) ext.instr_ext._high << 20 | (instr.instr_immediate._value & 0xfffff);
+    if (instr.instr_generic._indexed)
+        return (uint32_t) ext.instr_ext._high << 16 | (instr.instr_indexed._offset & 0xffff);
+    return (uint32_t) ext.instr_ext._high << 20 | instr.instr_absolute._address;
+}
+
+//! Préfixe éventuel de l'instruction d'adresse addr
+/*!
+ * \param text le segment de texte
+ * \param addr l'adresse de l'instruction
+ * \return le mot qui la précède (\c ILLOP, sans effet, pour la première)
+ */
+static inline Instruction text_prefix(const Instruction *text, unsigned addr)
+{
+    Instruction none = { ._raw = 0 };
+    return addr ? text[addr - 1] : none;
+}
+
 //! Forme imprimable des codes opérations
 extern const char *cop_names[];
 
 //! Forme imprimable des conditions
 extern const char *condition_names[];
 
+//! Taille suffisante pour le désassemblage d'une instruction (nul final compris)
+#define INSTR_TEXT_MAX 32
+
+//! Écriture d'un entier en hexadécimal (minuscules)
+/*!
+ * \param p où écrire (pas de nul final)
+ * \param v l'entier
+ * \param digits le nombre minimal de chiffres (complété par des zéros)
+ * \return la position qui suit le dernier chiffre
+ */
+char *format_hex(char *p, uint32_t v, unsigned digits);
+
+//! Écriture d'un entier non signé en décimal
+/*!
+ * \param p où écrire (pas de nul final)
+ * \param v l'entier
+ * \return la position qui suit le dernier chiffre
+ */
+char *format_udec(char *p, uint32_t v);
+
+//! Écriture d'un entier signé en décimal
+/*!
+ * \param p où écrire (pas de nul final)
+ * \param v l'entier
+ * \return la position qui suit le dernier chiffre
+ */
+char *format_dec(char *p, int32_t v);
+
+//! Désassemblage d'une instruction dans un tampon
+/*!
+ * Le texte est celui qu'imprime print_instruction(), sans appel à printf()
+ * ni allocation.
+ *
+ * \param buf le tampon, d'au moins \c INSTR_TEXT_MAX octets
+ * \param instr l'instruction
+ * \param addr son adresse
+ * \return la longueur du texte (terminé par un nul)
+ */
+unsigned format_instruction(char *buf, Instruction instr, unsigned addr);
+
+//! Désassemblage d'une instruction et de son préfixe éventuel
+/*!
+ * Si \c prefix est un préfixe \c EXT, l'opérande affiché est l'opérande
+ * étendu (voir extend_operand()).
+ *
+ * \param buf le tampon, d'au moins \c INSTR_TEXT_MAX octets
+ * \param prefix le mot qui précède l'instruction (voir text_prefix())
+ * \param instr l'instruction
+ * \param addr son adresse
+ * \return la longueur du texte (terminé par un nul)
+ */
+unsigned format_prefixed(char *buf, Instruction prefix, Instruction instr, unsigned addr);
+
 //! Impression d'une instruction sous forme lisible (désassemblage)
 /*!
  * \param instr l'instruction à imprimer
@@ -136,4 +237,12 @@ extern const char *condition_names[];
  */
 void print_instruction(Instruction instr, unsigned addr);
 
+//! Impression d'une instruction et de son préfixe éventuel
+/*!
+ * \param prefix le mot qui précède l'instruction (voir text_prefix())
+ * \param instr l'instruction à imprimer
+ * \param addr son adresse
+ */
+void print_prefixed(Instruction prefix, Instruction instr, unsigned addr);
+
 #endif
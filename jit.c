@@ -0,0 +1,822 @@
+/*!
+ * \file jit.c
+ * \brief Compilateur à la volée (JIT) du segment de texte vers du code x86-64.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ *
+ * Le segment de texte est découpé en blocs de base, compilés à leur première
+ * exécution en code machine x86-64 dans une zone de mémoire exécutable
+ * obtenue par \c mmap(). Chaque bloc est une fonction
+ *
+ * \code
+ * uint64_t bloc(Machine *pmach, Word *data);
+ * \endcode
+ *
+ * qui charge dans des registres de l'hôte les registres généraux qu'elle
+ * utilise, exécute les instructions du bloc puis range les registres
+ * modifiés et renvoie l'adresse de l'instruction suivante. Le code
+ * condition est évalué paresseusement : on garde seulement le registre
+ * contenant le dernier résultat et le code condition n'est calculé (à partir
+ * des indicateurs de l'hôte) qu'en fin de bloc ou pour un branchement.
+ *
+ * Toute instruction que le compilateur ne sait pas traiter (HALT, erreurs
+ * détectées au décodage, adresse absolue hors segment) termine le bloc.
+ * Tout contrôle dynamique qui échoue (adresse indexée hors segment, pile)
+ * fait sortir du bloc \e avant l'instruction fautive, avec le bit
+ * JIT_INTERPRET positionné : l'instruction est alors ré-exécutée par
+ * l'interpréteur, qui signale la même erreur à la même adresse que simul().
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "exec.h"
+#include "error.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+#include <sys/mman.h>
+
+//! Nombre maximal d'instructions dans un bloc
+#define JIT_MAXBLOCK 256
+
+//! Taille maximale du code x86-64 produit pour une instruction
+#define JIT_MAXINSTR 192
+
+//! Taille d'une zone de code exécutable
+#define JIT_CHUNK (1 << 20)
+
+//! Bit du résultat d'un bloc demandant l'interprétation de l'instruction suivante
+#define JIT_INTERPRET ((uint64_t) 1 << 32)
+
+//! Type d'un bloc compilé
+typedef uint64_t (*Jit_Block)(Machine *pmach, Word *data);
+
+//! Marque d'un bloc qui ne peut pas être compilé
+#define JIT_NONE ((Jit_Block) 1)
+
+//! Registres de l'hôte (numérotation x86-64)
+enum
+{
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+//! Registres de l'hôte disponibles pour les registres généraux de la machine
+static const int host_pool[] = { RBX, RBP, R12, R13, R14, R15, R8, R9, R10, R11 };
+
+//! Nombre de registres de l'hôte disponibles
+#define NHOST (sizeof(host_pool) / sizeof(host_pool[0]))
+
+//! Registres de l'hôte sauvegardés par le prologue (convention System V)
+static const int saved_regs[] = { RBX, RBP, R12, R13, R14, R15 };
+
+//! Nombre de registres sauvegardés
+#define NSAVED (sizeof(saved_regs) / sizeof(saved_regs[0]))
+
+//! Sortie de bloc en attente de génération
+typedef struct
+{
+    uint8_t *_patch;    //!< Déplacement rel32 à corriger
+    unsigned _pc;       //!< Adresse de l'instruction à interpréter
+    int _ccreg;         //!< Registre portant le code condition (-1 si en mémoire)
+} Jit_Exit;
+
+//! État du compilateur
+typedef struct
+{
+    Machine *_pmach;            //!< Machine compilée
+    Jit_Block *_blocks;         //!< Blocs compilés, indicés par adresse
+    uint8_t *_chunk;            //!< Zone de code courante
+    size_t _used;               //!< Octets utilisés dans la zone courante
+    uint8_t **_chunks;          //!< Toutes les zones allouées
+    unsigned _nchunks;          //!< Nombre de zones allouées
+
+    // Bloc en cours de compilation
+    uint8_t *_p;                //!< Position d'écriture
+    int _host[NREGISTERS];      //!< Registre de l'hôte de chaque registre général (-1 sinon)
+    bool _written[NREGISTERS];  //!< Registres généraux modifiés par le bloc
+    int _ccreg;                 //!< Registre général portant le code condition (-1 : en mémoire)
+    Jit_Exit _exits[2 * JIT_MAXBLOCK]; //!< Sorties vers l'interpréteur
+    unsigned _nexits;           //!< Nombre de sorties
+} Jit;
+
+//----------------------------------------------------------------------
+// Encodage des instructions x86-64 (opérandes 32 bits)
+//----------------------------------------------------------------------
+
+static inline void emit8(Jit *pj, uint8_t b) { *pj->_p++ = b; }
+
+static inline void emit32(Jit *pj, uint32_t v) { memcpy(pj->_p, &v, 4); pj->_p += 4; }
+
+//! Préfixe REX si nécessaire
+static void emit_rex(Jit *pj, bool w, int reg, int index, int base)
+{
+    uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if (rex != 0x40)
+        emit8(pj, rex);
+}
+
+//! Octet ModRM
+static inline void emit_modrm(Jit *pj, int mod, int reg, int rm)
+{
+    emit8(pj, (mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+//! op reg, rm (registre à registre)
+static void emit_rr(Jit *pj, uint8_t opcode, int reg, int rm)
+{
+    emit_rex(pj, false, reg, 0, rm);
+    emit8(pj, opcode);
+    emit_modrm(pj, 3, reg, rm);
+}
+
+//! op reg, [base + disp32]
+static void emit_rm(Jit *pj, uint8_t opcode, int reg, int base, int32_t disp)
+{
+    emit_rex(pj, false, reg, 0, base);
+    emit8(pj, opcode);
+    emit_modrm(pj, 2, reg, base);
+    emit32(pj, disp);
+}
+
+//! op reg, [rsi + index*4] (accès au segment de données)
+static void emit_rdata(Jit *pj, uint8_t opcode, int reg, int index)
+{
+    emit_rex(pj, false, reg, index, RSI);
+    emit8(pj, opcode);
+    emit_modrm(pj, 0, reg, 4);
+    emit8(pj, (2 << 6) | ((index & 7) << 3) | RSI);
+}
+
+//! mov reg, imm32
+static void emit_mov_ri(Jit *pj, int reg, uint32_t imm)
+{
+    emit_rex(pj, false, 0, 0, reg);
+    emit8(pj, 0xB8 + (reg & 7));
+    emit32(pj, imm);
+}
+
+//! op reg, [rsi + addr*4] (accès absolu au segment de données)
+/*!
+ * Au-delà de 2^29 mots, le déplacement ne tient plus sur 32 bits signés :
+ * l'adresse passe alors par eax.
+ */
+static void emit_rabs(Jit *pj, uint8_t opcode, int reg, uint32_t addr)
+{
+    if (addr < (1u << 29))
+        emit_rm(pj, opcode, reg, RSI, addr * sizeof(Word));
+    else
+    {
+        emit_mov_ri(pj, RAX, addr);
+        emit_rdata(pj, opcode, reg, RAX);
+    }
+}
+
+//! mov rax, imm64
+static void emit_mov_rax64(Jit *pj, uint64_t imm)
+{
+    emit8(pj, 0x48);
+    emit8(pj, 0xB8);
+    memcpy(pj->_p, &imm, 8);
+    pj->_p += 8;
+}
+
+//! Opération arithmétique reg, imm32 (ext : 0 add, 5 sub, 7 cmp)
+static void emit_alu_ri(Jit *pj, int ext, int reg, uint32_t imm)
+{
+    emit_rex(pj, false, 0, 0, reg);
+    emit8(pj, 0x81);
+    emit_modrm(pj, 3, ext, reg);
+    emit32(pj, imm);
+}
+
+//! mov dword [rsi + index*4], imm32
+static void emit_store_imm(Jit *pj, int index, uint32_t imm)
+{
+    emit_rex(pj, false, 0, index, RSI);
+    emit8(pj, 0xC7);
+    emit_modrm(pj, 0, 0, 4);
+    emit8(pj, (2 << 6) | ((index & 7) << 3) | RSI);
+    emit32(pj, imm);
+}
+
+//! inc (ext 0) ou dec (ext 1) d'un registre
+static void emit_incdec(Jit *pj, int ext, int reg)
+{
+    emit_rex(pj, false, 0, 0, reg);
+    emit8(pj, 0xFF);
+    emit_modrm(pj, 3, ext, reg);
+}
+
+//! Saut conditionnel (cc : code de condition x86) ou non (cc < 0), rel32 à corriger
+static uint8_t *emit_jump(Jit *pj, int cc)
+{
+    if (cc < 0)
+        emit8(pj, 0xE9);
+    else
+    {
+        emit8(pj, 0x0F);
+        emit8(pj, 0x80 + cc);
+    }
+    emit32(pj, 0);
+    return pj->_p - 4;
+}
+
+//! Correction d'un saut rel32 vers la position courante
+static void patch_jump(Jit *pj, uint8_t *patch, uint8_t *target)
+{
+    int32_t rel = (int32_t) (target - (patch + 4));
+    memcpy(patch, &rel, 4);
+}
+
+//! Codes de condition x86
+enum { X86_B = 0x2, X86_AE = 0x3, X86_E = 0x4, X86_NE = 0x5 };
+
+//! Opcodes x86 utilisés (forme reg, r/m ou r/m, reg)
+enum
+{
+    OP_ADD_RMR = 0x01, OP_ADD_RRM = 0x03,
+    OP_SUB_RMR = 0x29, OP_SUB_RRM = 0x2B,
+    OP_TEST = 0x85, OP_MOV_RMR = 0x89, OP_MOV_RRM = 0x8B,
+};
+
+//! Position du registre général reg dans la structure Machine
+static inline int32_t reg_offset(int reg)
+{
+    return offsetof(Machine, _registers) + reg * sizeof(Word);
+}
+
+//----------------------------------------------------------------------
+// Code condition paresseux
+//----------------------------------------------------------------------
+
+//! Calcul du code condition dans ecx et rangement dans la machine
+/*!
+ * \attention ecx est écrasé : aucune valeur ne doit y être vivante.
+ *
+ * Le code condition ne peut valoir que CC_Z ou CC_P (les mots sont non
+ * signés) : ecx ← CC_Z + (valeur ≠ 0).
+ */
+static void emit_cc_store(Jit *pj, int ccreg)
+{
+    if (ccreg < 0)
+        return;
+    emit_rr(pj, 0x31, RCX, RCX);                        // xor ecx, ecx
+    emit_rr(pj, OP_TEST, pj->_host[ccreg], pj->_host[ccreg]);
+    emit8(pj, 0x0F); emit8(pj, 0x95); emit8(pj, 0xC1);  // setnz cl
+    emit_incdec(pj, 0, RCX);                            // inc ecx
+    emit_rm(pj, OP_MOV_RMR, RCX, RDI, offsetof(Machine, _cc));
+}
+
+//! Le code condition devient à jour dans la machine
+static void flush_cc(Jit *pj)
+{
+    emit_cc_store(pj, pj->_ccreg);
+    pj->_ccreg = -1;
+}
+
+//----------------------------------------------------------------------
+// Contrôles dynamiques et sorties
+//----------------------------------------------------------------------
+
+//! Enregistrement d'une sortie vers l'interpréteur pour l'instruction addr
+static void add_exit(Jit *pj, uint8_t *patch, unsigned addr)
+{
+    Jit_Exit *pe = &pj->_exits[pj->_nexits++];
+    pe->_patch = patch;
+    pe->_pc = addr;
+    pe->_ccreg = pj->_ccreg;
+}
+
+//! Contrôle de l'adresse de données contenue dans eax
+static void emit_check_data(Jit *pj, unsigned addr)
+{
+    emit_alu_ri(pj, 7, RAX, pj->_pmach->_datasize);     // cmp eax, datasize
+    add_exit(pj, emit_jump(pj, X86_AE), addr);
+}
+
+//! Contrôle de pile sur la valeur du registre de l'hôte reg
+static void emit_check_stack(Jit *pj, int reg, unsigned addr)
+{
+    Machine *pmach = pj->_pmach;
+    emit_rr(pj, OP_MOV_RMR, reg, RDX);                  // mov edx, reg
+    emit_alu_ri(pj, 5, RDX, pmach->_dataend);           // sub edx, dataend
+    emit_alu_ri(pj, 7, RDX, pmach->_datasize - pmach->_dataend);
+    add_exit(pj, emit_jump(pj, X86_AE), addr);
+}
+
+//! Calcul dans eax d'une adresse indexée
+/*!
+ * \param sp_delta correction à appliquer si le registre d'index est SP
+ * (POP incrémente SP, CALL le décrémente, avant le calcul de l'adresse)
+ */
+static void emit_index(Jit *pj, Decoded_Instruction di, int sp_delta)
+{
+    emit_rr(pj, OP_MOV_RMR, pj->_host[di._rindex], RAX);
+    int32_t off = di._operand;
+    if (di._rindex == NREGISTERS - 1)
+        off += sp_delta;
+    if (off)
+        emit_alu_ri(pj, 0, RAX, off);
+}
+
+//! Test d'une condition de branchement : saut vers la cible si elle est fausse
+/*!
+ * \return le déplacement à corriger, ou NULL si la condition est toujours vraie
+ */
+static uint8_t *emit_condition(Jit *pj, unsigned cond)
+{
+    uint32_t mask = 0;
+    for (unsigned cc = 0; cc <= LAST_CC; cc++)
+        if (condition_holds(cc, cond))
+            mask |= 1u << cc;
+    if (mask == (1u << (LAST_CC + 1)) - 1)
+        return NULL;
+    if (pj->_ccreg >= 0)
+        flush_cc(pj);                                   // ecx ← cc
+    else
+        emit_rm(pj, OP_MOV_RRM, RCX, RDI, offsetof(Machine, _cc));
+    emit_mov_ri(pj, RDX, mask);
+    emit8(pj, 0x0F); emit8(pj, 0xA3); emit8(pj, 0xCA);  // bt edx, ecx
+    return emit_jump(pj, X86_AE);                       // CF = 0 : faux
+}
+
+//----------------------------------------------------------------------
+// Compilation d'un bloc
+//----------------------------------------------------------------------
+
+//! Registres généraux lus ou écrits par une instruction
+static void regs_used(Decoded_Instruction di, bool used[NREGISTERS])
+{
+    switch (di._uop)
+    {
+    case UOP_LOAD_IDX: case UOP_STORE_IDX: case UOP_ADD_IDX: case UOP_SUB_IDX:
+        used[di._rindex] = true;
+        // continue
+    case UOP_LOAD_IMM: case UOP_LOAD_ABS: case UOP_STORE_ABS:
+    case UOP_ADD_IMM: case UOP_ADD_ABS: case UOP_SUB_IMM: case UOP_SUB_ABS:
+        used[di._regcond] = true;
+        break;
+    case UOP_BRANCH_IDX:
+        used[di._rindex] = true;
+        break;
+    case UOP_CALL_IDX: case UOP_PUSH_IDX: case UOP_POP_IDX:
+        used[di._rindex] = true;
+        // continue
+    case UOP_CALL_ABS: case UOP_RET: case UOP_PUSH_IMM: case UOP_PUSH_ABS: case UOP_POP_ABS:
+        used[NREGISTERS - 1] = true;
+        break;
+    default:
+        break;
+    }
+}
+
+//! L'instruction peut-elle être compilée ?
+static bool compilable(Decoded_Instruction di)
+{
+    switch (di._uop)
+    {
+    // une adresse absolue non prouvée par le vérificateur est laissée à l'interpréteur
+    case UOP_FAULT: case UOP_HALT: case UOP_RTT:
+    case UOP_BRANCH_CHK: case UOP_CALL_CHK: case UOP_PUSH_CHK: case UOP_POP_CHK:
+        return false;
+    default:
+        return true;
+    }
+}
+
+//! L'instruction termine-t-elle un bloc ?
+static bool ends_block(Decoded_Instruction di)
+{
+    return di._uop == UOP_BRANCH_ABS || di._uop == UOP_BRANCH_IDX
+        || di._uop == UOP_CALL_ABS || di._uop == UOP_CALL_IDX
+        || di._uop == UOP_RET;
+}
+
+//! Sortie normale du bloc vers l'adresse constante target
+static uint8_t *emit_leave(Jit *pj, uint64_t target)
+{
+    flush_cc(pj);
+    emit_mov_rax64(pj, target);
+    return emit_jump(pj, -1);
+}
+
+//! Sortie normale du bloc vers l'adresse contenue dans eax
+static uint8_t *emit_leave_rax(Jit *pj)
+{
+    flush_cc(pj);
+    return emit_jump(pj, -1);
+}
+
+//! Compilation d'une instruction
+/*!
+ * \param leaves sauts vers l'épilogue à corriger
+ * \param nleaves leur nombre
+ * \param loop début du corps du bloc (pour les boucles sur le bloc lui-même)
+ * \param start adresse de la première instruction du bloc
+ */
+static void compile_instruction(Jit *pj, Decoded_Instruction di, unsigned addr,
+                                uint8_t **leaves, unsigned *nleaves,
+                                uint8_t *loop, unsigned start)
+{
+    const int sp = pj->_host[NREGISTERS - 1];
+    const int r = pj->_host[di._regcond];
+    uint8_t *skip;
+
+    switch (di._uop)
+    {
+    case UOP_NOP:
+        break;
+
+    case UOP_LOAD_IMM:
+        emit_mov_ri(pj, r, di._operand);
+        pj->_ccreg = di._regcond;
+        break;
+    case UOP_LOAD_ABS:
+        emit_rabs(pj, OP_MOV_RRM, r, di._operand);
+        pj->_ccreg = di._regcond;
+        break;
+    case UOP_LOAD_IDX:
+        emit_index(pj, di, 0);
+        emit_check_data(pj, addr);
+        emit_rdata(pj, OP_MOV_RRM, r, RAX);
+        pj->_ccreg = di._regcond;
+        break;
+
+    case UOP_STORE_ABS:
+        emit_rabs(pj, OP_MOV_RMR, r, di._operand);
+        break;
+    case UOP_STORE_IDX:
+        emit_index(pj, di, 0);
+        emit_check_data(pj, addr);
+        emit_rdata(pj, OP_MOV_RMR, r, RAX);
+        break;
+
+    case UOP_ADD_IMM:
+    case UOP_SUB_IMM:
+        emit_alu_ri(pj, di._uop == UOP_ADD_IMM ? 0 : 5, r, di._operand);
+        pj->_ccreg = di._regcond;
+        break;
+    case UOP_ADD_ABS:
+    case UOP_SUB_ABS:
+        emit_rabs(pj, di._uop == UOP_ADD_ABS ? OP_ADD_RRM : OP_SUB_RRM, r, di._operand);
+        pj->_ccreg = di._regcond;
+        break;
+    case UOP_ADD_IDX:
+    case UOP_SUB_IDX:
+        emit_index(pj, di, 0);
+        emit_check_data(pj, addr);
+        emit_rdata(pj, di._uop == UOP_ADD_IDX ? OP_ADD_RRM : OP_SUB_RRM, r, RAX);
+        pj->_ccreg = di._regcond;
+        break;
+
+    case UOP_PUSH_IMM:
+    case UOP_PUSH_ABS:
+    case UOP_PUSH_IDX:
+        // SP va changer : le code condition qu'il porte est rangé d'abord
+        if (pj->_ccreg == NREGISTERS - 1)
+            flush_cc(pj);
+        emit_check_stack(pj, sp, addr);
+        if (di._uop == UOP_PUSH_ABS)
+            emit_rabs(pj, OP_MOV_RRM, RCX, di._operand);
+        else if (di._uop == UOP_PUSH_IDX)
+        {
+            emit_index(pj, di, 0);
+            emit_check_data(pj, addr);
+            emit_rdata(pj, OP_MOV_RRM, RCX, RAX);
+        }
+        emit_rr(pj, OP_MOV_RMR, sp, RAX);
+        if (di._uop == UOP_PUSH_IMM)
+            emit_store_imm(pj, RAX, di._operand);
+        else
+            emit_rdata(pj, OP_MOV_RMR, RCX, RAX);
+        emit_incdec(pj, 1, sp);
+        break;
+
+    case UOP_POP_ABS:
+    case UOP_POP_IDX:
+        if (pj->_ccreg == NREGISTERS - 1)
+            flush_cc(pj);
+        // ecx ← SP + 1 ; contrôles avant toute modification
+        emit_rr(pj, OP_MOV_RMR, sp, RCX);
+        emit_incdec(pj, 0, RCX);
+        emit_check_stack(pj, RCX, addr);
+        if (di._uop == UOP_POP_IDX)
+        {
+            emit_index(pj, di, 1);
+            emit_check_data(pj, addr);
+        }
+        else
+            emit_mov_ri(pj, RAX, di._operand);
+        emit_rr(pj, OP_MOV_RMR, RCX, sp);
+        emit_rdata(pj, OP_MOV_RRM, RDX, RCX);
+        emit_rdata(pj, OP_MOV_RMR, RDX, RAX);
+        break;
+
+    case UOP_BRANCH_ABS:
+    case UOP_BRANCH_IDX:
+        skip = emit_condition(pj, di._regcond);
+        if (di._uop == UOP_BRANCH_IDX)
+        {
+            emit_index(pj, di, 0);
+            emit_check_data(pj, addr);
+            leaves[(*nleaves)++] = emit_leave_rax(pj);
+        }
+        else if ((unsigned) di._operand == start)
+        {
+            // boucle sur le bloc lui-même : les registres restent dans l'hôte
+            flush_cc(pj);
+            patch_jump(pj, emit_jump(pj, -1), loop);
+        }
+        else
+            leaves[(*nleaves)++] = emit_leave(pj, (unsigned) di._operand);
+        if (skip)
+        {
+            patch_jump(pj, skip, pj->_p);
+            leaves[(*nleaves)++] = emit_leave(pj, addr + 1);
+        }
+        break;
+
+    case UOP_CALL_ABS:
+    case UOP_CALL_IDX:
+        skip = emit_condition(pj, di._regcond);
+        emit_check_stack(pj, sp, addr);
+        if (di._uop == UOP_CALL_IDX)
+        {
+            emit_index(pj, di, -1);
+            emit_check_data(pj, addr);
+        }
+        else
+            emit_mov_ri(pj, RAX, di._operand);
+        flush_cc(pj);
+        emit_rr(pj, OP_MOV_RMR, sp, RDX);
+        emit_store_imm(pj, RDX, addr + 1);
+        emit_incdec(pj, 1, sp);
+        leaves[(*nleaves)++] = emit_jump(pj, -1);
+        if (skip)
+        {
+            patch_jump(pj, skip, pj->_p);
+            leaves[(*nleaves)++] = emit_leave(pj, addr + 1);
+        }
+        break;
+
+    case UOP_RET:
+        flush_cc(pj);
+        emit_rr(pj, OP_MOV_RMR, sp, RCX);
+        emit_incdec(pj, 0, RCX);
+        emit_check_stack(pj, RCX, addr);
+        emit_rr(pj, OP_MOV_RMR, RCX, sp);
+        emit_rdata(pj, OP_MOV_RRM, RAX, RCX);
+        leaves[(*nleaves)++] = emit_jump(pj, -1);
+        break;
+
+    default:
+        break;
+    }
+}
+
+//! Allocation d'une zone de code d'au moins size octets
+static bool reserve(Jit *pj, size_t size)
+{
+    if (pj->_chunk && pj->_used + size <= JIT_CHUNK)
+        return true;
+    uint8_t *chunk = mmap(NULL, JIT_CHUNK, PROT_READ | PROT_WRITE | PROT_EXEC,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk == MAP_FAILED)
+        return false;
+    uint8_t **chunks = realloc(pj->_chunks, (pj->_nchunks + 1) * sizeof(uint8_t *));
+    if (!chunks)
+    {
+        munmap(chunk, JIT_CHUNK);
+        return false;
+    }
+    pj->_chunks = chunks;
+    pj->_chunks[pj->_nchunks++] = chunk;
+    pj->_chunk = chunk;
+    pj->_used = 0;
+    return true;
+}
+
+//! Compilation du bloc commençant à l'adresse start
+/*!
+ * \return le bloc compilé, ou JIT_NONE si sa première instruction doit être
+ * interprétée
+ */
+static Jit_Block compile_block(Jit *pj, unsigned start)
+{
+    Machine *pmach = pj->_pmach;
+    const Decoded_Text *pdec = &pmach->_decoded;
+    bool used[NREGISTERS] = { false };
+    unsigned end = start;
+
+    // Délimitation du bloc : au plus NHOST registres généraux différents
+    while (end < pmach->_textsize && end - start < JIT_MAXBLOCK)
+    {
+        Decoded_Instruction di = decoded_at(pdec, end);
+        if (!compilable(di))
+            break;
+        bool more[NREGISTERS];
+        memcpy(more, used, sizeof(used));
+        regs_used(di, more);
+        unsigned n = 0;
+        for (int g = 0; g < NREGISTERS; g++)
+            n += more[g];
+        if (n > NHOST)
+            break;
+        memcpy(used, more, sizeof(used));
+        end++;
+        if (ends_block(di))
+            break;
+    }
+    if (end == start)
+        return JIT_NONE;
+    if (!reserve(pj, 512 + (end - start) * JIT_MAXINSTR))
+        return JIT_NONE;
+
+    // Affectation des registres de l'hôte
+    unsigned h = 0;
+    for (int g = 0; g < NREGISTERS; g++)
+    {
+        pj->_host[g] = used[g] ? host_pool[h++] : -1;
+        pj->_written[g] = false;
+    }
+    for (unsigned a = start; a < end; a++)
+    {
+        Decoded_Instruction di = decoded_at(pdec, a);
+        switch (di._uop)
+        {
+        case UOP_LOAD_IMM: case UOP_LOAD_ABS: case UOP_LOAD_IDX:
+        case UOP_ADD_IMM: case UOP_ADD_ABS: case UOP_ADD_IDX:
+        case UOP_SUB_IMM: case UOP_SUB_ABS: case UOP_SUB_IDX:
+            pj->_written[di._regcond] = true;
+            break;
+        case UOP_CALL_ABS: case UOP_CALL_IDX: case UOP_RET:
+        case UOP_PUSH_IMM: case UOP_PUSH_ABS: case UOP_PUSH_IDX:
+        case UOP_POP_ABS: case UOP_POP_IDX:
+            pj->_written[NREGISTERS - 1] = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint8_t *entry = pj->_p = pj->_chunk + pj->_used;
+    uint8_t *leaves[2 * JIT_MAXBLOCK + 4];
+    unsigned nleaves = 0;
+    pj->_nexits = 0;
+    pj->_ccreg = -1;
+
+    // Prologue : sauvegarde et chargement des registres utilisés
+    for (unsigned i = 0; i < NSAVED; i++)
+    {
+        emit_rex(pj, false, 0, 0, saved_regs[i]);
+        emit8(pj, 0x50 + (saved_regs[i] & 7));          // push
+    }
+    for (int g = 0; g < NREGISTERS; g++)
+        if (pj->_host[g] >= 0)
+            emit_rm(pj, OP_MOV_RRM, pj->_host[g], RDI, reg_offset(g));
+    uint8_t *loop = pj->_p;
+
+    // Corps
+    unsigned a;
+    for (a = start; a < end; a++)
+        compile_instruction(pj, decoded_at(pdec, a), a, leaves, &nleaves, loop, start);
+    if (!ends_block(decoded_at(pdec, end - 1)))
+        leaves[nleaves++] = emit_leave(pj, end < pmach->_textsize && !compilable(decoded_at(pdec, end))
+                                       ? (JIT_INTERPRET | end) : end);
+
+    // Sorties vers l'interpréteur avant une instruction fautive
+    for (unsigned i = 0; i < pj->_nexits; i++)
+    {
+        patch_jump(pj, pj->_exits[i]._patch, pj->_p);
+        emit_cc_store(pj, pj->_exits[i]._ccreg);
+        emit_mov_rax64(pj, JIT_INTERPRET | pj->_exits[i]._pc);
+        leaves[nleaves++] = emit_jump(pj, -1);
+    }
+
+    // Épilogue : rangement des registres modifiés
+    for (unsigned i = 0; i < nleaves; i++)
+        patch_jump(pj, leaves[i], pj->_p);
+    for (int g = 0; g < NREGISTERS; g++)
+        if (pj->_written[g])
+            emit_rm(pj, OP_MOV_RMR, pj->_host[g], RDI, reg_offset(g));
+    for (int i = NSAVED - 1; i >= 0; i--)
+    {
+        emit_rex(pj, false, 0, 0, saved_regs[i]);
+        emit8(pj, 0x58 + (saved_regs[i] & 7));          // pop
+    }
+    emit8(pj, 0xC3);                                    // ret
+
+    pj->_used = pj->_p - pj->_chunk;
+    return (Jit_Block) entry;
+}
+
+//! Libération du code compilé
+static void jit_free(Jit *pj)
+{
+    for (unsigned i = 0; i < pj->_nchunks; i++)
+        munmap(pj->_chunks[i], JIT_CHUNK);
+    free(pj->_chunks);
+    free(pj->_blocks);
+}
+
+//! Boucle de répartition
+/*!
+ * On exécute le bloc compilé de l'adresse courante (en le compilant si
+ * nécessaire) ou, à défaut, une instruction par l'interpréteur.
+ *
+ * \param pj le compilateur (avec sa table de blocs allouée)
+ */
+static void jit_run(Jit *pj)
+{
+    Machine *pmach = pj->_pmach;
+    unsigned pc = pmach->_pc;
+    while (true)
+    {
+        bool interpret = true;
+        if (pc < pmach->_textsize)
+        {
+            Jit_Block block = pj->_blocks[pc];
+            if (!block)
+                block = pj->_blocks[pc] = compile_block(pj, pc);
+            if (block != JIT_NONE)
+            {
+                uint64_t next = block(pmach, pmach->_data);
+                pc = (unsigned) next;
+                interpret = (next & JIT_INTERPRET) != 0;
+            }
+        }
+        if (interpret)
+        {
+            // même contrôle et même exécution que simul()
+            if (pc >= pmach->_textsize)
+            {
+                pmach->_pc = pc;
+                fault(pmach, ERR_SEGTEXT, pc);
+            }
+            pmach->_pc = pc + 1;
+            if (!execute_decoded(pmach, pc))
+                return;
+            pc = pmach->_pc;
+        }
+    }
+}
+
+/*!
+ * Une erreur interrompt jit_run() par fault() : un point de reprise est
+ * établi ici pour libérer le code compilé, puis l'erreur est transmise au
+ * point de reprise de l'hôte (\c _abort) ou signalée par error().
+ *
+ * \param pmach la machine en cours d'exécution
+ */
+void simul_jit(Machine *pmach)
+{
+    Jit jit = { ._pmach = pmach };
+    jmp_buf env, *host = pmach->_abort;
+
+    // Configurations que le code produit ne sait pas contrôler (sondes, qu'il
+    // ne sait pas notifier, points de reprise de l'enregistreur et trappes,
+    // qu'il ne sait pas délivrer)
+    if (pmach->_probes || pmach->_recorder || pmach->_trapbase != TRAP_NONE || pmach->_datasize == 0 || pmach->_dataend > pmach->_datasize
+        || !(jit._blocks = calloc(pmach->_textsize + 1, sizeof(Jit_Block))))
+    {
+        simul_threaded(pmach);
+        return;
+    }
+
+    pmach->_abort = &env;
+    if (setjmp(env))
+    {
+        jit_free(&jit);
+        pmach->_abort = host;
+        if (host)
+            longjmp(*host, 1);
+        error(pmach->_fault, pmach->_fault_addr);
+    }
+    jit_run(&jit);
+    pmach->_abort = host;
+    jit_free(&jit);
+    // le point de reprise a fait taire l'exécution de HALT (voir execute_decoded())
+    if (!host)
+        warning(WARN_HALT, pmach->_pc - 1);
+}
+
+#else
+
+/*!
+ * Sans processeur x86-64 (ou sans compilateur GNU), on se replie sur le
+ * moteur à code enfilé.
+ *
+ * \param pmach la machine en cours d'exécution
+ */
+void simul_jit(Machine *pmach)
+{
+    simul_threaded(pmach);
+}
+
+#endif
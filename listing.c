@@ -0,0 +1,199 @@
+/*!
+ * \file listing.c
+ * \brief Listings du programme, des données et des registres.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "listing.h"
+#include "instruction.h"
+
+//! Place réservée en fin de tampon : une ligne de listing y tient toujours
+#define LISTING_MARGIN 256
+
+//! Listing en cours
+typedef struct {
+	FILE *_out;		//!< Fichier de sortie
+	char *_p;		//!< Prochain octet libre du tampon
+	char _buf[LISTING_CHUNK + LISTING_MARGIN];	//!< Tampon
+} Listing;
+
+//! Écriture du tampon
+static void flush(Listing *pl){
+	fwrite(pl->_buf, 1, pl->_p - pl->_buf, pl->_out);
+	pl->_p = pl->_buf;
+}
+
+//! Place pour une ligne (écriture du tampon s'il est plein)
+static inline void reserve(Listing *pl){
+	if(pl->_p >= pl->_buf + LISTING_CHUNK) flush(pl);
+}
+
+//! Copie d'une chaîne, sans le nul final
+static inline char *put(char *p, const char *s){
+	size_t n = strlen(s);
+	memcpy(p, s, n);
+	return p + n;
+}
+
+//! Entier signé en décimal cadré à gauche sur 8 caractères (\c %-8d)
+static inline char *put_dec8(char *p, int32_t v){
+	char *start = p;
+	p = format_dec(p, v);
+	while(p < start + 8) *p++ = ' ';
+	return p;
+}
+
+void list_program(const Machine *pmach, FILE *out){
+	Listing l = { out };
+	l._p = l._buf;
+
+	l._p = put(l._p, "\n### PROGRAM ###\n\n");
+	//pour chaque instruction : l'adresse, le mot, l'instruction
+	for(unsigned i = 0 ; i < pmach->_textsize ; i++){
+		reserve(&l);
+		char *p = put(l._p, "\t0x");
+		p = format_hex(p, i, 4);
+		p = put(p, " : 0x");
+		p = format_hex(p, pmach->_text[i]._raw, 8);
+		*p++ = '\t';
+		p += format_prefixed(p, text_prefix(pmach->_text, i), pmach->_text[i], i);
+		*p++ = '\n';
+		l._p = p;
+	}
+	flush(&l);
+
+	//taille du programme
+	fprintf(out, "\n Program size : %u\n", pmach->_textsize);
+}
+
+void list_data(const Machine *pmach, FILE *out){
+	Listing l = { out };
+	l._p = l._buf;
+	unsigned col = 0;
+
+	l._p = put(l._p, "\n### DATA ###\n\n");
+	//l'adresse et le mot, trois par ligne
+	for(unsigned i = 0 ; i < pmach->_datasize ; i++){
+		reserve(&l);
+		char *p = l._p;
+		//une suite de pages nulles tient sur une ligne
+		unsigned end = i % DATA_PAGE_WORDS ? i : zero_pages_end(pmach, i);
+		if(end > i){
+			if(col) *p++ = '\n';
+			p = put(p, "\t0x");
+			p = format_hex(p, i, 4);
+			p = put(p, " - 0x");
+			p = format_hex(p, end - 1, 4);
+			p = put(p, " : 0x00000000 (");
+			p = format_udec(p, end - i);
+			p = put(p, " words)\n");
+			l._p = p;
+			col = 0;
+			i = end - 1;
+			continue;
+		}
+		if(col == 0) *p++ = '\t';
+		p = put(p, "0x");
+		p = format_hex(p, i, 4);
+		p = put(p, " : 0x");
+		p = format_hex(p, pmach->_data[i], 8);
+		*p++ = ' ';
+		p = put_dec8(p, pmach->_data[i]);
+		p = put(p, "\t ");
+		if(++col == 3){
+			*p++ = '\n';
+			col = 0;
+		}
+		l._p = p;
+	}
+	flush(&l);
+
+	//taille des données
+	fprintf(out, "\n\nData size : %u\nData end : 0x%08x (%u)\n", pmach->_datasize, pmach->_dataend, pmach->_dataend);
+}
+
+void list_cpu(const Machine *pmach, FILE *out){
+	Listing l = { out };
+	char *p = l._buf;
+
+	p = put(p, "\n### REGISTERS ###\n\n");
+	//trois registres par ligne
+	for(unsigned i = 0 ; i < NREGISTERS ; i++){
+		if(i % 3 == 0) *p++ = '\t';
+		*p++ = 'R';
+		*p++ = '0' + i / 10;
+		*p++ = '0' + i % 10;
+		p = put(p, " : 0x");
+		p = format_hex(p, pmach->_registers[i], 8);
+		*p++ = ' ';
+		p = put_dec8(p, pmach->_registers[i]);
+		p = put(p, "\t ");
+		if(i % 3 == 2 || i == NREGISTERS - 1) *p++ = '\n';
+	}
+
+	//pc et cc
+	p = put(p, "\nPC : 0x");
+	p = format_hex(p, pmach->_pc, 8);
+	p = put(p, " (");
+	p = format_dec(p, pmach->_pc);
+	p = put(p, ") | CC : ");
+	p = put(p, pmach->_cc == CC_U ? "U" : pmach->_cc == CC_P ? "P" : pmach->_cc == CC_N ? "N" : "Z");
+	*p++ = '\n';
+	l._p = p;
+	flush(&l);
+}
+
+//! Listing d'un segment sous forme de tableau C (quatre mots par ligne)
+/*!
+ * \param pl le listing
+ * \param words les mots
+ * \param size leur nombre
+ * \param pmach la machine si les mots sont son segment de données, dont les
+ * suites de pages nulles sont alors résumées par <tt>[début ... fin] = 0</tt>
+ */
+static void list_words(Listing *pl, const uint32_t *words, unsigned size, const Machine *pmach){
+	unsigned col = 0;
+	for(unsigned i = 0 ; i < size ; i++){
+		reserve(pl);
+		char *p = pl->_p;
+		unsigned end = !pmach || i % DATA_PAGE_WORDS ? i : zero_pages_end(pmach, i);
+		if(end > i){
+			if(col) *p++ = '\n';
+			p = put(p, "\t[0x");
+			p = format_hex(p, i, 4);
+			p = put(p, " ... 0x");
+			p = format_hex(p, end - 1, 4);
+			p = put(p, "] = 0,\n");
+			pl->_p = p;
+			col = 0;
+			i = end - 1;
+			continue;
+		}
+		if(col == 0) *p++ = '\t';
+		p = put(p, "Ox");
+		p = format_hex(p, words[i], 8);
+		p = put(p, ", ");
+		if(++col == 4 || i == size - 1){
+			*p++ = '\n';
+			col = 0;
+		}
+		pl->_p = p;
+	}
+}
+
+void list_dump(const Machine *pmach, FILE *out){
+	Listing l = { out };
+	l._p = l._buf;
+
+	l._p = put(l._p, "Instruction text[] = {\n");
+	list_words(&l, (const uint32_t *) pmach->_text, pmach->_textsize, NULL);
+	flush(&l);
+	fprintf(out, "};\nunsigned textsize = %u\n\n", pmach->_textsize);
+
+	l._p = put(l._p, "Word data[] = {\n");
+	list_words(&l, pmach->_data, pmach->_datasize, pmach);
+	flush(&l);
+	fprintf(out, "};\nunsigned datasize = %u\nunsigned dataend = %u\n", pmach->_datasize, pmach->_dataend);
+}
@@ -0,0 +1,52 @@
+#ifndef _LISTING_H_
+#define _LISTING_H_
+
+/*!
+ * \file listing.h
+ * \brief Listings du programme, des données et des registres.
+ *
+ * Les listings sont formatés sans printf() (voir format_instruction(),
+ * format_hex() et format_dec()) dans un tampon qui est écrit d'un seul bloc
+ * chaque fois qu'il est plein. Le texte produit est exactement celui des
+ * anciennes fonctions d'affichage print_program(), print_data(),
+ * print_cpu() et dump_print(), qui s'appuient maintenant sur ce module, à
+ * ceci près qu'une suite de pages entièrement nulles du segment de données
+ * (voir DATA_PAGE_WORDS) est résumée en une ligne.
+ */
+
+#include <stdio.h>
+
+#include "machine.h"
+
+//! Taille du tampon d'un listing (octets écrits en une fois)
+#define LISTING_CHUNK (1 << 16)
+
+//! Listing des instructions du programme
+/*!
+ * \param pmach la machine
+ * \param out le fichier de sortie
+ */
+void list_program(const Machine *pmach, FILE *out);
+
+//! Listing des données du programme (en hexadécimal et en décimal)
+/*!
+ * \param pmach la machine
+ * \param out le fichier de sortie
+ */
+void list_data(const Machine *pmach, FILE *out);
+
+//! Listing des registres du CPU
+/*!
+ * \param pmach la machine
+ * \param out le fichier de sortie
+ */
+void list_cpu(const Machine *pmach, FILE *out);
+
+//! Listing des segments sous forme de tableaux C (voir dump_memory())
+/*!
+ * \param pmach la machine
+ * \param out le fichier de sortie
+ */
+void list_dump(const Machine *pmach, FILE *out);
+
+#endif
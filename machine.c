@@ -8,18 +8,32 @@
  *
  */
 
+// mmap(MAP_ANONYMOUS) n'est pas POSIX
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "machine.h"
 #include "instruction.h"
 #include "exec.h"
 #include "debug.h"
 #include "error.h"
+#include "container.h"
+#include "verify.h"
+#include "listing.h"
 
 
 /*!
  * La machine est réinitialisée et ses segments de texte et de données sont
- * remplacés par ceux fournis en paramètre.
+ * remplacés par ceux fournis en paramètre. Le segment de texte est décodé
+ * dans la table de micro-opérations.
  *
  * \param pmach la machine en cours d'exécution
  * \param textsize taille utile du segment de texte
@@ -30,10 +44,34 @@
 void load_program(Machine *pmach,
                   unsigned textsize, Instruction text[textsize],
                   unsigned datasize, Word data[datasize],  unsigned dataend){
+	Decoded_Text decoded;
+
+	//décodage du segment de texte en micro-opérations, puis vérification
+	decode_text(&decoded, textsize, text);
+	verify_text(&decoded, textsize, datasize);
+	load_decoded(pmach, textsize, text, decoded, datasize, data, dataend);
+}
+
+/*!
+ * \param pmach la machine en cours d'exécution
+ * \param textsize taille utile du segment de texte
+ * \param text le contenu du segment de texte
+ * \param decoded la table de micro-opérations de ce segment
+ * \param datasize taille utile du segment de données
+ * \param data le contenu initial du segment de texte
+ * \param dataend première adresse libre après les données statiques
+ */
+void load_decoded(Machine *pmach,
+                  unsigned textsize, Instruction text[textsize], Decoded_Text decoded,
+                  unsigned datasize, Word data[datasize], unsigned dataend){
 
 	//réinitialisation du segment de texte
 	pmach->_text = text;
 	pmach ->_textsize = textsize;
+	pmach->_decoded = decoded;
+	pmach->_textmap = NULL;
+	pmach->_datamap = NULL;
+	pmach->_snapshot = NULL;
 
 	//réinitialisation du segment de donnée
 	pmach->_data = data;
@@ -54,11 +92,192 @@ void load_program(Machine *pmach,
 	//réinitialisation du registre R15
 	pmach->_sp = datasize-1;
 
+	//trace complète par défaut
+	pmach->_trace = TRACE_FULL;
+
+	//ancien format binaire pour dump.bin
+	pmach->_dumpformat = DUMP_RAW;
+
+	//aucune sonde attachée, pas d'enregistrement
+	pmach->_probes = NULL;
+	pmach->_recorder = NULL;
+
+	//aucune instruction exécutée, aucune erreur
+	pmach->_steps = 0;
+	pmach->_fault = ERR_NOERROR;
+	pmach->_fault_addr = 0;
+	pmach->_abort = NULL;
+	pmach->_stop = false;
+
+	//pas de table des trappes
+	pmach->_trapbase = TRAP_NONE;
+	pmach->_intrap = false;
+	pmach->_trapcc = CC_U;
+	pmach->_resume = NULL;
+
 }
 
 
+//! Taille de l'en-tête d'un fichier binaire (en octets)
+#define HEADER_SIZE (3 * sizeof(uint32_t))
+
+//! Fichier produit par dump_memory()
+#define DUMP_FILE "dump.bin"
+//! Fichier temporaire de dump_create(), renommé en DUMP_FILE
+#define DUMP_TMPFILE "dump.bin.tmp"
+
 /*!
- * Lecture d'un fichier binaire.
+ * \param datasize taille du segment de données dans le fichier
+ * \param dataend première adresse libre après les données statiques
+ * \return la taille du segment en mémoire (en mots)
+ */
+unsigned data_memsize(unsigned datasize, unsigned dataend){
+	//On vérifie que la taille pour la pile est suffisante, sinon on la modifie.
+	unsigned int stack_size = (datasize - dataend < MINSTACKSIZE)?MINSTACKSIZE:datasize - dataend;
+	return dataend + stack_size;
+}
+
+/*!
+ * \param memsize la taille du segment (en mots)
+ * \param plen la longueur de la projection (en octets)
+ * \return le segment, ou NULL (voir \c errno)
+ */
+Word *map_data(unsigned memsize, size_t *plen){
+	*plen = (size_t) (memsize ? memsize : 1) * sizeof(Word);
+	void *data = mmap(NULL, *plen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return data == MAP_FAILED ? NULL : data;
+}
+
+/*!
+ * \param w les mots
+ * \param n leur nombre
+ * \return vrai si les \c n mots sont nuls
+ */
+bool zero_words(const Word *w, size_t n){
+	Word acc = 0;
+	//sans sortie anticipée dans un bloc : la boucle se vectorise
+	for(size_t i = 0 ; i < n ; i += 64){
+		size_t k = n - i < 64 ? n - i : 64;
+		for(size_t j = 0 ; j < k ; j++) acc |= w[i + j];
+		if(acc) return false;
+	}
+	return true;
+}
+
+/*!
+ * \param pmach la machine
+ * \param addr une adresse de début de page
+ * \return la fin des pages nulles qui commencent à \c addr
+ */
+unsigned zero_pages_end(const Machine *pmach, unsigned addr){
+	while(pmach->_datasize - addr >= DATA_PAGE_WORDS && zero_words(pmach->_data + addr, DATA_PAGE_WORDS))
+		addr += DATA_PAGE_WORDS;
+	return addr;
+}
+
+/*!
+ * \param f le fichier, ouvert en écriture
+ * \param data les mots
+ * \param n leur nombre
+ * \return faux en cas d'erreur d'écriture
+ */
+bool write_data_pages(FILE *f, const Word *data, unsigned n){
+	bool hole = false;
+	for(unsigned i = 0 ; i < n ; i += DATA_PAGE_WORDS){
+		unsigned k = n - i < DATA_PAGE_WORDS ? n - i : DATA_PAGE_WORDS;
+		//sur un tube, la page nulle est écrite
+		hole = zero_words(data + i, k) && fseek(f, (long) (k * sizeof(Word)), SEEK_CUR) == 0;
+		if(!hole && fwrite(data + i, sizeof(Word), k, f) != k) return false;
+	}
+	if(hole){
+		Word zero = 0;
+		return fseek(f, -(long) sizeof(Word), SEEK_CUR) == 0 && fwrite(&zero, sizeof(Word), 1, f) == 1;
+	}
+	return true;
+}
+
+//! Lecture des mots de données d'un fichier
+/*!
+ * Les mots sont lus page par page ; une page nulle n'est pas recopiée dans
+ * le segment (nul au départ), qui ne la matérialise donc pas.
+ * \param f le fichier
+ * \param data le segment de données
+ * \param n le nombre de mots
+ * \return faux si le fichier est trop court
+ */
+static bool read_data_pages(FILE *f, Word *data, unsigned n){
+	Word page[DATA_PAGE_WORDS];
+	for(unsigned i = 0 ; i < n ; i += DATA_PAGE_WORDS){
+		unsigned k = n - i < DATA_PAGE_WORDS ? n - i : DATA_PAGE_WORDS;
+		if(fread(page, sizeof(Word), k, f) != k) return false;
+		if(!zero_words(page, k)) memcpy(data + i, page, k * sizeof(Word));
+	}
+	return true;
+}
+
+//! Lecture séquentielle d'un fichier binaire
+/*!
+ * Utilisée pour les fichiers au format conteneur (voir container.h) et pour
+ * ceux qui ne peuvent être projetés en mémoire (tubes, terminaux...). Les
+ * segments sont alloués et lus.
+ * \param pmach la machine à simuler
+ * \param f le fichier, ouvert en lecture (fermé au retour)
+ * \return vrai si le programme a été chargé ; faux sinon (voir \c errno)
+ */
+static bool read_binary(Machine *pmach, FILE *f){
+	unsigned int header[3];
+	Instruction * text = NULL;
+	Word * data = NULL;
+	size_t datalen = 0;
+	int saved_errno;
+
+	//on lit la signature du format conteneur ou textsize
+	if(fread(header, sizeof(unsigned), 1, f)!=1) goto fail;
+	if(is_container(header)){
+		bool loaded = read_container(pmach, f, NULL);
+		saved_errno = errno;
+		fclose(f);
+		errno = saved_errno;
+		return loaded;
+	}
+
+	//on lit les 2 entiers non signés datasize et dataend. 
+	if(fread(header + 1, sizeof(unsigned), 2, f)!=2) goto fail;
+	unsigned int textsize = header[0], datasize = header[1], dataend = header[2];
+	unsigned int memsize = data_memsize(datasize, dataend);
+	if(memsize < datasize) {
+		errno = ENOEXEC;
+		goto fail;
+	}
+
+	//On alloue la mémoire nécessaire à l'accueil des instructions du programme puis on les lit
+	if(!(text = (Instruction *) calloc(textsize ? textsize : 1, sizeof(Instruction)))
+	   || fread(text, sizeof(Instruction), textsize, f)!=textsize) goto fail;
+
+	//On alloue la mémoire nécessaire à l'accueil des données du programme puis on les lit
+	if(!(data = map_data(memsize, &datalen)) || !read_data_pages(f, data, datasize)) goto fail;
+
+	//On appelle la fonction fclose() de stio.h et on ferme proprement le fichier.
+	fclose(f);
+
+	//on réinitialise la machine avec les nouvelles données du programme
+	load_program(pmach, textsize, text, memsize, data, dataend);
+	pmach->_datamap = data;
+	pmach->_datamaplen = datalen;
+	return true;
+
+fail:
+	//fichier trop court : le format n'est pas respecté
+	saved_errno = feof(f) ? ENOEXEC : errno;
+	free(text);
+	if(data) munmap(data, datalen);
+	fclose(f);
+	errno = saved_errno;
+	return false;
+}
+
+/*!
+ * Lecture d'un fichier binaire sans arrêt du simulateur.
  *
  * Le fichier binaire a le format suivant :
  * 
@@ -73,84 +292,131 @@ void load_program(Machine *pmach,
  *    segment de données.
  *
  * Tous les entiers font 32 bits et les adresses de chaque segment commencent à
- * 0. La fonction initialise complétement la machine.
+ * 0. En cas de succès, la fonction initialise complétement la machine.
+ *
+ * Un fichier au format conteneur (voir container.h) est reconnu à sa
+ * signature et lu par read_container().
+ *
+ * Un fichier ordinaire dans l'ancien format n'est pas lu mais projeté en mémoire : le segment de
+ * texte pointe directement dans une projection partagée en lecture seule,
+ * le segment de données est une projection privée (copie sur écriture),
+ * complétée par des pages anonymes pour la pile. Seules les pages de données
+ * modifiées par le programme sont donc copiées. Les tailles sont vérifiées
+ * d'emblée par rapport à la longueur du fichier.
  *
  * \param pmach la machine à simuler
  * \param programfile le nom du fichier binaire
+ * \return vrai si le programme a été chargé ; faux sinon (voir \c errno)
  */
-void read_program(Machine *mach, const char *programfile){
-	
-	FILE * f;
-	unsigned int textsize, datasize, dataend;
-	
+bool load_binary(Machine *pmach, const char *programfile){
+	int fd;
+	struct stat st;
+	uint32_t header[3];
+	void *textmap = MAP_FAILED, *datamap = MAP_FAILED;
+	size_t textmaplen = 0, datamaplen = 0;
+	int saved_errno;
+
 	//on ouvre le programme en lecture seule. 
-	if(!(f = fopen(programfile,"r"))){
-		//Si on rencontre un problème, on quitte l'execution
-		perror("Erreur lors de l'ouverture du fichier dans <machine.c:read_program>");
-		exit(1);
+	if((fd = open(programfile, O_RDONLY)) < 0) return false;
+	if(fstat(fd, &st) < 0) goto fail;
+
+	//un fichier spécial ne se projette pas : on le lit
+	errno = ENOEXEC;
+	if(!S_ISREG(st.st_mode)
+	   || ((size_t) st.st_size >= sizeof(uint32_t) && pread(fd, header, sizeof(uint32_t), 0) == sizeof(uint32_t)
+	       && is_container(header))) {
+		FILE *f = fdopen(fd, "r");
+		if(!f) goto fail;
+		return read_binary(pmach, f);
 	}
 
 	//on lit les 3 entiers non signés textsize, datasize et dataend. 
-	if(fread(&textsize, sizeof(unsigned), 1, f)!=1){
-		//Si on rencontre un problème, on quitte l'exécution. 
-		perror("Erreur lors de la lecture de textsize non signés dans <machine.c:read_program>");
-		exit(1);
-	} else printf("%d\n\n", (int) textsize);
-			
-	if(fread(&datasize, sizeof(unsigned), 1, f)!=1){
-		//Si on rencontre un problème, on quitte l'exécution. 
-		perror("Erreur lors de la lecture de datasize non signés dans <machine.c:read_program>");
-		exit(1);
+	errno = ENOEXEC;
+	if((size_t) st.st_size < HEADER_SIZE || pread(fd, header, HEADER_SIZE, 0) != HEADER_SIZE) goto fail;
+	unsigned int textsize = header[0], datasize = header[1], dataend = header[2];
+	unsigned int memsize = data_memsize(datasize, dataend);
+
+	//le fichier doit contenir les deux segments
+	uint64_t dataoff = HEADER_SIZE + (uint64_t) textsize * sizeof(Instruction);
+	if(memsize < datasize || (uint64_t) st.st_size < dataoff + (uint64_t) datasize * sizeof(Word)) goto fail;
+
+	//segment de texte : projection partagée, en lecture seule
+	textmaplen = dataoff;
+	textmap = mmap(NULL, textmaplen, PROT_READ, MAP_SHARED, fd, 0);
+	if(textmap == MAP_FAILED) goto fail;
+
+	//segment de données : des pages anonymes pour l'ensemble du segment...
+	size_t pagesize = sysconf(_SC_PAGESIZE);
+	size_t pageoff = dataoff & ~(uint64_t) (pagesize - 1);
+	size_t delta = dataoff - pageoff;
+	size_t filelen = delta + (size_t) datasize * sizeof(Word);
+	datamaplen = delta + (size_t) memsize * sizeof(Word);
+	datamap = mmap(NULL, datamaplen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(datamap == MAP_FAILED) goto fail;
+	//... dont le début est remplacé par la projection privée du fichier
+	if(datasize && mmap(datamap, filelen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, fd, pageoff) == MAP_FAILED) goto fail;
+	close(fd);
+
+	Word *data = (Word *) ((char *) datamap + delta);
+	//la dernière page projetée peut contenir la suite du fichier : la pile doit être nulle
+	if(datasize && (uint64_t) st.st_size > dataoff + (uint64_t) datasize * sizeof(Word)) {
+		size_t pageend = (filelen + pagesize - 1) & ~(pagesize - 1);
+		memset(data + datasize, 0, (pageend < datamaplen ? pageend : datamaplen) - filelen);
 	}
-	
-	if(fread(&dataend, sizeof(unsigned), 1, f)!=1){
-		//Si on rencontre un problème, on quitte l'exécution. 
-		perror("Erreur lors de la lecture de dataend non signés dans <machine.c:read_program>");
-		exit(1);
-	}
-
-	//variable définissant la taille de la pile
-	//On vérifie que la taille pour la pile est suffisante, sinon on la modifie.
-	int stack_size = (datasize - dataend < MINSTACKSIZE)?MINSTACKSIZE:datasize - dataend;
 
-	//variable contenant les instuctions du programme
-	Instruction * text;
+	//on réinitialise la machine avec les nouvelles données du programme
+	load_program(pmach, textsize, (Instruction *) ((char *) textmap + HEADER_SIZE), memsize, data, dataend);
+	pmach->_textmap = textmap;
+	pmach->_textmaplen = textmaplen;
+	pmach->_datamap = datamap;
+	pmach->_datamaplen = datamaplen;
+	return true;
+
+fail:
+	saved_errno = errno;
+	if(textmap != MAP_FAILED) munmap(textmap, textmaplen);
+	if(datamap != MAP_FAILED) munmap(datamap, datamaplen);
+	close(fd);
+	errno = saved_errno;
+	return false;
+}
 
-	//On alloue la mémoire nécessaire à l'accueil des instructions du programme.
-	if(!(text = (Instruction *) calloc(textsize, sizeof(Instruction)))){
-		//Si une erreur se produit, on quitte l'exécution.
-		perror("Erreur d'allocation mémoire pour le segment text dans <machine.c:read_program>");
-		exit(1);
-	} 
-	//On lit les instructions du programme
-	else if(fread(text, sizeof(Instruction), textsize, f)!=textsize){
-		//En cas d'erreur, on quitte l'exécution
-		perror("Erreur lors de la lecture des instructions dans <machine.c:read_program>");
+/*!
+ * Lecture d'un fichier binaire.
+ *
+ * Le format du fichier est décrit avec load_binary(). En cas d'erreur, on
+ * quitte l'exécution.
+ *
+ * \param pmach la machine à simuler
+ * \param programfile le nom du fichier binaire
+ */
+void read_program(Machine *mach, const char *programfile){
+	if(!load_binary(mach, programfile)){
+		//Si on rencontre un problème, on quitte l'execution
+		perror("Erreur lors de la lecture du programme dans <machine.c:read_program>");
 		exit(1);
 	}
+	printf("%d\n\n", (int) mach->_textsize);
+}
 
-	//variable contenant les données du programme
-	Word * data;
-
-	//On alloue la mémoire nécessaire à l'accueil des instructions du programme.
-	if(!(data = (Word *) calloc(dataend + stack_size, sizeof(Word)))){	
-		//Si une erreur se produit, on quitte l'exécution.
-		perror("Erreur d'allocation mémoire pour le segment data dans <machine.c:read_program>");
-		exit(1);
-	} 
-	//On lit les données du programme
-	else if(fread(data, sizeof(Word), datasize, f)!=datasize){
-		//En cas d'erreur, on quitte l'exécution
-		perror("Erreur lors de la lecture des données dans <machine.c:read_program>");
-		exit(1);
+/*!
+ * \param pmach la machine
+ */
+void free_program(Machine *pmach){
+	//le texte d'une copie d'instantané appartient à l'instantané
+	if(!pmach->_snapshot){
+		//segments projetés par load_binary() ou alloués
+		if(pmach->_textmap) munmap(pmach->_textmap, pmach->_textmaplen);
+		else free(pmach->_text);
+		free_decoded(&pmach->_decoded);
 	}
-
-	//On appelle la fonction fclose() de stio.h et on ferme proprement le fichier.
-	fclose(f);
-
-	//on réinitialise la machine avec les nouvelles données du programme
-	load_program(mach, textsize, text, dataend+stack_size, data, dataend);
-
+	if(pmach->_datamap) munmap(pmach->_datamap, pmach->_datamaplen);
+	else free(pmach->_data);
+	pmach->_text = NULL;
+	pmach->_data = NULL;
+	pmach->_textmap = NULL;
+	pmach->_datamap = NULL;
+	pmach->_snapshot = NULL;
 }
 
 /*!
@@ -159,82 +425,86 @@ void read_program(Machine *mach, const char *programfile){
  * \param pmach la machine en cours d'exécution
  */
 void dump_print(Machine *pmach){
-	
-	//impression des instructions
-	printf("Instruction text[] = {\n");
-
-	for(int i = 0 ; i< pmach->_textsize; i++){
-		//affichage d'une instruction (tabulation en début de ligne, quattre par ligne séparés par une virgule)
-		printf("%sOx%08x, %s",(i%4 == 0)?"\t":"",(pmach->_text[i])._raw, ((i%4 == 3) 
-			|| (i >= pmach->_textsize -1))?"\n":"");
-	}
-
-	printf("};\nunsigned textsize = %d\n\n", pmach->_textsize);
-
-	//impression des donnéess
-	printf("Word data[] = {\n");
-
-	for(int i = 0 ; i< pmach->_datasize; i++){		
-		//affichage d'une donnée (tabulation en débt de ligne, quatre par lignes séparés par une virgule)
-		printf("%sOx%08x, %s",(i%4 == 0)?"\t":"", pmach->_data[i],((i%4 == 3) 
-			|| (i >= pmach->_datasize -1))?"\n":"");
-	}
-
-	printf("};\nunsigned datasize = %d\nunsigned dataend = %d\n", pmach->_datasize, pmach ->_dataend);
+	list_dump(pmach, stdout);
 }
 
+//! Écriture du dump binaire dans l'ancien format (voir load_binary())
 /*!
- * Délégation de la création du dump binaire par dump_memory()
- * 
  * \param pmach la machine en cours d'exécution
+ * \param f le fichier ouvert en écriture
  */
-void dump_create(Machine *pmach){
-	FILE * f;
-
-	//ouverture en mode ecriture (création si inexistant, remplace sinon)
-	if(!(f = fopen("dump.bin","w+"))){
-		//si le fichier n'a pas été ouvert, on quitte l'exécution
-		perror("Erreur lors de l'ouverture du fichier dump.bin dans <machine.c:dump_create>");
-		exit(1);
-	}
-
+static void dump_raw(Machine *pmach, FILE *f){
 	//écriture de textsize
 	if(fwrite(&(pmach->_textsize),sizeof(unsigned), 1, f)!=1){
 		//si on écrit plus ou moins d'un caratère, on quitte l'exécution
-		perror("Erreur lors de l'écriture de _textsize dans <machine.c:dump_create>");
+		perror("Erreur lors de l'écriture de _textsize dans <machine.c:dump_raw>");
 		exit(1);
 	}
 
 	//écriture de datasize
 	if(fwrite(&(pmach->_datasize),sizeof(unsigned), 1, f)!=1){
 		//si on écrit plus ou moins d'un caratère, on quitte l'exécution
-		perror("Erreur lors de l'écriture de _datasize dans <machine.c:dump_create>");
+		perror("Erreur lors de l'écriture de _datasize dans <machine.c:dump_raw>");
 		exit(1);
 	}
 
 	//écriture de dataend
 	if(fwrite(&(pmach->_dataend),sizeof(unsigned), 1, f)!=1){
 		//si on écrit plus ou moins d'un caratère, on quitte l'exécution
-		perror("Erreur lors de l'écriture de _dataend dans <machine.c:dump_create>");
+		perror("Erreur lors de l'écriture de _dataend dans <machine.c:dump_raw>");
 		exit(1);
 	}
 
 	//écriture des instructions
 	if((fwrite(&(pmach->_text->_raw),sizeof(Word), pmach->_textsize, f)) != pmach->_textsize){
 		//si l'on écrit moins de pmach->_textsize mots de 32 bits, alors on quitte l'exécutions
-		perror("Erreur lors de l'écriture des instructions dans <machine.c:dump_create>");
+		perror("Erreur lors de l'écriture des instructions dans <machine.c:dump_raw>");
 		exit(1);
 	}
 
 	//écriture des données
-	if((fwrite(pmach->_data,sizeof(Word), pmach->_datasize, f)) != pmach->_datasize){
+	if(!write_data_pages(f, pmach->_data, pmach->_datasize)){
 		//si l'on écrit moins de pmach->_datasize mots de 32 bits, alors on quitte l'exécutions
-		perror("Erreur lors de l'écriture des données dans <machine.c:dump_create>");
+		perror("Erreur lors de l'écriture des données dans <machine.c:dump_raw>");
 		exit(1);
 	}
+}
 
-	//on ferme proprement le fichier ouvert
-	fclose(f);
+/*!
+ * Délégation de la création du dump binaire par dump_memory()
+ *
+ * Le format est celui du champ \c _dumpformat de la machine.
+ *
+ * Le programme a pu être chargé (et projeté) depuis dump.bin lui-même : on
+ * écrit donc dans un fichier temporaire, renommé ensuite en dump.bin. Le
+ * fichier projeté garde son contenu jusqu'à free_program().
+ * 
+ * \param pmach la machine en cours d'exécution
+ */
+void dump_create(Machine *pmach){
+	FILE * f;
+
+	//ouverture en mode ecriture (création si inexistant, remplace sinon)
+	if(!(f = fopen(DUMP_TMPFILE,"w+"))){
+		//si le fichier n'a pas été ouvert, on quitte l'exécution
+		perror("Erreur lors de l'ouverture du fichier " DUMP_TMPFILE " dans <machine.c:dump_create>");
+		exit(1);
+	}
+
+	//format conteneur
+	if(pmach->_dumpformat != DUMP_RAW){
+		if(!write_container(pmach, f, NULL, pmach->_dumpformat == DUMP_CONTAINER_LZ ? CONTAINER_LZ : 0)){
+			perror("Erreur lors de l'écriture du conteneur dans <machine.c:dump_create>");
+			exit(1);
+		}
+	}
+	else dump_raw(pmach, f);
+
+	//on ferme proprement le fichier ouvert, puis on remplace dump.bin
+	if(fclose(f) != 0 || rename(DUMP_TMPFILE, DUMP_FILE) != 0){
+		perror("Erreur lors de l'écriture du fichier " DUMP_FILE " dans <machine.c:dump_create>");
+		exit(1);
+	}
 }
 
 
@@ -264,21 +534,7 @@ void dump_memory(Machine *pmach){
  * \param pmach la machine en cours d'exécution
  */
 void print_program(Machine *pmach){
-	
-	printf("\n### PROGRAM ###\n\n");
-	
-	//pour chaque instruction on affiche : 
-	for(int i = 0 ; i < pmach->_textsize ; i++){
-		//l'adresse
-		printf("\t0x%04x : 0x%08x\t", i, (pmach->_text[i])._raw);
-		//l'instruction
-		print_instruction(pmach->_text[i], i);
-		//saut de ligne
-		printf("\n");
-	}
-
-	//taille du programme
-	printf("\n Program size : %d\n",pmach->_textsize);
+	list_program(pmach, stdout);
 }
 
 /*! 
@@ -289,18 +545,7 @@ void print_program(Machine *pmach){
  * \param pmach la machine en cours d'exécution
  */
 void print_data(Machine *pmach){
-	
-	printf("\n### DATA ###\n\n");
-	
-	//pour chaque data on affiche : 
-	for(int i = 0 ; i < pmach->_datasize ; i++){
-		//l'adresse + data (trois par lignes)
-		printf("%s0x%04x : 0x%08x %-8d\t %s", (i%3==0)?"\t":"",i, pmach->_data[i], pmach->_data[i], ((i%3==2) 
-			|| (i > pmach->_datasize - 1))?"\n":"");
-	}
-
-	//taille des données
-	printf("\n\nData size : %d\nData end : 0x%08x (%d)\n",pmach->_datasize, pmach->_dataend, pmach->_dataend);	
+	list_data(pmach, stdout);
 }
 
 /*! 
@@ -311,41 +556,118 @@ void print_data(Machine *pmach){
  * \param pmach la machine en cours d'exécution
  */
 void print_cpu(Machine *pmach){
-
-	printf("\n### REGISTERS ###\n\n");
-
-	//pour chaque registre on affiche :
-	for(int i = 0 ; i < NREGISTERS ; i++){
-		//trois registres par ligne
-		printf("%sR%02d : 0x%08x %-8d\t %s", (i%3==0)?"\t":"",i, pmach->_registers[i], pmach->_registers[i], ((i%3==2) 
-			|| (i >= NREGISTERS - 1))?"\n":"");
-	}
-
-	//on imprime pc et cc
-	printf("\nPC : 0x%08x (%d) | CC : %s\n", pmach->_pc, pmach->_pc, 
-		(pmach->_cc == CC_U)?"U":(pmach->_cc == CC_P)?"P":(pmach->_cc == CC_N)?"N":"Z");
+	list_cpu(pmach, stdout);
 }
 
 /*!
  * Simulation
  *
  * La boucle de simualtion est très simple : recherche de l'instruction
- * suivante (pointée par le compteur ordinal \c _pc) puis décodage et exécution
- * de l'instruction.
+ * suivante (pointée par le compteur ordinal \c _pc) dans la table de
+ * micro-opérations puis exécution de l'instruction.
  *
- * Cette fonction fait appel aux fonctions <exec.c:decode_execute>, <exec.c:trace> et <debug.c:ask_debug>
+ * Tant que le mode de mise au point est actif, on exécute les instructions
+ * une à une ; s'il existe des points d'arrêt ou d'observation, la commande
+ * \c c exécute jusqu'au prochain arrêt (voir debug_continue()) puis revient
+ * au pas à pas. Ensuite (ou directement hors mise au point), l'exécution est
+ * confiée à la boucle spécialisée pour le niveau de trace de la machine.
+ *
+ * En mode de mise au point, une erreur non traitée par une trappe ne
+ * termine pas tout de suite le simulateur : elle est affichée et le
+ * dialogue reprend, pour examiner la machine ou revenir en arrière si
+ * l'exécution est enregistrée (voir record.h). Repartir en avant de
+ * l'erreur termine le simulateur.
+ *
+ * Cette fonction fait appel aux fonctions <exec.c:execute_decoded>, <exec.c:execute_program>, <exec.c:trace> et <debug.c:ask_debug>
  *
  * \param pmach la machine en cours d'exécution
  * \param debug mode de mise au point (pas à apas) ?
  */
 void simul(Machine *pmach, bool debug){
-	do{
-	//on imprime la trace d'execution de l'instruction
-	trace("EXECUTING", pmach, pmach->_text[pmach->_pc], pmach->_pc);
-	//si le parametre debug est vrai, on passe en mode debug
-	if(debug) debug = debug_ask(pmach);
-	if(pmach->_pc >= pmach->_textsize) error(ERR_SEGTEXT, pmach->_pc);
-    }
-	//tant que pc ne dépasse pas la taille du segment d'instructions et que la procedure decode_execute retourne vrai
-	while(decode_execute(pmach, pmach->_text[pmach->_pc++]));
-}
\ No newline at end of file
+	jmp_buf resume, env;
+	volatile bool stepping = debug, halted = false;
+	Debugger dbg;
+	if(debug){
+		debug_start(&dbg, pmach);
+		//une erreur non traitée rend la main au dialogue de mise au point
+		pmach->_abort = &env;
+		if(setjmp(env)){
+			print_error(pmach->_fault, pmach->_fault_addr);
+			//l'erreur a pu interrompre debug_continue()
+			detach_probe(pmach, &dbg._probe);
+			pmach->_stop = false;
+			stepping = true;
+		}
+	}
+	//point de reprise après une trappe pendant la mise au point
+	if(pmach->_trapbase != TRAP_NONE){
+		pmach->_resume = &resume;
+		setjmp(resume);
+	}
+	while(stepping){
+		if(pmach->_fault == ERR_NOERROR){
+			//on vérifie que pc ne dépasse pas la taille du segment d'instructions
+			if(pmach->_pc >= pmach->_textsize) fault(pmach, ERR_SEGTEXT, pmach->_pc);
+			//on imprime la trace d'execution de l'instruction
+			if(trace_wanted(pmach, pmach->_trace, pmach->_pc))
+				trace("EXECUTING", pmach, pmach->_text[pmach->_pc], pmach->_pc);
+		}
+		//dialogue de mise au point ; on en sort sur 'c'
+		stepping = debug_ask(&dbg);
+		//un retour en arrière a pu rejouer l'exécution (voir record_goto())
+		if(pmach->_trapbase != TRAP_NONE) pmach->_resume = &resume;
+		//on ne repart pas en avant d'une erreur
+		if(pmach->_fault != ERR_NOERROR) error(pmach->_fault, pmach->_fault_addr);
+		//points armés : exécution jusqu'au prochain arrêt, puis retour au pas à pas
+		if(!stepping && debug_armed(&dbg)){
+			if(!debug_continue(&dbg)){
+				halted = true;
+				break;
+			}
+			if(pmach->_trapbase != TRAP_NONE) pmach->_resume = &resume;
+			stepping = true;
+			continue;
+		}
+		//on s'arrête après HALT
+		if(!execute_decoded(pmach, pmach->_pc++)){
+			halted = true;
+			break;
+		}
+	}
+	if(!halted) execute_program(pmach, pmach->_trace);
+	pmach->_resume = NULL;
+	pmach->_abort = NULL;
+	if(debug){
+		//le point de reprise de la mise au point a fait taire l'exécution de HALT
+		warning(WARN_HALT, pmach->_pc - 1);
+		debug_end(&dbg);
+	}
+}
+
+/*!
+ * Exécution contrôlée par un programme hôte.
+ *
+ * Le point de reprise est établi ici, une fois pour toutes : une erreur y
+ * ramène directement depuis le traitant de l'instruction fautive (voir
+ * fault()).
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param budget le nombre maximal d'instructions à exécuter
+ * \return la raison de l'arrêt
+ */
+Run_Status run_program(Machine *pmach, uint64_t budget){
+	jmp_buf env;
+	//limite du compteur d'instructions (saturée)
+	uint64_t limit = (pmach->_steps + budget < budget) ? UINT64_MAX : pmach->_steps + budget;
+
+	pmach->_fault = ERR_NOERROR;
+	pmach->_abort = &env;
+	if(setjmp(env)){
+		pmach->_abort = NULL;
+		pmach->_resume = NULL;
+		return RUN_FAULT;
+	}
+	bool exhausted = execute_budget(pmach, limit);
+	pmach->_abort = NULL;
+	return exhausted ? RUN_BUDGET : RUN_HALT;
+}
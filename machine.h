@@ -6,9 +6,15 @@
  * \brief Description de la structure du processeur et de sa mémoire
  */
 
+#include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
 
 #include "instruction.h"
+#include "decode.h"
+#include "error.h"
 
 //! Nombre de resitres généraux
 #define NREGISTERS 16
@@ -34,9 +40,84 @@ typedef enum
 //! Dernière valeur possible du code condition
 static const unsigned LAST_CC = CC_N;
 
+//! Niveau de trace de la simulation
+/*!
+ * La trace affiche chaque instruction avant son exécution (voir trace()).
+ */
+typedef enum
+{
+    TRACE_OFF = 0,	//!< Aucune trace
+    TRACE_BRANCH,	//!< Branchements, appels et retours seulement
+    TRACE_FULL,		//!< Toutes les instructions
+} Trace_Level;
+
+//! Format du fichier binaire produit par dump_memory()
+typedef enum
+{
+    DUMP_RAW = 0,	//!< Ancien format (voir read_program())
+    DUMP_CONTAINER,	//!< Format conteneur (voir container.h)
+    DUMP_CONTAINER_LZ,	//!< Format conteneur, grandes sections compressées
+} Dump_Format;
+
+//! Raison de l'arrêt de run_program()
+typedef enum
+{
+    RUN_HALT = 0,	//!< Fin normale du programme (sur HALT)
+    RUN_FAULT,		//!< Erreur (voir \c _fault et \c _fault_addr)
+    RUN_BUDGET,		//!< Budget d'instructions épuisé
+} Run_Status;
+
+//! Table des trappes
+/*!
+ * Si l'hôte a installé une table des trappes (champ \c _trapbase de la
+ * machine), une erreur à l'exécution ne termine pas le programme : c'est une
+ * \e trappe. Le processeur range le code de l'erreur et l'adresse de
+ * l'instruction fautive dans la table, puis continue à l'adresse du traitant
+ * de cette erreur, lue dans la table. Le programme installe ses traitants en
+ * écrivant dans la table, qui fait partie du segment de données.
+ *
+ * Les trappes sont précises : l'instruction fautive n'a modifié ni les
+ * registres ni la mémoire. L'instruction RTT (retour de trappe) reprend
+ * l'exécution à l'adresse rangée dans la case TRAP_EPC, donc réexécute
+ * l'instruction fautive, à moins que le traitant n'ait modifié cette case ;
+ * elle restaure aussi le code condition.
+ *
+ * L'erreur est signalée à l'hôte comme en l'absence de table (voir fault())
+ * si la table ne tient pas dans le segment de données, si le traitant de
+ * l'erreur est à l'adresse 0 (pas de traitant) ou si l'erreur se produit
+ * dans un traitant, avant RTT (double faute). RTT hors d'un traitant est une
+ * instruction illégale.
+ */
+typedef enum
+{
+    TRAP_CAUSE = 0,	//!< Code de la dernière erreur (écrit par le processeur)
+    TRAP_EPC,		//!< Adresse de l'instruction fautive (écrite par le processeur, lue par RTT)
+    TRAP_VECTORS,	//!< Traitant de l'erreur \c e dans la case TRAP_VECTORS + \c e - 1
+} Trap_Slot;
+
+//! Taille de la table des trappes (en mots)
+#define TRAP_TABLESIZE (TRAP_VECTORS + LAST_ERROR)
+
+//! Pas de table des trappes
+#define TRAP_NONE (~0u)
+
+//! Sonde d'observation de l'exécution (voir probe.h)
+struct Probe;
+struct Snapshot;
+
 //! Taille minimale de la pile d'exécution
 static const unsigned MINSTACKSIZE = 10;
 
+//! Taille d'une page du segment de données (en mots)
+/*!
+ * Les segments de données alloués par le simulateur sont des projections
+ * anonymes (voir map_data()) : une page ne coûte de la mémoire qu'à sa
+ * première écriture, avant quoi c'est la page nulle du système, partagée.
+ * Les chargeurs ne recopient pas les pages nulles ; les listings, les
+ * vidages et les instantanés les sautent au lieu de les développer.
+ */
+#define DATA_PAGE_WORDS 1024
+
 //! Structure générale de la machine.
 /*!
  * Cette machine simple est composée de mémoire et d'un processeur. 
@@ -72,10 +153,17 @@ typedef struct
     // Segments de mémoire
     Instruction *_text;		//!< Mémoire pour les instructions
     unsigned int _textsize;	//!< Taille utilisée pour les instructions
+    Decoded_Text _decoded;	//!< Instructions pré-décodées (micro-opérations)
 
     Word *_data;		//!< Mémoire de données
     unsigned int _datasize;	//!< Taille utilisée pour les données
 
+    void *_textmap;		//!< Projection du fichier contenant \c _text (NULL si le segment est alloué)
+    size_t _textmaplen;		//!< Longueur de cette projection
+    void *_datamap;		//!< Projection contenant \c _data (NULL si le segment est alloué)
+    size_t _datamaplen;		//!< Longueur de cette projection
+    const struct Snapshot *_snapshot; //!< Instantané propriétaire du texte (voir fork_machine())
+
     unsigned int _dataend;      //!< Première adresse libre après les données statiques
 
     // Registres de l'unité centrale
@@ -85,12 +173,34 @@ typedef struct
 
 //! Définition de _sp comme synonyme du registre R15    
 #   define _sp _registers[NREGISTERS - 1] 
+
+    // Configuration de la simulation
+    Trace_Level _trace;		//!< Niveau de trace de simul() (TRACE_FULL au chargement)
+    Dump_Format _dumpformat;	//!< Format de dump.bin (DUMP_RAW au chargement)
+    struct Probe *_probes;	//!< Sondes attachées (aucune au chargement)
+    struct Recorder *_recorder;	//!< Enregistreur de l'exécution (voir record.h ; aucun au chargement)
+
+    // État de l'exécution
+    uint64_t _steps;		//!< Nombre d'instructions exécutées par l'interpréteur
+    Error _fault;		//!< Dernière erreur (ERR_NOERROR si aucune)
+    unsigned _fault_addr;	//!< Adresse de l'instruction fautive
+    jmp_buf *_abort;		//!< Point de reprise de l'hôte sur erreur (voir run_program())
+    bool _stop;			//!< Arrêt demandé par une sonde (voir execute_until())
+
+    // Trappes
+    unsigned _trapbase;		//!< Adresse de la table des trappes (TRAP_NONE au chargement)
+    bool _intrap;		//!< Dans un traitant de trappe (jusqu'à RTT) ?
+    Condition_Code _trapcc;	//!< Code condition au moment de la trappe (restauré par RTT)
+    jmp_buf *_resume;		//!< Point de reprise de la boucle d'exécution après une trappe
 } Machine;
 
 //! Chargement d'un programme
 /*!
  * La machine est réinitialisée et ses segments de texte et de données sont
- * remplacés par ceux fournis en paramètre.
+ * remplacés par ceux fournis en paramètre. Le segment de texte est décodé
+ * une fois pour toutes dans la table de micro-opérations de la machine,
+ * puis vérifié (voir verify.h) ; le tableau \c text reste utilisé pour
+ * l'affichage.
  *
  * \param pmach la machine en cours d'exécution
  * \param textsize taille utile du segment de texte
@@ -102,6 +212,25 @@ void load_program(Machine *pmach,
                   unsigned textsize, Instruction text[textsize],
                   unsigned datasize, Word data[datasize],  unsigned dataend);
 
+//! Chargement d'un programme déjà décodé
+/*!
+ * Comme load_program(), mais la table de micro-opérations du segment de
+ * texte est fournie, déjà vérifiée pour ces tailles de segments (voir
+ * verify_text()) : elle n'est pas reconstruite. La machine en devient
+ * responsable, sauf pour une copie d'instantané (voir fork_machine()).
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param textsize taille utile du segment de texte
+ * \param text le contenu du segment de texte
+ * \param decoded la table de micro-opérations de ce segment
+ * \param datasize taille utile du segment de données
+ * \param data le contenu initial du segment de texte
+ * \param dataend première adresse libre après les données statiques
+ */
+void load_decoded(Machine *pmach,
+                  unsigned textsize, Instruction text[textsize], Decoded_Text decoded,
+                  unsigned datasize, Word data[datasize], unsigned dataend);
+
 //! Lecture d'un programme depuis un fichier binaire
 /*!
  * Le fichier binaire a le format suivant :
@@ -117,7 +246,8 @@ void load_program(Machine *pmach,
  *    segment de données.
  *
  * Tous les entiers font 32 bits et les adresses de chaque segment commencent à
- * 0. La fonction initialise complétement la machine.
+ * 0. La fonction initialise complétement la machine. Le segment de texte
+ * est en lecture seule (voir load_binary()).
  *
  * \param pmach la machine à simuler
  * \param programfile le nom du fichier binaire
@@ -125,13 +255,92 @@ void load_program(Machine *pmach,
  */
 void read_program(Machine *mach, const char *programfile);  
  
+//! Lecture d'un programme sans arrêt du simulateur en cas d'erreur
+/*!
+ * Même format et même initialisation que read_program(), mais rien n'est
+ * affiché : si le fichier ne peut être lu, la fonction renvoie faux et \c
+ * errno indique la cause (\c ENOEXEC pour un fichier tronqué ou incohérent).
+ * La machine n'est alors pas modifiée.
+ *
+ * \param pmach la machine à simuler
+ * \param programfile le nom du fichier binaire
+ * \return vrai si le programme a été chargé
+ */
+bool load_binary(Machine *pmach, const char *programfile);
+
+//! Taille du segment de données en mémoire
+/*!
+ * La pile occupe au moins MINSTACKSIZE mots après les données statiques :
+ * le segment lu dans un fichier est agrandi si nécessaire.
+ *
+ * \param datasize taille du segment de données dans le fichier
+ * \param dataend première adresse libre après les données statiques
+ * \return la taille du segment en mémoire (en mots)
+ */
+unsigned data_memsize(unsigned datasize, unsigned dataend);
+
+//! Allocation d'un segment de données nul, en pages anonymes
+/*!
+ * Une page n'est matérialisée qu'à sa première écriture, et aucune réserve
+ * n'est faite pour les autres : un segment de plusieurs Go peu utilisé ne
+ * coûte que ses pages touchées. Le segment est libéré par free_program()
+ * une fois rangé, avec sa longueur, dans les champs \c _datamap et \c
+ * _datamaplen de la machine.
+ *
+ * \param memsize la taille du segment (en mots)
+ * \param plen la longueur de la projection (en octets)
+ * \return le segment, ou NULL (voir \c errno)
+ */
+Word *map_data(unsigned memsize, size_t *plen);
+
+//! Les mots sont-ils tous nuls ?
+/*!
+ * \param w les mots
+ * \param n leur nombre
+ * \return vrai si les \c n mots sont nuls
+ */
+bool zero_words(const Word *w, size_t n);
+
+//! Fin d'une suite de pages nulles du segment de données
+/*!
+ * \param pmach la machine
+ * \param addr une adresse de début de page
+ * \return la première adresse après les pages entièrement nulles (et
+ * entièrement dans le segment) qui commencent à \c addr ; \c addr s'il n'y
+ * en a pas
+ */
+unsigned zero_pages_end(const Machine *pmach, unsigned addr);
+
+//! Écriture des mots de données dans un fichier
+/*!
+ * Une page nulle est sautée (fseek()) plutôt qu'écrite quand le fichier le
+ * permet : elle y laisse un trou qui n'occupe pas le disque. Le dernier mot
+ * est toujours écrit, pour que le fichier ait sa taille.
+ *
+ * \param f le fichier, ouvert en écriture
+ * \param data les mots
+ * \param n leur nombre
+ * \return faux en cas d'erreur d'écriture
+ */
+bool write_data_pages(FILE *f, const Word *data, unsigned n);
+
+//! Libération des segments d'un programme lu dans un fichier
+/*!
+ * Libère les segments projetés ou alloués par read_program() ou
+ * load_binary() et la table de micro-opérations.
+ *
+ * \param pmach la machine
+ */
+void free_program(Machine *pmach);
+
 //! Affichage du programme et des données
 /*!
  * On affiche les instruction et les données en format hexadécimal, sous une
  * forme prête à être coupée-collée dans le simulateur.
  *
  * Pendant qu'on y est, on produit aussi un dump binaire dans le fichier
- * dump.prog. Le format de ce fichier est compatible avec l'option -b de
+ * dump.prog. Le format de ce fichier (ancien format ou format conteneur,
+ * selon le champ \c _dumpformat) est compatible avec l'option -b de
  * test_simul.
  *
  * \param pmach la machine en cours d'exécution
@@ -165,12 +374,62 @@ void print_cpu(Machine *pmach);
 //! Simulation
 /*!
  * La boucle de simualtion est très simple : recherche de l'instruction
- * suivante (pointée par le compteur ordinal \c _pc) puis décodage et exécution
- * de l'instruction.
+ * suivante (pointée par le compteur ordinal \c _pc) dans la table de
+ * micro-opérations puis exécution de l'instruction.
+ *
+ * Les instructions sont tracées selon le niveau \c _trace de la machine.
+ * En dehors du mode de mise au point, la boucle est spécialisée pour ce
+ * niveau : au niveau TRACE_OFF, elle ne fait aucun test de trace.
  *
  * \param pmach la machine en cours d'exécution
  * \param debug mode de mise au point (pas à apas) ?
  */
 void simul(Machine *pmach, bool debug);
 
+//! Exécution contrôlée par un programme hôte
+/*!
+ * Exécute le programme sans trace ni mise au point, pour au plus \c budget
+ * instructions. Une erreur n'arrête pas le simulateur : elle est rangée dans
+ * \c _fault et \c _fault_addr et la fonction renvoie RUN_FAULT. Rien n'est
+ * affiché, même sur HALT.
+ *
+ * Le cas courant ne coûte rien : le point de reprise est établi une fois par
+ * appel et les traitants d'instruction ne testent aucun état de retour.
+ * Chaque appel à run_program() utilise sa propre machine : plusieurs
+ * machines peuvent être exécutées en parallèle par des threads différents.
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param budget le nombre maximal d'instructions à exécuter
+ * \return la raison de l'arrêt
+ */
+Run_Status run_program(Machine *pmach, uint64_t budget);
+
+//! Simulation par code enfilé direct
+/*!
+ * Second moteur d'exécution, de même sémantique que simul() : chaque
+ * traitant d'instruction se termine par son propre saut vers le traitant de
+ * l'instruction suivante (extension GNU C des étiquettes comme valeurs).
+ * Ce moteur ne produit pas de trace et n'offre pas de mode de mise au point.
+ * Si des sondes sont attachées à la machine (voir probe.h) ou si une table
+ * des trappes est installée, l'exécution est confiée à execute_program().
+ *
+ * \param pmach la machine en cours d'exécution
+ */
+void simul_threaded(Machine *pmach);
+
+//! Simulation par compilation à la volée (JIT) vers du code x86-64
+/*!
+ * Troisième moteur d'exécution, de même sémantique que simul() : les blocs
+ * de base du segment de texte sont traduits en code machine x86-64 à leur
+ * première exécution. Les instructions que le compilateur ne sait pas
+ * traiter, ainsi que les instructions fautives, sont exécutées par
+ * l'interpréteur : les erreurs sont signalées avec le même code et à la même
+ * adresse. Sur un autre processeur, ou si des sondes ou une table des
+ * trappes sont installées, on se replie sur simul_threaded(). Ce
+ * moteur ne produit pas de trace et n'offre pas de mode de mise au point.
+ *
+ * \param pmach la machine en cours d'exécution
+ */
+void simul_jit(Machine *pmach);
+
 #endif
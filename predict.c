@@ -0,0 +1,277 @@
+/*!
+ * \file predict.c
+ * \brief Modèles de prédicteurs de branchements.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "predict.h"
+
+//! Noms des sortes de prédicteurs
+static const char *kind_names[] = { "static", "bimodal", "gshare", "ras" };
+
+//! Lecture d'une description
+static bool parse_one(Predictor_Config *pconf, const char *spec, size_t len){
+	char buf[64], name[16], extra[2];
+	int n;
+
+	if(len >= sizeof(buf)) return false;
+	memcpy(buf, spec, len);
+	buf[len] = '\0';
+	pconf->_size = pconf->_history = 0;
+	n = sscanf(buf, "%15[a-z]:%u:%u%1s", name, &pconf->_size, &pconf->_history, extra);
+	for(pconf->_kind = PREDICT_STATIC ; pconf->_kind <= PREDICT_RAS ; pconf->_kind++){
+		if(strcmp(name, kind_names[pconf->_kind]) == 0) break;
+	}
+	switch(pconf->_kind){
+		case PREDICT_STATIC :
+			return n == 1 && strcmp(buf, name) == 0;
+		case PREDICT_BIMODAL :
+			return n == 2 && pconf->_size && pconf->_size <= PREDICT_MAXBITS;
+		case PREDICT_GSHARE :
+			return n == 3 && pconf->_size && pconf->_size <= PREDICT_MAXBITS && pconf->_history <= 32;
+		case PREDICT_RAS :
+			return n == 2 && pconf->_size && pconf->_size <= PREDICT_MAXRAS;
+		default:
+			return false;
+	}
+}
+
+/*!
+ * \param pconfs les paramètres lus
+ * \param spec la liste
+ * \param pn le nombre de prédicteurs lus
+ * \return faux si la liste est invalide
+ */
+bool parse_predictors(Predictor_Config *pconfs, const char *spec, unsigned *pn){
+	*pn = 0;
+	for(;;){
+		size_t len = strcspn(spec, ",");
+		if(*pn == PREDICT_MAX || !parse_one(&pconfs[(*pn)++], spec, len)){
+			errno = EINVAL;
+			return false;
+		}
+		if(!spec[len]) return true;
+		spec += len + 1;
+	}
+}
+
+//! Comptage d'une prédiction
+static inline void record(Predictor *ppred, unsigned addr, bool wrong){
+	ppred->_predictions++;
+	ppred->_pc_predictions[addr]++;
+	if(wrong){
+		ppred->_mispredicts++;
+		ppred->_pc_mispredicts[addr]++;
+	}
+}
+
+//! Prédiction et mise à jour d'un compteur à saturation de 2 bits
+static inline bool counter_predict(uint8_t *pc, bool taken){
+	bool predicted = *pc >= 2;
+	if(taken && *pc < 3) ++*pc;
+	if(!taken && *pc > 0) --*pc;
+	return predicted;
+}
+
+//! Sonde : décision d'un branchement ou d'un appel
+static void on_branch(Probe *pp, Machine *pmach, unsigned addr, bool taken){
+	Predictor *ppred = (Predictor *) pp;
+	Instruction instr = pmach->_text[addr];
+	unsigned mask = (1u << ppred->_config._size) - 1;
+	bool predicted;
+
+	//les branchements inconditionnels ne sont pas prédits
+	if(instr.instr_generic._regcond == NC) return;
+	switch(ppred->_config._kind){
+		case PREDICT_STATIC :
+			predicted = pmach->_decoded._mode[addr] == ADDR_ABSOLUTE && (unsigned) pmach->_decoded._operand[addr] <= addr;
+			break;
+		case PREDICT_BIMODAL :
+			predicted = counter_predict(&ppred->_counters[addr & mask], taken);
+			break;
+		case PREDICT_GSHARE : {
+			uint32_t history = ppred->_config._history < 32
+			                   ? ppred->_ghr & ((1u << ppred->_config._history) - 1) : ppred->_ghr;
+			predicted = counter_predict(&ppred->_counters[(addr ^ history) & mask], taken);
+			ppred->_ghr = ppred->_ghr << 1 | taken;
+			break;
+		}
+		default:
+			return;
+	}
+	record(ppred, addr, predicted != taken);
+}
+
+//! Sonde : appel de sous-programme (l'adresse de retour est \c _pc)
+static void on_call(Probe *pp, Machine *pmach, unsigned addr, unsigned target){
+	Predictor *ppred = (Predictor *) pp;
+	unsigned depth = ppred->_config._size;
+	//la plus ancienne adresse est écrasée quand la pile est pleine
+	ppred->_ras_top = (ppred->_ras_top + 1) % depth;
+	ppred->_ras[ppred->_ras_top] = pmach->_pc;
+	if(ppred->_ras_count < depth) ppred->_ras_count++;
+}
+
+//! Sonde : retour de sous-programme (la cible réelle est \c _pc)
+static void on_ret(Probe *pp, Machine *pmach, unsigned addr){
+	Predictor *ppred = (Predictor *) pp;
+	unsigned depth = ppred->_config._size;
+	bool wrong = true;
+
+	if(ppred->_ras_count){
+		wrong = ppred->_ras[ppred->_ras_top] != pmach->_pc;
+		ppred->_ras_top = (ppred->_ras_top + depth - 1) % depth;
+		ppred->_ras_count--;
+	}
+	record(ppred, addr, wrong);
+}
+
+//! Allocation d'un tableau nul
+static void *predict_alloc(size_t n, size_t size){
+	void *p = calloc(n ? n : 1, size);
+	if(!p){
+		perror("Erreur d'allocation mémoire pour le prédicteur dans <predict.c:predictor_start>");
+		exit(1);
+	}
+	return p;
+}
+
+/*!
+ * \param ppred le prédicteur
+ * \param pmach la machine à observer (déjà chargée)
+ * \param pconf les paramètres (valides)
+ */
+void predictor_start(Predictor *ppred, Machine *pmach, const Predictor_Config *pconf){
+	memset(ppred, 0, sizeof(Predictor));
+	ppred->_pmach = pmach;
+	ppred->_config = *pconf;
+	ppred->_pc_predictions = predict_alloc(pmach->_textsize, sizeof(uint64_t));
+	ppred->_pc_mispredicts = predict_alloc(pmach->_textsize, sizeof(uint64_t));
+
+	switch(pconf->_kind){
+		case PREDICT_BIMODAL :
+		case PREDICT_GSHARE :
+			//faiblement non pris
+			ppred->_counters = predict_alloc((size_t) 1 << pconf->_size, sizeof(uint8_t));
+			memset(ppred->_counters, 1, (size_t) 1 << pconf->_size);
+			/* FALLTHRU */
+		case PREDICT_STATIC :
+			ppred->_probe._branch = on_branch;
+			break;
+		case PREDICT_RAS :
+			ppred->_ras = predict_alloc(pconf->_size, sizeof(unsigned));
+			ppred->_probe._call = on_call;
+			ppred->_probe._ret = on_ret;
+			break;
+	}
+	attach_probe(pmach, &ppred->_probe);
+	ppred->_running = true;
+}
+
+/*!
+ * \param ppred le prédicteur
+ */
+void predictor_stop(Predictor *ppred){
+	if(!ppred->_running) return;
+	detach_probe(ppred->_pmach, &ppred->_probe);
+	ppred->_running = false;
+}
+
+//! Nom d'un prédicteur avec ses paramètres
+static const char *predictor_name(const Predictor *ppred, char *buf){
+	const Predictor_Config *pconf = &ppred->_config;
+	switch(pconf->_kind){
+		case PREDICT_STATIC :
+			return kind_names[pconf->_kind];
+		case PREDICT_GSHARE :
+			sprintf(buf, "%s:%u:%u", kind_names[pconf->_kind], pconf->_size, pconf->_history);
+			return buf;
+		default:
+			sprintf(buf, "%s:%u", kind_names[pconf->_kind], pconf->_size);
+			return buf;
+	}
+}
+
+//! Proportion en pour cent
+static inline double percent(uint64_t part, uint64_t whole){
+	return whole ? 100.0 * part / whole : 0;
+}
+
+//! Prédicteurs à comparer et critère de tri (qsort)
+static const Predictor *sort_preds;
+static unsigned sort_npreds;
+static uint64_t worst(unsigned addr){
+	uint64_t w = 0;
+	for(unsigned i = 0 ; i < sort_npreds ; i++){
+		if(sort_preds[i]._pc_mispredicts[addr] > w) w = sort_preds[i]._pc_mispredicts[addr];
+	}
+	return w;
+}
+static int by_mispredicts(const void *a, const void *b){
+	unsigned x = *(const unsigned *) a, y = *(const unsigned *) b;
+	uint64_t wx = worst(x), wy = worst(y);
+	if(wx != wy) return wx < wy ? 1 : -1;
+	return x < y ? -1 : x > y;
+}
+
+/*!
+ * \param preds les prédicteurs (arrêtés)
+ * \param n leur nombre
+ * \param top le nombre d'instructions à afficher
+ */
+void print_predictors(const Predictor *preds, unsigned n, unsigned top){
+	if(!n) return;
+	const Machine *pmach = preds[0]._pmach;
+	unsigned *order = predict_alloc(pmach->_textsize, sizeof(unsigned));
+	unsigned count = 0;
+	char name[32], cell[48];
+
+	printf("\n### BRANCH PREDICTION ###\n\n");
+	for(unsigned i = 0 ; i < n ; i++){
+		const Predictor *ppred = &preds[i];
+		printf("\t%-16s predictions : %12" PRIu64 ", mispredictions : %12" PRIu64 " (%.2f%%)\n",
+		       predictor_name(ppred, name), ppred->_predictions, ppred->_mispredicts,
+		       percent(ppred->_mispredicts, ppred->_predictions));
+	}
+
+	sort_preds = preds;
+	sort_npreds = n;
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		if(worst(addr)) order[count++] = addr;
+	}
+	qsort(order, count, sizeof(unsigned), by_mispredicts);
+	if(top > count) top = count;
+	printf("\n Mispredictions by instruction (wrong/predicted) :\n\n\t");
+	for(unsigned i = 0 ; i < n ; i++) printf("%-22s", predictor_name(&preds[i], name));
+	printf("\n");
+	for(unsigned j = 0 ; j < top ; j++){
+		unsigned addr = order[j];
+		printf("\t");
+		for(unsigned i = 0 ; i < n ; i++){
+			sprintf(cell, "%" PRIu64 "/%" PRIu64, preds[i]._pc_mispredicts[addr], preds[i]._pc_predictions[addr]);
+			printf("%-22s", cell);
+		}
+		printf("0x%04x : ", addr);
+		print_prefixed(text_prefix(pmach->_text, addr), pmach->_text[addr], addr);
+		printf("\n");
+	}
+	free(order);
+}
+
+/*!
+ * \param ppred le prédicteur (arrêté)
+ */
+void free_predictor(Predictor *ppred){
+	free(ppred->_counters);
+	free(ppred->_ras);
+	free(ppred->_pc_predictions);
+	free(ppred->_pc_mispredicts);
+	ppred->_counters = NULL;
+	ppred->_ras = NULL;
+	ppred->_pc_predictions = ppred->_pc_mispredicts = NULL;
+}
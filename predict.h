@@ -0,0 +1,128 @@
+#ifndef _PREDICT_H_
+#define _PREDICT_H_
+
+/*!
+ * \file predict.h
+ * \brief Modèles de prédicteurs de branchements.
+ *
+ * Chaque prédicteur est une sonde (voir probe.h) : plusieurs prédicteurs
+ * attachés à la même machine sont évalués côte à côte en une seule
+ * exécution. Un prédicteur de direction prédit les \c BRANCH et \c CALL
+ * conditionnels (les inconditionnels sont toujours pris et ne sont pas
+ * comptés) ; la pile d'adresses de retour prédit la cible des \c RET.
+ *
+ * Un prédicteur est décrit par son nom suivi de ses paramètres :
+ *
+ *    - \c static : pris si le branchement est vers l'arrière (cible absolue
+ *    inférieure ou égale à son adresse), non pris sinon ;
+ *
+ *    - \c bimodal:n : table de 2^n compteurs à saturation de 2 bits indexée
+ *    par l'adresse du branchement ;
+ *
+ *    - \c gshare:n:h : table de 2^n compteurs indexée par l'adresse du
+ *    branchement combinée (ou exclusif) avec les \c h derniers résultats de
+ *    branchement ;
+ *
+ *    - \c ras:n : pile circulaire de \c n adresses de retour, empilées par
+ *    les appels pris et comparées à la cible de chaque \c RET.
+ *
+ * Plusieurs descriptions se séparent par des virgules :
+ * \c static,bimodal:12,gshare:14:10,ras:16.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+#include "probe.h"
+
+//! Nombre maximal de prédicteurs d'une description
+#define PREDICT_MAX 8
+
+//! Nombre maximal de bits d'index d'une table de compteurs
+#define PREDICT_MAXBITS 24
+
+//! Profondeur maximale d'une pile d'adresses de retour
+#define PREDICT_MAXRAS 65536
+
+//! Sorte de prédicteur
+typedef enum
+{
+    PREDICT_STATIC = 0,     //!< Arrière pris, avant non pris
+    PREDICT_BIMODAL,        //!< Compteurs de 2 bits par adresse
+    PREDICT_GSHARE,         //!< Compteurs indexés par adresse et historique global
+    PREDICT_RAS,            //!< Pile d'adresses de retour
+} Predictor_Kind;
+
+//! Paramètres d'un prédicteur
+typedef struct
+{
+    Predictor_Kind _kind;   //!< Sorte
+    unsigned _size;         //!< Bits d'index de la table, ou profondeur de la pile
+    unsigned _history;      //!< Bits d'historique (gshare)
+} Predictor_Config;
+
+//! Prédicteur attaché à une machine
+typedef struct
+{
+    Probe _probe;               //!< Sonde (premier champ)
+    Machine *_pmach;            //!< Machine observée
+    Predictor_Config _config;   //!< Paramètres
+    bool _running;              //!< Sonde attachée ?
+
+    uint8_t *_counters;         //!< Compteurs à saturation (bimodal, gshare)
+    uint32_t _ghr;              //!< Historique global des résultats (gshare)
+    unsigned *_ras;             //!< Pile d'adresses de retour (circulaire)
+    unsigned _ras_top;          //!< Sommet de la pile
+    unsigned _ras_count;        //!< Nombre d'adresses dans la pile
+
+    uint64_t _predictions;      //!< Nombre de prédictions
+    uint64_t _mispredicts;      //!< Nombre de prédictions fausses
+    uint64_t *_pc_predictions;  //!< Prédictions, par adresse d'instruction
+    uint64_t *_pc_mispredicts;  //!< Prédictions fausses, par adresse d'instruction
+} Predictor;
+
+//! Lecture d'une liste de descriptions de prédicteurs
+/*!
+ * \param pconfs les paramètres lus (PREDICT_MAX au plus)
+ * \param spec la liste (voir predict.h)
+ * \param pn le nombre de prédicteurs lus
+ * \return faux si la liste est invalide (\c errno vaut \c EINVAL)
+ */
+bool parse_predictors(Predictor_Config *pconfs, const char *spec, unsigned *pn);
+
+//! Début de l'évaluation d'un prédicteur (tables remises à zéro)
+/*!
+ * \param ppred le prédicteur
+ * \param pmach la machine à observer (déjà chargée)
+ * \param pconf les paramètres (valides)
+ */
+void predictor_start(Predictor *ppred, Machine *pmach, const Predictor_Config *pconf);
+
+//! Fin de l'évaluation
+/*!
+ * La sonde est détachée. Sans effet si l'évaluation est déjà arrêtée.
+ *
+ * \param ppred le prédicteur
+ */
+void predictor_stop(Predictor *ppred);
+
+//! Affichage du bilan de plusieurs prédicteurs
+/*!
+ * Le taux de prédictions fausses de chaque prédicteur, puis les \c top
+ * instructions qui ont le plus de prédictions fausses pour l'un d'eux, avec
+ * leurs résultats pour chacun.
+ *
+ * \param preds les prédicteurs (arrêtés, observant la même machine)
+ * \param n leur nombre
+ * \param top le nombre d'instructions à afficher
+ */
+void print_predictors(const Predictor *preds, unsigned n, unsigned top);
+
+//! Libération des tables
+/*!
+ * \param ppred le prédicteur (arrêté)
+ */
+void free_predictor(Predictor *ppred);
+
+#endif
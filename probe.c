@@ -0,0 +1,34 @@
+/*!
+ * \file probe.c
+ * \brief Sondes d'observation de l'exécution.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stddef.h>
+#include "probe.h"
+
+/*!
+ * \param pmach la machine à observer
+ * \param pp la sonde (qui ne doit pas déjà être attachée)
+ */
+void attach_probe(Machine *pmach, Probe *pp){
+	Probe **link = &pmach->_probes;
+	//on cherche la fin de la liste
+	while(*link) link = &(*link)->_next;
+	pp->_next = NULL;
+	*link = pp;
+}
+
+/*!
+ * \param pmach la machine observée
+ * \param pp la sonde (sans effet si elle n'est pas attachée)
+ */
+void detach_probe(Machine *pmach, Probe *pp){
+	for(Probe **link = &pmach->_probes ; *link ; link = &(*link)->_next){
+		if(*link == pp){
+			*link = pp->_next;
+			pp->_next = NULL;
+			return;
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#ifndef _PROBE_H_
+#define _PROBE_H_
+
+/*!
+ * \file probe.h
+ * \brief Sondes d'observation de l'exécution.
+ */
+
+#include "machine.h"
+
+//! Sonde d'observation de l'exécution
+/*!
+ * Une sonde est un ensemble de fonctions de rappel que l'interpréteur invoque
+ * à chaque événement de l'exécution : début et fin d'une instruction, lecture
+ * et écriture d'un mot de données, décision d'un branchement ou d'un appel
+ * conditionnel, appel et retour de sous-programme. Un pointeur nul signifie que la sonde ne s'intéresse pas à
+ * l'événement correspondant.
+ *
+ * Les sondes attachées à une machine forment une liste chaînée. Tant que
+ * cette liste est vide, execute_program() utilise une boucle compilée sans
+ * aucun appel de sonde : l'observation ne coûte rien quand elle n'est pas
+ * utilisée. Une sonde concrète contient une structure Probe comme premier
+ * champ, de sorte que chaque fonction de rappel retrouve son propre état.
+ *
+ * Les moteurs simul_threaded() et simul_jit() ne savent pas appeler les
+ * sondes : si une sonde est attachée, ils se replient sur execute_program().
+ */
+typedef struct Probe Probe;
+
+struct Probe
+{
+    //! Avant l'exécution de l'instruction d'adresse \c addr
+    void (*_before)(Probe *pp, Machine *pmach, unsigned addr);
+    //! Après l'exécution (\c _pc désigne alors l'instruction suivante)
+    void (*_after)(Probe *pp, Machine *pmach, unsigned addr);
+    //! Lecture du mot de données d'adresse \c daddr
+    void (*_read)(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr);
+    //! Écriture de \c value à l'adresse \c daddr (l'ancienne valeur est encore en place)
+    void (*_write)(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr, Word value);
+    //! Décision d'un branchement ou d'un appel (\c taken : condition satisfaite)
+    void (*_branch)(Probe *pp, Machine *pmach, unsigned addr, bool taken);
+    //! Appel de \c target (l'adresse de retour vient d'être empilée en \c _sp + 1)
+    void (*_call)(Probe *pp, Machine *pmach, unsigned addr, unsigned target);
+    //! Retour (l'adresse de retour vient d'être dépilée de \c _sp vers \c _pc)
+    void (*_ret)(Probe *pp, Machine *pmach, unsigned addr);
+
+    Probe *_next;   //!< Sonde suivante attachée à la même machine
+};
+
+//! Attachement d'une sonde à une machine
+/*!
+ * La sonde est ajoutée en fin de liste : les sondes sont appelées dans
+ * l'ordre où elles ont été attachées.
+ *
+ * \param pmach la machine à observer
+ * \param pp la sonde (qui ne doit pas déjà être attachée)
+ */
+void attach_probe(Machine *pmach, Probe *pp);
+
+//! Détachement d'une sonde
+/*!
+ * \param pmach la machine observée
+ * \param pp la sonde (sans effet si elle n'est pas attachée)
+ */
+void detach_probe(Machine *pmach, Probe *pp);
+
+//! Notification du début d'une instruction
+static inline void probe_before(Machine *pmach, unsigned addr)
+{
+    for (Probe *pp = pmach->_probes; pp; pp = pp->_next)
+        if (pp->_before)
+            pp->_before(pp, pmach, addr);
+}
+
+//! Notification de la fin d'une instruction
+static inline void probe_after(Machine *pmach, unsigned addr)
+{
+    for (Probe *pp = pmach->_probes; pp; pp = pp->_next)
+        if (pp->_after)
+            pp->_after(pp, pmach, addr);
+}
+
+//! Notification d'une lecture de données
+static inline void probe_read(Machine *pmach, unsigned addr, unsigned daddr)
+{
+    for (Probe *pp = pmach->_probes; pp; pp = pp->_next)
+        if (pp->_read)
+            pp->_read(pp, pmach, addr, daddr);
+}
+
+//! Notification d'une écriture de données
+static inline void probe_write(Machine *pmach, unsigned addr, unsigned daddr, Word value)
+{
+    for (Probe *pp = pmach->_probes; pp; pp = pp->_next)
+        if (pp->_write)
+            pp->_write(pp, pmach, addr, daddr, value);
+}
+
+//! Notification de la décision d'un branchement ou d'un appel
+static inline void probe_branch(Machine *pmach, unsigned addr, bool taken)
+{
+    for (Probe *pp = pmach->_probes; pp; pp = pp->_next)
+        if (pp->_branch)
+            pp->_branch(pp, pmach, addr, taken);
+}
+
+//! Notification d'un appel de sous-programme
+static inline void probe_call(Machine *pmach, unsigned addr, unsigned target)
+{
+    for (Probe *pp = pmach->_probes; pp; pp = pp->_next)
+        if (pp->_call)
+            pp->_call(pp, pmach, addr, target);
+}
+
+//! Notification d'un retour de sous-programme
+static inline void probe_ret(Machine *pmach, unsigned addr)
+{
+    for (Probe *pp = pmach->_probes; pp; pp = pp->_next)
+        if (pp->_ret)
+            pp->_ret(pp, pmach, addr);
+}
+
+#endif
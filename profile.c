@@ -0,0 +1,240 @@
+/*!
+ * \file profile.c
+ * \brief Compteurs d'exécution (profil du programme simulé).
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+// clock_gettime() est POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include "profile.h"
+
+//! Instant présent (en secondes, horloge monotone)
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//! Allocation d'un tableau de compteurs nuls
+static uint64_t *counters(unsigned n){
+	uint64_t *p = calloc(n ? n : 1, sizeof(uint64_t));
+	if(!p){
+		perror("Erreur d'allocation mémoire pour le profil dans <profile.c:profile_start>");
+		exit(1);
+	}
+	return p;
+}
+
+//! Sonde : début d'une instruction
+static void on_before(Probe *pp, Machine *pmach, unsigned addr){
+	Profile *pprof = (Profile *) pp;
+	pprof->_total++;
+	pprof->_ops[pmach->_text[addr].instr_generic._cop]++;
+	pprof->_hits[addr]++;
+}
+
+//! Sonde : lecture d'un mot de données
+static void on_read(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr){
+	Profile *pprof = (Profile *) pp;
+	if(daddr < pmach->_datasize) pprof->_reads[daddr]++;
+}
+
+//! Sonde : écriture d'un mot de données
+static void on_write(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr, Word value){
+	Profile *pprof = (Profile *) pp;
+	if(daddr < pmach->_datasize) pprof->_writes[daddr]++;
+}
+
+//! Sonde : décision d'un branchement ou d'un appel
+/*!
+ * La cible d'un appel pris est calculée ici, avant que l'appel ne modifie
+ * quoi que ce soit ; une cible hors du segment de texte (l'appel échoue)
+ * n'est pas comptée.
+ */
+static void on_branch(Probe *pp, Machine *pmach, unsigned addr, bool taken){
+	Profile *pprof = (Profile *) pp;
+	Instruction instr = pmach->_text[addr];
+
+	if(instr.instr_generic._cop == BRANCH){
+		if(taken) pprof->_taken[addr]++;
+		else pprof->_not_taken[addr]++;
+	} else if(taken){
+		const Decoded_Text *pdec = &pmach->_decoded;
+		unsigned target = pdec->_mode[addr] == ADDR_INDEXED
+		                  ? pmach->_registers[pdec->_rindex[addr]] + pdec->_operand[addr]
+		                  : (unsigned) pdec->_operand[addr];
+		if(target < pmach->_textsize) pprof->_calls[target]++;
+	}
+}
+
+/*!
+ * \param pprof le profil
+ * \param pmach la machine à observer (déjà chargée)
+ */
+void profile_start(Profile *pprof, Machine *pmach){
+	memset(pprof, 0, sizeof(Profile));
+	pprof->_pmach = pmach;
+	pprof->_hits = counters(pmach->_textsize);
+	pprof->_taken = counters(pmach->_textsize);
+	pprof->_not_taken = counters(pmach->_textsize);
+	pprof->_calls = counters(pmach->_textsize);
+	pprof->_reads = counters(pmach->_datasize);
+	pprof->_writes = counters(pmach->_datasize);
+
+	pprof->_probe._before = on_before;
+	pprof->_probe._read = on_read;
+	pprof->_probe._write = on_write;
+	pprof->_probe._branch = on_branch;
+	attach_probe(pmach, &pprof->_probe);
+	pprof->_running = true;
+	pprof->_start = now();
+}
+
+/*!
+ * \param pprof le profil
+ */
+void profile_stop(Profile *pprof){
+	if(!pprof->_running) return;
+	pprof->_seconds = now() - pprof->_start;
+	detach_probe(pprof->_pmach, &pprof->_probe);
+	pprof->_running = false;
+}
+
+//! Débit en millions d'instructions par seconde
+static double mips(const Profile *pprof){
+	return pprof->_seconds > 0 ? pprof->_total / pprof->_seconds * 1e-6 : 0;
+}
+
+//! Adresses du texte par nombres d'exécutions décroissants (qsort)
+static const uint64_t *sort_hits;
+static int by_hits(const void *a, const void *b){
+	unsigned x = *(const unsigned *) a, y = *(const unsigned *) b;
+	if(sort_hits[x] != sort_hits[y]) return sort_hits[x] < sort_hits[y] ? 1 : -1;
+	return x < y ? -1 : x > y;
+}
+
+/*!
+ * \param pprof le profil (arrêté)
+ * \param top le nombre d'adresses à afficher
+ */
+void print_profile(const Profile *pprof, unsigned top){
+	const Machine *pmach = pprof->_pmach;
+	unsigned *order = malloc((pmach->_textsize ? pmach->_textsize : 1) * sizeof(unsigned));
+	unsigned n = 0;
+
+	if(!order){
+		perror("Erreur d'allocation mémoire pour le profil dans <profile.c:print_profile>");
+		exit(1);
+	}
+
+	printf("\n### PROFILE ###\n\n");
+	printf(" Instructions : %" PRIu64 ", time : %.6f s, MIPS : %.2f\n\n",
+	       pprof->_total, pprof->_seconds, mips(pprof));
+	for(unsigned cop = 0 ; cop < PROFILE_NCOPS ; cop++){
+		if(!pprof->_ops[cop]) continue;
+		if(cop <= LAST_COP) printf("\t%-6s : %" PRIu64 "\n", cop_names[cop], pprof->_ops[cop]);
+		else printf("\t0x%02x   : %" PRIu64 "\n", cop, pprof->_ops[cop]);
+	}
+
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		if(pprof->_hits[addr]) order[n++] = addr;
+	}
+	sort_hits = pprof->_hits;
+	qsort(order, n, sizeof(unsigned), by_hits);
+	if(top > n) top = n;
+	printf("\n Hot instructions :\n\n");
+	for(unsigned i = 0 ; i < top ; i++){
+		unsigned addr = order[i];
+		printf("\t%12" PRIu64 " %5.1f%%  0x%04x : ", pprof->_hits[addr],
+		       100.0 * pprof->_hits[addr] / pprof->_total, addr);
+		print_prefixed(text_prefix(pmach->_text, addr), pmach->_text[addr], addr);
+		if(pprof->_taken[addr] || pprof->_not_taken[addr]){
+			printf("\t(taken %" PRIu64 ", not taken %" PRIu64 ")",
+			       pprof->_taken[addr], pprof->_not_taken[addr]);
+		}
+		printf("\n");
+	}
+	free(order);
+}
+
+/*!
+ * \param pprof le profil (arrêté)
+ * \param f le fichier, ouvert en écriture
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_profile_json(const Profile *pprof, FILE *f){
+	const Machine *pmach = pprof->_pmach;
+	const char *sep;
+
+	fprintf(f, "{\n  \"instructions\": %" PRIu64 ",\n  \"seconds\": %.6f,\n  \"mips\": %.2f,\n",
+	        pprof->_total, pprof->_seconds, mips(pprof));
+
+	fprintf(f, "  \"opcodes\": {");
+	sep = "";
+	for(unsigned cop = 0 ; cop < PROFILE_NCOPS ; cop++){
+		if(!pprof->_ops[cop]) continue;
+		if(cop <= LAST_COP) fprintf(f, "%s\"%s\": %" PRIu64, sep, cop_names[cop], pprof->_ops[cop]);
+		else fprintf(f, "%s\"0x%02x\": %" PRIu64, sep, cop, pprof->_ops[cop]);
+		sep = ", ";
+	}
+	fprintf(f, "},\n");
+
+	fprintf(f, "  \"pcs\": [");
+	sep = "\n";
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		if(!pprof->_hits[addr]) continue;
+		fprintf(f, "%s    {\"pc\": %u, \"hits\": %" PRIu64 "}", sep, addr, pprof->_hits[addr]);
+		sep = ",\n";
+	}
+	fprintf(f, "\n  ],\n");
+
+	fprintf(f, "  \"branches\": [");
+	sep = "\n";
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		if(!pprof->_taken[addr] && !pprof->_not_taken[addr]) continue;
+		fprintf(f, "%s    {\"pc\": %u, \"taken\": %" PRIu64 ", \"not_taken\": %" PRIu64 "}",
+		        sep, addr, pprof->_taken[addr], pprof->_not_taken[addr]);
+		sep = ",\n";
+	}
+	fprintf(f, "\n  ],\n");
+
+	fprintf(f, "  \"calls\": [");
+	sep = "\n";
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		if(!pprof->_calls[addr]) continue;
+		fprintf(f, "%s    {\"target\": %u, \"count\": %" PRIu64 "}", sep, addr, pprof->_calls[addr]);
+		sep = ",\n";
+	}
+	fprintf(f, "\n  ],\n");
+
+	fprintf(f, "  \"data\": [");
+	sep = "\n";
+	for(unsigned addr = 0 ; addr < pmach->_datasize ; addr++){
+		if(!pprof->_reads[addr] && !pprof->_writes[addr]) continue;
+		fprintf(f, "%s    {\"addr\": %u, \"reads\": %" PRIu64 ", \"writes\": %" PRIu64 "}",
+		        sep, addr, pprof->_reads[addr], pprof->_writes[addr]);
+		sep = ",\n";
+	}
+	fprintf(f, "\n  ]\n}\n");
+
+	return !ferror(f);
+}
+
+/*!
+ * \param pprof le profil (arrêté)
+ */
+void free_profile(Profile *pprof){
+	free(pprof->_hits);
+	free(pprof->_taken);
+	free(pprof->_not_taken);
+	free(pprof->_calls);
+	free(pprof->_reads);
+	free(pprof->_writes);
+	pprof->_hits = pprof->_taken = pprof->_not_taken = NULL;
+	pprof->_calls = pprof->_reads = pprof->_writes = NULL;
+}
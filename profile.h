@@ -0,0 +1,100 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/*!
+ * \file profile.h
+ * \brief Compteurs d'exécution (profil du programme simulé).
+ *
+ * Le profileur est une sonde (voir probe.h) qui compte, pendant
+ * l'exécution : les instructions par code opération, les exécutions de
+ * chaque adresse du segment de texte, les branchements pris et non pris de
+ * chaque instruction \c BRANCH, les appels reçus par chaque cible de \c CALL
+ * et les lectures et écritures de chaque mot de données.
+ *
+ * Tant qu'il n'est pas attaché, il ne coûte rien : execute_program() utilise
+ * alors sa boucle compilée sans appel de sonde. Attaché, il force le moteur
+ * d'interprétation (les moteurs simul_threaded() et simul_jit() se replient
+ * sur lui), et la durée mesurée inclut le coût des compteurs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+#include "probe.h"
+
+//! Nombre de codes opérations distincts (champ de 6 bits)
+#define PROFILE_NCOPS 64
+
+//! Profil d'exécution
+typedef struct
+{
+    Probe _probe;               //!< Sonde (premier champ)
+    Machine *_pmach;            //!< Machine observée
+    bool _running;              //!< Sonde attachée ?
+
+    uint64_t _total;            //!< Nombre d'instructions exécutées
+    double _seconds;            //!< Durée de l'exécution (temps réel)
+    double _start;              //!< Instant de profile_start()
+
+    uint64_t _ops[PROFILE_NCOPS]; //!< Instructions exécutées par code opération
+    uint64_t *_hits;            //!< Exécutions de chaque adresse du texte
+    uint64_t *_taken;           //!< Branchements pris, par adresse de BRANCH
+    uint64_t *_not_taken;       //!< Branchements non pris, par adresse de BRANCH
+    uint64_t *_calls;           //!< Appels reçus, par adresse cible
+    uint64_t *_reads;           //!< Lectures de chaque mot de données
+    uint64_t *_writes;          //!< Écritures de chaque mot de données
+} Profile;
+
+//! Début du profil d'une machine
+/*!
+ * Les compteurs sont mis à zéro et la sonde attachée à la machine.
+ *
+ * \param pprof le profil
+ * \param pmach la machine à observer (déjà chargée)
+ */
+void profile_start(Profile *pprof, Machine *pmach);
+
+//! Fin du profil
+/*!
+ * La sonde est détachée et la durée de l'exécution arrêtée ; les compteurs
+ * restent disponibles jusqu'à free_profile(). Sans effet si le profil est
+ * déjà arrêté.
+ *
+ * \param pprof le profil
+ */
+void profile_stop(Profile *pprof);
+
+//! Affichage du bilan d'exécution
+/*!
+ * Nombre d'instructions, durée et débit (en millions d'instructions par
+ * seconde), instructions par code opération, puis les \c top adresses les
+ * plus exécutées, désassemblées par print_instruction().
+ *
+ * \param pprof le profil (arrêté)
+ * \param top le nombre d'adresses à afficher
+ */
+void print_profile(const Profile *pprof, unsigned top);
+
+//! Écriture du profil au format JSON
+/*!
+ * Un objet avec les champs \c instructions, \c seconds, \c mips, \c opcodes
+ * (nom → nombre), et les tableaux \c pcs (\c pc, \c hits), \c branches
+ * (\c pc, \c taken, \c not_taken), \c calls (\c target, \c count) et
+ * \c data (\c addr, \c reads, \c writes). Les tableaux ne contiennent que
+ * les entrées non nulles, par adresses croissantes.
+ *
+ * \param pprof le profil (arrêté)
+ * \param f le fichier, ouvert en écriture
+ * \return faux en cas d'erreur d'écriture (voir \c errno)
+ */
+bool write_profile_json(const Profile *pprof, FILE *f);
+
+//! Libération des compteurs
+/*!
+ * \param pprof le profil (arrêté)
+ */
+void free_profile(Profile *pprof);
+
+#endif
@@ -0,0 +1,464 @@
+/*!
+ * \file record.c
+ * \brief Enregistrement de l'exécution et exécution à rebours.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "record.h"
+#include "exec.h"
+
+/*
+ * Un enregistrement est écrit dans cet ordre (voir on_write() et
+ * on_after()) ; seul l'en-tête est toujours présent :
+ *
+ *   mots écrits      n x (adresse, ancienne valeur), 8 octets chacun
+ *   adresse          4 octets, sans REC_SEQ
+ *   registre         numéro, ancienne valeur (5 octets), avec REC_REG
+ *   état des trappes 1 octet (_intrap, _trapcc << 1), avec REC_TRAP
+ *   nombre de mots   1 octet, s'il y en a 3 ou plus
+ *   en-tête          1 octet
+ */
+
+//! Adresse déduite du compteur ordinal suivant (en-tête)
+#define REC_SEQ 1
+//! Position de l'ancien code condition (en-tête, 2 bits)
+#define REC_CC_SHIFT 1
+//! Ancien état des trappes présent (en-tête)
+#define REC_TRAP 8
+//! Ancienne valeur d'un registre présente (en-tête)
+#define REC_REG 16
+//! Position du nombre de mots écrits (en-tête, 2 bits ; 3 : octet suivant)
+#define REC_MEM_SHIFT 6
+//! Instruction qui ne modifie aucun registre (voir \c _regmap)
+#define REC_NOREG 0xff
+
+//! Enregistrement relu
+typedef struct {
+	bool _seq;		//!< Adresse déduite du compteur ordinal suivant ?
+	unsigned _pc;		//!< Adresse de l'instruction (sans \c _seq)
+	Condition_Code _cc;	//!< Ancien code condition
+	bool _trap;		//!< Ancien état des trappes présent ?
+	uint8_t _trapstate;	//!< Ancien état des trappes
+	bool _reg;		//!< Ancienne valeur d'un registre présente ?
+	unsigned _regnum;	//!< Numéro du registre
+	Word _regold;		//!< Ancienne valeur du registre
+	unsigned _nmem;		//!< Nombre de mots écrits
+	const uint8_t *_mem;	//!< Mots écrits
+} Undo_Record;
+
+//! Écriture d'un entier de 32 bits (sans contrainte d'alignement)
+static inline uint8_t *put32(uint8_t *p, uint32_t v){
+	memcpy(p, &v, sizeof(v));
+	return p + sizeof(v);
+}
+
+//! Lecture d'un entier de 32 bits (sans contrainte d'alignement)
+static inline uint32_t get32(const uint8_t *p){
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+//! Lecture à rebours d'un enregistrement
+/*!
+ * \param end la fin de l'enregistrement
+ * \param pr l'enregistrement relu
+ * \return le début de l'enregistrement
+ */
+static const uint8_t *parse(const uint8_t *end, Undo_Record *pr){
+	const uint8_t *p = end - 1;
+	unsigned h = *p;
+
+	pr->_seq = h & REC_SEQ;
+	pr->_cc = h >> REC_CC_SHIFT & 3;
+	pr->_nmem = h >> REC_MEM_SHIFT;
+	if(pr->_nmem == 3) pr->_nmem = *--p;
+	pr->_trap = h & REC_TRAP;
+	if(pr->_trap) pr->_trapstate = *--p;
+	pr->_reg = h & REC_REG;
+	if(pr->_reg){
+		p -= 1 + sizeof(Word);
+		pr->_regnum = p[0];
+		pr->_regold = get32(p + 1);
+	}
+	pr->_pc = 0;
+	if(!pr->_seq){
+		p -= sizeof(uint32_t);
+		pr->_pc = get32(p);
+	}
+	p -= pr->_nmem * 2 * sizeof(uint32_t);
+	pr->_mem = p;
+	return p;
+}
+
+//! Copie de l'état de la machine dans l'enregistreur
+static void sync(Recorder *prec){
+	const Machine *pmach = prec->_pmach;
+	prec->_steps = pmach->_steps;
+	prec->_cc = pmach->_cc;
+	prec->_intrap = pmach->_intrap;
+	prec->_trapcc = pmach->_trapcc;
+	memcpy(prec->_regs, pmach->_registers, sizeof(prec->_regs));
+	prec->_nmem = 0;
+}
+
+//! Ouverture d'un nouveau bloc du journal
+static void new_chunk(Recorder *prec){
+	Record_Chunk *pc = malloc(sizeof(Record_Chunk));
+	if(!pc){
+		perror("Erreur d'allocation mémoire pour le journal dans <record.c:new_chunk>");
+		exit(1);
+	}
+	pc->_prev = prec->_chunk;
+	pc->_len = 0;
+	prec->_chunk = pc;
+}
+
+//! Libération de tout le journal
+static void free_chunks(Recorder *prec){
+	while(prec->_chunk){
+		Record_Chunk *pc = prec->_chunk;
+		prec->_chunk = pc->_prev;
+		free(pc);
+	}
+	prec->_logged = false;
+}
+
+//! Sonde du rejeu : ancienne valeur d'un mot de données écrit
+static void on_write(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr, Word value){
+	(void) addr;
+	(void) value;
+	Recorder *prec = (Recorder *) pp;
+	Record_Chunk *pc = prec->_chunk;
+	uint8_t *p = pc->_bytes + pc->_len + 2 * sizeof(uint32_t) * prec->_nmem;
+	p = put32(p, daddr);
+	put32(p, pmach->_data[daddr]);
+	prec->_nmem++;
+}
+
+//! Sonde du rejeu : fin de l'enregistrement d'une instruction
+/*!
+ * Les mots écrits sont déjà en place (voir on_write()) ; on ajoute ce que
+ * l'instruction a changé depuis l'état copié après la précédente.
+ */
+static void on_after(Probe *pp, Machine *pmach, unsigned addr){
+	Recorder *prec = (Recorder *) pp;
+	Record_Chunk *pc = prec->_chunk;
+	uint8_t *p = pc->_bytes + pc->_len + 2 * sizeof(uint32_t) * prec->_nmem;
+	unsigned h = prec->_cc << REC_CC_SHIFT;
+	unsigned r = prec->_regmap[addr];
+
+	if(addr == pmach->_pc - 1) h |= REC_SEQ;
+	else p = put32(p, addr);
+	if(r != REC_NOREG && pmach->_registers[r] != prec->_regs[r]){
+		*p++ = r;
+		p = put32(p, prec->_regs[r]);
+		prec->_regs[r] = pmach->_registers[r];
+		h |= REC_REG;
+	}
+	if(pmach->_intrap != prec->_intrap || pmach->_trapcc != prec->_trapcc){
+		*p++ = prec->_intrap | prec->_trapcc << 1;
+		prec->_intrap = pmach->_intrap;
+		prec->_trapcc = pmach->_trapcc;
+		h |= REC_TRAP;
+	}
+	if(prec->_nmem >= 3){
+		*p++ = prec->_nmem;
+		h |= 3 << REC_MEM_SHIFT;
+	} else h |= prec->_nmem << REC_MEM_SHIFT;
+	*p++ = h;
+	pc->_len = p - pc->_bytes;
+	prec->_nmem = 0;
+	prec->_cc = pmach->_cc;
+	prec->_steps = pmach->_steps;
+	if(pc->_len > RECORD_CHUNK - RECORD_MAXREC) new_chunk(prec);
+}
+
+//! Sonde du rejeu : début d'une instruction
+/*!
+ * Une trappe ERR_SEGTEXT est délivrée entre deux instructions, sans
+ * notification (voir fault()) : ses effets n'appartiennent à aucun
+ * enregistrement. Le journal repart donc de l'instruction qui la suit ;
+ * revenir avant elle passe par un rejeu, qui s'arrête avant la délivrance.
+ */
+static void on_before(Probe *pp, Machine *pmach, unsigned addr){
+	(void) addr;
+	Recorder *prec = (Recorder *) pp;
+	if(pmach->_intrap == prec->_intrap && pmach->_trapcc == prec->_trapcc) return;
+	prec->_intrap = pmach->_intrap;
+	prec->_trapcc = pmach->_trapcc;
+	prec->_logstart = pmach->_steps;
+}
+
+//! Registre que l'instruction d'une adresse du texte peut modifier
+static unsigned written_register(const Machine *pmach, unsigned addr){
+	switch(pmach->_decoded._uop[addr]){
+		case UOP_LOAD_IMM : case UOP_LOAD_ABS : case UOP_LOAD_IDX :
+		case UOP_ADD_IMM : case UOP_ADD_ABS : case UOP_ADD_IDX :
+		case UOP_SUB_IMM : case UOP_SUB_ABS : case UOP_SUB_IDX :
+			return pmach->_decoded._regcond[addr];
+		case UOP_CALL_ABS : case UOP_CALL_IDX : case UOP_CALL_CHK : case UOP_RET :
+		case UOP_PUSH_IMM : case UOP_PUSH_ABS : case UOP_PUSH_IDX : case UOP_PUSH_CHK :
+		case UOP_POP_ABS : case UOP_POP_IDX : case UOP_POP_CHK :
+			return NREGISTERS - 1;
+		default :
+			return REC_NOREG;
+	}
+}
+
+//! Dernière instruction terminée
+/*!
+ * Une erreur qui arrête la machine au milieu d'une instruction (\c
+ * _fault_addr dans le texte) l'a déjà comptée dans \c _steps ; \c
+ * ERR_SEGTEXT sur le compteur ordinal est détectée avant.
+ */
+static uint64_t completed(const Machine *pmach){
+	if(pmach->_fault != ERR_NOERROR && pmach->_fault_addr < pmach->_textsize) return pmach->_steps - 1;
+	return pmach->_steps;
+}
+
+//! Reconstruction du journal par rejeu
+/*!
+ * La machine repart du dernier point de reprise qui précède l'instruction
+ * visée et exécute jusqu'à elle, sonde de l'enregistreur attachée seule.
+ *
+ * \param prec l'enregistreur
+ * \param steps la valeur de \c _steps visée (au moins record_first())
+ */
+static void replay(Recorder *prec, uint64_t steps){
+	Machine *pmach = prec->_pmach;
+	unsigned i = prec->_nchecks - 1;
+	while(i > 0 && prec->_checks[i]._steps >= steps) i--;
+	if(!restore_snapshot(pmach, &prec->_checks[i])){
+		perror("Erreur de retour à un point de reprise dans <record.c:replay>");
+		exit(1);
+	}
+	free_chunks(prec);
+	new_chunk(prec);
+	sync(prec);
+	prec->_logstart = pmach->_steps;
+
+	Probe *probes = pmach->_probes;
+	Recorder *recorder = pmach->_recorder;
+	prec->_probe._next = NULL;
+	pmach->_probes = &prec->_probe;
+	pmach->_recorder = NULL;
+	execute_budget(pmach, steps);
+	pmach->_probes = probes;
+	pmach->_recorder = recorder;
+	prec->_logged = true;
+}
+
+/*!
+ * \param prec l'enregistreur
+ */
+void record_checkpoint(Recorder *prec){
+	Machine *pmach = prec->_pmach;
+	//trop de points de reprise : on en garde un sur deux, dont le premier
+	if(prec->_nchecks == prec->_maxchecks){
+		unsigned n = 1;
+		for(unsigned i = 1 ; i < prec->_nchecks ; i++){
+			if(i % 2) free_snapshot(&prec->_checks[i]);
+			else prec->_checks[n++] = prec->_checks[i];
+		}
+		prec->_nchecks = n;
+		prec->_interval *= 2;
+	}
+	if(!take_snapshot(&prec->_checks[prec->_nchecks], pmach)){
+		perror("Erreur de prise d'un point de reprise dans <record.c:record_checkpoint>");
+		exit(1);
+	}
+	prec->_nchecks++;
+	prec->_nextcheck = pmach->_steps + prec->_interval;
+}
+
+/*!
+ * \param prec l'enregistreur
+ * \param pmach la machine à enregistrer (déjà chargée)
+ */
+void record_start(Recorder *prec, Machine *pmach){
+	size_t words = (size_t) pmach->_textsize + pmach->_datasize;
+	size_t bytes = words * sizeof(Word) + sizeof(Snapshot);
+
+	memset(prec, 0, sizeof(Recorder));
+	prec->_pmach = pmach;
+	prec->_regmap = malloc(pmach->_textsize ? pmach->_textsize : 1);
+	prec->_checks = malloc(RECORD_MAXCHECKS * sizeof(Snapshot));
+	if(!prec->_regmap || !prec->_checks){
+		perror("Erreur d'allocation mémoire pour l'enregistreur dans <record.c:record_start>");
+		exit(1);
+	}
+	for(unsigned a = 0 ; a < pmach->_textsize ; a++) prec->_regmap[a] = written_register(pmach, a);
+
+	//intervalle et nombre de points de reprise selon la taille du programme
+	prec->_interval = RECORD_CHECKPOINT_RATIO * (uint64_t) words;
+	if(prec->_interval < RECORD_CHECKPOINT_STEPS) prec->_interval = RECORD_CHECKPOINT_STEPS;
+	prec->_maxchecks = RECORD_MAXBYTES / bytes < RECORD_MAXCHECKS ? RECORD_MAXBYTES / bytes : RECORD_MAXCHECKS;
+	if(prec->_maxchecks < 2) prec->_maxchecks = 2;
+
+	prec->_probe._before = on_before;
+	prec->_probe._write = on_write;
+	prec->_probe._after = on_after;
+	record_checkpoint(prec);
+	pmach->_recorder = prec;
+}
+
+/*!
+ * \param prec l'enregistreur
+ */
+void record_stop(Recorder *prec){
+	if(record_running(prec)) prec->_pmach->_recorder = NULL;
+}
+
+/*!
+ * \param prec l'enregistreur (arrêté)
+ */
+void free_record(Recorder *prec){
+	free_chunks(prec);
+	for(unsigned i = 0 ; i < prec->_nchecks ; i++) free_snapshot(&prec->_checks[i]);
+	free(prec->_checks);
+	free(prec->_regmap);
+	prec->_regmap = NULL;
+	prec->_checks = NULL;
+	prec->_nchecks = prec->_maxchecks = 0;
+}
+
+/*!
+ * \param prec l'enregistreur
+ * \return la plus petite valeur de \c _steps à laquelle on peut revenir
+ */
+uint64_t record_first(const Recorder *prec){
+	return prec->_checks[0]._steps;
+}
+
+//! Note d'un mot écrit par l'instruction annulée
+static inline void undone(Recorder *prec, unsigned daddr){
+	if(prec->_nundone < RECORD_MAXWRITES) prec->_undone[prec->_nundone] = daddr;
+	prec->_nundone++;
+}
+
+/*!
+ * \param prec l'enregistreur
+ * \return faux si le début de l'enregistrement est atteint (rien n'est annulé)
+ */
+bool record_undo(Recorder *prec){
+	Machine *pmach = prec->_pmach;
+	uint64_t steps = completed(pmach);
+	Undo_Record r;
+
+	prec->_nundone = 0;
+	//instruction interrompue par une erreur : retour à l'état qui la précédait
+	if(steps != pmach->_steps){
+		replay(prec, steps);
+		return true;
+	}
+	pmach->_fault = ERR_NOERROR;
+	if(steps <= record_first(prec)) return false;
+	//journal absent, périmé (la machine est repartie en avant) ou épuisé
+	if(!prec->_logged || prec->_steps != steps || steps == prec->_logstart) replay(prec, steps);
+
+	//les blocs vidés sont libérés
+	Record_Chunk *pc = prec->_chunk;
+	while(pc->_len == 0){
+		prec->_chunk = pc->_prev;
+		free(pc);
+		pc = prec->_chunk;
+	}
+	const uint8_t *start = parse(pc->_bytes + pc->_len, &r);
+	for(unsigned i = r._nmem ; i-- > 0 ; ){
+		unsigned daddr = get32(r._mem + 8 * i);
+		pmach->_data[daddr] = get32(r._mem + 8 * i + 4);
+		undone(prec, daddr);
+	}
+	if(r._reg) pmach->_registers[r._regnum] = r._regold;
+	pmach->_pc = r._seq ? pmach->_pc - 1 : r._pc;
+	pmach->_cc = r._cc;
+	if(r._trap){
+		pmach->_intrap = r._trapstate & 1;
+		pmach->_trapcc = r._trapstate >> 1;
+	}
+	pmach->_steps--;
+	pc->_len = start - pc->_bytes;
+	sync(prec);
+	return true;
+}
+
+/*!
+ * \param prec l'enregistreur (attaché pour aller en avant)
+ * \param steps la valeur de \c _steps visée
+ * \return faux si cette instruction n'est plus (ou pas) enregistrée
+ */
+bool record_goto(Recorder *prec, uint64_t steps){
+	Machine *pmach = prec->_pmach;
+
+	//en avant : l'exécution est simplement poursuivie
+	if(steps > completed(pmach)){
+		if(!record_running(prec)) return false;
+		if(pmach->_fault != ERR_NOERROR) record_undo(prec);
+		//arrêt sur HALT : on revient juste avant
+		if(!execute_budget(pmach, steps)) record_undo(prec);
+		return true;
+	}
+	if(steps < record_first(prec)) return false;
+
+	//le journal couvre l'instruction visée : on annule les suivantes
+	if(pmach->_fault == ERR_NOERROR && prec->_logged && prec->_steps == pmach->_steps
+	   && steps >= prec->_logstart){
+		while(pmach->_steps > steps) record_undo(prec);
+	}
+	else replay(prec, steps);
+	return true;
+}
+
+//! Observation des écritures d'un mot (voir record_last_write())
+typedef struct {
+	Probe _probe;		//!< Sonde (premier champ)
+	unsigned _daddr;	//!< Adresse du mot observé
+	bool _found;		//!< Mot écrit ?
+	Record_Write _last;	//!< Dernière écriture du mot
+} Write_Watch;
+
+//! Sonde d'observation : écriture d'un mot de données
+static void on_watch(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr, Word value){
+	Write_Watch *pw = (Write_Watch *) pp;
+	if(daddr != pw->_daddr) return;
+	pw->_found = true;
+	pw->_last._step = pmach->_steps;
+	pw->_last._pc = addr;
+	pw->_last._old = pmach->_data[daddr];
+	pw->_last._new = value;
+}
+
+/*!
+ * \param prec l'enregistreur
+ * \param daddr l'adresse du mot
+ * \param pw la dernière écriture
+ * \return faux si le mot n'a pas été écrit depuis record_first()
+ */
+bool record_last_write(Recorder *prec, unsigned daddr, Record_Write *pw){
+	uint64_t end = prec->_pmach->_steps;
+	//du plus récent au plus ancien intervalle
+	for(unsigned i = prec->_nchecks ; i-- > 0 ; ){
+		const Snapshot *ps = &prec->_checks[i];
+		if(ps->_steps >= end) continue;
+		Machine mach;
+		Write_Watch watch = { ._daddr = daddr, ._found = false };
+		watch._probe._write = on_watch;
+		if(!fork_machine(&mach, ps)){
+			perror("Erreur de copie d'un point de reprise dans <record.c:record_last_write>");
+			exit(1);
+		}
+		attach_probe(&mach, &watch._probe);
+		run_program(&mach, end - ps->_steps);
+		free_program(&mach);
+		if(watch._found){
+			*pw = watch._last;
+			return true;
+		}
+		end = ps->_steps;
+	}
+	return false;
+}
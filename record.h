@@ -0,0 +1,217 @@
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+/*!
+ * \file record.h
+ * \brief Enregistrement de l'exécution et exécution à rebours.
+ *
+ * Le processeur est déterministe : l'état après n'importe quelle instruction
+ * se retrouve en repartant d'un état antérieur et en rejouant l'exécution.
+ * Pendant l'exécution, l'enregistreur ne fait donc que prendre des points de
+ * reprise complets (des instantanés, voir snapshot.h), toutes les \c
+ * _interval instructions. La boucle d'exécution s'arrête pour cela par le
+ * test qui borne déjà le nombre d'instructions (voir execute_budget()) :
+ * entre deux points de reprise, elle tourne à pleine vitesse, sans sonde.
+ *
+ * Pour revenir en arrière, l'enregistreur reconstruit le journal
+ * d'annulation de l'intervalle concerné : il repart du point de reprise qui
+ * le précède et rejoue l'exécution avec une sonde qui note, pour chaque
+ * instruction, ce qu'elle a écrasé, c'est-à-dire les anciennes valeurs du
+ * registre modifié, du code condition, de l'état des trappes et des mots de
+ * données écrits, ainsi que son adresse quand elle ne se déduit pas du
+ * compteur ordinal suivant. En appliquant ces enregistrements du plus récent
+ * au plus ancien, record_undo() ramène la machine une instruction en
+ * arrière. Le journal reste valable tant que la machine ne repart pas en
+ * avant.
+ *
+ * Un enregistrement occupe de 1 à quelques dizaines d'octets : un octet
+ * d'en-tête, écrit en dernier pour que le journal se relise à l'envers, puis
+ * seulement les effets présents. Une instruction séquentielle qui modifie un
+ * registre coûte 6 octets. Le journal est fait de blocs de RECORD_CHUNK
+ * octets ; un enregistrement ne chevauche jamais deux blocs.
+ *
+ * Le nombre de points de reprise est borné (RECORD_MAXCHECKS, et
+ * RECORD_MAXBYTES octets pour leurs copies du programme) : quand la borne
+ * est atteinte, un point sur deux est abandonné et l'intervalle doublé. Le
+ * début de l'exécution reste accessible ; seuls les rejeux s'allongent.
+ *
+ * Pendant l'enregistrement, la machine ne doit être modifiée que par ses
+ * propres instructions, sans quoi les rejeux divergeraient. Les moteurs
+ * simul_threaded() et simul_jit() ne savent pas s'arrêter aux points de
+ * reprise : ils se replient sur execute_program().
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "machine.h"
+#include "probe.h"
+#include "snapshot.h"
+
+//! Nombre minimal d'instructions entre deux points de reprise
+#define RECORD_CHECKPOINT_STEPS (UINT64_C(1) << 20)
+
+//! Rapport minimal entre cet intervalle et la taille du programme (en mots)
+/*!
+ * Un point de reprise coûte une copie du texte et du segment de données :
+ * l'intervalle est allongé pour un gros programme.
+ */
+#define RECORD_CHECKPOINT_RATIO 16
+
+//! Nombre maximal de points de reprise
+#define RECORD_MAXCHECKS 1024
+
+//! Taille maximale des copies du programme faites par les points de reprise (en octets)
+#define RECORD_MAXBYTES ((size_t) 1 << 30)
+
+//! Taille d'un bloc du journal (en octets)
+#define RECORD_CHUNK (1 << 20)
+
+//! Taille maximale d'un enregistrement (place réservée en fin de bloc)
+#define RECORD_MAXREC 64
+
+//! Nombre maximal d'adresses écrites retenues par record_undo()
+#define RECORD_MAXWRITES 4
+
+//! Bloc du journal
+typedef struct Record_Chunk
+{
+    struct Record_Chunk *_prev;	//!< Bloc précédent (plus ancien)
+    size_t _len;		//!< Nombre d'octets utilisés
+    uint8_t _bytes[RECORD_CHUNK]; //!< Enregistrements
+} Record_Chunk;
+
+//! Enregistreur
+/*!
+ * Une instruction modifie au plus un registre : celui de \c LOAD, \c ADD et
+ * \c SUB, ou \c SP pour les instructions de pile (les trappes ne touchent à
+ * aucun registre). La table \c _regmap le donne pour chaque adresse du
+ * texte : la sonde ne compare que lui à sa copie de l'état.
+ */
+typedef struct Recorder
+{
+    Probe _probe;		//!< Sonde qui tient le journal pendant un rejeu (premier champ)
+    Machine *_pmach;		//!< Machine enregistrée
+    uint8_t *_regmap;		//!< Registre modifié par chaque instruction
+
+    // Points de reprise
+    Snapshot *_checks;		//!< Points de reprise, du plus ancien au plus récent
+    unsigned _nchecks;		//!< Nombre de points de reprise
+    unsigned _maxchecks;	//!< Nombre maximal de points de reprise
+    uint64_t _interval;		//!< Nombre d'instructions entre deux points de reprise
+    uint64_t _nextcheck;	//!< Valeur de \c _steps du prochain point de reprise
+
+    // Journal d'annulation
+    Record_Chunk *_chunk;	//!< Bloc courant (le plus récent)
+    bool _logged;		//!< Journal reconstruit ?
+    uint64_t _logstart;		//!< Valeur de \c _steps au début du journal
+    unsigned _nmem;		//!< Écritures de l'instruction en cours déjà notées
+
+    // État de la machine après la dernière instruction du journal
+    uint64_t _steps;		//!< Nombre d'instructions exécutées
+    Condition_Code _cc;		//!< Code condition
+    bool _intrap;		//!< Dans un traitant de trappe ?
+    Condition_Code _trapcc;	//!< Code condition sauvegardé par la trappe
+    Word _regs[NREGISTERS];	//!< Registres
+
+    // Dernière instruction annulée par record_undo()
+    unsigned _nundone;		//!< Nombre de mots de données qu'elle avait écrits
+    unsigned _undone[RECORD_MAXWRITES]; //!< Adresses des premiers de ces mots
+} Recorder;
+
+//! Dernière écriture d'un mot de données (voir record_last_write())
+typedef struct
+{
+    uint64_t _step;		//!< Numéro de l'instruction (valeur de \c _steps après elle)
+    unsigned _pc;		//!< Adresse de l'instruction
+    Word _old;			//!< Valeur écrasée
+    Word _new;			//!< Valeur écrite
+} Record_Write;
+
+//! Début de l'enregistrement d'une machine
+/*!
+ * Un premier point de reprise est pris et l'enregistreur attaché à la
+ * machine (\c _recorder).
+ *
+ * \param prec l'enregistreur
+ * \param pmach la machine à enregistrer (déjà chargée)
+ */
+void record_start(Recorder *prec, Machine *pmach);
+
+//! Fin de l'enregistrement
+/*!
+ * L'enregistreur est détaché : il ne prend plus de point de reprise.
+ *
+ * \param prec l'enregistreur
+ */
+void record_stop(Recorder *prec);
+
+//! Libération du journal et des points de reprise
+/*!
+ * \param prec l'enregistreur (arrêté)
+ */
+void free_record(Recorder *prec);
+
+//! L'enregistreur est-il attaché à sa machine ?
+static inline bool record_running(const Recorder *prec)
+{
+    return prec->_pmach->_recorder == prec;
+}
+
+//! Prise d'un point de reprise
+/*!
+ * Appelée par la boucle d'exécution quand \c _steps atteint \c _nextcheck.
+ *
+ * \param prec l'enregistreur
+ */
+void record_checkpoint(Recorder *prec);
+
+//! Première instruction encore enregistrée
+/*!
+ * \param prec l'enregistreur
+ * \return la plus petite valeur de \c _steps à laquelle on peut revenir
+ */
+uint64_t record_first(const Recorder *prec);
+
+//! Retour une instruction en arrière
+/*!
+ * Si la machine s'est arrêtée sur une erreur au milieu d'une instruction
+ * (\c _fault, voir run_program()), c'est cette instruction qui est
+ * annulée : la machine revient dans l'état qui la précédait et \c _fault
+ * est effacé. Les adresses des mots de données que l'instruction annulée
+ * avait écrits sont rangées dans \c _undone.
+ *
+ * \param prec l'enregistreur
+ * \return faux si le début de l'enregistrement est atteint (rien n'est annulé)
+ */
+bool record_undo(Recorder *prec);
+
+//! Déplacement jusqu'à une instruction
+/*!
+ * La machine est amenée dans l'état qui suivait l'instruction numéro \c
+ * steps. En arrière, les instructions suivantes sont annulées si le journal
+ * les couvre ; sinon l'exécution est rejouée depuis le dernier point de
+ * reprise qui la précède. Une instruction future est atteinte en
+ * poursuivant l'exécution (sans trace) ; si \c HALT survient avant, la
+ * machine s'arrête juste avant lui.
+ *
+ * \param prec l'enregistreur (attaché pour aller en avant)
+ * \param steps la valeur de \c _steps visée
+ * \return faux si cette instruction n'est plus (ou pas) enregistrée
+ */
+bool record_goto(Recorder *prec, uint64_t steps);
+
+//! Dernière écriture d'un mot de données
+/*!
+ * Les intervalles entre points de reprise sont rejoués, du plus récent au
+ * plus ancien, sur une copie de la machine qui observe les écritures du mot.
+ *
+ * \param prec l'enregistreur
+ * \param daddr l'adresse du mot
+ * \param pw la dernière écriture
+ * \return faux si le mot n'a pas été écrit depuis record_first()
+ */
+bool record_last_write(Recorder *prec, unsigned daddr, Record_Write *pw);
+
+#endif
@@ -0,0 +1,151 @@
+/*!
+ * \file simul_asm.c
+ * \brief Assemblage d'un programme source (outil simul-asm)
+ *
+ * Le programme produit est dans le format accepté par read_program() :
+ * l'ancien format brut par défaut, ou le format conteneur (avec les
+ * symboles). La table des symboles peut aussi être écrite dans un fichier
+ * texte séparé (voir write_asm_symbols()).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asm.h"
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul-asm [options] file.asm\n");
+    printf("where options are:\n"
+           "\t-o outfile\tWrite the program into outfile (default: file.bin)\n"
+           "\t-F format\tFormat of the program: raw (default), container or lz (compressed container)\n"
+           "\t-s symfile\tAlso write the symbol table into symfile (one \"address T|D name\" per line)\n"
+           "\t-h\tprint this help message\n");
+}
+
+//! Nom du fichier produit par défaut : le source avec l'extension \c .bin
+/*!
+ * \param source le nom du source
+ * \return le nom (alloué)
+ */
+static char *default_output(const char *source)
+{
+    size_t len = strlen(source);
+    char *name = malloc(len + 5);
+
+    if (!name)
+    {
+        perror("Erreur d'allocation mémoire dans <simul_asm.c:default_output>");
+        exit(1);
+    }
+    strcpy(name, source);
+    if (len > 4 && strcmp(name + len - 4, ".asm") == 0)
+        name[len - 4] = '\0';
+    strcat(name, ".bin");
+    return name;
+}
+
+//! Programme principal
+/*!
+ * Les erreurs du source sont signalées sur la sortie d'erreur ; le code de
+ * retour est alors non nul et aucun fichier n'est écrit.
+ */
+int main(int argc, char *argv[])
+{
+    const char *source = NULL;
+    const char *output = NULL;
+    const char *symfile = NULL;
+    Dump_Format format = DUMP_RAW;
+
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] == '-' && argv[iarg][1] != '\0')
+        {
+            char option = argv[iarg][1];
+            if (option == 'h')
+            {
+                usage();
+                exit(EXIT_SUCCESS);
+            }
+            if (!strchr("oFs", option))
+            {
+                fprintf(stderr, "Unknown option: %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            if (iarg + 1 >= argc)
+            {
+                fprintf(stderr, "Missing argument after %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            ++iarg;
+            switch (option)
+            {
+            case 'o':
+                output = argv[iarg];
+                break;
+            case 's':
+                symfile = argv[iarg];
+                break;
+            case 'F':
+                if (strcmp(argv[iarg], "raw") == 0)
+                    format = DUMP_RAW;
+                else if (strcmp(argv[iarg], "container") == 0)
+                    format = DUMP_CONTAINER;
+                else if (strcmp(argv[iarg], "lz") == 0)
+                    format = DUMP_CONTAINER_LZ;
+                else
+                {
+                    fprintf(stderr, "Unknown format: %s\n", argv[iarg]);
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+        }
+        else if (!source)
+            source = argv[iarg];
+        else
+        {
+            fprintf(stderr, "Only one source file may be given\n");
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!source)
+    {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    Asm_Program prog;
+    if (!assemble_file(&prog, source, stderr))
+        exit(EXIT_FAILURE);
+
+    char *defout = output ? NULL : default_output(source);
+    if (!output)
+        output = defout;
+    FILE *f = fopen(output, "wb");
+    if (!f || !write_asm_program(&prog, f, format) || fclose(f) != 0)
+    {
+        perror(output);
+        exit(EXIT_FAILURE);
+    }
+    if (symfile)
+    {
+        if (!(f = fopen(symfile, "w")) || !write_asm_symbols(&prog, f) || fclose(f) != 0)
+        {
+            perror(symfile);
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(defout);
+    free_asm_program(&prog);
+    return 0;
+}
@@ -0,0 +1,388 @@
+/*!
+ * \file simul_batch.c
+ * \brief Exécution d'un lot de programmes en parallèle (outil simul-batch)
+ *
+ * Chaque programme est exécuté dans sa propre machine par run_program(), sur
+ * un ensemble de threads de l'hôte. Une erreur d'un programme n'arrête que
+ * ce programme. On écrit un enregistrement d'une ligne par programme, dans
+ * l'ordre des arguments :
+ *
+ * \code
+ * fichier état erreur adresse instructions pc cc R00 ... R15 empreinte
+ * \endcode
+ *
+ * où l'état est \c halt, \c fault ou \c budget ; l'erreur et son adresse
+ * valent \c - si le programme ne s'est pas arrêté sur une erreur ; les
+ * registres sont en hexadécimal ; l'empreinte est le FNV-1a sur 64 bits des
+ * mots du segment de données. Un programme qui ne peut être chargé donne la
+ * ligne <tt>fichier load "cause"</tt>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "machine.h"
+#include "error.h"
+
+//! Budget d'instructions par défaut de chaque programme
+#define DEFAULT_BUDGET 100000000ULL
+
+//! Place réservée dans un enregistrement en plus du nom du fichier
+#define LINE_MARGIN 512
+
+//! Liste de noms de fichiers
+typedef struct
+{
+    char **_names;      //!< Noms (alloués)
+    size_t _count;      //!< Nombre de noms
+    size_t _size;       //!< Taille allouée
+} File_List;
+
+//! Lot de programmes partagé par les threads
+typedef struct
+{
+    File_List *_files;          //!< Programmes à exécuter
+    char **_results;            //!< Enregistrement de chaque programme
+    uint64_t _budget;           //!< Budget d'instructions par programme
+    size_t _next;               //!< Prochain programme à exécuter
+    pthread_mutex_t _lock;      //!< Protège \c _next
+} Batch;
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul-batch [options] file-or-directory...\n");
+    printf("where options are:\n"
+           "\t-j threads\tNumber of host threads (default: number of CPUs)\n"
+           "\t-n budget\tMaximum number of instructions per program (default: %llu)\n"
+           "\t-l listfile\tAlso run the .bin files listed in listfile (one per line, - for stdin)\n"
+           "\t-o outfile\tWrite the results into outfile (default: standard output)\n"
+           "\t-h\tprint this help message\n"
+           "A directory stands for all the .bin files it contains.\n",
+           DEFAULT_BUDGET);
+}
+
+//! Ajout d'un nom à une liste
+/*!
+ * \param pl la liste
+ * \param name le nom (copié)
+ */
+static void add_file(File_List *pl, const char *name)
+{
+    if (pl->_count == pl->_size)
+    {
+        pl->_size = pl->_size ? 2 * pl->_size : 64;
+        if (!(pl->_names = realloc(pl->_names, pl->_size * sizeof(char *))))
+        {
+            perror("Erreur d'allocation mémoire dans <simul_batch.c:add_file>");
+            exit(1);
+        }
+    }
+    size_t len = strlen(name);
+    if (!(pl->_names[pl->_count] = malloc(len + 1)))
+    {
+        perror("Erreur d'allocation mémoire dans <simul_batch.c:add_file>");
+        exit(1);
+    }
+    memcpy(pl->_names[pl->_count++], name, len + 1);
+}
+
+//! Comparaison de deux noms pour qsort()
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+//! Ajout des fichiers .bin d'un répertoire, par ordre alphabétique
+/*!
+ * \param pl la liste
+ * \param dirname le répertoire
+ */
+static void add_directory(File_List *pl, const char *dirname)
+{
+    DIR *dir;
+    struct dirent *entry;
+    size_t first = pl->_count;
+
+    if (!(dir = opendir(dirname)))
+    {
+        perror(dirname);
+        exit(1);
+    }
+    while ((entry = readdir(dir)))
+    {
+        size_t len = strlen(entry->d_name);
+        if (len > 4 && strcmp(entry->d_name + len - 4, ".bin") == 0)
+        {
+            char path[strlen(dirname) + len + 2];
+            sprintf(path, "%s/%s", dirname, entry->d_name);
+            add_file(pl, path);
+        }
+    }
+    closedir(dir);
+    qsort(pl->_names + first, pl->_count - first, sizeof(char *), compare_names);
+}
+
+//! Ajout d'un fichier ou d'un répertoire
+/*!
+ * \param pl la liste
+ * \param name le nom du fichier ou du répertoire
+ */
+static void add_argument(File_List *pl, const char *name)
+{
+    struct stat st;
+
+    if (stat(name, &st) == 0 && S_ISDIR(st.st_mode))
+        add_directory(pl, name);
+    else
+        add_file(pl, name);
+}
+
+//! Ajout des fichiers cités dans une liste
+/*!
+ * \param pl la liste
+ * \param listfile le fichier contenant un nom par ligne (\c - : entrée standard)
+ */
+static void add_list(File_List *pl, const char *listfile)
+{
+    FILE *f = strcmp(listfile, "-") == 0 ? stdin : fopen(listfile, "r");
+    char line[4096];
+
+    if (!f)
+    {
+        perror(listfile);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0')
+            add_argument(pl, line);
+    }
+    if (f != stdin)
+        fclose(f);
+}
+
+//! Empreinte du segment de données (FNV-1a sur 64 bits, mot par mot)
+/*!
+ * \param pmach la machine
+ * \return l'empreinte
+ */
+static uint64_t data_hash(const Machine *pmach)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned i = 0; i < pmach->_datasize; i++)
+    {
+        hash ^= pmach->_data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//! Ajout formaté à la fin d'un enregistrement
+/*!
+ * Un enregistrement trop long est tronqué : on n'écrit plus rien une fois
+ * le tampon plein.
+ * \param buf le tampon
+ * \param size la taille du tampon
+ * \param pn le nombre de caractères déjà écrits (mis à jour)
+ * \param format le format, suivi de ses arguments
+ */
+static void append(char *buf, size_t size, size_t *pn, const char *format, ...)
+{
+    va_list ap;
+    int len;
+
+    if (*pn >= size)
+        return;
+    va_start(ap, format);
+    len = vsnprintf(buf + *pn, size - *pn, format, ap);
+    va_end(ap);
+    if (len > 0)
+        *pn += (size_t) len;
+}
+
+//! Exécution d'un programme et construction de son enregistrement
+/*!
+ * \param file le fichier binaire du programme
+ * \param budget le nombre maximal d'instructions
+ * \return l'enregistrement (alloué)
+ */
+static char *run_one(const char *file, uint64_t budget)
+{
+    static const char *status_names[] = { "halt", "fault", "budget" };
+    static const char cc_names[] = "UZPN";
+    Machine mach;
+    size_t size = strlen(file) + LINE_MARGIN;
+    char *buf = malloc(size);
+    size_t n = 0;
+
+    if (!buf)
+    {
+        perror("Erreur d'allocation mémoire dans <simul_batch.c:run_one>");
+        exit(1);
+    }
+    if (!load_binary(&mach, file))
+        append(buf, size, &n, "%s load \"%s\"", file, strerror(errno));
+    else
+    {
+        Run_Status status = run_program(&mach, budget);
+        if (status == RUN_FAULT)
+            append(buf, size, &n, "%s fault %s 0x%04x", file,
+                   error_name(mach._fault), mach._fault_addr);
+        else
+            append(buf, size, &n, "%s %s - -", file, status_names[status]);
+        append(buf, size, &n, " %" PRIu64 " 0x%04x %c",
+               mach._steps, mach._pc, cc_names[mach._cc & 3]);
+        for (int r = 0; r < NREGISTERS; r++)
+            append(buf, size, &n, " %08x", mach._registers[r]);
+        append(buf, size, &n, " %016" PRIx64, data_hash(&mach));
+        free_program(&mach);
+    }
+    return buf;
+}
+
+//! Thread d'exécution : prend les programmes un par un dans le lot
+/*!
+ * \param arg le lot (Batch)
+ */
+static void *worker(void *arg)
+{
+    Batch *pb = arg;
+
+    while (true)
+    {
+        pthread_mutex_lock(&pb->_lock);
+        size_t i = pb->_next++;
+        pthread_mutex_unlock(&pb->_lock);
+        if (i >= pb->_files->_count)
+            return NULL;
+        pb->_results[i] = run_one(pb->_files->_names[i], pb->_budget);
+    }
+}
+
+//! Exécution d'un lot de programmes
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-j n</dt><dd>nombre de threads (par défaut, nombre de processeurs).</dd>
+ *
+ *   <dt>-n budget</dt><dd>nombre maximal d'instructions exécutées par chaque
+ *   programme.</dd>
+ *
+ *   <dt>-l fichier</dt><dd>liste de programmes, un nom par ligne (\c - pour
+ *   l'entrée standard).</dd>
+ *
+ *   <dt>-o fichier</dt><dd>fichier des résultats (par défaut, la sortie
+ *   standard).</dd>
+ * </dl>
+ *
+ * Les autres arguments sont des fichiers binaires ou des répertoires (dont
+ * on exécute tous les fichiers \c .bin).
+ */
+int main(int argc, char *argv[])
+{
+    File_List files = { NULL, 0, 0 };
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t budget = DEFAULT_BUDGET;
+    FILE *out = stdout;
+
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] == '-' && argv[iarg][1] != '\0')
+        {
+            char option = argv[iarg][1];
+            if (option == 'h')
+            {
+                usage();
+                exit(EXIT_SUCCESS);
+            }
+            if (!strchr("jnlo", option))
+            {
+                fprintf(stderr, "Unknown option: %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            if (iarg + 1 >= argc)
+            {
+                fprintf(stderr, "Missing argument after %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            ++iarg;
+            switch (option)
+            {
+            case 'j':
+                nthreads = strtol(argv[iarg], NULL, 0);
+                break;
+            case 'n':
+                budget = strtoull(argv[iarg], NULL, 0);
+                break;
+            case 'l':
+                add_list(&files, argv[iarg]);
+                break;
+            case 'o':
+                if (!(out = fopen(argv[iarg], "w")))
+                {
+                    perror(argv[iarg]);
+                    exit(1);
+                }
+                break;
+            }
+        }
+        else
+            add_argument(&files, argv[iarg]);
+    }
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if ((size_t) nthreads > files._count)
+        nthreads = files._count ? files._count : 1;
+
+    Batch batch = { &files, calloc(files._count ? files._count : 1, sizeof(char *)), budget, 0 };
+    pthread_t threads[nthreads];
+
+    if (!batch._results)
+    {
+        perror("Erreur d'allocation mémoire dans <simul_batch.c:main>");
+        exit(1);
+    }
+    pthread_mutex_init(&batch._lock, NULL);
+    for (long t = 0; t < nthreads; t++)
+        if (pthread_create(&threads[t], NULL, worker, &batch) != 0)
+        {
+            perror("Erreur de création de thread dans <simul_batch.c:main>");
+            exit(1);
+        }
+    for (long t = 0; t < nthreads; t++)
+        pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&batch._lock);
+
+    fprintf(out, "# file status error address steps pc cc R00-R15 datahash\n");
+    for (size_t i = 0; i < files._count; i++)
+    {
+        fprintf(out, "%s\n", batch._results[i]);
+        free(batch._results[i]);
+        free(files._names[i]);
+    }
+    free(batch._results);
+    free(files._names);
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
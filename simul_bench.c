@@ -0,0 +1,543 @@
+/*!
+ * \file simul_bench.c
+ * \brief Mesure du débit des moteurs d'exécution (outil simul-bench)
+ *
+ * Des programmes synthétiques, construits directement sous forme
+ * d'instructions (\link Instruction \endlink), sont exécutés plusieurs fois
+ * par chaque moteur : simul() sans trace, simul_threaded(), simul_jit() et
+ * simul() sans trace avec enregistrement de l'exécution (\c record, voir
+ * record.h), qui mesure le surcoût de l'enregistreur.
+ * Chaque programme exerce une partie de l'interpréteur :
+ *
+ *    - \c alu : boucle serrée d'additions et de soustractions immédiates ;
+ *
+ *    - \c calls : récursion par \c CALL conditionnel et \c RET ;
+ *
+ *    - \c stack : empilements et dépilements (\c PUSH, \c POP) ;
+ *
+ *    - \c sweep : parcours indexé d'un tableau (lecture, écriture) ;
+ *
+ *    - \c branchy : branchement conditionnel sur des données aléatoires,
+ *    imprévisible pour le processeur hôte.
+ *
+ * Le nombre d'instructions de chaque programme et son état final sont
+ * d'abord établis par run_program() ; chaque exécution mesurée doit
+ * retrouver le même état. On écrit un enregistrement d'une ligne par
+ * programme et par moteur :
+ *
+ * \code
+ * programme moteur instructions répétitions moyenne écart-type min max
+ * \endcode
+ *
+ * où les quatre derniers champs sont des débits en millions d'instructions
+ * par seconde (temps écoulé) ; les lignes de commentaire commencent par \c #.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "machine.h"
+#include "error.h"
+#include "decode.h"
+#include "verify.h"
+#include "record.h"
+
+//! Nombre de répétitions par défaut de chaque mesure
+#define DEFAULT_REPEAT 5
+
+//! Nombre maximal d'instructions d'un programme synthétique
+#define BENCH_MAXTEXT 32
+
+//! Taille de la pile des programmes synthétiques (en mots)
+#define BENCH_STACK 256
+
+//! Facteur de longueur maximal (valeur immédiate positive sur 20 bits)
+#define MAX_SCALE 524287
+
+//! Nombre d'éléments des tableaux de \c sweep et \c branchy
+#define BENCH_ARRAY 4096
+
+//! Programme synthétique
+typedef struct
+{
+    Instruction _text[BENCH_MAXTEXT];   //!< Segment de texte
+    unsigned _textsize;                 //!< Taille utile du segment de texte
+    Word *_data;                        //!< Segment de données initial (alloué)
+    unsigned _datasize;                 //!< Taille du segment de données (pile comprise)
+    unsigned _dataend;                  //!< Première adresse libre après les données statiques
+} Bench_Program;
+
+//! Description d'un programme synthétique
+typedef struct
+{
+    const char *_name;                                  //!< Nom
+    void (*_build)(Bench_Program *pprog, unsigned scale); //!< Construction
+} Bench_Kind;
+
+//! Moteur d'exécution
+typedef struct
+{
+    const char *_name;                  //!< Nom (option -e de test_simul)
+    void (*_run)(Machine *pmach);       //!< Exécution jusqu'à HALT
+} Bench_Engine;
+
+//! Instruction à adressage absolu
+static Instruction absolute(Code_Op cop, unsigned regcond, unsigned address)
+{
+    Instruction instr = { .instr_absolute = { cop, false, false, regcond, address } };
+    return instr;
+}
+
+//! Instruction à valeur immédiate
+static Instruction immediate(Code_Op cop, unsigned reg, int value)
+{
+    Instruction instr = { .instr_immediate = { cop, true, false, reg, value } };
+    return instr;
+}
+
+//! Instruction à adressage indexé
+static Instruction indexed(Code_Op cop, unsigned reg, unsigned rindex, int offset)
+{
+    Instruction instr = { .instr_indexed = { cop, false, true, reg, rindex, offset } };
+    return instr;
+}
+
+//! Instruction sans opérande
+static Instruction generic(Code_Op cop)
+{
+    Instruction instr = { .instr_generic = { cop } };
+    return instr;
+}
+
+//! Allocation du segment de données : \c nstatic mots suivis de la pile
+static void alloc_data(Bench_Program *pprog, unsigned nstatic)
+{
+    pprog->_dataend = nstatic;
+    pprog->_datasize = nstatic + BENCH_STACK;
+    if (!(pprog->_data = calloc(pprog->_datasize, sizeof(Word))))
+    {
+        perror("Erreur d'allocation mémoire dans <simul_bench.c:alloc_data>");
+        exit(1);
+    }
+}
+
+//! Ajout d'une instruction ; renvoie son adresse
+static unsigned emit(Bench_Program *pprog, Instruction instr)
+{
+    pprog->_text[pprog->_textsize] = instr;
+    return pprog->_textsize++;
+}
+
+//! Début de la boucle de répétition (registre R6) ; renvoie son adresse
+static unsigned begin_scale(Bench_Program *pprog, unsigned scale)
+{
+    emit(pprog, immediate(LOAD, 6, scale));
+    return pprog->_textsize;
+}
+
+//! Fin de la boucle de répétition, puis HALT
+static void end_scale(Bench_Program *pprog, unsigned start)
+{
+    emit(pprog, immediate(SUB, 6, 1));
+    emit(pprog, absolute(BRANCH, GT, start));
+    emit(pprog, generic(HALT));
+}
+
+//! \c alu : 4000 × 1000 itérations de 6 instructions
+static void build_alu(Bench_Program *pprog, unsigned scale)
+{
+    alloc_data(pprog, 1);
+    unsigned start = begin_scale(pprog, scale);
+    emit(pprog, immediate(LOAD, 0, 4000));
+    unsigned outer = emit(pprog, immediate(LOAD, 1, 1000));
+    unsigned inner = emit(pprog, immediate(ADD, 2, 1));
+    emit(pprog, immediate(ADD, 3, 7));
+    emit(pprog, immediate(SUB, 4, 3));
+    emit(pprog, immediate(ADD, 5, 1));
+    emit(pprog, immediate(SUB, 1, 1));
+    emit(pprog, absolute(BRANCH, GT, inner));
+    emit(pprog, immediate(SUB, 0, 1));
+    emit(pprog, absolute(BRANCH, GT, outer));
+    end_scale(pprog, start);
+}
+
+//! \c calls : 80000 descentes récursives de profondeur 100
+static void build_calls(Bench_Program *pprog, unsigned scale)
+{
+    alloc_data(pprog, 1);
+    unsigned start = begin_scale(pprog, scale);
+    emit(pprog, immediate(LOAD, 0, 80000));
+    unsigned outer = emit(pprog, immediate(LOAD, 1, 100));
+    unsigned call = emit(pprog, absolute(CALL, NC, 0));
+    emit(pprog, immediate(SUB, 0, 1));
+    emit(pprog, absolute(BRANCH, GT, outer));
+    end_scale(pprog, start);
+    //sous-programme : R1 décrémenté, appel récursif tant qu'il est positif
+    unsigned sub = emit(pprog, immediate(SUB, 1, 1));
+    emit(pprog, absolute(CALL, GT, sub));
+    emit(pprog, generic(RET));
+    pprog->_text[call].instr_absolute._address = sub;
+}
+
+//! \c stack : 2500 × 1000 itérations de 3 empilements et 3 dépilements
+static void build_stack(Bench_Program *pprog, unsigned scale)
+{
+    alloc_data(pprog, 8);
+    pprog->_data[0] = 42;
+    pprog->_data[1] = 7;
+    unsigned start = begin_scale(pprog, scale);
+    emit(pprog, immediate(LOAD, 0, 2500));
+    unsigned outer = emit(pprog, immediate(LOAD, 1, 1000));
+    unsigned inner = emit(pprog, immediate(PUSH, 0, 5));
+    emit(pprog, absolute(PUSH, 0, 0));
+    emit(pprog, absolute(PUSH, 0, 1));
+    emit(pprog, absolute(POP, 0, 2));
+    emit(pprog, absolute(POP, 0, 3));
+    emit(pprog, absolute(POP, 0, 4));
+    emit(pprog, immediate(SUB, 1, 1));
+    emit(pprog, absolute(BRANCH, GT, inner));
+    emit(pprog, immediate(SUB, 0, 1));
+    emit(pprog, absolute(BRANCH, GT, outer));
+    end_scale(pprog, start);
+}
+
+//! \c sweep : 1000 parcours d'un tableau de BENCH_ARRAY mots
+static void build_sweep(Bench_Program *pprog, unsigned scale)
+{
+    alloc_data(pprog, BENCH_ARRAY);
+    for (unsigned i = 0; i < BENCH_ARRAY; i++)
+        pprog->_data[i] = i;
+    unsigned start = begin_scale(pprog, scale);
+    emit(pprog, immediate(LOAD, 0, 1000));
+    unsigned outer = emit(pprog, immediate(LOAD, 1, BENCH_ARRAY));
+    unsigned inner = emit(pprog, indexed(LOAD, 2, 1, -1));
+    emit(pprog, immediate(ADD, 2, 1));
+    emit(pprog, indexed(STORE, 2, 1, -1));
+    emit(pprog, indexed(ADD, 3, 1, -1));
+    emit(pprog, immediate(SUB, 1, 1));
+    emit(pprog, absolute(BRANCH, GT, inner));
+    emit(pprog, immediate(SUB, 0, 1));
+    emit(pprog, absolute(BRANCH, GT, outer));
+    end_scale(pprog, start);
+}
+
+//! \c branchy : 1200 parcours d'un tableau de bits aléatoires
+static void build_branchy(Bench_Program *pprog, unsigned scale)
+{
+    uint32_t x = 2463534242u;
+
+    alloc_data(pprog, BENCH_ARRAY);
+    for (unsigned i = 0; i < BENCH_ARRAY; i++)
+    {
+        //xorshift 32 bits : suite fixe d'une exécution à l'autre
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        pprog->_data[i] = x >> 31;
+    }
+    unsigned start = begin_scale(pprog, scale);
+    emit(pprog, immediate(LOAD, 0, 1200));
+    unsigned outer = emit(pprog, immediate(LOAD, 1, BENCH_ARRAY));
+    unsigned inner = emit(pprog, indexed(LOAD, 2, 1, -1));
+    unsigned branch = emit(pprog, absolute(BRANCH, EQ, 0));
+    emit(pprog, immediate(ADD, 3, 1));
+    pprog->_text[branch].instr_absolute._address =
+        emit(pprog, immediate(SUB, 1, 1));
+    emit(pprog, absolute(BRANCH, GT, inner));
+    emit(pprog, immediate(SUB, 0, 1));
+    emit(pprog, absolute(BRANCH, GT, outer));
+    end_scale(pprog, start);
+}
+
+//! Programmes synthétiques
+static const Bench_Kind kinds[] = {
+    { "alu", build_alu },
+    { "calls", build_calls },
+    { "stack", build_stack },
+    { "sweep", build_sweep },
+    { "branchy", build_branchy },
+};
+
+//! Nombre de programmes synthétiques
+#define NKINDS (sizeof(kinds) / sizeof(kinds[0]))
+
+//! Moteur \c switch : simul() sans trace
+static void run_switch(Machine *pmach)
+{
+    pmach->_trace = TRACE_OFF;
+    simul(pmach, false);
+}
+
+//! Moteur \c record : simul() sans trace, exécution enregistrée
+static void run_record(Machine *pmach)
+{
+    Recorder rec;
+    pmach->_trace = TRACE_OFF;
+    record_start(&rec, pmach);
+    simul(pmach, false);
+    record_stop(&rec);
+    free_record(&rec);
+}
+
+//! Moteurs d'exécution
+static const Bench_Engine engines[] = {
+    { "switch", run_switch },
+    { "threaded", simul_threaded },
+    { "jit", simul_jit },
+    { "record", run_record },
+};
+
+//! Nombre de moteurs
+#define NENGINES (sizeof(engines) / sizeof(engines[0]))
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul-bench [options] [program...]\n");
+    printf("where options are:\n"
+           "\t-r count\tNumber of timed runs per program and engine (default: %d)\n"
+           "\t-s scale\tMultiply the length of every program by scale (default: 1)\n"
+           "\t-e engines\tComma-separated engines to measure (default: switch,threaded,jit,record)\n"
+           "\t-o outfile\tWrite the results into outfile (default: standard output)\n"
+           "\t-h\tprint this help message\n"
+           "Programs are alu, calls, stack, sweep and branchy (default: all).\n"
+           "Each result line is: program engine instructions runs mean stddev min max,\n"
+           "where the last four fields are in millions of instructions per second.\n",
+           DEFAULT_REPEAT);
+}
+
+//! Temps écoulé en secondes
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//! Les registres et les données de deux machines sont-ils identiques ?
+static bool same_state(const Machine *pa, const Machine *pb)
+{
+    return pa->_pc == pb->_pc && pa->_cc == pb->_cc
+        && memcmp(pa->_registers, pb->_registers, sizeof(pa->_registers)) == 0
+        && memcmp(pa->_data, pb->_data, pa->_datasize * sizeof(Word)) == 0;
+}
+
+//! Mesure d'un programme par un ensemble de moteurs
+/*!
+ * \param out le fichier des résultats
+ * \param pkind le programme
+ * \param scale le facteur de longueur
+ * \param repeat le nombre d'exécutions mesurées
+ * \param selected les moteurs à mesurer
+ */
+static void bench_program(FILE *out, const Bench_Kind *pkind, unsigned scale,
+                          unsigned repeat, const bool selected[NENGINES])
+{
+    Bench_Program prog = { ._textsize = 0 };
+    Decoded_Text decoded;
+    Machine ref, mach;
+
+    pkind->_build(&prog, scale);
+    decode_text(&decoded, prog._textsize, prog._text);
+    verify_text(&decoded, prog._textsize, prog._datasize);
+
+    Word *refdata = malloc(prog._datasize * sizeof(Word));
+    Word *data = malloc(prog._datasize * sizeof(Word));
+    if (!refdata || !data)
+    {
+        perror("Erreur d'allocation mémoire dans <simul_bench.c:bench_program>");
+        exit(1);
+    }
+
+    //exécution de référence (et mise en température des caches de l'hôte)
+    memcpy(refdata, prog._data, prog._datasize * sizeof(Word));
+    load_decoded(&ref, prog._textsize, prog._text, decoded, prog._datasize, refdata, prog._dataend);
+    if (run_program(&ref, UINT64_MAX) != RUN_HALT)
+    {
+        fprintf(stderr, "%s: %s at 0x%04x\n", pkind->_name, error_name(ref._fault), ref._fault_addr);
+        exit(1);
+    }
+
+    for (unsigned e = 0; e < NENGINES; e++)
+    {
+        double sum = 0, sum2 = 0, min = INFINITY, max = 0;
+        if (!selected[e])
+            continue;
+        for (unsigned r = 0; r < repeat; r++)
+        {
+            memcpy(data, prog._data, prog._datasize * sizeof(Word));
+            load_decoded(&mach, prog._textsize, prog._text, decoded, prog._datasize, data, prog._dataend);
+
+            //le message de HALT n'est pas mesuré
+            fflush(stderr);
+            int saved = dup(STDERR_FILENO), null = open("/dev/null", O_WRONLY);
+            if (null >= 0)
+                dup2(null, STDERR_FILENO);
+            double start = now();
+            engines[e]._run(&mach);
+            double seconds = now() - start;
+            dup2(saved, STDERR_FILENO);
+            close(saved);
+            if (null >= 0)
+                close(null);
+
+            if (!same_state(&mach, &ref))
+            {
+                fprintf(stderr, "%s: engine %s diverges from run_program()\n",
+                        pkind->_name, engines[e]._name);
+                exit(1);
+            }
+            double mips = ref._steps / seconds / 1e6;
+            sum += mips;
+            sum2 += mips * mips;
+            if (mips < min)
+                min = mips;
+            if (mips > max)
+                max = mips;
+        }
+        double mean = sum / repeat;
+        double var = repeat > 1 ? (sum2 - sum * mean) / (repeat - 1) : 0;
+        fprintf(out, "%-8s %-8s %12" PRIu64 " %3u %10.2f %8.2f %10.2f %10.2f\n",
+                pkind->_name, engines[e]._name, ref._steps, repeat,
+                mean, var > 0 ? sqrt(var) : 0, min, max);
+        fflush(out);
+    }
+
+    free_decoded(&decoded);
+    free(prog._data);
+    free(refdata);
+    free(data);
+}
+
+//! Mesure du débit des moteurs d'exécution
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-r n</dt><dd>nombre d'exécutions mesurées par programme et par
+ *   moteur.</dd>
+ *
+ *   <dt>-s n</dt><dd>facteur de longueur des programmes (nombre
+ *   d'itérations de leur boucle externe).</dd>
+ *
+ *   <dt>-e moteurs</dt><dd>liste des moteurs à mesurer, séparés par des
+ *   virgules (par défaut, tous).</dd>
+ *
+ *   <dt>-o fichier</dt><dd>fichier des résultats (par défaut, la sortie
+ *   standard).</dd>
+ * </dl>
+ *
+ * Les autres arguments sont des noms de programmes synthétiques (par défaut,
+ * tous).
+ */
+int main(int argc, char *argv[])
+{
+    unsigned repeat = DEFAULT_REPEAT;
+    unsigned scale = 1;
+    bool selected[NENGINES];
+    bool wanted[NKINDS] = { false };
+    bool any = false;
+    FILE *out = stdout;
+
+    for (unsigned e = 0; e < NENGINES; e++)
+        selected[e] = true;
+
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] == '-' && argv[iarg][1] != '\0')
+        {
+            char option = argv[iarg][1];
+            if (option == 'h')
+            {
+                usage();
+                exit(EXIT_SUCCESS);
+            }
+            if (!strchr("rseo", option))
+            {
+                fprintf(stderr, "Unknown option: %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            if (iarg + 1 >= argc)
+            {
+                fprintf(stderr, "Missing argument after %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            ++iarg;
+            switch (option)
+            {
+            case 'r':
+                repeat = strtoul(argv[iarg], NULL, 0);
+                break;
+            case 's':
+                scale = strtoul(argv[iarg], NULL, 0);
+                if (scale < 1 || scale > MAX_SCALE)
+                {
+                    fprintf(stderr, "Scale must be between 1 and %d\n", MAX_SCALE);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'e':
+                for (unsigned e = 0; e < NENGINES; e++)
+                    selected[e] = false;
+                for (char *name = strtok(argv[iarg], ","); name; name = strtok(NULL, ","))
+                {
+                    unsigned e;
+                    for (e = 0; e < NENGINES && strcmp(name, engines[e]._name) != 0; e++);
+                    if (e == NENGINES)
+                    {
+                        fprintf(stderr, "Unknown engine: %s\n", name);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    selected[e] = true;
+                }
+                break;
+            case 'o':
+                if (!(out = fopen(argv[iarg], "w")))
+                {
+                    perror(argv[iarg]);
+                    exit(1);
+                }
+                break;
+            }
+        }
+        else
+        {
+            unsigned k;
+            for (k = 0; k < NKINDS && strcmp(argv[iarg], kinds[k]._name) != 0; k++);
+            if (k == NKINDS)
+            {
+                fprintf(stderr, "Unknown program: %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            wanted[k] = any = true;
+        }
+    }
+    if (repeat < 1)
+        repeat = 1;
+
+    fprintf(out, "# program  engine   instructions runs    mean MIPS   stddev   min MIPS   max MIPS\n");
+    for (unsigned k = 0; k < NKINDS; k++)
+    {
+        if (!any || wanted[k])
+            bench_program(out, &kinds[k], scale, repeat, selected);
+    }
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,749 @@
+/*!
+ * \file simul_gen.c
+ * \brief Génération de programmes aléatoires valides (outil simul-gen)
+ *
+ * Le programme produit est valide par construction : il passe la
+ * vérification au chargement (voir verify.h) et se termine toujours par \c
+ * HALT. Il est formé d'un programme principal (à l'adresse 0) et de
+ * sous-programmes répartis en niveaux d'appel : un sous-programme n'appelle
+ * que des sous-programmes de niveau plus profond, il n'y a donc pas de
+ * récursion. Chaque corps est une suite d'éléments tirés selon un mélange
+ * pondéré :
+ *
+ *    - \c nop, \c load, \c store, \c add, \c sub : une instruction, avec un
+ *    adressage immédiat, absolu ou indexé par R12 (positionné juste avant) ;
+ *    les données adressées restent dans la zone statique ;
+ *
+ *    - \c push : un \c PUSH, ou un \c POP d'un mot empilé auparavant dans le
+ *    même corps ; tout ce qui est empilé est dépilé à la fin du corps ;
+ *
+ *    - \c branch : un branchement conditionnel vers l'avant, par-dessus
+ *    quelques instructions de calcul ;
+ *
+ *    - \c call : un appel, conditionnel ou non, d'un sous-programme de
+ *    niveau plus profond ;
+ *
+ *    - \c loop : une boucle dont le compteur est rangé dans un mot réservé du
+ *    segment de données (R11 ne sert qu'à le décrémenter), de 1 à \c -i
+ *    itérations.
+ *
+ * Les registres R0 à R9 portent les calculs. Les mêmes options et la même
+ * graine donnent toujours le même programme.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "machine.h"
+
+//! Nombre maximal de mots empilés dans un même corps
+#define MAX_PENDING 8
+
+//! Plus grande adresse d'un segment (champ d'adresse de 20 bits)
+#define MAX_ADDRESS 0xfffff
+
+//! Registre d'index des adressages indexés
+#define REG_INDEX 12
+
+//! Registre de décrémentation des compteurs de boucle
+#define REG_LOOP 11
+
+//! Nombre de registres de calcul (R0 à R9)
+#define NCOMPUTE 10
+
+//! Sortes d'éléments d'un corps
+typedef enum
+{
+    ITEM_NOP = 0,
+    ITEM_LOAD,
+    ITEM_STORE,
+    ITEM_ADD,
+    ITEM_SUB,
+    ITEM_PUSH,
+    ITEM_BRANCH,
+    ITEM_CALL,
+    ITEM_LOOP,
+    NITEMS
+} Item_Kind;
+
+//! Noms des éléments (option -m)
+static const char *item_names[NITEMS] = {
+    "nop", "load", "store", "add", "sub", "push", "branch", "call", "loop"
+};
+
+//! Mélange par défaut
+static const unsigned default_mix[NITEMS] = { 1, 4, 2, 4, 3, 1, 2, 1, 1 };
+
+//! Adresse à reporter après placement des sous-programmes
+typedef enum
+{
+    FIX_NONE = 0,   //!< Aucune
+    FIX_LOCAL,      //!< Position dans le même sous-programme
+    FIX_CALL,       //!< Numéro de sous-programme appelé
+} Fixup;
+
+//! Instruction en cours de génération
+typedef struct
+{
+    Instruction _instr;     //!< Instruction
+    Fixup _fix;             //!< Adresse à reporter
+    unsigned _target;       //!< Position ou sous-programme cible
+} Gen_Instr;
+
+//! Sous-programme en cours de génération
+typedef struct
+{
+    Gen_Instr *_code;       //!< Instructions
+    unsigned _size;         //!< Nombre d'instructions
+    unsigned _alloc;        //!< Taille allouée
+    unsigned _level;        //!< Niveau d'appel (0 : programme principal)
+    unsigned _base;         //!< Adresse dans le segment de texte
+    uint64_t _cost;         //!< Nombre maximal d'instructions exécutées par un appel
+} Gen_Function;
+
+//! Paramètres et état du générateur
+typedef struct
+{
+    uint64_t _seed;             //!< Graine (état du générateur pseudo-aléatoire)
+    unsigned _textsize;         //!< Taille visée du segment de texte
+    unsigned _datasize;         //!< Taille de la zone de données statiques
+    unsigned _nfunctions;       //!< Nombre de sous-programmes
+    unsigned _loopdepth;        //!< Profondeur maximale d'imbrication des boucles
+    unsigned _calldepth;        //!< Profondeur maximale d'appel
+    unsigned _iterations;       //!< Nombre maximal d'itérations d'une boucle
+    unsigned _mix[NITEMS];      //!< Poids des éléments
+    unsigned _total;            //!< Somme des poids
+
+    Gen_Function *_functions;   //!< Programme principal puis sous-programmes
+    unsigned *_first;           //!< Premier sous-programme de chaque niveau
+    unsigned *_uncalled;        //!< Prochain sous-programme jamais appelé de chaque niveau
+    unsigned _nloops;           //!< Nombre de compteurs de boucle
+} Generator;
+
+//! Tirage pseudo-aléatoire (xorshift64*)
+static uint64_t next_random(Generator *pg)
+{
+    pg->_seed ^= pg->_seed >> 12;
+    pg->_seed ^= pg->_seed << 25;
+    pg->_seed ^= pg->_seed >> 27;
+    return pg->_seed * 2685821657736338717ULL;
+}
+
+//! Tirage dans [0, n[
+static unsigned pick(Generator *pg, unsigned n)
+{
+    return (next_random(pg) >> 32) % n;
+}
+
+//! Somme bornée (les coûts d'exécution peuvent déborder)
+static uint64_t sat_add(uint64_t a, uint64_t b)
+{
+    return a + b < a ? UINT64_MAX : a + b;
+}
+
+//! Produit borné
+static uint64_t sat_mul(uint64_t a, uint64_t b)
+{
+    return a && b > UINT64_MAX / a ? UINT64_MAX : a * b;
+}
+
+//! Ajout d'une instruction à un sous-programme ; renvoie sa position
+static unsigned emit(Gen_Function *pf, Instruction instr, Fixup fix, unsigned target)
+{
+    if (pf->_size == pf->_alloc)
+    {
+        pf->_alloc = pf->_alloc ? 2 * pf->_alloc : 256;
+        if (!(pf->_code = realloc(pf->_code, pf->_alloc * sizeof(Gen_Instr))))
+        {
+            perror("Erreur d'allocation mémoire dans <simul_gen.c:emit>");
+            exit(1);
+        }
+    }
+    pf->_code[pf->_size] = (Gen_Instr) { instr, fix, target };
+    return pf->_size++;
+}
+
+//! Instruction à adressage absolu
+static Instruction absolute(Code_Op cop, unsigned regcond, unsigned address)
+{
+    Instruction instr = { .instr_absolute = { cop, false, false, regcond, address } };
+    return instr;
+}
+
+//! Instruction à valeur immédiate
+static Instruction immediate(Code_Op cop, unsigned reg, int value)
+{
+    Instruction instr = { .instr_immediate = { cop, true, false, reg, value } };
+    return instr;
+}
+
+//! Instruction à adressage indexé
+static Instruction indexed(Code_Op cop, unsigned reg, unsigned rindex, int offset)
+{
+    Instruction instr = { .instr_indexed = { cop, false, true, reg, rindex, offset } };
+    return instr;
+}
+
+//! Instruction sans opérande
+static Instruction generic(Code_Op cop)
+{
+    Instruction instr = { .instr_generic = { cop } };
+    return instr;
+}
+
+//! Instruction à opérande de données : immédiat (si permis), absolu ou indexé
+/*!
+ * Un adressage indexé est précédé du chargement de R12 : l'adresse
+ * effective reste dans la zone statique.
+ *
+ * \return le nombre d'instructions émises
+ */
+static unsigned emit_operand(Generator *pg, Gen_Function *pf, Code_Op cop, unsigned reg, bool imm)
+{
+    unsigned mode = pick(pg, imm ? 3 : 2) + !imm;
+    unsigned addr = pick(pg, pg->_datasize);
+
+    switch (mode)
+    {
+    case 0:
+        emit(pf, immediate(cop, reg, (int) pick(pg, 2000) - 1000), FIX_NONE, 0);
+        return 1;
+    case 1:
+        emit(pf, absolute(cop, reg, addr), FIX_NONE, 0);
+        return 1;
+    default:
+    {
+        //déplacement dans [-64, 64], base positive
+        unsigned above = addr < 64 ? addr : 64;
+        int offset = (int) pick(pg, above + 65) - 64;
+        emit(pf, immediate(LOAD, REG_INDEX, addr - offset), FIX_NONE, 0);
+        emit(pf, indexed(cop, reg, REG_INDEX, offset), FIX_NONE, 0);
+        return 2;
+    }
+    }
+}
+
+//! Élément de calcul (\c nop, \c load, \c store, \c add ou \c sub)
+static unsigned emit_simple(Generator *pg, Gen_Function *pf, Item_Kind kind)
+{
+    static const Code_Op cops[] = { NOP, LOAD, STORE, ADD, SUB };
+    unsigned reg = pick(pg, NCOMPUTE);
+
+    if (kind == ITEM_NOP)
+    {
+        emit(pf, generic(NOP), FIX_NONE, 0);
+        return 1;
+    }
+    return emit_operand(pg, pf, cops[kind], reg, kind != ITEM_STORE);
+}
+
+//! Tirage d'un élément selon le mélange
+static Item_Kind pick_item(Generator *pg)
+{
+    unsigned w = pick(pg, pg->_total);
+    Item_Kind kind;
+    for (kind = 0; w >= pg->_mix[kind]; kind++)
+        w -= pg->_mix[kind];
+    return kind;
+}
+
+//! Génération d'un corps
+/*!
+ * \param pg le générateur
+ * \param pf le sous-programme en cours
+ * \param target le nombre d'instructions visé
+ * \param depth la profondeur d'imbrication des boucles
+ * \return le nombre maximal d'instructions exécutées par le corps
+ */
+static uint64_t gen_body(Generator *pg, Gen_Function *pf, unsigned target, unsigned depth)
+{
+    unsigned start = pf->_size, pending = 0;
+    uint64_t cost = 0;
+
+    while (pf->_size - start < target)
+    {
+        unsigned remaining = target - (pf->_size - start);
+        Item_Kind kind = pick_item(pg);
+
+        switch (kind)
+        {
+        case ITEM_PUSH:
+            if (pending == MAX_PENDING || (pending && pick(pg, 2)))
+            {
+                pending--;
+                cost += emit_operand(pg, pf, POP, 0, false);
+            }
+            else
+            {
+                pending++;
+                cost += emit_operand(pg, pf, PUSH, 0, true);
+            }
+            break;
+
+        case ITEM_BRANCH:
+        {
+            //condition quelconque, cible après 1 à 4 éléments de calcul
+            unsigned branch = emit(pf, absolute(BRANCH, pick(pg, LAST_CONDITION + 1), 0), FIX_LOCAL, 0);
+            cost++;
+            for (unsigned n = 1 + pick(pg, 4); n > 0; n--)
+                cost += emit_simple(pg, pf, ITEM_LOAD + pick(pg, 4));
+            pf->_code[branch]._target = pf->_size;
+            break;
+        }
+
+        case ITEM_CALL:
+        {
+            //un sous-programme du niveau suivant pas encore appelé, sinon
+            //n'importe quel sous-programme plus profond
+            unsigned level = pf->_level + 1, callee;
+            if (level > pg->_calldepth || pg->_first[level] > pg->_nfunctions)
+                break;
+            if (pg->_uncalled[level] < pg->_first[level + 1])
+                callee = pg->_uncalled[level]++;
+            else
+                callee = pg->_first[level] + pick(pg, pg->_nfunctions + 1 - pg->_first[level]);
+            unsigned cond = pick(pg, 2) ? NC : 1 + pick(pg, LAST_CONDITION);
+            emit(pf, absolute(CALL, cond, 0), FIX_CALL, callee);
+            cost = sat_add(cost, sat_add(1, pg->_functions[callee]._cost));
+            break;
+        }
+
+        case ITEM_LOOP:
+        {
+            if (depth >= pg->_loopdepth || remaining < 8
+                || pg->_datasize + pg->_nloops >= MAX_ADDRESS)
+                break;
+            unsigned counter = pg->_datasize + pg->_nloops++;
+            unsigned iterations = 1 + pick(pg, pg->_iterations);
+            unsigned size = 1 + pick(pg, remaining / 2);
+            emit(pf, immediate(LOAD, REG_LOOP, iterations), FIX_NONE, 0);
+            emit(pf, absolute(STORE, REG_LOOP, counter), FIX_NONE, 0);
+            unsigned top = pf->_size;
+            uint64_t body = gen_body(pg, pf, size, depth + 1);
+            emit(pf, absolute(LOAD, REG_LOOP, counter), FIX_NONE, 0);
+            emit(pf, immediate(SUB, REG_LOOP, 1), FIX_NONE, 0);
+            emit(pf, absolute(STORE, REG_LOOP, counter), FIX_NONE, 0);
+            emit(pf, absolute(BRANCH, GT, 0), FIX_LOCAL, top);
+            cost = sat_add(cost, sat_add(2, sat_mul(iterations, sat_add(body, 4))));
+            break;
+        }
+
+        default:
+            cost += emit_simple(pg, pf, kind);
+            break;
+        }
+    }
+
+    //la pile est rendue équilibrée
+    for (; pending > 0; pending--)
+        cost += emit_operand(pg, pf, POP, 0, false);
+    return cost;
+}
+
+//! Lecture du mélange \c nom=poids,...
+static bool parse_mix(unsigned mix[NITEMS], char *spec)
+{
+    for (char *item = strtok(spec, ","); item; item = strtok(NULL, ","))
+    {
+        char *eq = strchr(item, '=');
+        Item_Kind kind;
+        if (!eq)
+            return false;
+        *eq = '\0';
+        for (kind = 0; kind < NITEMS && strcmp(item, item_names[kind]) != 0; kind++);
+        if (kind == NITEMS)
+            return false;
+        mix[kind] = strtoul(eq + 1, NULL, 0);
+    }
+    return true;
+}
+
+//! Génération de tout le programme
+/*!
+ * Les sous-programmes les plus profonds sont générés d'abord : le coût d'un
+ * appel est alors connu. Les adresses sont reportées une fois tous les
+ * sous-programmes placés à la suite du programme principal.
+ *
+ * \param pg le générateur
+ * \param text le segment de texte (alloué)
+ * \param ptextsize sa taille
+ * \return le nombre maximal d'instructions exécutées
+ */
+static uint64_t generate(Generator *pg, Instruction **text, unsigned *ptextsize)
+{
+    unsigned nf = pg->_nfunctions + 1;
+    unsigned share = pg->_textsize / nf ? pg->_textsize / nf : 1;
+
+    if (!(pg->_functions = calloc(nf, sizeof(Gen_Function)))
+        || !(pg->_first = calloc(pg->_calldepth + 2, sizeof(unsigned)))
+        || !(pg->_uncalled = calloc(pg->_calldepth + 2, sizeof(unsigned))))
+    {
+        perror("Erreur d'allocation mémoire dans <simul_gen.c:generate>");
+        exit(1);
+    }
+    //niveaux contigus : les sous-programmes 1 à n répartis en calldepth niveaux
+    for (unsigned level = 0; level <= pg->_calldepth + 1; level++)
+    {
+        pg->_first[level] = !level ? 0 : !pg->_calldepth ? 1
+                            : 1 + ((level - 1) * pg->_nfunctions + pg->_calldepth - 1) / pg->_calldepth;
+        pg->_uncalled[level] = pg->_first[level];
+    }
+    for (unsigned f = 0; f < nf; f++)
+    {
+        unsigned level = 0;
+        while (level <= pg->_calldepth && pg->_first[level + 1] <= f)
+            level++;
+        pg->_functions[f]._level = level;
+    }
+
+    //les plus profonds d'abord
+    for (unsigned f = nf; f-- > 0;)
+    {
+        Gen_Function *pf = &pg->_functions[f];
+        pf->_cost = gen_body(pg, pf, share, 0);
+        if (!f)
+        {
+            //tout sous-programme est atteint : le programme principal appelle
+            //ceux du premier niveau que personne d'autre n'appelle
+            while (pg->_calldepth && pg->_uncalled[1] < pg->_first[2])
+            {
+                unsigned callee = pg->_uncalled[1]++;
+                emit(pf, absolute(CALL, NC, 0), FIX_CALL, callee);
+                pf->_cost = sat_add(pf->_cost, sat_add(1, pg->_functions[callee]._cost));
+            }
+        }
+        pf->_cost = sat_add(pf->_cost, 1);
+        emit(pf, generic(f ? RET : HALT), FIX_NONE, 0);
+    }
+
+    //placement puis report des adresses
+    *ptextsize = 0;
+    for (unsigned f = 0; f < nf; f++)
+    {
+        pg->_functions[f]._base = *ptextsize;
+        *ptextsize += pg->_functions[f]._size;
+    }
+    if (!(*text = calloc(*ptextsize, sizeof(Instruction))))
+    {
+        perror("Erreur d'allocation mémoire dans <simul_gen.c:generate>");
+        exit(1);
+    }
+    for (unsigned f = 0; f < nf; f++)
+    {
+        Gen_Function *pf = &pg->_functions[f];
+        for (unsigned i = 0; i < pf->_size; i++)
+        {
+            Instruction instr = pf->_code[i]._instr;
+            if (pf->_code[i]._fix == FIX_LOCAL)
+                instr.instr_absolute._address = pf->_base + pf->_code[i]._target;
+            else if (pf->_code[i]._fix == FIX_CALL)
+                instr.instr_absolute._address = pg->_functions[pf->_code[i]._target]._base;
+            (*text)[pf->_base + i] = instr;
+        }
+    }
+    return pg->_functions[0]._cost;
+}
+
+//! Écriture du programme binaire (ancien format, voir read_program())
+static bool write_bin(const char *file, const Instruction *text, unsigned textsize,
+                      const Word *data, unsigned datasize, unsigned dataend)
+{
+    unsigned header[3] = { textsize, datasize, dataend };
+    FILE *f = fopen(file, "wb");
+
+    if (!f)
+        return false;
+    bool ok = fwrite(header, sizeof(unsigned), 3, f) == 3
+        && fwrite(text, sizeof(Instruction), textsize, f) == textsize
+        && fwrite(data, sizeof(Word), datasize, f) == datasize;
+    return fclose(f) == 0 && ok;
+}
+
+//! Écriture du programme source (syntaxe de Examples/syntax.asm)
+/*!
+ * Les entrées de sous-programmes s'appellent \c main et \c fN, les cibles
+ * de branchements \c LN (où N est l'adresse).
+ */
+static bool write_asm(const char *file, const Generator *pg, const Instruction *text, unsigned textsize,
+                      const Word *data, unsigned datasize, unsigned dataend)
+{
+    FILE *f = fopen(file, "w");
+    bool *target = calloc(textsize ? textsize : 1, sizeof(bool));
+
+    if (!f || !target)
+    {
+        free(target);
+        if (f)
+            fclose(f);
+        return false;
+    }
+    for (unsigned addr = 0; addr < textsize; addr++)
+    {
+        Instruction instr = text[addr];
+        Code_Op cop = instr.instr_generic._cop;
+        if ((cop == BRANCH || cop == CALL) && !instr.instr_generic._indexed)
+            target[instr.instr_absolute._address] = true;
+    }
+
+    fprintf(f, "// Programme engendré par simul-gen\n\n        TEXT %u\n\n", textsize);
+    for (unsigned addr = 0, fn = 0; addr < textsize; addr++)
+    {
+        Instruction instr = text[addr];
+        Code_Op cop = instr.instr_generic._cop;
+        char label[16] = "";
+        char operand[32] = "";
+
+        if (fn <= pg->_nfunctions && pg->_functions[fn]._base == addr)
+        {
+            if (fn)
+                snprintf(label, sizeof(label), "f%u", fn);
+            else
+                strcpy(label, "main");
+            fn++;
+        }
+        else if (target[addr])
+            snprintf(label, sizeof(label), "L%u", addr);
+
+        if (instr.instr_generic._immediate)
+            snprintf(operand, sizeof(operand), "#%d", instr.instr_immediate._value);
+        else if (instr.instr_generic._indexed)
+            snprintf(operand, sizeof(operand), "%d[R%02u]", instr.instr_indexed._offset,
+                     instr.instr_indexed._rindex);
+        else if (cop == BRANCH || cop == CALL)
+        {
+            unsigned dest = instr.instr_absolute._address;
+            if (dest == 0)
+                snprintf(operand, sizeof(operand), "@main");
+            else
+            {
+                unsigned g;
+                for (g = 1; g <= pg->_nfunctions && pg->_functions[g]._base != dest; g++);
+                if (g <= pg->_nfunctions)
+                    snprintf(operand, sizeof(operand), "@f%u", g);
+                else
+                    snprintf(operand, sizeof(operand), "@L%u", dest);
+            }
+        }
+        else
+            snprintf(operand, sizeof(operand), "@%u", instr.instr_absolute._address);
+
+        fprintf(f, "%-7s %-7s", label, cop_names[cop]);
+        switch (cop)
+        {
+        case LOAD: case STORE: case ADD: case SUB:
+            fprintf(f, "R%02u, %s", instr.instr_generic._regcond, operand);
+            break;
+        case BRANCH: case CALL:
+            fprintf(f, "%s, %s", condition_names[instr.instr_generic._regcond], operand);
+            break;
+        case PUSH: case POP:
+            fprintf(f, "%s", operand);
+            break;
+        default:
+            break;
+        }
+        fprintf(f, "\n");
+    }
+
+    fprintf(f, "\n        END\n\n        DATA %u\n\n", datasize);
+    for (unsigned addr = 0; addr < dataend; addr++)
+        fprintf(f, "        WORD %" PRIu32 "\n", data[addr]);
+    fprintf(f, "\n        END\n");
+    free(target);
+    return fclose(f) == 0;
+}
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul-gen [options] binfile\n");
+    printf("where options are:\n"
+           "\t-s seed\tSeed of the pseudo-random generator (default: 1)\n"
+           "\t-n size\tApproximate number of instructions (default: 1000)\n"
+           "\t-d size\tNumber of static data words (default: 256)\n"
+           "\t-f count\tNumber of subroutines (default: size / 200)\n"
+           "\t-L depth\tMaximum loop nesting depth (default: 2)\n"
+           "\t-C depth\tMaximum call depth (default: 3)\n"
+           "\t-i count\tMaximum number of iterations of a loop (default: 8)\n"
+           "\t-m mix\tWeights of the program items, e.g. load=4,store=2,loop=0\n"
+           "\t\t(items: nop load store add sub push branch call loop)\n"
+           "\t-a asmfile\tAlso write the program in assembly language\n"
+           "\t-h\tprint this help message\n"
+           "The program is written into binfile; its size and an upper bound on the\n"
+           "number of executed instructions are printed.\n");
+}
+
+//! Génération d'un programme aléatoire
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-s graine</dt><dd>graine du générateur pseudo-aléatoire.</dd>
+ *
+ *   <dt>-n taille</dt><dd>nombre approximatif d'instructions.</dd>
+ *
+ *   <dt>-d taille</dt><dd>taille de la zone de données statiques ; les
+ *   compteurs de boucle et la pile sont placés après.</dd>
+ *
+ *   <dt>-f nombre</dt><dd>nombre de sous-programmes.</dd>
+ *
+ *   <dt>-L profondeur</dt><dd>profondeur maximale d'imbrication des boucles
+ *   (dans un même sous-programme).</dd>
+ *
+ *   <dt>-C profondeur</dt><dd>profondeur maximale d'appel.</dd>
+ *
+ *   <dt>-i nombre</dt><dd>nombre maximal d'itérations d'une boucle.</dd>
+ *
+ *   <dt>-m mélange</dt><dd>poids des éléments (voir simul_gen.c), par exemple
+ *   \c load=4,store=2,loop=0.</dd>
+ *
+ *   <dt>-a fichier</dt><dd>écriture du programme en langage d'assemblage.</dd>
+ * </dl>
+ */
+int main(int argc, char *argv[])
+{
+    Generator gen = {
+        ._seed = 1, ._textsize = 1000, ._datasize = 256, ._nfunctions = UINT32_MAX,
+        ._loopdepth = 2, ._calldepth = 3, ._iterations = 8,
+    };
+    const char *binfile = NULL, *asmfile = NULL;
+
+    memcpy(gen._mix, default_mix, sizeof(default_mix));
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] == '-' && argv[iarg][1] != '\0')
+        {
+            char option = argv[iarg][1];
+            if (option == 'h')
+            {
+                usage();
+                exit(EXIT_SUCCESS);
+            }
+            if (!strchr("sndfLCima", option))
+            {
+                fprintf(stderr, "Unknown option: %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            if (iarg + 1 >= argc)
+            {
+                fprintf(stderr, "Missing argument after %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            ++iarg;
+            switch (option)
+            {
+            case 's':
+                gen._seed = strtoull(argv[iarg], NULL, 0);
+                break;
+            case 'n':
+                gen._textsize = strtoul(argv[iarg], NULL, 0);
+                break;
+            case 'd':
+                gen._datasize = strtoul(argv[iarg], NULL, 0);
+                break;
+            case 'f':
+                gen._nfunctions = strtoul(argv[iarg], NULL, 0);
+                break;
+            case 'L':
+                gen._loopdepth = strtoul(argv[iarg], NULL, 0);
+                break;
+            case 'C':
+                gen._calldepth = strtoul(argv[iarg], NULL, 0);
+                break;
+            case 'i':
+                gen._iterations = strtoul(argv[iarg], NULL, 0);
+                break;
+            case 'm':
+                if (!parse_mix(gen._mix, argv[iarg]))
+                {
+                    fprintf(stderr, "Bad item mix\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'a':
+                asmfile = argv[iarg];
+                break;
+            }
+        }
+        else
+            binfile = argv[iarg];
+    }
+
+    if (!binfile)
+    {
+        fprintf(stderr, "Missing binary file name\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    //le champ d'adresse limite la taille des segments
+    if (gen._textsize < 1 || gen._textsize > 1000000 || gen._datasize < 1
+        || gen._datasize > MAX_ADDRESS / 2 - 64 || gen._iterations < 1 || gen._iterations > 0x7ffff)
+    {
+        fprintf(stderr, "Sizes out of range\n");
+        exit(EXIT_FAILURE);
+    }
+    if (gen._nfunctions == UINT32_MAX)
+        gen._nfunctions = gen._textsize / 200;
+    if (!gen._calldepth)
+        gen._nfunctions = 0;
+    if (!gen._seed)
+        gen._seed = 1;
+    for (Item_Kind kind = 0; kind < NITEMS; kind++)
+        gen._total += gen._mix[kind];
+    //les éléments de calcul garantissent la progression de la génération
+    if (gen._total == gen._mix[ITEM_CALL] + gen._mix[ITEM_LOOP])
+    {
+        gen._mix[ITEM_LOAD]++;
+        gen._total++;
+    }
+
+    Instruction *text;
+    unsigned textsize;
+    uint64_t cost = generate(&gen, &text, &textsize);
+
+    //zone statique, compteurs de boucle, puis pile : adresses de retour et
+    //mots empilés de chaque corps, à chaque niveau d'appel et de boucle
+    unsigned dataend = gen._datasize + gen._nloops;
+    unsigned datasize = dataend + (gen._calldepth + 1) * (MAX_PENDING * (gen._loopdepth + 1) + 1) + MINSTACKSIZE;
+    //une cible de branchement doit aussi être une adresse de données valide
+    if (datasize < textsize)
+        datasize = textsize;
+    Word *data = calloc(datasize, sizeof(Word));
+    if (!data || textsize > MAX_ADDRESS || datasize > MAX_ADDRESS)
+    {
+        fprintf(stderr, "Program too large\n");
+        exit(1);
+    }
+    for (unsigned addr = 0; addr < gen._datasize; addr++)
+        data[addr] = pick(&gen, 1000);
+
+    if (!write_bin(binfile, text, textsize, data, datasize, dataend))
+    {
+        perror(binfile);
+        exit(1);
+    }
+    if (asmfile && !write_asm(asmfile, &gen, text, textsize, data, datasize, dataend))
+    {
+        perror(asmfile);
+        exit(1);
+    }
+    printf("%s: %u instructions, %u data words, at most %" PRIu64 " instructions executed\n",
+           binfile, textsize, datasize, cost);
+
+    for (unsigned f = 0; f <= gen._nfunctions; f++)
+        free(gen._functions[f]._code);
+    free(gen._functions);
+    free(gen._first);
+    free(gen._uncalled);
+    free(text);
+    free(data);
+    return 0;
+}
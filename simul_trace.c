@@ -0,0 +1,171 @@
+/*!
+ * \file simul_trace.c
+ * \brief Décodage d'une trace binaire (outil simul-trace)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "btrace.h"
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul-trace [options] tracefile\n");
+    printf("where options are:\n"
+           "\t-p lo:hi\tOnly show instructions at addresses lo to hi (inclusive)\n"
+           "\t-o opcode\tOnly show this opcode (e.g. CALL); may be repeated\n"
+           "\t-v\tAlso show the effects of each instruction\n"
+           "\t-h\tprint this help message\n"
+           "The trace file is produced by test_simul -B. Instructions are\n"
+           "printed in the format of the test_simul text trace.\n");
+}
+
+//! Affichage des effets d'une instruction
+/*!
+ * \param prec l'enregistrement de l'instruction
+ */
+static void print_effects(const Trace_Record *prec)
+{
+    static const char cc_names[] = "UZPN";
+
+    if (prec->_flags & BT_REG)
+        printf("\tR%02d = 0x%08x\n", prec->_reg, prec->_regval);
+    if (prec->_flags & BT_CC)
+        printf("\tCC = %c\n", cc_names[prec->_cc & 3]);
+    if (prec->_flags & BT_MEM)
+        printf("\tData[0x%04x] = 0x%08x\n", prec->_memaddr, prec->_memval);
+}
+
+//! Décodeur de trace binaire
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-p lo:hi</dt><dd>n'affiche que les instructions dont l'adresse est
+ *   comprise entre \c lo et \c hi (bornes incluses, en décimal ou en
+ *   hexadécimal avec le préfixe \c 0x).</dd>
+ *
+ *   <dt>-o code</dt><dd>n'affiche que les instructions de ce code opération
+ *   (\c LOAD, \c CALL...) ; l'option peut être répétée.</dd>
+ *
+ *   <dt>-v</dt><dd>affiche aussi les effets de chaque instruction (registre,
+ *   code condition, mot de données).</dd>
+ * </dl>
+ */
+int main(int argc, char *argv[])
+{
+    unsigned lo = 0, hi = ~0u;
+    bool opcodes[LAST_COP + 1];
+    bool filter_opcodes = false;
+    bool verbose = false;
+    char *tracefile = NULL;
+
+    memset(opcodes, 0, sizeof(opcodes));
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] == '-')
+            switch (argv[iarg][1])
+            {
+            case 'p':
+            {
+                char *end;
+                if (iarg + 1 >= argc)
+                {
+                    fprintf(stderr, "Missing address range after -p\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                ++iarg;
+                lo = strtoul(argv[iarg], &end, 0);
+                if (*end != ':' || (hi = strtoul(end + 1, &end, 0), *end != '\0'))
+                {
+                    fprintf(stderr, "Bad address range: %s\n", argv[iarg]);
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'o':
+            {
+                unsigned cop;
+                if (iarg + 1 >= argc)
+                {
+                    fprintf(stderr, "Missing opcode after -o\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                ++iarg;
+                // les codes opération sont acceptés en minuscules
+                for (char *p = argv[iarg]; *p; p++)
+                    *p = toupper((unsigned char) *p);
+                for (cop = 0; cop <= LAST_COP; cop++)
+                    if (strcmp(argv[iarg], cop_names[cop]) == 0)
+                        break;
+                if (cop > LAST_COP)
+                {
+                    fprintf(stderr, "Unknown opcode: %s\n", argv[iarg]);
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                opcodes[cop] = true;
+                filter_opcodes = true;
+                break;
+            }
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+                usage();
+                exit(EXIT_SUCCESS);
+            default:
+                fprintf(stderr, "Unknown option: %s\n", argv[iarg]);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+        else if (!tracefile)
+            tracefile = argv[iarg];
+        else
+            fprintf(stderr, "Trailing options ignored...\n");
+    }
+
+    if (!tracefile)
+    {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    Trace_Reader reader;
+    Trace_Record rec;
+    Instruction prefix = { ._raw = 0 };
+    unsigned prefixpc = 0;
+
+    btrace_open(&reader, tracefile);
+    while (btrace_read(&reader, &rec))
+    {
+        Instruction instr = { ._raw = rec._raw };
+        unsigned cop = instr.instr_generic._cop;
+        // Un préfixe EXT exécuté juste avant complète l'opérande affiché
+        Instruction prev = rec._pc == prefixpc + 1 ? prefix : (Instruction) { ._raw = 0 };
+        prefix = instr;
+        prefixpc = rec._pc;
+
+        if (rec._pc < lo || rec._pc > hi)
+            continue;
+        if (filter_opcodes && (cop > LAST_COP || !opcodes[cop]))
+            continue;
+        printf("TRACE: EXECUTING: 0x%04x: ", rec._pc);
+        print_prefixed(prev, instr, rec._pc);
+        printf("\n");
+        if (verbose)
+            print_effects(&rec);
+    }
+    btrace_close(&reader);
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+/*!
+ * \file snapshot.c
+ * \brief Instantanés d'une machine.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+// memfd_create() n'est pas POSIX
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "snapshot.h"
+#include "container.h"
+#include "verify.h"
+
+//! Création d'un fichier anonyme
+/*!
+ * \return le descripteur du fichier, ou -1 (voir \c errno)
+ */
+static int anonymous_file(void){
+#ifdef MFD_CLOEXEC
+	int fd = memfd_create("simul-snapshot", MFD_CLOEXEC);
+	if(fd >= 0) return fd;
+#endif
+	//à défaut, un fichier temporaire déjà détruit
+	FILE *f = tmpfile();
+	if(!f) return -1;
+	int fd2 = dup(fileno(f));
+	fclose(f);
+	return fd2;
+}
+
+//! Taille de l'image du segment de données (en octets)
+static inline size_t image_size(const Snapshot *ps){
+	return (size_t) ps->_datasize * sizeof(Word);
+}
+
+//! Projection privée de l'image du segment de données
+/*!
+ * \param ps l'instantané
+ * \return le segment de données, ou MAP_FAILED
+ */
+static Word *map_image(const Snapshot *ps){
+	return mmap(NULL, image_size(ps), PROT_READ | PROT_WRITE, MAP_PRIVATE, ps->_fd, 0);
+}
+
+//! Mise d'une machine dans l'état du processeur d'un instantané
+/*!
+ * \param pmach la machine
+ * \param ps l'instantané
+ */
+static void set_state(Machine *pmach, const Snapshot *ps){
+	memcpy(pmach->_registers, ps->_registers, sizeof(pmach->_registers));
+	pmach->_pc = ps->_pc;
+	pmach->_cc = ps->_cc;
+	pmach->_steps = ps->_steps;
+	pmach->_trapbase = ps->_trapbase;
+	pmach->_intrap = ps->_intrap;
+	pmach->_trapcc = ps->_trapcc;
+	pmach->_fault = ERR_NOERROR;
+	pmach->_fault_addr = 0;
+}
+
+/*!
+ * \param ps l'instantané
+ * \param pmach la machine (arrêtée)
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool take_snapshot(Snapshot *ps, const Machine *pmach){
+	const char *image = (const char *) pmach->_data;
+	int saved_errno;
+
+	ps->_textsize = pmach->_textsize;
+	ps->_datasize = pmach->_datasize;
+	ps->_dataend = pmach->_dataend;
+	ps->_fd = -1;
+
+	//copie du programme
+	if(!(ps->_text = malloc((ps->_textsize ? ps->_textsize : 1) * sizeof(Instruction)))) return false;
+	memcpy(ps->_text, pmach->_text, ps->_textsize * sizeof(Instruction));
+
+	//image du segment de données : les pages nulles restent des trous du fichier
+	if((ps->_fd = anonymous_file()) < 0 || ftruncate(ps->_fd, image_size(ps)) < 0) goto fail;
+	for(size_t done = 0 ; done < image_size(ps) ; ){
+		size_t len = image_size(ps) - done;
+		if(len > DATA_PAGE_WORDS * sizeof(Word)) len = DATA_PAGE_WORDS * sizeof(Word);
+		if(zero_words((const Word *) (image + done), len / sizeof(Word))){
+			done += len;
+			continue;
+		}
+		ssize_t n = pwrite(ps->_fd, image + done, len, done);
+		if(n < 0) goto fail;
+		done += n;
+	}
+
+	decode_text(&ps->_decoded, ps->_textsize, ps->_text);
+	verify_text(&ps->_decoded, ps->_textsize, ps->_datasize);
+	memcpy(ps->_registers, pmach->_registers, sizeof(ps->_registers));
+	ps->_pc = pmach->_pc;
+	ps->_cc = pmach->_cc;
+	ps->_steps = pmach->_steps;
+	ps->_trapbase = pmach->_trapbase;
+	ps->_intrap = pmach->_intrap;
+	ps->_trapcc = pmach->_trapcc;
+	return true;
+
+fail:
+	saved_errno = errno;
+	if(ps->_fd >= 0) close(ps->_fd);
+	free(ps->_text);
+	errno = saved_errno;
+	return false;
+}
+
+/*!
+ * \param pmach la machine
+ * \param ps l'instantané
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool restore_snapshot(Machine *pmach, const Snapshot *ps){
+	if(pmach->_textsize != ps->_textsize || pmach->_datasize != ps->_datasize){
+		errno = EINVAL;
+		return false;
+	}
+	if(pmach->_datamap){
+		//nouvelle projection : les pages modifiées depuis l'instantané sont abandonnées
+		Word *data = map_image(ps);
+		if(data == MAP_FAILED) return false;
+		munmap(pmach->_datamap, pmach->_datamaplen);
+		pmach->_data = data;
+		pmach->_datamap = data;
+		pmach->_datamaplen = image_size(ps);
+	} else {
+		//segment alloué ou statique : on y recopie l'image
+		char *image = (char *) pmach->_data;
+		for(size_t done = 0 ; done < image_size(ps) ; ){
+			ssize_t n = pread(ps->_fd, image + done, image_size(ps) - done, done);
+			if(n <= 0){
+				if(n == 0) errno = EIO;
+				return false;
+			}
+			done += n;
+		}
+	}
+	pmach->_dataend = ps->_dataend;
+	set_state(pmach, ps);
+	return true;
+}
+
+/*!
+ * \param pmach la nouvelle machine
+ * \param ps l'instantané
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool fork_machine(Machine *pmach, const Snapshot *ps){
+	Word *data = map_image(ps);
+	if(data == MAP_FAILED) return false;
+
+	load_decoded(pmach, ps->_textsize, ps->_text, ps->_decoded, ps->_datasize, data, ps->_dataend);
+	pmach->_datamap = data;
+	pmach->_datamaplen = image_size(ps);
+	pmach->_snapshot = ps;
+	set_state(pmach, ps);
+	return true;
+}
+
+/*!
+ * \param ps l'instantané
+ */
+void free_snapshot(Snapshot *ps){
+	close(ps->_fd);
+	free(ps->_text);
+	free_decoded(&ps->_decoded);
+	ps->_fd = -1;
+	ps->_text = NULL;
+}
+
+/*!
+ * \param ps l'instantané
+ * \param file le nom du fichier
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool save_snapshot(const Snapshot *ps, const char *file){
+	Machine mach;
+	FILE *f;
+	int saved_errno;
+
+	if(!fork_machine(&mach, ps)) return false;
+	if(!(f = fopen(file, "w"))){
+		saved_errno = errno;
+		free_program(&mach);
+		errno = saved_errno;
+		return false;
+	}
+	bool ok = write_container(&mach, f, NULL, CONTAINER_LZ | CONTAINER_STATE);
+	saved_errno = errno;
+	if(fclose(f) != 0 && ok){
+		ok = false;
+		saved_errno = errno;
+	}
+	free_program(&mach);
+	errno = saved_errno;
+	return ok;
+}
+
+/*!
+ * \param ps l'instantané
+ * \param file le nom du fichier
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool load_snapshot(Snapshot *ps, const char *file){
+	Machine mach;
+
+	if(!load_binary(&mach, file)) return false;
+	bool ok = take_snapshot(ps, &mach);
+	int saved_errno = errno;
+	free_program(&mach);
+	errno = saved_errno;
+	return ok;
+}
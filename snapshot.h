@@ -0,0 +1,120 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+/*!
+ * \file snapshot.h
+ * \brief Instantanés d'une machine.
+ *
+ * Un instantané fige l'état complet d'une machine : registres, compteur
+ * ordinal, code condition, état des trappes, nombre d'instructions
+ * exécutées et contenu du segment de données. On peut ensuite y ramener une
+ * machine (restore_snapshot()) ou en tirer autant de machines indépendantes
+ * que l'on veut (fork_machine()), pour explorer plusieurs suites d'une même
+ * exécution sans la refaire depuis load_program().
+ *
+ * L'image du segment de données est rangée dans un fichier anonyme. Chaque
+ * copie en fait une projection privée : les pages sont partagées tant
+ * qu'elles ne sont pas modifiées, et seule une page écrite est copiée (par
+ * le système, page par page). Restaurer ou copier un instantané ne coûte
+ * donc qu'une projection, quelle que soit la taille des données.
+ *
+ * Un instantané s'enregistre dans un fichier au format conteneur (voir
+ * container.h), avec une section d'état : read_program() reprend alors
+ * l'exécution là où elle en était.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+
+//! Instantané d'une machine
+typedef struct Snapshot
+{
+    // Programme, propre à l'instantané et partagé par ses copies
+    Instruction *_text;		//!< Segment de texte
+    unsigned _textsize;		//!< Taille du segment de texte
+    Decoded_Text _decoded;	//!< Table de micro-opérations
+
+    // Segment de données
+    int _fd;			//!< Fichier anonyme contenant l'image du segment
+    unsigned _datasize;		//!< Taille du segment de données
+    unsigned _dataend;		//!< Première adresse libre après les données statiques
+
+    // Processeur
+    unsigned _pc;		//!< Compteur ordinal
+    Condition_Code _cc;		//!< Code condition
+    Word _registers[NREGISTERS];//!< Registres généraux
+    uint64_t _steps;		//!< Nombre d'instructions exécutées
+    unsigned _trapbase;		//!< Adresse de la table des trappes
+    bool _intrap;		//!< Dans un traitant de trappe ?
+    Condition_Code _trapcc;	//!< Code condition au moment de la trappe
+} Snapshot;
+
+//! Prise d'un instantané
+/*!
+ * Le segment de texte et la table de micro-opérations sont recopiés :
+ * l'instantané ne dépend plus de la machine.
+ *
+ * \param ps l'instantané
+ * \param pmach la machine (arrêtée)
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool take_snapshot(Snapshot *ps, const Machine *pmach);
+
+//! Retour d'une machine à un instantané
+/*!
+ * La machine doit exécuter le même programme que celle dont l'instantané a
+ * été pris. Son segment de données est remplacé par une projection de
+ * l'instantané si c'était déjà une projection (programme lu par
+ * read_program() ou copie d'instantané) ; sinon l'image y est recopiée. La
+ * configuration (trace, sondes) est conservée.
+ *
+ * \param pmach la machine
+ * \param ps l'instantané
+ * \return faux en cas d'erreur (voir \c errno ; \c EINVAL si les tailles des
+ * segments diffèrent)
+ */
+bool restore_snapshot(Machine *pmach, const Snapshot *ps);
+
+//! Création d'une machine à partir d'un instantané
+/*!
+ * La machine est initialisée comme par load_program(), puis placée dans
+ * l'état de l'instantané. Elle partage avec lui le segment de texte et la
+ * table de micro-opérations : l'instantané doit lui survivre. On la libère
+ * par free_program().
+ *
+ * \param pmach la nouvelle machine
+ * \param ps l'instantané
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool fork_machine(Machine *pmach, const Snapshot *ps);
+
+//! Libération d'un instantané
+/*!
+ * \param ps l'instantané (dont il ne doit plus rester de copie)
+ */
+void free_snapshot(Snapshot *ps);
+
+//! Enregistrement d'un instantané dans un fichier
+/*!
+ * Le fichier est au format conteneur compressé, avec une section d'état.
+ *
+ * \param ps l'instantané
+ * \param file le nom du fichier
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool save_snapshot(const Snapshot *ps, const char *file);
+
+//! Lecture d'un instantané enregistré
+/*!
+ * Tout programme binaire peut être lu ; sans section d'état, l'instantané
+ * est celui du début de l'exécution.
+ *
+ * \param ps l'instantané
+ * \param file le nom du fichier
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool load_snapshot(Snapshot *ps, const char *file);
+
+#endif
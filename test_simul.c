@@ -5,9 +5,21 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include "machine.h"
 #include "debug.h"
+#include "btrace.h"
+#include "snapshot.h"
+#include "verify.h"
+#include "cfg.h"
+#include "profile.h"
+#include "callgraph.h"
+#include "timing.h"
+#include "cache.h"
+#include "predict.h"
+#include "record.h"
 
 //! Segment de texte
 extern Instruction text[];
@@ -24,6 +36,91 @@ extern const unsigned dataend;
 //! Taille utile du segment de données
 extern const unsigned datasize;  
 
+//! Nombre d'instructions les plus exécutées affichées avec -s
+#define PROFILE_TOP 10
+
+//! Profil en cours (options -s et -J)
+static Profile *profile = NULL;
+
+//! Afficher le bilan du profil ?
+static bool profile_print = false;
+
+//! Fichier JSON du profil (option -J)
+static const char *profile_json = NULL;
+
+//! Profil par sous-programme en cours (option -P)
+static Call_Profile *callprofile = NULL;
+
+//! Fichier des piles repliées (option -P)
+static const char *folded_file = NULL;
+
+//! Modèle de temps en cours (option -c)
+static Timing_Model *timing = NULL;
+
+//! Simulateur de caches en cours (option -m)
+static Cache_Sim *caches = NULL;
+
+//! Prédicteurs de branchements en cours (option -p)
+static Predictor predictors[PREDICT_MAX];
+
+//! Nombre de prédicteurs en cours
+static unsigned npredictors = 0;
+
+//! Bilan des profils
+/*!
+ * Appelée à la fin de l'exécution, ou à la terminaison du simulateur si
+ * error() l'arrête avant.
+ */
+static void report_profile(void)
+{
+    if (npredictors)
+    {
+        for (unsigned i = 0; i < npredictors; i++)
+            predictor_stop(&predictors[i]);
+        print_predictors(predictors, npredictors, PROFILE_TOP);
+        for (unsigned i = 0; i < npredictors; i++)
+            free_predictor(&predictors[i]);
+        npredictors = 0;
+    }
+    if (caches)
+    {
+        cache_stop(caches);
+        print_cache(caches, PROFILE_TOP);
+        free_cache(caches);
+        caches = NULL;
+    }
+    if (timing)
+    {
+        timing_stop(timing);
+        print_timing(timing, PROFILE_TOP);
+        free_timing(timing);
+        timing = NULL;
+    }
+    if (callprofile)
+    {
+        callgraph_stop(callprofile);
+        print_callgraph(callprofile);
+        FILE *f = fopen(folded_file, "w");
+        if (!f || !write_folded_stacks(callprofile, f) || fclose(f) != 0)
+            perror(folded_file);
+        free_callgraph(callprofile);
+        callprofile = NULL;
+    }
+    if (!profile)
+        return;
+    profile_stop(profile);
+    if (profile_print)
+        print_profile(profile, PROFILE_TOP);
+    if (profile_json)
+    {
+        FILE *f = fopen(profile_json, "w");
+        if (!f || !write_profile_json(profile, f) || fclose(f) != 0)
+            perror(profile_json);
+    }
+    free_profile(profile);
+    profile = NULL;
+}
+
 //! Help message.
 /*!
  * Printed with option \c -h.
@@ -35,11 +132,30 @@ static void usage()
            "\t-d\tDebug mode (interactive execution)\n"
            "\t-b\tA binary file is provided\n"
            "\t-l\tDo not execute; just display the listing\n"
+           "\t-V\tDisplay the load-time verifier diagnostics\n"
+           "\t-G file\tWrite the control flow graph into file (DOT format)\n"
+           "\t-s\tPrint execution statistics (instructions, time, MIPS, hot instructions)\n"
+           "\t-J file\tWrite the execution counters into file (JSON format)\n"
+           "\t-P file\tProfile subroutines; write folded stacks into file (flame graphs)\n"
+           "\t-c file\tTiming model: cycles, CPI and stalls, with latencies read from file\n"
+           "\t-m spec\tData cache simulation, spec is size:assoc:line[:lru|plru|random][,L2...]\n"
+           "\t-p spec\tBranch predictors, spec is static,bimodal:bits,gshare:bits:history,ras:depth\n"
+           "\t-e engine\tExecution engine: switch (default), threaded or jit\n"
+           "\t-t level\tTrace level: off, branch (branches/calls/returns) or full (default)\n"
+           "\t-B file\tWrite a binary execution trace into file (see simul-trace)\n"
+           "\t-z\tCompress the binary trace (with -B)\n"
+           "\t-F format\tFormat of dump.bin: raw (default), container or lz (compressed container)\n"
+           "\t-T addr\tDeliver errors as traps, with the trap table at data address addr\n"
+           "\t-S n:file\tStop after n instructions and save a snapshot into file\n"
+           "\t-R\tRecord the execution, for reverse execution in debug mode (-d)\n"
            "\t-h\tprint this help message\n"
            "If -b is given, the next argument must be a file name containing\n"
            "a valid program in binary format. Otherwise an internally defined\n"
            "example program is used; the program is also dumped in binary into\n"
-           "the file dump.bin\n");
+           "the file dump.bin\n"
+           "A snapshot is a binary file: with -b, execution resumes where it stopped.\n"
+           "The threaded and jit engines produce no trace and ignore -d;\n"
+           "with -B, execution always uses the switch engine.\n");
 }
 
 //! Programme de test
@@ -53,6 +169,63 @@ static void usage()
  *   fichier doit être fourni également en paramètre de la ligne de
  *   commande ; sans cette option, on exécute un programme de test prédéfini.</dd>
  *
+ *   <dt>-V</dt><dd>affichage du diagnostic du vérificateur (voir verify.h) :
+ *   instructions fautives et adresses absolues non prouvées.</dd>
+ *
+ *   <dt>-G fichier</dt><dd>graphe de flot de contrôle du programme (voir
+ *   cfg.h) écrit dans ce fichier au format DOT ; les sous-programmes et les
+ *   boucles sont aussi affichés.</dd>
+ *
+ *   <dt>-s</dt><dd>bilan de l'exécution (voir profile.h) : nombre
+ *   d'instructions, durée, débit et instructions les plus exécutées.</dd>
+ *
+ *   <dt>-J fichier</dt><dd>compteurs d'exécution écrits dans ce fichier au
+ *   format JSON.</dd>
+ *
+ *   <dt>-P fichier</dt><dd>profil par sous-programme (voir callgraph.h) :
+ *   comptes inclusifs et exclusifs, arcs d'appel, et piles repliées écrites
+ *   dans ce fichier pour les outils de « flame graph ».</dd>
+ *
+ *   <dt>-c fichier</dt><dd>modèle de temps (voir timing.h) dont les
+ *   latences et pénalités sont lues dans ce fichier : nombre de cycles, CPI
+ *   et suspensions par instruction.</dd>
+ *
+ *   <dt>-m description</dt><dd>simulation des caches de données (voir
+ *   cache.h), par exemple \c 256:4:4,4096:8:8:plru : succès et défauts par
+ *   niveau et par instruction.</dd>
+ *
+ *   <dt>-p description</dt><dd>évaluation de prédicteurs de branchements
+ *   côte à côte (voir predict.h), par exemple \c static,gshare:12:8,ras:16 :
+ *   taux de prédictions fausses global et par instruction.</dd>
+ *
+ *   <dt>-e moteur</dt><dd>choix du moteur d'exécution : \c switch (simul(),
+ *   par défaut), \c threaded (simul_threaded()) ou \c jit (simul_jit()).</dd>
+ *
+ *   <dt>-t niveau</dt><dd>niveau de trace de simul() : \c off, \c branch
+ *   (branchements, appels et retours) ou \c full (par défaut).</dd>
+ *
+ *   <dt>-B fichier</dt><dd>trace binaire de l'exécution dans ce fichier
+ *   (voir btrace.h), indépendante du niveau de trace ; elle se relit avec
+ *   l'outil \c simul-trace.</dd>
+ *
+ *   <dt>-z</dt><dd>compression de la trace binaire.</dd>
+ *
+ *   <dt>-F format</dt><dd>format du fichier dump.bin : \c raw (ancien
+ *   format, par défaut), \c container (voir container.h) ou \c lz
+ *   (conteneur compressé).</dd>
+ *
+ *   <dt>-T adresse</dt><dd>les erreurs sont délivrées au programme comme des
+ *   trappes ; la table des trappes est à cette adresse du segment de données
+ *   (voir \link Trap_Slot \endlink).</dd>
+ *
+ *   <dt>-S n:fichier</dt><dd>arrêt après \c n instructions et enregistrement
+ *   d'un instantané dans ce fichier (voir snapshot.h) ; lu avec \c -b, il
+ *   reprend l'exécution là où elle s'est arrêtée.</dd>
+ *
+ *   <dt>-R</dt><dd>enregistrement de l'exécution (voir record.h) : en mode
+ *   pas à pas, on peut alors revenir en arrière, y compris après une
+ *   erreur.</dd>
+ *
  * </dl>
  */
 int main(int argc, char *argv[])
@@ -60,7 +233,23 @@ int main(int argc, char *argv[])
     bool debug = false;
     bool binfile = false;
     bool no_exec = false;
+    bool verify = false;
+    char *cfgfile = NULL;
+    char *timingfile = NULL;
+    Cache_Config cache_config;
+    bool cache_wanted = false;
+    Predictor_Config predictor_configs[PREDICT_MAX];
+    unsigned npredictor_configs = 0;
+    enum { SWITCH, THREADED, JIT } engine = SWITCH;
+    Trace_Level trace_level = TRACE_FULL;
     char *programfile = NULL;
+    char *btracefile = NULL;
+    bool btrace_delta = false;
+    unsigned trapbase = TRAP_NONE;
+    Dump_Format dump_format = DUMP_RAW;
+    char *snapshotfile = NULL;
+    uint64_t snapshot_steps = 0;
+    bool record = false;
 
     if (argc > 1) 
     {
@@ -78,6 +267,186 @@ int main(int argc, char *argv[])
                  case 'l': 
                     no_exec = true;
                     break;
+                case 'V':
+                    verify = true;
+                    break;
+                case 'G':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing file name after -G\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    cfgfile = argv[++iarg];
+                    break;
+                case 's':
+                    profile_print = true;
+                    break;
+                case 'J':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing file name after -J\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    profile_json = argv[++iarg];
+                    break;
+                case 'P':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing file name after -P\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    folded_file = argv[++iarg];
+                    break;
+                case 'c':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing file name after -c\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    timingfile = argv[++iarg];
+                    break;
+                case 'm':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing cache description after -m\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ++iarg;
+                    if (!parse_cache_config(&cache_config, argv[iarg]))
+                    {
+                        fprintf(stderr, "Bad cache description: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    cache_wanted = true;
+                    break;
+                case 'p':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing predictor description after -p\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ++iarg;
+                    if (!parse_predictors(predictor_configs, argv[iarg], &npredictor_configs))
+                    {
+                        fprintf(stderr, "Bad predictor description: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'e':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing engine name after -e\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ++iarg;
+                    if (strcmp(argv[iarg], "threaded") == 0)
+                        engine = THREADED;
+                    else if (strcmp(argv[iarg], "jit") == 0)
+                        engine = JIT;
+                    else if (strcmp(argv[iarg], "switch") == 0)
+                        engine = SWITCH;
+                    else
+                    {
+                        fprintf(stderr, "Unknown engine: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 't':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing trace level after -t\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ++iarg;
+                    if (strcmp(argv[iarg], "off") == 0)
+                        trace_level = TRACE_OFF;
+                    else if (strcmp(argv[iarg], "branch") == 0)
+                        trace_level = TRACE_BRANCH;
+                    else if (strcmp(argv[iarg], "full") == 0)
+                        trace_level = TRACE_FULL;
+                    else
+                    {
+                        fprintf(stderr, "Unknown trace level: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'B':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing file name after -B\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    btracefile = argv[++iarg];
+                    break;
+                case 'z':
+                    btrace_delta = true;
+                    break;
+                case 'F':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing format after -F\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ++iarg;
+                    if (strcmp(argv[iarg], "raw") == 0)
+                        dump_format = DUMP_RAW;
+                    else if (strcmp(argv[iarg], "container") == 0)
+                        dump_format = DUMP_CONTAINER;
+                    else if (strcmp(argv[iarg], "lz") == 0)
+                        dump_format = DUMP_CONTAINER_LZ;
+                    else
+                    {
+                        fprintf(stderr, "Unknown dump format: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'S':
+                {
+                    char *end;
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing n:file after -S\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ++iarg;
+                    snapshot_steps = strtoull(argv[iarg], &end, 0);
+                    if (*end != ':' || end[1] == '\0')
+                    {
+                        fprintf(stderr, "Bad snapshot specification: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    snapshotfile = end + 1;
+                    break;
+                }
+                case 'R':
+                    record = true;
+                    break;
+                case 'T':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Missing trap table address after -T\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    trapbase = strtoul(argv[++iarg], NULL, 0);
+                    break;
                   case 'h':
                     usage();
                     exit(EXIT_SUCCESS);
@@ -101,22 +470,131 @@ int main(int argc, char *argv[])
         read_program(&mach, programfile);   
 
     printf("\n*** Sauvegarde des programmes et données initiales en format binaire ***\n\n");
+    mach._dumpformat = dump_format;
     dump_memory(&mach);
 
     printf("\n*** Machine state before execution ***\n");
     print_program(&mach);
     print_data(&mach);
     print_cpu(&mach);
+    if (verify)
+        print_verify(&mach);
+    if (cfgfile)
+    {
+        Cfg cfg;
+        build_cfg(&cfg, &mach);
+        FILE *f = fopen(cfgfile, "w");
+        if (!f || !write_cfg_dot(&cfg, f) || fclose(f) != 0)
+        {
+            perror(cfgfile);
+            exit(1);
+        }
+        print_cfg(&cfg);
+        free_cfg(&cfg);
+    }
 
     if (no_exec) 
         return 0;
 
+    Binary_Trace btrace;
+    if (btracefile)
+        btrace_start(&btrace, &mach, btracefile, btrace_delta);
+
+    Profile prof;
+    Call_Profile callprof;
+    Timing_Model timing_model;
+    Cache_Sim cache_sim;
+    for (unsigned i = 0; i < npredictor_configs; i++)
+        predictor_start(&predictors[i], &mach, &predictor_configs[i]);
+    npredictors = npredictor_configs;
+    if (cache_wanted)
+    {
+        cache_start(&cache_sim, &mach, &cache_config);
+        caches = &cache_sim;
+    }
+    if (timingfile)
+    {
+        Timing_Config config;
+        unsigned line;
+        if (!read_timing_config(&config, timingfile, &line))
+        {
+            if (line)
+                fprintf(stderr, "%s:%u: ", timingfile, line);
+            perror(timingfile);
+            exit(1);
+        }
+        timing_start(&timing_model, &mach, &config);
+        timing = &timing_model;
+    }
+    if (profile_print || profile_json)
+    {
+        profile_start(&prof, &mach);
+        profile = &prof;
+    }
+    if (folded_file)
+    {
+        callgraph_start(&callprof, &mach);
+        callprofile = &callprof;
+    }
+    if (profile || callprofile || timing || caches || npredictors)
+        atexit(report_profile);
+
     printf("\n*** Execution trace ***\n\n");
-    simul(&mach, debug);
+    mach._trace = trace_level;
+    // un instantané repris garde sa table des trappes
+    if (trapbase != TRAP_NONE)
+        mach._trapbase = trapbase;
+    // le premier point de reprise contient la table des trappes
+    Recorder recorder;
+    if (record)
+        record_start(&recorder, &mach);
+    if (snapshotfile)
+    {
+        Run_Status status = run_program(&mach, snapshot_steps);
+        if (status == RUN_FAULT)
+            error(mach._fault, mach._fault_addr);
+        if (status == RUN_BUDGET)
+        {
+            Snapshot snapshot;
+            if (!take_snapshot(&snapshot, &mach) || !save_snapshot(&snapshot, snapshotfile))
+            {
+                perror(snapshotfile);
+                exit(1);
+            }
+            free_snapshot(&snapshot);
+            printf("\n*** Snapshot after %" PRIu64 " instructions saved into %s ***\n",
+                   mach._steps, snapshotfile);
+        }
+    }
+    else if (engine == THREADED)
+        simul_threaded(&mach);
+    else if (engine == JIT)
+        simul_jit(&mach);
+    else
+        simul(&mach, debug);
+
+    if (profile)
+        profile_stop(profile);
+    if (callprofile)
+        callgraph_stop(callprofile);
+    if (timing)
+        timing_stop(timing);
+    if (caches)
+        cache_stop(caches);
+    for (unsigned i = 0; i < npredictors; i++)
+        predictor_stop(&predictors[i]);
+    if (btracefile)
+        btrace_stop(&btrace);
+    if (record)
+    {
+        record_stop(&recorder);
+        free_record(&recorder);
+    }
 
     printf("\n*** Machine state after execution ***\n");
     print_cpu(&mach);
     print_data(&mach);
+    report_profile();
 
     return 0; 
 }
@@ -0,0 +1,329 @@
+/*!
+ * \file threaded.c
+ * \brief Moteur d'exécution à code enfilé direct (\e direct threading).
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ *
+ * Chaque instruction pré-décodée est traduite en une cellule qui contient
+ * directement l'adresse de son traitant. Les traitants sont des étiquettes
+ * d'une même fonction et chacun se termine par son propre saut indirect vers
+ * le traitant de l'instruction suivante : il n'y a ni appel de fonction par
+ * instruction, ni aiguillage central unique que le prédicteur de branchement
+ * du processeur hôte aurait du mal à prévoir.
+ *
+ * Ce moteur utilise l'extension GNU C des étiquettes comme valeurs (\c &&label
+ * et \c goto \c *). Sans compilateur GNU, simul_threaded() se contente
+ * d'appeler simul(). Si des sondes sont attachées à la machine ou si une
+ * table de trappes est installée, on se replie sur execute_program(), qui sait
+ * notifier les unes et délivrer les autres.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "machine.h"
+#include "exec.h"
+#include "error.h"
+
+#ifdef __GNUC__
+
+//! Cellule de code enfilé
+typedef struct
+{
+    const void *_handler;       //!< Adresse du traitant (étiquette)
+    int32_t _operand;           //!< Valeur, adresse, déplacement ou code d'erreur
+    uint8_t _regcond;           //!< Numéro de registre ou condition
+    uint8_t _rindex;            //!< Numéro du registre d'index
+} Threaded_Op;
+
+//! Pointeur de pile
+#define SP R[NREGISTERS - 1]
+
+//! Saut vers le traitant de l'instruction à l'adresse pc
+#define DISPATCH() goto *(op = &code[pc])->_handler
+
+//! Passage à l'instruction suivante en séquence
+/*!
+ * La cellule d'indice textsize est une sentinelle qui signale le débordement
+ * du segment de texte : aucun test n'est nécessaire ici.
+ */
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+
+//! Rupture de séquence vers l'adresse t
+#define JUMP(t) do { pc = (t); if (pc >= textsize) goto segtext; DISPATCH(); } while (0)
+
+//! Erreur à l'exécution de l'instruction courante
+/*!
+ * Comme dans simul(), le compteur ordinal désigne l'instruction suivante au
+ * moment de l'erreur, qui est confiée à fault() : l'hôte peut la reprendre
+ * (\c _abort). Aucun traitant ne modifie l'état avant ses vérifications.
+ */
+#define FAULT(err) FAULT_AT((err), pc + 1, pc)
+
+//! Erreur à l'adresse addr, le compteur ordinal valant next
+#define FAULT_AT(err, next, addr) \
+    do { Error e_ = (err); pmach->_pc = (next); pmach->_cc = cc; free(code); fault(pmach, e_, (addr)); } while (0)
+
+//! Vérifie qu'une adresse appartient au segment de données
+#define CHECK_DATA(a) do { if ((a) > datasize - 1) FAULT(ERR_SEGDATA); } while (0)
+
+//! Vérifie qu'une adresse de pile (SP, ou SP + 1 avant de dépiler) est dans la pile
+#define CHECK_STACK(s) do { if ((s) < dataend || (s) >= datasize) FAULT(ERR_SEGSTACK); } while (0)
+
+/*!
+ * Le code enfilé est construit à chaque appel à partir de la table de
+ * micro-opérations de la machine : les adresses des étiquettes ne sont
+ * connues qu'à l'intérieur de cette fonction.
+ *
+ * \param pmach la machine en cours d'exécution
+ */
+void simul_threaded(Machine *pmach)
+{
+	//traitants indicés par micro-opération (voir Micro_Op)
+	static const void *handlers[NUOPS] = {
+		[UOP_FAULT] = &&fault,
+		[UOP_NOP] = &&nop,
+		[UOP_LOAD_IMM] = &&load_imm, [UOP_LOAD_ABS] = &&load_abs, [UOP_LOAD_IDX] = &&load_idx,
+		[UOP_STORE_ABS] = &&store_abs, [UOP_STORE_IDX] = &&store_idx,
+		[UOP_ADD_IMM] = &&add_imm, [UOP_ADD_ABS] = &&add_abs, [UOP_ADD_IDX] = &&add_idx,
+		[UOP_SUB_IMM] = &&sub_imm, [UOP_SUB_ABS] = &&sub_abs, [UOP_SUB_IDX] = &&sub_idx,
+		[UOP_BRANCH_ABS] = &&branch_abs, [UOP_BRANCH_IDX] = &&branch_idx,
+		[UOP_CALL_ABS] = &&call_abs, [UOP_CALL_IDX] = &&call_idx,
+		[UOP_RET] = &&ret,
+		[UOP_PUSH_IMM] = &&push_imm, [UOP_PUSH_ABS] = &&push_abs, [UOP_PUSH_IDX] = &&push_idx,
+		[UOP_POP_ABS] = &&pop_abs, [UOP_POP_IDX] = &&pop_idx,
+		[UOP_HALT] = &&halt,
+		[UOP_RTT] = &&rtt,
+		[UOP_BRANCH_CHK] = &&branch_chk, [UOP_CALL_CHK] = &&call_chk,
+		[UOP_PUSH_CHK] = &&push_chk, [UOP_POP_CHK] = &&pop_chk,
+	};
+
+	//les traitants ne notifient pas les sondes, ne prennent pas de point de reprise et ne délivrent pas de trappe
+	if(pmach->_probes || pmach->_recorder || pmach->_trapbase != TRAP_NONE){
+		execute_program(pmach, TRACE_OFF);
+		return;
+	}
+
+	const Decoded_Text *pdec = &pmach->_decoded;
+	const unsigned textsize = pmach->_textsize;
+	Threaded_Op *code;
+
+	//une cellule de plus pour la sentinelle de fin de segment
+	if(!(code = malloc((textsize + 1) * sizeof(Threaded_Op)))){
+		perror("Erreur d'allocation mémoire pour le code enfilé dans <threaded.c:simul_threaded>");
+		exit(1);
+	}
+	for(unsigned i = 0 ; i < textsize ; i++){
+		code[i]._handler = handlers[pdec->_uop[i]];
+		code[i]._operand = pdec->_operand[i];
+		code[i]._regcond = pdec->_regcond[i];
+		code[i]._rindex = pdec->_rindex[i];
+	}
+	code[textsize]._handler = &&segtext;
+
+	//l'état du processeur utile à chaque instruction est gardé en local
+	Word *R = pmach->_registers;
+	Word *D = pmach->_data;
+	const unsigned datasize = pmach->_datasize;
+	const unsigned dataend = pmach->_dataend;
+	Condition_Code cc = pmach->_cc;
+	unsigned pc = pmach->_pc;
+	const Threaded_Op *op;
+	unsigned a;
+	Word v;
+
+	JUMP(pc);
+
+fault:
+	FAULT(op->_operand);
+nop:
+	NEXT();
+
+load_imm:
+	R[op->_regcond] = op->_operand;
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+load_abs:
+	a = op->_operand;
+	R[op->_regcond] = D[a];
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+load_idx:
+	a = R[op->_rindex] + op->_operand;
+	CHECK_DATA(a);
+	R[op->_regcond] = D[a];
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+
+store_abs:
+	a = op->_operand;
+	D[a] = R[op->_regcond];
+	NEXT();
+store_idx:
+	a = R[op->_rindex] + op->_operand;
+	CHECK_DATA(a);
+	D[a] = R[op->_regcond];
+	NEXT();
+
+add_imm:
+	R[op->_regcond] += op->_operand;
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+add_abs:
+	a = op->_operand;
+	R[op->_regcond] += D[a];
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+add_idx:
+	a = R[op->_rindex] + op->_operand;
+	CHECK_DATA(a);
+	R[op->_regcond] += D[a];
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+
+sub_imm:
+	R[op->_regcond] -= op->_operand;
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+sub_abs:
+	a = op->_operand;
+	R[op->_regcond] -= D[a];
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+sub_idx:
+	a = R[op->_rindex] + op->_operand;
+	CHECK_DATA(a);
+	R[op->_regcond] -= D[a];
+	cc = condition_code(R[op->_regcond]);
+	NEXT();
+
+branch_abs:
+	if(condition_holds(cc, op->_regcond)){
+		//cible prouvée dans les segments de texte et de données
+		pc = op->_operand;
+		DISPATCH();
+	}
+	NEXT();
+branch_idx:
+	if(condition_holds(cc, op->_regcond)){
+		a = R[op->_rindex] + op->_operand;
+		CHECK_DATA(a);
+		JUMP(a);
+	}
+	NEXT();
+
+call_abs:
+	if(condition_holds(cc, op->_regcond)){
+		CHECK_STACK(SP);
+		D[SP--] = pc + 1;
+		pc = op->_operand;
+		DISPATCH();
+	}
+	NEXT();
+call_idx:
+	if(condition_holds(cc, op->_regcond)){
+		CHECK_STACK(SP);
+		//l'adresse indexée par SP voit sa valeur après l'empilement
+		a = R[op->_rindex] + op->_operand;
+		if(op->_rindex == NREGISTERS - 1) a -= 1;
+		CHECK_DATA(a);
+		D[SP--] = pc + 1;
+		JUMP(a);
+	}
+	NEXT();
+
+ret:
+	CHECK_STACK(SP + 1);
+	SP += 1;
+	JUMP(D[SP]);
+
+push_imm:
+	CHECK_STACK(SP);
+	D[SP--] = op->_operand;
+	NEXT();
+push_abs:
+	CHECK_STACK(SP);
+	v = D[(uint32_t) op->_operand];
+	D[SP--] = v;
+	NEXT();
+push_idx:
+	CHECK_STACK(SP);
+	a = R[op->_rindex] + op->_operand;
+	CHECK_DATA(a);
+	v = D[a];
+	D[SP--] = v;
+	NEXT();
+
+pop_abs:
+	CHECK_STACK(SP + 1);
+	SP += 1;
+	D[(uint32_t) op->_operand] = D[SP];
+	NEXT();
+pop_idx:
+	CHECK_STACK(SP + 1);
+	//l'adresse indexée par SP voit sa valeur après le dépilement
+	a = R[op->_rindex] + op->_operand;
+	if(op->_rindex == NREGISTERS - 1) a += 1;
+	CHECK_DATA(a);
+	SP += 1;
+	D[a] = D[SP];
+	NEXT();
+
+	//adresses absolues non prouvées par le vérificateur (voir verify.h)
+branch_chk:
+	if(condition_holds(cc, op->_regcond)){
+		a = op->_operand;
+		CHECK_DATA(a);
+		JUMP(a);
+	}
+	NEXT();
+call_chk:
+	if(condition_holds(cc, op->_regcond)){
+		CHECK_STACK(SP);
+		a = op->_operand;
+		CHECK_DATA(a);
+		D[SP--] = pc + 1;
+		JUMP(a);
+	}
+	NEXT();
+push_chk:
+	CHECK_STACK(SP);
+	a = op->_operand;
+	CHECK_DATA(a);
+	v = D[a];
+	D[SP--] = v;
+	NEXT();
+pop_chk:
+	CHECK_STACK(SP + 1);
+	a = op->_operand;
+	CHECK_DATA(a);
+	SP += 1;
+	D[a] = D[SP];
+	NEXT();
+
+rtt:
+	//sans table de trappes, on n'est jamais dans un traitant
+	FAULT(ERR_ILLEGAL);
+
+segtext:
+	//comme dans execute_program(), l'erreur vient avant l'instruction
+	FAULT_AT(ERR_SEGTEXT, pc, pc);
+
+halt:
+	pmach->_pc = pc + 1;
+	pmach->_cc = cc;
+	free(code);
+	warning(WARN_HALT, pc);
+}
+
+#else
+
+/*!
+ * Sans l'extension GNU C, on se replie sur la boucle de simulation standard.
+ *
+ * \param pmach la machine en cours d'exécution
+ */
+void simul_threaded(Machine *pmach)
+{
+	simul(pmach, false);
+}
+
+#endif
@@ -0,0 +1,262 @@
+/*!
+ * \file timing.c
+ * \brief Modèle de temps d'exécution (cycles et suspensions).
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "timing.h"
+
+//! Longueur maximale d'une ligne du fichier de configuration
+#define LINE_MAX_LENGTH 256
+
+/*!
+ * \param pconf les paramètres
+ */
+void timing_default(Timing_Config *pconf){
+	for(unsigned cop = 0 ; cop < TIMING_NCOPS ; cop++) pconf->_latency[cop] = 1;
+	pconf->_load_use = 1;
+	pconf->_branch = 2;
+	pconf->_call = 2;
+	pconf->_ret = 2;
+}
+
+//! Paramètre désigné par un nom, ou NULL
+static unsigned *parameter(Timing_Config *pconf, const char *name){
+	for(unsigned cop = 0 ; cop < TIMING_NCOPS ; cop++){
+		if(strcmp(name, cop_names[cop]) == 0) return &pconf->_latency[cop];
+	}
+	if(strcmp(name, "load_use") == 0) return &pconf->_load_use;
+	if(strcmp(name, "branch") == 0) return &pconf->_branch;
+	if(strcmp(name, "call") == 0) return &pconf->_call;
+	if(strcmp(name, "ret") == 0) return &pconf->_ret;
+	return NULL;
+}
+
+/*!
+ * \param pconf les paramètres
+ * \param file le nom du fichier
+ * \param pline numéro de la ligne invalide
+ * \return faux en cas d'erreur (voir \c errno)
+ */
+bool read_timing_config(Timing_Config *pconf, const char *file, unsigned *pline){
+	char line[LINE_MAX_LENGTH];
+	FILE *f = fopen(file, "r");
+
+	timing_default(pconf);
+	*pline = 0;
+	if(!f) return false;
+	while(fgets(line, sizeof(line), f)){
+		char name[32], extra[2];
+		unsigned value, *pparam;
+		int n;
+
+		++*pline;
+		line[strcspn(line, "#\n")] = '\0';
+		n = sscanf(line, "%31s %u %1s", name, &value, extra);
+		if(n == EOF) continue;
+		if(n != 2 || !(pparam = parameter(pconf, name))){
+			fclose(f);
+			errno = EINVAL;
+			return false;
+		}
+		*pparam = value;
+	}
+	*pline = 0;
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+//! L'instruction lit-elle le registre \c reg ?
+/*!
+ * Un branchement ou un appel conditionnel lit en plus le code condition,
+ * positionné par le chargement : il dépend donc toujours de lui.
+ */
+static bool uses(Instruction instr, unsigned reg){
+	unsigned cop = instr.instr_generic._cop;
+	if(instr.instr_generic._indexed && instr.instr_indexed._rindex == reg) return true;
+	switch(cop){
+		case STORE : case ADD : case SUB :
+			return instr.instr_generic._regcond == reg;
+		case BRANCH :
+			return instr.instr_generic._regcond != NC;
+		case CALL :
+			return instr.instr_generic._regcond != NC || reg == NREGISTERS - 1;
+		//SP implicite
+		case RET : case PUSH : case POP :
+			return reg == NREGISTERS - 1;
+		default:
+			return false;
+	}
+}
+
+//! Sonde : début d'une instruction
+static void on_before(Probe *pp, Machine *pmach, unsigned addr){
+	Timing_Model *ptm = (Timing_Model *) pp;
+	Instruction instr = pmach->_text[addr];
+	unsigned cop = instr.instr_generic._cop;
+	unsigned latency = ptm->_config._latency[cop < TIMING_NCOPS ? cop : ILLOP];
+
+	ptm->_instructions++;
+	ptm->_base += latency;
+	ptm->_pc_base[addr] += latency;
+	if(ptm->_pending_reg >= 0 && uses(instr, ptm->_pending_reg)){
+		ptm->_load_use += ptm->_config._load_use;
+		ptm->_pc_load_use[addr] += ptm->_config._load_use;
+	}
+	ptm->_pending_reg = -1;
+	ptm->_current = instr;
+	ptm->_read = false;
+}
+
+//! Sonde : lecture d'un mot de données
+static void on_read(Probe *pp, Machine *pmach, unsigned addr, unsigned daddr){
+	((Timing_Model *) pp)->_read = true;
+}
+
+//! Pénalité de contrôle de l'instruction d'adresse \c addr
+static inline void control(Timing_Model *ptm, unsigned addr, unsigned penalty){
+	ptm->_control += penalty;
+	ptm->_pc_control[addr] += penalty;
+}
+
+//! Sonde : décision d'un branchement ou d'un appel
+static void on_branch(Probe *pp, Machine *pmach, unsigned addr, bool taken){
+	Timing_Model *ptm = (Timing_Model *) pp;
+	//un appel pris est compté par on_call()
+	if(taken && ptm->_current.instr_generic._cop == BRANCH) control(ptm, addr, ptm->_config._branch);
+}
+
+//! Sonde : appel de sous-programme
+static void on_call(Probe *pp, Machine *pmach, unsigned addr, unsigned target){
+	Timing_Model *ptm = (Timing_Model *) pp;
+	control(ptm, addr, ptm->_config._call);
+}
+
+//! Sonde : retour de sous-programme
+static void on_ret(Probe *pp, Machine *pmach, unsigned addr){
+	Timing_Model *ptm = (Timing_Model *) pp;
+	control(ptm, addr, ptm->_config._ret);
+}
+
+//! Sonde : fin d'une instruction
+static void on_after(Probe *pp, Machine *pmach, unsigned addr){
+	Timing_Model *ptm = (Timing_Model *) pp;
+	switch(ptm->_current.instr_generic._cop){
+		//seules ces instructions chargent un registre depuis la mémoire
+		case LOAD : case ADD : case SUB :
+			if(ptm->_read) ptm->_pending_reg = ptm->_current.instr_generic._regcond;
+			break;
+		default:
+			break;
+	}
+}
+
+//! Allocation d'un tableau de compteurs nuls
+static uint64_t *counters(unsigned n){
+	uint64_t *p = calloc(n ? n : 1, sizeof(uint64_t));
+	if(!p){
+		perror("Erreur d'allocation mémoire pour le modèle de temps dans <timing.c:timing_start>");
+		exit(1);
+	}
+	return p;
+}
+
+/*!
+ * \param ptm le modèle
+ * \param pmach la machine à observer (déjà chargée)
+ * \param pconf les paramètres (copiés)
+ */
+void timing_start(Timing_Model *ptm, Machine *pmach, const Timing_Config *pconf){
+	memset(ptm, 0, sizeof(Timing_Model));
+	ptm->_pmach = pmach;
+	ptm->_config = *pconf;
+	ptm->_pending_reg = -1;
+	ptm->_pc_base = counters(pmach->_textsize);
+	ptm->_pc_load_use = counters(pmach->_textsize);
+	ptm->_pc_control = counters(pmach->_textsize);
+
+	ptm->_probe._before = on_before;
+	ptm->_probe._read = on_read;
+	ptm->_probe._branch = on_branch;
+	ptm->_probe._call = on_call;
+	ptm->_probe._ret = on_ret;
+	ptm->_probe._after = on_after;
+	attach_probe(pmach, &ptm->_probe);
+	ptm->_running = true;
+}
+
+/*!
+ * \param ptm le modèle
+ */
+void timing_stop(Timing_Model *ptm){
+	if(!ptm->_running) return;
+	detach_probe(ptm->_pmach, &ptm->_probe);
+	ptm->_running = false;
+}
+
+//! Adresses par suspensions décroissantes (qsort)
+static const Timing_Model *sort_model;
+static int by_stalls(const void *a, const void *b){
+	unsigned x = *(const unsigned *) a, y = *(const unsigned *) b;
+	uint64_t sx = sort_model->_pc_load_use[x] + sort_model->_pc_control[x];
+	uint64_t sy = sort_model->_pc_load_use[y] + sort_model->_pc_control[y];
+	if(sx != sy) return sx < sy ? 1 : -1;
+	return x < y ? -1 : x > y;
+}
+
+/*!
+ * \param ptm le modèle (arrêté)
+ * \param top le nombre d'instructions à afficher
+ */
+void print_timing(const Timing_Model *ptm, unsigned top){
+	const Machine *pmach = ptm->_pmach;
+	uint64_t cycles = ptm->_base + ptm->_load_use + ptm->_control;
+	double total = cycles ? cycles : 1;
+	unsigned *order = calloc(pmach->_textsize ? pmach->_textsize : 1, sizeof(unsigned));
+	unsigned n = 0;
+
+	if(!order){
+		perror("Erreur d'allocation mémoire pour le modèle de temps dans <timing.c:print_timing>");
+		exit(1);
+	}
+
+	printf("\n### TIMING ###\n\n");
+	printf(" Instructions : %" PRIu64 ", cycles : %" PRIu64 ", CPI : %.3f\n",
+	       ptm->_instructions, cycles, ptm->_instructions ? (double) cycles / ptm->_instructions : 0);
+	printf(" Latencies : %" PRIu64 " (%.1f%%), load-use stalls : %" PRIu64 " (%.1f%%),"
+	       " control penalties : %" PRIu64 " (%.1f%%)\n",
+	       ptm->_base, 100 * ptm->_base / total, ptm->_load_use, 100 * ptm->_load_use / total,
+	       ptm->_control, 100 * ptm->_control / total);
+
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		if(ptm->_pc_load_use[addr] || ptm->_pc_control[addr]) order[n++] = addr;
+	}
+	sort_model = ptm;
+	qsort(order, n, sizeof(unsigned), by_stalls);
+	if(top > n) top = n;
+	printf("\n Stalls by instruction :\n\n\t      cycles     load-use      control\n");
+	for(unsigned i = 0 ; i < top ; i++){
+		unsigned addr = order[i];
+		printf("\t%12" PRIu64 " %12" PRIu64 " %12" PRIu64 "  0x%04x : ",
+		       ptm->_pc_base[addr] + ptm->_pc_load_use[addr] + ptm->_pc_control[addr],
+		       ptm->_pc_load_use[addr], ptm->_pc_control[addr], addr);
+		print_prefixed(text_prefix(pmach->_text, addr), pmach->_text[addr], addr);
+		printf("\n");
+	}
+	free(order);
+}
+
+/*!
+ * \param ptm le modèle (arrêté)
+ */
+void free_timing(Timing_Model *ptm){
+	free(ptm->_pc_base);
+	free(ptm->_pc_load_use);
+	free(ptm->_pc_control);
+	ptm->_pc_base = ptm->_pc_load_use = ptm->_pc_control = NULL;
+}
@@ -0,0 +1,135 @@
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+/*!
+ * \file timing.h
+ * \brief Modèle de temps d'exécution (cycles et suspensions).
+ *
+ * Le modèle de temps est une sonde (voir probe.h) : il observe l'exécution
+ * sans en changer le comportement et, détaché, ne coûte rien. Chaque
+ * instruction coûte la latence de son code opération ; s'y ajoutent des
+ * suspensions (« stalls ») :
+ *
+ *    - chargement-utilisation : une instruction qui a lu un mot de données
+ *    dans un registre (\c LOAD, \c ADD ou \c SUB avec un opérande en
+ *    mémoire, donc dont l'adresse vient de generate_address()) retarde
+ *    l'instruction suivante si celle-ci lit ce registre (opérande, index ou
+ *    SP implicite) ou le code condition (branchement conditionnel) ;
+ *
+ *    - contrôle : un branchement pris, un appel pris ou un retour vident le
+ *    pipeline et coûtent chacun une pénalité.
+ *
+ * Le fichier de configuration contient une ligne par paramètre, un nom et
+ * une valeur entière ; \c # commence un commentaire :
+ *
+ * \code
+ * # latences par code opération
+ * LOAD 2
+ * STORE 2
+ * # pénalités
+ * load_use 1
+ * branch 2
+ * call 3
+ * ret 3
+ * \endcode
+ *
+ * Les paramètres absents gardent leur valeur par défaut (voir
+ * timing_default()).
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+#include "probe.h"
+
+//! Nombre de codes opérations (les codes inconnus coûtent comme \c ILLOP)
+#define TIMING_NCOPS (EXT + 1)
+
+//! Paramètres du modèle de temps (en cycles)
+typedef struct
+{
+    unsigned _latency[TIMING_NCOPS];    //!< Latence de chaque code opération
+    unsigned _load_use;                 //!< Suspension chargement-utilisation
+    unsigned _branch;                   //!< Pénalité d'un branchement pris
+    unsigned _call;                     //!< Pénalité d'un appel pris
+    unsigned _ret;                      //!< Pénalité d'un retour
+} Timing_Config;
+
+//! Modèle de temps attaché à une machine
+typedef struct
+{
+    Probe _probe;               //!< Sonde (premier champ)
+    Machine *_pmach;            //!< Machine observée
+    Timing_Config _config;      //!< Paramètres
+    bool _running;              //!< Sonde attachée ?
+
+    uint64_t _instructions;     //!< Nombre d'instructions exécutées
+    uint64_t _base;             //!< Cycles des latences
+    uint64_t _load_use;         //!< Cycles de suspension chargement-utilisation
+    uint64_t _control;          //!< Cycles de pénalité de contrôle
+
+    uint64_t *_pc_base;         //!< Cycles des latences, par adresse
+    uint64_t *_pc_load_use;     //!< Suspensions chargement-utilisation, par adresse
+    uint64_t *_pc_control;      //!< Pénalités de contrôle, par adresse
+
+    // État du pipeline
+    Instruction _current;       //!< Instruction en cours
+    bool _read;                 //!< L'instruction en cours a-t-elle lu la mémoire ?
+    int _pending_reg;           //!< Registre en cours de chargement (-1 : aucun)
+} Timing_Model;
+
+//! Paramètres par défaut
+/*!
+ * Une instruction par cycle, un cycle de suspension
+ * chargement-utilisation, deux cycles de pénalité par rupture de séquence.
+ *
+ * \param pconf les paramètres
+ */
+void timing_default(Timing_Config *pconf);
+
+//! Lecture d'un fichier de configuration
+/*!
+ * Les paramètres sont d'abord mis à leur valeur par défaut.
+ *
+ * \param pconf les paramètres
+ * \param file le nom du fichier
+ * \return faux si le fichier ne peut être lu (voir \c errno) ou contient une
+ * ligne invalide (\c errno vaut alors \c EINVAL et \c *pline son numéro)
+ */
+bool read_timing_config(Timing_Config *pconf, const char *file, unsigned *pline);
+
+//! Début de la mesure
+/*!
+ * \param ptm le modèle
+ * \param pmach la machine à observer (déjà chargée)
+ * \param pconf les paramètres (copiés)
+ */
+void timing_start(Timing_Model *ptm, Machine *pmach, const Timing_Config *pconf);
+
+//! Fin de la mesure
+/*!
+ * La sonde est détachée. Sans effet si la mesure est déjà arrêtée.
+ *
+ * \param ptm le modèle
+ */
+void timing_stop(Timing_Model *ptm);
+
+//! Affichage du bilan
+/*!
+ * Nombre de cycles et d'instructions, CPI, répartition des cycles, puis les
+ * \c top instructions qui ont le plus suspendu le pipeline.
+ *
+ * \param ptm le modèle (arrêté)
+ * \param top le nombre d'instructions à afficher
+ */
+void print_timing(const Timing_Model *ptm, unsigned top);
+
+//! Libération des compteurs
+/*!
+ * \param ptm le modèle (arrêté)
+ */
+void free_timing(Timing_Model *ptm);
+
+#endif
@@ -0,0 +1,130 @@
+/*!
+ * \file verify.c
+ * \brief Vérification du programme au chargement.
+ * \author {L. GIN, A. EL-AMRANI, F. PINEL, C. BOINAUD}
+ */
+
+#include <stdio.h>
+#include "verify.h"
+#include "error.h"
+
+/*!
+ * \param pdi l'instruction, réécrite si son adresse absolue est hors segment
+ * \param textsize taille du segment de texte
+ * \param datasize taille du segment de données
+ */
+void verify_instruction(Decoded_Instruction *pdi, unsigned textsize, unsigned datasize){
+	unsigned address = pdi->_operand;
+	bool in_data = address < datasize;
+
+	switch(pdi->_uop){
+		//erreur à coup sûr, avant tout autre effet
+		case UOP_LOAD_ABS :
+		case UOP_STORE_ABS :
+		case UOP_ADD_ABS :
+		case UOP_SUB_ABS :
+			if(!in_data){
+				pdi->_uop = UOP_FAULT;
+				pdi->_mode = ADDR_NONE;
+				pdi->_operand = ERR_SEGDATA;
+			}
+			break;
+		//la pile est vérifiée d'abord : l'erreur n'est pas connue d'avance
+		case UOP_PUSH_ABS :
+			if(!in_data) pdi->_uop = UOP_PUSH_CHK;
+			break;
+		case UOP_POP_ABS :
+			if(!in_data) pdi->_uop = UOP_POP_CHK;
+			break;
+		//la cible doit aussi être dans le segment de texte
+		case UOP_BRANCH_ABS :
+			if(!in_data || address >= textsize) pdi->_uop = UOP_BRANCH_CHK;
+			break;
+		case UOP_CALL_ABS :
+			if(!in_data || address >= textsize) pdi->_uop = UOP_CALL_CHK;
+			break;
+		default:
+			break;
+	}
+}
+
+/*!
+ * \param pdec la table
+ * \param textsize taille du segment de texte
+ * \param datasize taille du segment de données
+ */
+void verify_text(Decoded_Text *pdec, unsigned textsize, unsigned datasize){
+	for(unsigned addr = 0 ; addr < textsize ; addr++){
+		Decoded_Instruction di = decoded_at(pdec, addr);
+		verify_instruction(&di, textsize, datasize);
+		pdec->_uop[addr] = di._uop;
+		pdec->_mode[addr] = di._mode;
+		pdec->_operand[addr] = di._operand;
+	}
+}
+
+/*!
+ * \param uop la micro-opération (voir \link Micro_Op \endlink)
+ * \return le verdict correspondant
+ */
+Verdict verdict(unsigned uop){
+	switch(uop){
+		case UOP_NOP :
+		case UOP_LOAD_IMM : case UOP_LOAD_ABS :
+		case UOP_STORE_ABS :
+		case UOP_ADD_IMM : case UOP_ADD_ABS :
+		case UOP_SUB_IMM : case UOP_SUB_ABS :
+		case UOP_BRANCH_ABS :
+		case UOP_HALT :
+			return VERDICT_SAFE;
+		case UOP_FAULT :
+			return VERDICT_FAULT;
+		//accès indexés, pile, RTT (légal seulement dans un traitant)
+		default:
+			return VERDICT_DYNAMIC;
+	}
+}
+
+/*!
+ * \param pmach la machine
+ * \param prep le bilan à remplir
+ */
+void verify_report(const Machine *pmach, Verify_Report *prep){
+	for(unsigned v = VERDICT_SAFE ; v <= VERDICT_FAULT ; v++) prep->_count[v] = 0;
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		prep->_count[verdict(pmach->_decoded._uop[addr])]++;
+	}
+}
+
+/*!
+ * \param pmach la machine
+ */
+void print_verify(const Machine *pmach){
+	const Decoded_Text *pdec = &pmach->_decoded;
+	Verify_Report report;
+
+	printf("\n### VERIFICATION ###\n\n");
+
+	for(unsigned addr = 0 ; addr < pmach->_textsize ; addr++){
+		Error err;
+		switch(pdec->_uop[addr]){
+			case UOP_FAULT :
+				err = pdec->_operand[addr];
+				break;
+			//l'erreur n'a lieu que si la pile ou la condition le permet
+			case UOP_BRANCH_CHK : case UOP_CALL_CHK :
+			case UOP_PUSH_CHK : case UOP_POP_CHK :
+				err = (unsigned) pdec->_operand[addr] < pmach->_datasize ? ERR_SEGTEXT : ERR_SEGDATA;
+				break;
+			default:
+				continue;
+		}
+		printf("\t0x%04x : %-9s ", addr, pdec->_uop[addr] == UOP_FAULT ? "FAULT" : "DYNAMIC");
+		print_prefixed(text_prefix(pmach->_text, addr), pmach->_text[addr], addr);
+		printf("\t(%s)\n", error_name(err));
+	}
+
+	verify_report(pmach, &report);
+	printf("\n Safe : %u, dynamic checks : %u, faults : %u\n",
+	       report._count[VERDICT_SAFE], report._count[VERDICT_DYNAMIC], report._count[VERDICT_FAULT]);
+}
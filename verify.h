@@ -0,0 +1,91 @@
+#ifndef _VERIFY_H_
+#define _VERIFY_H_
+
+/*!
+ * \file verify.h
+ * \brief Vérification du programme au chargement.
+ *
+ * Le décodage (voir decode.h) écarte déjà les codes opérations inconnus, les
+ * conditions inexistantes et les adressages immédiats interdits. Une fois la
+ * taille du segment de données connue, le vérificateur va plus loin : toute
+ * adresse absolue est comparée une fois pour toutes aux tailles des
+ * segments, et la table de micro-opérations est réécrite en conséquence.
+ *
+ *    - Une adresse absolue dans le segment de données (et, pour un
+ *    branchement ou un appel, aussi dans le segment de texte) est prouvée :
+ *    la micro-opération \c UOP_xxx_ABS est conservée et son traitant ne fait
+ *    plus aucune vérification d'adresse.
+ *
+ *    - Un chargement, un rangement, une addition ou une soustraction à une
+ *    adresse absolue hors du segment de données échoue à coup sûr : il
+ *    devient \c UOP_FAULT (\c ERR_SEGDATA).
+ *
+ *    - Un empilement, un dépilement, un branchement ou un appel dont
+ *    l'adresse absolue n'est pas prouvée devient \c UOP_xxx_CHK : l'erreur
+ *    dépend de la pile ou de la condition, l'adresse est donc vérifiée à
+ *    l'exécution.
+ *
+ * Seuls les accès indexés et les accès à la pile paient encore une
+ * vérification à chaque exécution. load_program() et take_snapshot()
+ * vérifient toujours la table qu'ils construisent : les traitants des
+ * micro-opérations \c UOP_xxx_ABS comptent dessus.
+ */
+
+#include "machine.h"
+
+//! Verdict du vérificateur sur une instruction
+typedef enum
+{
+    VERDICT_SAFE = 0,   //!< Aucune vérification à l'exécution
+    VERDICT_DYNAMIC,    //!< Accès indexé ou à la pile, vérifié à l'exécution
+    VERDICT_FAULT,      //!< Erreur à coup sûr si l'instruction est exécutée
+} Verdict;
+
+//! Bilan de la vérification d'un programme
+typedef struct
+{
+    unsigned _count[VERDICT_FAULT + 1];    //!< Nombre d'instructions par verdict
+} Verify_Report;
+
+//! Vérification d'une instruction décodée
+/*!
+ * \param pdi l'instruction, réécrite si son adresse absolue est hors segment
+ * \param textsize taille du segment de texte
+ * \param datasize taille du segment de données
+ */
+void verify_instruction(Decoded_Instruction *pdi, unsigned textsize, unsigned datasize);
+
+//! Vérification de toute une table de micro-opérations
+/*!
+ * Une table déjà vérifiée pour les mêmes tailles de segments est inchangée.
+ *
+ * \param pdec la table
+ * \param textsize taille du segment de texte
+ * \param datasize taille du segment de données
+ */
+void verify_text(Decoded_Text *pdec, unsigned textsize, unsigned datasize);
+
+//! Verdict sur une micro-opération vérifiée
+/*!
+ * \param uop la micro-opération (voir \link Micro_Op \endlink)
+ * \return le verdict correspondant
+ */
+Verdict verdict(unsigned uop);
+
+//! Bilan de la vérification du programme d'une machine
+/*!
+ * \param pmach la machine
+ * \param prep le bilan à remplir
+ */
+void verify_report(const Machine *pmach, Verify_Report *prep);
+
+//! Affichage du diagnostic du vérificateur
+/*!
+ * Les instructions fautives et celles dont l'adresse absolue n'a pas pu être
+ * prouvée sont listées avec l'erreur correspondante, puis le bilan.
+ *
+ * \param pmach la machine
+ */
+void print_verify(const Machine *pmach);
+
+#endif